@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <omp.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <faiss/IndexACORN.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/utils/random.h>
+#include <faiss/utils/utils.h>
+
+/* Level-0 adjacency size (bytes per node) and filtered search QPS of an
+ * ACORN index before and after ACORN::compact_level0().
+ *
+ * usage: bench_acorn_compact_level0 [n] [d] [M] [gamma] [M_beta] [nlabel]
+ */
+
+using namespace faiss;
+
+namespace {
+
+struct Run {
+    double qps;
+    std::vector<idx_t> I;
+};
+
+Run run_search(
+        const IndexACORN& index,
+        size_t nq,
+        const float* xq,
+        int k,
+        char* filter_map,
+        int efs,
+        int nrun) {
+    SearchParametersACORN params;
+    params.efSearch = efs;
+    Run r;
+    r.I.resize(nq * k);
+    std::vector<float> D(nq * k);
+    double best = 1e30;
+    for (int run = 0; run < nrun; run++) {
+        double t0 = getmillisecs();
+        index.search(
+                nq,
+                xq,
+                k,
+                D.data(),
+                r.I.data(),
+                filter_map,
+                nullptr,
+                nullptr,
+                nullptr,
+                true,
+                &params);
+        double t1 = getmillisecs();
+        best = std::min(best, t1 - t0);
+    }
+    r.qps = nq * 1000.0 / best;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atoi(argv[1]) : 200000;
+    int d = argc > 2 ? atoi(argv[2]) : 64;
+    int M = argc > 3 ? atoi(argv[3]) : 32;
+    int gamma = argc > 4 ? atoi(argv[4]) : 12;
+    int M_beta = argc > 5 ? atoi(argv[5]) : 64;
+    int nlabel = argc > 6 ? atoi(argv[6]) : gamma;
+    size_t nq = 1000;
+    int k = 10;
+    int nrun = 3;
+
+    printf("n=%zd d=%d M=%d gamma=%d M_beta=%d nlabel=%d nthreads=%d\n",
+           n,
+           d,
+           M,
+           gamma,
+           M_beta,
+           nlabel,
+           omp_get_max_threads());
+
+    std::vector<float> xb(n * d), xq(nq * d);
+    float_rand(xb.data(), xb.size(), 123);
+    float_rand(xq.data(), xq.size(), 456);
+
+    std::vector<std::vector<int>> metadata(n);
+    std::vector<int64_t> lab(n);
+    int64_rand_max(lab.data(), n, nlabel, 789);
+    for (size_t i = 0; i < n; i++) {
+        metadata[i] = {int(lab[i])};
+    }
+    std::vector<char> filter_map(nq * n);
+    for (size_t q = 0; q < nq; q++) {
+        for (size_t i = 0; i < n; i++) {
+            filter_map[q * n + i] = lab[i] == q % nlabel;
+        }
+    }
+
+    IndexACORNFlat index(d, M, gamma, metadata, M_beta);
+    double t0 = getmillisecs();
+    index.add(n, xb.data());
+    printf("build time %.3f s\n", (getmillisecs() - t0) / 1000);
+
+    int nb0 = index.acorn.nb_neighbors(0);
+    double bytes_plain = nb0 * sizeof(ACORN::storage_idx_t);
+
+    std::vector<int> efss = {16, 32, 64, 128, 256};
+    std::vector<Run> plain;
+    for (int efs : efss) {
+        plain.push_back(run_search(
+                index, nq, xq.data(), k, filter_map.data(), efs, nrun));
+    }
+
+    t0 = getmillisecs();
+    index.acorn.compact_level0();
+    double t_compact = getmillisecs() - t0;
+    double bytes_compact =
+            (index.acorn.level0_codes.size() +
+             index.acorn.level0_code_offsets.size() * sizeof(size_t)) /
+            double(n);
+
+    printf("compaction time %.3f s\n", t_compact / 1000);
+    printf("level0 bytes/node: plain %.2f compact %.2f (ratio %.2f)\n",
+           bytes_plain,
+           bytes_compact,
+           bytes_plain / bytes_compact);
+    printf("efs\tQPS_plain\tQPS_compact\tsame_results\n");
+    for (size_t i = 0; i < efss.size(); i++) {
+        Run c = run_search(
+                index, nq, xq.data(), k, filter_map.data(), efss[i], nrun);
+        printf("%d\t%.1f\t%.1f\t%d\n",
+               efss[i],
+               plain[i].qps,
+               c.qps,
+               int(c.I == plain[i].I));
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <omp.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <faiss/IndexACORN.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/index_io.h>
+#include <faiss/utils/distances.h>
+#include <faiss/utils/random.h>
+#include <faiss/utils/utils.h>
+
+/* Build -> write_index -> read_index -> filtered search round trip of the
+ * ACORN variants (IHNH flat, IHHp PQ, IHHs SQ and the IxRH refine wrapper
+ * over the PQ index). For each one it prints the recall@k against the exact
+ * filtered ground truth, before and after the round trip, and whether the
+ * reloaded index returns the same results.
+ *
+ * usage: bench_acorn_compressed [n] [d] [M] [gamma] [M_beta] [nlabel] [tmpdir]
+ */
+
+using namespace faiss;
+
+namespace {
+
+struct Run {
+    double qps;
+    std::vector<idx_t> I;
+};
+
+Run run_search(
+        const Index& index,
+        size_t nq,
+        const float* xq,
+        int k,
+        char* filter_map,
+        int efs) {
+    SearchParametersACORN params;
+    params.efSearch = efs;
+    Run r;
+    r.I.resize(nq * k);
+    std::vector<float> D(nq * k);
+    double t0 = getmillisecs();
+    if (auto refine = dynamic_cast<const IndexACORNRefine*>(&index)) {
+        dynamic_cast<IndexACORN*>(refine->base_index)->acorn.efSearch = efs;
+        refine->search(
+                nq, xq, k, D.data(), r.I.data(), filter_map, true, &params);
+    } else {
+        auto acorn_index = dynamic_cast<const IndexACORN*>(&index);
+        FAISS_THROW_IF_NOT(acorn_index);
+        const_cast<IndexACORN*>(acorn_index)->acorn.efSearch = efs;
+        acorn_index->search(
+                nq,
+                xq,
+                k,
+                D.data(),
+                r.I.data(),
+                filter_map,
+                nullptr,
+                nullptr,
+                nullptr,
+                true,
+                &params);
+    }
+    r.qps = nq * 1000.0 / (getmillisecs() - t0);
+    return r;
+}
+
+double recall_at_k(
+        const std::vector<idx_t>& I,
+        const std::vector<idx_t>& gt,
+        size_t nq,
+        int k) {
+    size_t found = 0, total = 0;
+    for (size_t q = 0; q < nq; q++) {
+        for (int j = 0; j < k; j++) {
+            idx_t g = gt[q * k + j];
+            if (g < 0) {
+                continue;
+            }
+            total++;
+            found += std::find(I.begin() + q * k, I.begin() + (q + 1) * k, g) !=
+                    I.begin() + (q + 1) * k;
+        }
+    }
+    return total ? double(found) / total : 1.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atoi(argv[1]) : 20000;
+    int d = argc > 2 ? atoi(argv[2]) : 64;
+    int M = argc > 3 ? atoi(argv[3]) : 32;
+    int gamma = argc > 4 ? atoi(argv[4]) : 12;
+    int M_beta = argc > 5 ? atoi(argv[5]) : 64;
+    int nlabel = argc > 6 ? atoi(argv[6]) : gamma;
+    std::string tmpdir = argc > 7 ? argv[7] : "/tmp";
+    size_t nq = 200;
+    int k = 10;
+    int efs = 64;
+
+    printf("n=%zd d=%d M=%d gamma=%d M_beta=%d nlabel=%d nthreads=%d\n",
+           n,
+           d,
+           M,
+           gamma,
+           M_beta,
+           nlabel,
+           omp_get_max_threads());
+
+    std::vector<float> xb(n * d), xq(nq * d);
+    float_rand(xb.data(), xb.size(), 123);
+    float_rand(xq.data(), xq.size(), 456);
+
+    std::vector<std::vector<int>> metadata(n);
+    std::vector<int64_t> lab(n);
+    int64_rand_max(lab.data(), n, nlabel, 789);
+    for (size_t i = 0; i < n; i++) {
+        metadata[i] = {int(lab[i])};
+    }
+    std::vector<char> filter_map(nq * n);
+    for (size_t q = 0; q < nq; q++) {
+        for (size_t i = 0; i < n; i++) {
+            filter_map[q * n + i] = lab[i] == q % nlabel;
+        }
+    }
+
+    // exact filtered ground truth
+    std::vector<idx_t> gt(nq * k, -1);
+#pragma omp parallel for
+    for (size_t q = 0; q < nq; q++) {
+        std::vector<std::pair<float, idx_t>> cand;
+        for (size_t i = 0; i < n; i++) {
+            if (filter_map[q * n + i]) {
+                cand.emplace_back(
+                        fvec_L2sqr(xq.data() + q * d, xb.data() + i * d, d),
+                        i);
+            }
+        }
+        size_t nk = std::min(cand.size(), size_t(k));
+        std::partial_sort(cand.begin(), cand.begin() + nk, cand.end());
+        for (size_t j = 0; j < nk; j++) {
+            gt[q * k + j] = cand[j].second;
+        }
+    }
+
+    // the variants are built from the same vectors and labels
+    auto build_acorn = [&](IndexACORN* index) {
+        index->train(n, xb.data());
+        index->add(n, xb.data());
+        return index;
+    };
+    struct Variant {
+        const char* name;
+        std::function<Index*()> build;
+    };
+    std::vector<Variant> variants = {
+            {"IHNH flat",
+             [&] {
+                 return build_acorn(
+                         new IndexACORNFlat(d, M, gamma, metadata, M_beta));
+             }},
+            {"IHHp PQ",
+             [&] {
+                 return build_acorn(new IndexACORNPQ(
+                         d, d / 8, M, gamma, metadata, M_beta));
+             }},
+            {"IHHs SQ8",
+             [&] {
+                 return build_acorn(new IndexACORNSQ(
+                         d,
+                         ScalarQuantizer::QT_8bit,
+                         M,
+                         gamma,
+                         metadata,
+                         M_beta));
+             }},
+            {"IxRH PQ+refine",
+             [&] {
+                 // the refine index is filled from xb, so the base is built
+                 // first
+                 auto refine = new IndexACORNRefine(
+                         build_acorn(new IndexACORNPQ(
+                                 d, d / 8, M, gamma, metadata, M_beta)),
+                         xb.data());
+                 refine->own_fields = true;
+                 refine->k_factor = 4;
+                 return refine;
+             }},
+    };
+
+    printf("index\tbuild_s\tfile_MB\tQPS\trecall\trecall_reloaded\tsame_results\n");
+    for (auto& v : variants) {
+        double t0 = getmillisecs();
+        std::unique_ptr<Index> index(v.build());
+        double t_build = (getmillisecs() - t0) / 1000;
+
+        Run before = run_search(
+                *index, nq, xq.data(), k, filter_map.data(), efs);
+
+        std::string fname = tmpdir + "/bench_acorn_compressed.index";
+        write_index(index.get(), fname.c_str());
+        FILE* f = fopen(fname.c_str(), "rb");
+        FAISS_THROW_IF_NOT_FMT(f, "cannot open %s", fname.c_str());
+        fseek(f, 0, SEEK_END);
+        double file_mb = ftell(f) / 1e6;
+        fclose(f);
+        std::unique_ptr<Index> reloaded(read_index(fname.c_str()));
+        remove(fname.c_str());
+        FAISS_THROW_IF_NOT_MSG(
+                typeid(*reloaded) == typeid(*index),
+                "read_index returned another index type");
+
+        Run after = run_search(
+                *reloaded, nq, xq.data(), k, filter_map.data(), efs);
+        printf("%s\t%.3f\t%.2f\t%.1f\t%.4f\t%.4f\t%d\n",
+               v.name,
+               t_build,
+               file_mb,
+               before.qps,
+               recall_at_k(before.I, gt, nq, k),
+               recall_at_k(after.I, gt, nq, k),
+               int(before.I == after.I));
+    }
+    return 0;
+}
@@ -55,6 +55,7 @@ struct QueryResult
    float acorn_1_recall;
    size_t acorn_1_n3;
    double filter_time;
+   faiss::PerfCounterValues acorn_perf, acorn_1_perf; // 仅在 perf_counters 时记录
 };
 
 int main(int argc, char *argv[])
@@ -96,6 +97,11 @@ int main(int argc, char *argv[])
    std::vector<int> efs_list;
    int efs_cnt = 0;
    bool if_bfs_filter = true; // true:ACORN原始的
+   bool perf_counters = false; // true: 每个查询记录硬件计数器 (--perf_counters)
+   // 向量文件, 默认 <base_path>/<dataset>_base.fvecs 和 <query_path>/<dataset>_query.fvecs
+   // 格式 (fvecs/bvecs/fbin/u8bin/i8bin/bin) 由文件名和大小识别
+   std::string base_vecs_file, query_vecs_file;
+   bool collect_stats = false; // true: 记录第0层搜索循环的耗时和访问计数 (ACORN_COLLECT_STATS=1)
 
    int opt;
    { // parse arguments
@@ -166,6 +172,32 @@ int main(int argc, char *argv[])
       printf("\n");
       efs_cnt = efs_list.size();
       printf("efs_cnt: %d\n", efs_cnt);
+
+      // optional: [--perf_counters] [--base_vecs <file>] [--query_vecs <file>]
+      for (int i = 16; i < argc; i++)
+      {
+         std::string arg = argv[i];
+         if ((arg == "--base_vecs" || arg == "--query_vecs") && i + 1 < argc)
+            (arg == "--base_vecs" ? base_vecs_file : query_vecs_file) = argv[++i];
+         else if (arg == "--perf_counters")
+            perf_counters = true;
+         else
+         {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            exit(1);
+         }
+      }
+      if (base_vecs_file.empty())
+         base_vecs_file = base_path + "/" + dataset + "_base.fvecs";
+      if (query_vecs_file.empty())
+         query_vecs_file = query_path + "/" + dataset + "_query.fvecs";
+      printf("perf_counters: %d\n", perf_counters);
+      printf("base_vecs: %s\n", base_vecs_file.c_str());
+      printf("query_vecs: %s\n", query_vecs_file.c_str());
+
+      const char *collect_stats_env = getenv("ACORN_COLLECT_STATS");
+      collect_stats = collect_stats_env && atoi(collect_stats_env);
+      printf("collect_stats: %d\n", collect_stats);
    }
 
    omp_set_num_threads(nthreads);
@@ -204,8 +236,7 @@ int main(int argc, char *argv[])
       bool is_base = 0;
       // load_data(dataset, is_base, &d2, &nq, xq);
       // std::string filename =get_file_name(dataset, is_base, BASE_DIR); // TODO:添加数据集名称
-      std::string filename = query_path + "/" + dataset + "_query.fvecs";
-      xq = fvecs_read(filename.c_str(), &d2, &nq);
+      xq = fvecs_read(query_vecs_file.c_str(), &d2, &nq);
       assert(d == d2 ||
              !"query does not have same dimension as expected 128");
       if (d != d2)
@@ -217,7 +248,7 @@ int main(int argc, char *argv[])
                 << std::endl;
       printf("[%.3f s] Loaded query vectors from %s\n",
              elapsed() - t0,
-             filename.c_str());
+             query_vecs_file.c_str());
       aq = load_aq_multi(
           dataset, n_centroids, alpha, N, ATTR_DATA_DIR); // TODO:添加数据集名称
       for (auto &inner_vector : aq)
@@ -273,12 +304,11 @@ int main(int argc, char *argv[])
       size_t nb, d2;
       bool is_base = 1;
       // std::string filename = get_file_name(dataset, is_base, BASE_DIR); // TODO
-      std::string filename = BASE_DIR + "/" + dataset + "_base.fvecs";
-      float *xb = fvecs_read(filename.c_str(), &d2, &nb);
+      float *xb = fvecs_read(base_vecs_file.c_str(), &d2, &nb);
       assert(d == d2 || !"dataset does not dim 128 as expected");
       printf("[%.3f s] Loaded base vectors from file: %s\n",
              elapsed() - t0,
-             filename.c_str());
+             base_vecs_file.c_str());
 
       std::cout << "data loaded, with dim: " << d2 << ", nb=" << nb
                 << std::endl;
@@ -426,6 +456,11 @@ int main(int argc, char *argv[])
             std::vector<double> query_times(nq);
             std::vector<double> query_qps(nq);
             std::vector<size_t> query_n3(nq); // 新增
+            std::vector<faiss::ACORNStats> query_stats(nq);
+            faiss::SearchParametersACORN search_params;
+            search_params.efSearch = efs_list[efs_id];
+            search_params.collect_perf_counters = perf_counters;
+            search_params.collect_stats = collect_stats;
             double t1_x = elapsed();
             hybrid_index.search(
                 nq,
@@ -437,7 +472,9 @@ int main(int argc, char *argv[])
                 &query_times, // 传入时间记录
                 &query_qps,   // 传入QPS记录
                 &query_n3,    // 传入n3记录
-                if_bfs_filter);
+                if_bfs_filter,
+                perf_counters || collect_stats ? &search_params : nullptr,
+                &query_stats);
             double t2_x = elapsed();
 
             printf("[%.3f s] Query results (vector ids, then distances):\n",
@@ -527,6 +564,7 @@ int main(int argc, char *argv[])
                all_query_results[repeat][efs_id][i].acorn_qps = query_qps[i];
                all_query_results[repeat][efs_id][i].acorn_recall = recalls[i];
                all_query_results[repeat][efs_id][i].acorn_n3 = query_n3[i];
+               all_query_results[repeat][efs_id][i].acorn_perf = query_stats[i].perf;
             }
             avg_query_results[repeat][efs_id][0].acorn_time = search_time;
             avg_query_results[repeat][efs_id][0].acorn_qps = qps;
@@ -550,6 +588,13 @@ int main(int argc, char *argv[])
                std::cout << "nreorder: " << stats.nreorder << std::endl;
                printf("average distance computations per query: %f\n",
                       (float)stats.n3 / stats.n1);
+               if (collect_stats)
+               {
+                  printf("candidates loop: %f s (%.0f cycles), neighbors loop: %f s (%.0f cycles)\n",
+                         stats.candidates_loop, stats.candidates_loop_cycles,
+                         stats.neighbors_loop, stats.neighbors_loop_cycles);
+                  printf("neighbors visited: %.0f, skipped: %.0f\n", stats.visits, stats.skips);
+               }
                avg_query_results[repeat][efs_id][0].acorn_n3 = (float)stats.n3 / stats.n1;
             }
          }
@@ -623,6 +668,11 @@ int main(int argc, char *argv[])
             std::vector<double> query_times3(nq);
             std::vector<double> query_qps3(nq);
             std::vector<size_t> query_n33(nq);
+            std::vector<faiss::ACORNStats> query_stats3(nq);
+            faiss::SearchParametersACORN search_params3;
+            search_params3.efSearch = efs_list[efs_id];
+            search_params3.collect_perf_counters = perf_counters;
+            search_params3.collect_stats = collect_stats;
             double t1_x = elapsed();
             hybrid_index_gamma1.search(
                 nq,
@@ -634,7 +684,9 @@ int main(int argc, char *argv[])
                 &query_times3,
                 &query_qps3,
                 &query_n33,
-                if_bfs_filter);
+                if_bfs_filter,
+                perf_counters || collect_stats ? &search_params3 : nullptr,
+                &query_stats3);
             double t2_x = elapsed();
 
             printf("[%.3f s] Query results (vector ids, then distances):\n",
@@ -700,6 +752,7 @@ int main(int argc, char *argv[])
                all_query_results[repeat][efs_id][i].acorn_1_qps = query_qps3[i];
                all_query_results[repeat][efs_id][i].acorn_1_recall = recalls[i];
                all_query_results[repeat][efs_id][i].acorn_1_n3 = query_n33[i];
+               all_query_results[repeat][efs_id][i].acorn_1_perf = query_stats3[i].perf;
             }
             avg_query_results[repeat][efs_id][0].acorn_1_time = search_time;
             avg_query_results[repeat][efs_id][0].acorn_1_qps = qps;
@@ -723,6 +776,13 @@ int main(int argc, char *argv[])
                std::cout << "nreorder: " << stats.nreorder << std::endl;
                printf("average distance computations per query: %f\n",
                       (float)stats.n3 / stats.n1);
+               if (collect_stats)
+               {
+                  printf("candidates loop: %f s (%.0f cycles), neighbors loop: %f s (%.0f cycles)\n",
+                         stats.candidates_loop, stats.candidates_loop_cycles,
+                         stats.neighbors_loop, stats.neighbors_loop_cycles);
+                  printf("neighbors visited: %.0f, skipped: %.0f\n", stats.visits, stats.skips);
+               }
                avg_query_results[repeat][efs_id][0].acorn_1_n3 = (float)stats.n3 / stats.n1;
             }
          }
@@ -731,7 +791,11 @@ int main(int argc, char *argv[])
 
    std::ofstream csv_file(csv_path);
    csv_file << "repeat,efs,QueryID,acorn_Time,acorn_QPS,acorn_Recall,acorn_n3, acorn_build_time,"
-            << "ACORN_1_Time,ACORN_1_QPS,ACORN_1_Recall,ACORN_1_n3, ACORN_1_build_time,FilterMapTime\n";
+            << "ACORN_1_Time,ACORN_1_QPS,ACORN_1_Recall,ACORN_1_n3, ACORN_1_build_time,FilterMapTime";
+   if (perf_counters)
+      csv_file << ",acorn_cycles,acorn_instructions,acorn_LLC_misses,acorn_dTLB_misses"
+               << ",ACORN_1_cycles,ACORN_1_instructions,ACORN_1_LLC_misses,ACORN_1_dTLB_misses";
+   csv_file << "\n";
    std::cout << "repeat_num: " << repeat_num << std::endl;
    for (int repeat; repeat < repeat_num; repeat++)
    {
@@ -748,7 +812,13 @@ int main(int argc, char *argv[])
                      << result.acorn_1_time << "," << result.acorn_1_qps << ","
                      << result.acorn_1_recall << "," << result.acorn_1_n3 << ","
                      << acorn_1_build_time << ","
-                     << result.filter_time << "\n";
+                     << result.filter_time;
+            if (perf_counters)
+               csv_file << "," << result.acorn_perf.cycles << "," << result.acorn_perf.instructions << ","
+                        << result.acorn_perf.llc_misses << "," << result.acorn_perf.dtlb_misses << ","
+                        << result.acorn_1_perf.cycles << "," << result.acorn_1_perf.instructions << ","
+                        << result.acorn_1_perf.llc_misses << "," << result.acorn_1_perf.dtlb_misses;
+            csv_file << "\n";
          }
       }
    }
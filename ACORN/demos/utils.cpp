@@ -60,6 +60,8 @@ using json = nlohmann::json;
 
 #include <zlib.h>
 #include <cstring>
+#include "vecs_io.h"
+#include "label_csr.h"
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -78,38 +80,27 @@ bool fileExists(const std::string &filePath)
 
 float *fvecs_read(const char *fname, size_t *d_out, size_t *n_out)
 {
-   FILE *f = fopen(fname, "r");
-   if (!f)
+   // any format known by the shared reader (fvecs/ivecs/bvecs/fbin/u8bin/i8bin/bin)
+   ANNS::VecsFileInfo info;
+   try
    {
-      fprintf(stderr, "could not open %s\n", fname);
-      perror("");
+      info = ANNS::sniff_vecs_file(fname);
+   }
+   catch (const std::exception &e)
+   {
+      fprintf(stderr, "could not open %s: %s\n", fname, e.what());
       abort();
    }
-   int d;
-   fread(&d, 1, sizeof(int), f);
-   assert((d > 0 && d < 1000000) || !"unreasonable dimension");
-   fseek(f, 0, SEEK_SET);
-   struct stat st;
-   fstat(fileno(f), &st);
-   size_t sz = st.st_size;
-   assert(sz % ((d + 1) * 4) == 0 || !"weird file size");
-   size_t n = sz / ((d + 1) * 4);
-
-   *d_out = d;
-   *n_out = n;
-   float *x = new float[n * (d + 1)];
-   size_t nr = fread(x, sizeof(float), n * (d + 1), f);
-   assert(nr == n * (d + 1) || !"could not read whole file");
-
-   // shift array to remove row headers
-   for (size_t i = 0; i < n; i++)
-      memmove(x + i * d, x + 1 + i * (d + 1), d * sizeof(*x));
-
-   fclose(f);
+   assert((info.dim > 0 && info.dim < 1000000) || !"unreasonable dimension");
+
+   *d_out = info.dim;
+   *n_out = info.num_points;
+   float *x = new float[info.num_points * info.dim];
+   ANNS::read_vecs(fname, info, 0, info.num_points, x);
    return x;
 }
 
-// not very clean, but works as long as sizeof(int) == sizeof(float)
+// ivecs are read bitwise as 4-byte elements
 int *ivecs_read(const char *fname, size_t *d_out, size_t *n_out)
 {
    return (int *)fvecs_read(fname, d_out, n_out);
@@ -387,6 +378,17 @@ template <typename T>
 std::vector<std::vector<T>> load_txt_to_vector_multi(
     const std::string &filepath)
 {
+   // binary CSR label files (UNG/codes/tools/convert_labels) are mmapped
+   if constexpr (std::is_integral_v<T>)
+   {
+      if (ANNS::is_label_csr_file(filepath))
+      {
+         ANNS::LabelCSR csr(filepath);
+         std::cout << "Loaded " << csr.num_points() << " rows from CSR" << std::endl;
+         return csr.to_vectors<T>();
+      }
+   }
+
    std::ifstream file(filepath);
    if (!file.is_open())
    {
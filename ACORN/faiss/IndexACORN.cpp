@@ -10,12 +10,14 @@
 #include <faiss/IndexACORN.h>
 
 #include <omp.h>
+#include <algorithm>
 #include <cassert>
 #include <cinttypes>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 
 #include <queue>
 #include <unordered_set>
@@ -30,6 +32,7 @@
 #include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/impl/FaissAssert.h>
 #include <faiss/utils/Heap.h>
+#include <faiss/utils/PerfCounters.h>
 #include <faiss/utils/distances.h>
 #include <faiss/utils/random.h>
 #include <faiss/utils/sorting.h>
@@ -98,6 +101,24 @@ namespace faiss
             return -(*basedis)(i);
          }
 
+         void distances_batch_4(
+             const idx_t idx0,
+             const idx_t idx1,
+             const idx_t idx2,
+             const idx_t idx3,
+             float &dis0,
+             float &dis1,
+             float &dis2,
+             float &dis3) override
+         {
+            basedis->distances_batch_4(
+                idx0, idx1, idx2, idx3, dis0, dis1, dis2, dis3);
+            dis0 = -dis0;
+            dis1 = -dis1;
+            dis2 = -dis2;
+            dis3 = -dis3;
+         }
+
          /// compute distance between two stored vectors
          float symmetric_dis(idx_t i, idx_t j) override
          {
@@ -122,6 +143,136 @@ namespace faiss
          }
       }
 
+      /* Deferred (lock-free) insertion of the points of one level bucket.
+       * The bucket is cut in batches whose size grows with the graph (at
+       * most 1/8 of the points already inserted, and ntotal / 500) so that
+       * the points of a batch, which do not see each other, are few
+       * compared to the graph they are inserted in. Within a batch the
+       * threads only write the lists of their own points and buffer the
+       * reverse links, which are then sorted by destination, merged in
+       * parallel (each destination by one thread) and written back. */
+      void acorn_add_level_deferred(
+          IndexACORN &index_acorn,
+          size_t n0,
+          const float *x,
+          const int *order,
+          size_t nb,
+          int pt_level,
+          size_t n_in_graph)
+      {
+         ACORN &acorn = index_acorn.acorn;
+         size_t d = index_acorn.d;
+         size_t ntotal = acorn.levels.size();
+         // largest batch, relative to the nb of points
+         size_t max_batch = std::max(size_t(64), ntotal / 500);
+
+         int nt = omp_get_max_threads();
+         std::vector<std::vector<ACORN::ReverseLink>> thread_links(nt);
+         std::vector<ACORN::ReverseLink> links;
+
+         size_t i0 = 0;
+         while (i0 < nb)
+         {
+            size_t bs = std::min(
+                std::max((n_in_graph + i0) / 8, size_t(1)), max_batch);
+            size_t i1 = std::min(i0 + bs, nb);
+
+#pragma omp parallel if (i1 > i0 + 100)
+            {
+               VisitedTable vt(ntotal);
+               DistanceComputer *dis =
+                   storage_distance_computer(index_acorn.storage);
+               ScopeDeleter1<DistanceComputer> del(dis);
+               std::vector<ACORN::ReverseLink> &tl =
+                   thread_links[omp_get_thread_num()];
+
+#pragma omp for schedule(static)
+               for (size_t i = i0; i < i1; i++)
+               {
+                  storage_idx_t pt_id = order[i];
+                  dis->set_query(x + (pt_id - n0) * d);
+                  acorn.add_deferred(*dis, pt_level, pt_id, vt, tl);
+               }
+            }
+
+            // gather and group the reverse links per (dest, level)
+            links.clear();
+            for (auto &tl : thread_links)
+            {
+               links.insert(links.end(), tl.begin(), tl.end());
+               tl.clear();
+            }
+            std::sort(links.begin(), links.end());
+            std::vector<size_t> group_start;
+            for (size_t j = 0; j < links.size(); j++)
+            {
+               if (j == 0 || links[j].dest != links[j - 1].dest ||
+                   links[j].level != links[j - 1].level)
+               {
+                  group_start.push_back(j);
+               }
+            }
+            group_start.push_back(links.size());
+            size_t ngroup = group_start.size() - 1;
+
+            // the merged lists of all the destinations are computed before
+            // any is written back: pruning a level-0 list reads the lists
+            // of its neighbors, which may be destinations themselves
+            std::vector<size_t> list_start(ngroup + 1, 0);
+            for (size_t g = 0; g < ngroup; g++)
+            {
+               list_start[g + 1] = list_start[g] +
+                   acorn.nb_neighbors(links[group_start[g]].level);
+            }
+            std::vector<storage_idx_t> new_lists(list_start[ngroup]);
+
+#pragma omp parallel if (ngroup > 100)
+            {
+               DistanceComputer *dis =
+                   storage_distance_computer(index_acorn.storage);
+               ScopeDeleter1<DistanceComputer> del(dis);
+               std::vector<storage_idx_t> srcs;
+
+#pragma omp for schedule(dynamic, 64)
+               for (size_t g = 0; g < ngroup; g++)
+               {
+                  srcs.clear();
+                  for (size_t j = group_start[g]; j < group_start[g + 1]; j++)
+                  {
+                     srcs.push_back(links[j].src);
+                  }
+                  const ACORN::ReverseLink &rl = links[group_start[g]];
+                  acorn.merge_reverse_links(
+                      *dis,
+                      rl.dest,
+                      srcs.data(),
+                      srcs.size(),
+                      rl.level,
+                      new_lists.data() + list_start[g]);
+               }
+
+#pragma omp for schedule(static)
+               for (size_t g = 0; g < ngroup; g++)
+               {
+                  const ACORN::ReverseLink &rl = links[group_start[g]];
+                  size_t begin, end;
+                  acorn.neighbor_range(rl.dest, rl.level, &begin, &end);
+                  for (size_t i = begin; i < end; i++)
+                  {
+                     acorn.neighbors[i] = ACORN::NeighNode(
+                         new_lists[list_start[g] + i - begin]);
+                  }
+               }
+            }
+
+            if (InterruptCallback::is_interrupted())
+            {
+               FAISS_THROW_MSG("computation interrupted");
+            }
+            i0 = i1;
+         }
+      }
+
       // TODO
       void acorn_add_vertices(
           IndexACORN &index_acorn,
@@ -157,8 +308,10 @@ namespace faiss
             printf("  max_level = %d\n", max_level);
          }
 
-         std::vector<omp_lock_t> locks(ntotal);
-         for (int i = 0; i < ntotal; i++)
+         // the deferred build takes no locks
+         std::vector<omp_lock_t> locks(
+             acorn.deferred_reverse_links ? 0 : ntotal);
+         for (int i = 0; i < locks.size(); i++)
             omp_init_lock(&locks[i]);
 
          // add vectors from highest to lowest level
@@ -214,6 +367,20 @@ namespace faiss
                for (int j = i0; j < i1; j++)
                   std::swap(order[j], order[j + rng2.rand_int(i1 - j)]);
 
+               if (acorn.deferred_reverse_links)
+               {
+                  acorn_add_level_deferred(
+                      index_acorn,
+                      n0,
+                      x,
+                      order.data() + i0,
+                      i1 - i0,
+                      pt_level,
+                      n0 + (n - i1));
+                  i1 = i0;
+                  continue;
+               }
+
                bool interrupt = false;
 
 #pragma omp parallel if (i1 > i0 + 100)
@@ -275,7 +442,7 @@ namespace faiss
             FAISS_ASSERT(i1 == 0);
          }
 
-         for (int i = 0; i < ntotal; i++)
+         for (int i = 0; i < locks.size(); i++)
          {
             omp_destroy_lock(&locks[i]);
          }
@@ -370,7 +537,8 @@ namespace faiss
        std::vector<double> *query_qps,   // 记录每个查询QPS
        std::vector<size_t> *query_n3,    // 记录每个查询的n3
        bool if_bfs_filter,
-       const SearchParameters *params_in) const
+       const SearchParameters *params_in,
+       std::vector<ACORNStats> *query_stats) const
    {
       // omp_set_num_threads(32); // thread=32
       // std::cout << "enter IndexACORN::search" << std::endl;
@@ -391,6 +559,9 @@ namespace faiss
       size_t n1 = 0, n2 = 0, n3 = 0, ndis = 0, nreorder = 0;
       double candidates_loop = 0, neighbors_loop = 0, tuple_unwrap = 0, skips = 0,
              visits = 0; // added for profiling
+      double candidates_loop_cycles = 0, neighbors_loop_cycles = 0;
+      uint64_t cycles = 0, instructions = 0, llc_misses = 0, dtlb_misses = 0;
+      bool collect_perf_counters = params && params->collect_perf_counters;
 
       idx_t check_period =
           InterruptCallback::get_period_hint(acorn.max_level * d * efSearch);
@@ -406,10 +577,19 @@ namespace faiss
             DistanceComputer *dis = storage_distance_computer(storage);
             ScopeDeleter1<DistanceComputer> del(dis);
 
-#pragma omp for reduction(+ : n1, n2, n3, ndis, nreorder, candidates_loop)
+            // counters of this thread, opened only when requested
+            std::unique_ptr<PerfCounters> counters(
+                collect_perf_counters ? new PerfCounters() : nullptr);
+
+#pragma omp for reduction(+ : n1, n2, n3, ndis, nreorder, candidates_loop, \
+                                neighbors_loop, tuple_unwrap, skips, visits, \
+                                candidates_loop_cycles, neighbors_loop_cycles, \
+                                cycles, instructions, llc_misses, dtlb_misses)
             for (idx_t i = i0; i < i1; i++)
             {
                double t_start = omp_get_wtime(); // 记录开始时间
+               if (counters)
+                  counters->start();
                idx_t *idxi = labels + i * k;
                float *simi = distances + i * k;
                char *filters = filter_id_map + i * ntotal;
@@ -442,7 +622,17 @@ namespace faiss
                tuple_unwrap += stats.tuple_unwrap;
                skips += stats.skips;
                visits += stats.visits;
+               candidates_loop_cycles += stats.candidates_loop_cycles;
+               neighbors_loop_cycles += stats.neighbors_loop_cycles;
                maxheap_reorder(k, simi, idxi);
+               if (counters)
+               {
+                  stats.perf = counters->stop();
+                  cycles += stats.perf.cycles;
+                  instructions += stats.perf.instructions;
+                  llc_misses += stats.perf.llc_misses;
+                  dtlb_misses += stats.perf.dtlb_misses;
+               }
                double t_end = omp_get_wtime();
                double elapsed = t_end - t_start;
 
@@ -452,6 +642,8 @@ namespace faiss
                   query_qps->at(i) = 1.0 / elapsed; // QPS = 1/耗时
                if (query_n3)
                   query_n3->at(i) = stats.n3; // 新增
+               if (query_stats)
+                  query_stats->at(i) = stats;
             }
          }
          InterruptCallback::check();
@@ -466,17 +658,24 @@ namespace faiss
          }
       }
 
-      acorn_stats.combine(
-          {n1,
-           n2,
-           n3,
-           ndis,
-           nreorder,
-           candidates_loop,
-           neighbors_loop,
-           tuple_unwrap,
-           skips,
-           visits}); // added for profiling
+      ACORNStats total(
+          n1,
+          n2,
+          n3,
+          ndis,
+          nreorder,
+          candidates_loop,
+          neighbors_loop,
+          tuple_unwrap,
+          skips,
+          visits,
+          candidates_loop_cycles,
+          neighbors_loop_cycles); // added for profiling
+      total.perf.cycles = cycles;
+      total.perf.instructions = instructions;
+      total.perf.llc_misses = llc_misses;
+      total.perf.dtlb_misses = dtlb_misses;
+      acorn_stats.combine(total);
    }
 
    // TODO figure out what do with this
@@ -557,6 +756,8 @@ namespace faiss
           storage,
           "Please use IndexACORNFlat (or variants) instead of IndexACORN directly");
       FAISS_THROW_IF_NOT(is_trained);
+      FAISS_THROW_IF_NOT_MSG(
+          !acorn.is_level0_compact(), "cannot add to a compacted ACORN index");
       int n0 = ntotal;
       storage->add(n, x);
       ntotal = storage->ntotal;
@@ -628,6 +829,194 @@ namespace faiss
       is_trained = true;
    }
 
+   /**************************************************************
+    * IndexACORNPQ implementation
+    **************************************************************/
+
+   namespace
+   {
+      // metadata bound by the default constructors (used when reading an
+      // index, the ACORN struct keeps a reference to it)
+      std::vector<std::vector<int>> no_metadata_multi;
+   } // namespace
+
+   IndexACORNPQ::IndexACORNPQ()
+       : IndexACORN(0, 0, 0, no_metadata_multi, 0) {}
+
+   IndexACORNPQ::IndexACORNPQ(
+       int d,
+       int pq_m,
+       int M,
+       int gamma,
+       std::vector<std::vector<int>> &metadata,
+       int M_beta,
+       int pq_nbits,
+       MetricType metric)
+       : IndexACORN(
+             new IndexPQ(d, pq_m, pq_nbits, metric),
+             M,
+             gamma,
+             metadata,
+             M_beta)
+   {
+      own_fields = true;
+      is_trained = false;
+   }
+
+   void IndexACORNPQ::train(idx_t n, const float *x)
+   {
+      IndexACORN::train(n, x);
+      (dynamic_cast<IndexPQ *>(storage))->pq.compute_sdc_table();
+   }
+
+   /**************************************************************
+    * IndexACORNSQ implementation
+    **************************************************************/
+
+   IndexACORNSQ::IndexACORNSQ()
+       : IndexACORN(0, 0, 0, no_metadata_multi, 0) {}
+
+   IndexACORNSQ::IndexACORNSQ(
+       int d,
+       ScalarQuantizer::QuantizerType qtype,
+       int M,
+       int gamma,
+       std::vector<std::vector<int>> &metadata,
+       int M_beta,
+       MetricType metric)
+       : IndexACORN(
+             new IndexScalarQuantizer(d, qtype, metric),
+             M,
+             gamma,
+             metadata,
+             M_beta)
+   {
+      own_fields = true;
+      is_trained = false;
+   }
+
+   /**************************************************************
+    * IndexACORNRefine implementation
+    **************************************************************/
+
+   IndexACORNRefine::IndexACORNRefine(IndexACORN *base_index, Index *refine_index)
+       : IndexRefine(base_index, refine_index) {}
+
+   IndexACORNRefine::IndexACORNRefine(IndexACORN *base_index, const float *xb)
+       : IndexRefine(base_index, nullptr)
+   {
+      is_trained = base_index->is_trained;
+      refine_index = new IndexFlat(base_index->d, base_index->metric_type);
+      own_refine_index = true;
+      refine_index->add(base_index->ntotal, xb);
+   }
+
+   IndexACORNRefine::IndexACORNRefine() : IndexRefine() {}
+
+   namespace
+   {
+      template <class C>
+      void acorn_refine_reorder(
+          idx_t n,
+          idx_t k,
+          idx_t *labels,
+          float *distances,
+          idx_t k_base,
+          const idx_t *base_labels,
+          const float *base_distances)
+      {
+#pragma omp parallel for
+         for (idx_t i = 0; i < n; i++)
+         {
+            idx_t *idxo = labels + i * k;
+            float *diso = distances + i * k;
+            const idx_t *idxi = base_labels + i * k_base;
+            const float *disi = base_distances + i * k_base;
+
+            heap_heapify<C>(k, diso, idxo, disi, idxi, k);
+            if (k_base != k)
+            { // add remaining elements
+               heap_addn<C>(k, diso, idxo, disi + k, idxi + k, k_base - k);
+            }
+            heap_reorder<C>(k, diso, idxo);
+         }
+      }
+   } // namespace
+
+   void IndexACORNRefine::search(
+       idx_t n,
+       const float *x,
+       idx_t k,
+       float *distances,
+       idx_t *labels,
+       char *filter_id_map,
+       bool if_bfs_filter,
+       const SearchParameters *params) const
+   {
+      FAISS_THROW_IF_NOT(k > 0);
+      FAISS_THROW_IF_NOT(is_trained);
+      const IndexACORN *base = dynamic_cast<const IndexACORN *>(base_index);
+      FAISS_THROW_IF_NOT_MSG(base, "base_index should be an IndexACORN");
+
+      idx_t k_base = idx_t(k * k_factor);
+      FAISS_THROW_IF_NOT(k_base >= k);
+      std::vector<idx_t> base_labels(n * k_base);
+      std::vector<float> base_distances(n * k_base);
+
+      base->search(
+          n,
+          x,
+          k_base,
+          base_distances.data(),
+          base_labels.data(),
+          filter_id_map,
+          nullptr,
+          nullptr,
+          nullptr,
+          if_bfs_filter,
+          params);
+
+      // recompute the distances of the candidates with the refine index
+#pragma omp parallel if (n > 1)
+      {
+         std::unique_ptr<DistanceComputer> dc(
+             refine_index->get_distance_computer());
+#pragma omp for
+         for (idx_t i = 0; i < n; i++)
+         {
+            dc->set_query(x + i * d);
+            idx_t ij = i * k_base;
+            for (idx_t j = 0; j < k_base; j++)
+            {
+               idx_t idx = base_labels[ij];
+               if (idx < 0)
+               {
+                  break;
+               }
+               base_distances[ij] = (*dc)(idx);
+               ij++;
+            }
+         }
+      }
+
+      if (metric_type == METRIC_L2)
+      {
+         acorn_refine_reorder<CMax<float, idx_t>>(
+             n, k, labels, distances, k_base,
+             base_labels.data(), base_distances.data());
+      }
+      else if (metric_type == METRIC_INNER_PRODUCT)
+      {
+         acorn_refine_reorder<CMin<float, idx_t>>(
+             n, k, labels, distances, k_base,
+             base_labels.data(), base_distances.data());
+      }
+      else
+      {
+         FAISS_THROW_MSG("Metric type not supported");
+      }
+   }
+
    /**************************************************************
     * recall calculation
     **************************************************************/
@@ -13,6 +13,7 @@
 
 #include <faiss/IndexFlat.h>
 #include <faiss/IndexPQ.h>
+#include <faiss/IndexRefine.h>
 #include <faiss/IndexScalarQuantizer.h>
 #include <faiss/impl/ACORN.h>
 #include <faiss/utils/utils.h>
@@ -103,7 +104,8 @@ namespace faiss
           std::vector<double> *query_qps,   // 记录每个查询QPS
           std::vector<size_t> *query_n3,    // 记录每个查询的n3
           bool if_bfs_filter,
-          const SearchParameters *params = nullptr) const;
+          const SearchParameters *params = nullptr,
+          std::vector<ACORNStats> *query_stats = nullptr) const; // 每个查询的完整统计
 
       void calculate_distances(
           idx_t nq,             // 查询的数量
@@ -196,4 +198,64 @@ namespace faiss
           MetricType metric = METRIC_L2);
    };
 
+   /** PQ index topped with with a ACORN structure to access elements
+    *  more efficiently. The graph is traversed with the compressed codes,
+    *  wrap it in an IndexACORNRefine to re-rank with exact distances.
+    */
+   struct IndexACORNPQ : IndexACORN
+   {
+      IndexACORNPQ();
+      IndexACORNPQ(
+          int d,
+          int pq_m,
+          int M,
+          int gamma,
+          std::vector<std::vector<int>> &metadata,
+          int M_beta,
+          int pq_nbits = 8,
+          MetricType metric = METRIC_L2);
+      void train(idx_t n, const float *x) override;
+   };
+
+   /** SQ index topped with with a ACORN structure to access elements
+    *  more efficiently.
+    */
+   struct IndexACORNSQ : IndexACORN
+   {
+      IndexACORNSQ();
+      IndexACORNSQ(
+          int d,
+          ScalarQuantizer::QuantizerType qtype,
+          int M,
+          int gamma,
+          std::vector<std::vector<int>> &metadata,
+          int M_beta,
+          MetricType metric = METRIC_L2);
+   };
+
+   /** Runs the filtered search on a (compressed) ACORN index with
+    *  k * k_factor results and re-ranks them with the exact distances of
+    *  refine_index (an IndexFlat when built from the vectors).
+    */
+   struct IndexACORNRefine : IndexRefine
+   {
+      IndexACORNRefine(IndexACORN *base_index, Index *refine_index);
+      /// refine with an IndexFlat holding a copy of the base vectors xb
+      IndexACORNRefine(IndexACORN *base_index, const float *xb);
+      IndexACORNRefine();
+
+      using IndexRefine::search;
+
+      // filtered search, same arguments as IndexACORN::search
+      void search(
+          idx_t n,
+          const float *x,
+          idx_t k,
+          float *distances,
+          idx_t *labels,
+          char *filter_id_map,
+          bool if_bfs_filter,
+          const SearchParameters *params = nullptr) const;
+   };
+
 } // namespace faiss
@@ -19,6 +19,12 @@
 #include <math.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 #include <fstream>
 #include <iostream>
 #include <unordered_map>
@@ -137,6 +143,151 @@ namespace faiss
       // debug("end: %ln\n", end);
    }
 
+   namespace
+   {
+
+      /// zig-zag mapping of signed deltas to unsigned varints: the level-0
+      /// lists keep their search order, so deltas may be negative
+      inline uint64_t zigzag_encode(int64_t v)
+      {
+         return ((uint64_t)v << 1) ^ (v < 0 ? ~uint64_t(0) : uint64_t(0));
+      }
+
+      inline int64_t zigzag_decode(uint64_t zz)
+      {
+         return (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+      }
+
+   } // namespace
+
+   void ACORN::compact_level0()
+   {
+      FAISS_THROW_IF_NOT_MSG(!is_level0_compact(), "level 0 already compact");
+      size_t n = levels.size();
+      int nb0 = nb_neighbors(0);
+      FAISS_THROW_IF_NOT(nb0 > 0);
+
+      // encode each list independently, then concatenate
+      std::vector<std::vector<uint8_t>> codes(n);
+#pragma omp parallel for schedule(dynamic, 1024)
+      for (size_t i = 0; i < n; i++)
+      {
+         size_t begin, end;
+         neighbor_range(i, 0, &begin, &end);
+         std::vector<uint8_t> &code = codes[i];
+         int64_t prev = i;
+         for (size_t j = begin; j < end; j++)
+         {
+            storage_idx_t v = neighbors[j];
+            if (v < 0)
+            {
+               break;
+            }
+            uint64_t zz = zigzag_encode((int64_t)v - prev);
+            prev = v;
+            while (zz >= 0x80)
+            {
+               code.push_back((uint8_t)(zz | 0x80));
+               zz >>= 7;
+            }
+            code.push_back((uint8_t)zz);
+         }
+      }
+
+      level0_code_offsets.resize(n + 1);
+      level0_code_offsets[0] = 0;
+      for (size_t i = 0; i < n; i++)
+      {
+         level0_code_offsets[i + 1] = level0_code_offsets[i] + codes[i].size();
+      }
+      level0_codes.resize(level0_code_offsets[n]);
+#pragma omp parallel for schedule(dynamic, 1024)
+      for (size_t i = 0; i < n; i++)
+      {
+         if (codes[i].size() > 0)
+         {
+            memcpy(level0_codes.data() + level0_code_offsets[i],
+                   codes[i].data(),
+                   codes[i].size());
+         }
+         std::vector<uint8_t>().swap(codes[i]);
+      }
+
+      // every list must decode back to its ids, in the same order
+      bool roundtrip_ok = true;
+#pragma omp parallel
+      {
+         std::vector<storage_idx_t> decoded(nb0);
+#pragma omp for schedule(dynamic, 1024)
+         for (size_t i = 0; i < n; i++)
+         {
+            size_t begin, end;
+            neighbor_range(i, 0, &begin, &end);
+            size_t nn = decode_level0(i, decoded.data());
+            size_t j = 0;
+            for (; j < nn; j++)
+            {
+               if (decoded[j] != neighbors[begin + j])
+               {
+                  break;
+               }
+            }
+            if (j != nn || (begin + nn < end && neighbors[begin + nn] >= 0))
+            {
+#pragma omp atomic write
+               roundtrip_ok = false;
+            }
+         }
+      }
+      FAISS_THROW_IF_NOT_MSG(roundtrip_ok, "compact level 0 does not decode to the original lists");
+
+      // drop the level-0 slots: upper levels are moved down by nb0
+      std::vector<size_t> new_offsets(n + 1);
+      new_offsets[0] = 0;
+      for (size_t i = 0; i < n; i++)
+      {
+         new_offsets[i + 1] = new_offsets[i] + (offsets[i + 1] - offsets[i]) - nb0;
+      }
+      std::vector<NeighNode> new_neighbors(new_offsets[n]);
+#pragma omp parallel for schedule(dynamic, 1024)
+      for (size_t i = 0; i < n; i++)
+      {
+         std::copy(neighbors.begin() + offsets[i] + nb0,
+                   neighbors.begin() + offsets[i + 1],
+                   new_neighbors.begin() + new_offsets[i]);
+      }
+      neighbors.swap(new_neighbors);
+      offsets.swap(new_offsets);
+      for (size_t l = 1; l < cum_nneighbor_per_level.size(); l++)
+      {
+         cum_nneighbor_per_level[l] -= nb0;
+      }
+      level0_nb_compact = nb0;
+   }
+
+   size_t ACORN::decode_level0(storage_idx_t no, storage_idx_t *out) const
+   {
+      const uint8_t *p = level0_codes.data() + level0_code_offsets[no];
+      const uint8_t *p_end = level0_codes.data() + level0_code_offsets[no + 1];
+      int64_t prev = no;
+      size_t nn = 0;
+      while (p < p_end)
+      {
+         uint64_t zz = 0;
+         int shift = 0;
+         uint8_t b;
+         do
+         {
+            b = *p++;
+            zz |= (uint64_t)(b & 0x7f) << shift;
+            shift += 7;
+         } while (b & 0x80);
+         prev += zigzag_decode(zz);
+         out[nn++] = (storage_idx_t)prev;
+      }
+      return nn;
+   }
+
    ACORN::ACORN(int M, int gamma, std::vector<int> &metadata, int M_beta)
        : rng(12345),
          metadata(metadata),
@@ -243,6 +394,17 @@ namespace faiss
       offsets.push_back(0);
       levels.clear();
       neighbors.clear();
+      if (is_level0_compact())
+      {
+         // restore the level-0 slots for the next build
+         for (size_t l = 1; l < cum_nneighbor_per_level.size(); l++)
+         {
+            cum_nneighbor_per_level[l] += level0_nb_compact;
+         }
+         level0_nb_compact = 0;
+      }
+      level0_codes.clear();
+      level0_code_offsets.clear();
    }
 
    void ACORN::print_neighbor_stats(int level) const
@@ -809,6 +971,15 @@ namespace faiss
                 hnsw.metadata_multi[src],
                 hnsw);
          }
+         else
+         {
+            // upper levels are not pruned: drop the farthest so that the
+            // list does not overflow into the next slots
+            while (resultSet.size() > end - begin)
+            {
+               resultSet.pop();
+            }
+         }
 
          // ...and back
          size_t i = begin;
@@ -1038,9 +1209,6 @@ namespace faiss
             //   begin
             //             << ", " << end << ")" << std::endl;
 
-            // for debugging, collect all neighbors looked at in a vector
-            std::vector<std::pair<storage_idx_t, std::vector<int>>>
-                neighbors_checked;
             bool keep_expanding = true;
 
             for (size_t i = begin; i < end; i++)
@@ -1148,7 +1316,8 @@ namespace faiss
        int level,
        omp_lock_t *locks,
        VisitedTable &vt,
-       std::vector<storage_idx_t> ep_per_level)
+       std::vector<storage_idx_t> ep_per_level,
+       std::vector<ReverseLink> *reverse_links)
    {
       debug("add_links_starting_from at level: %d, nearest: %d\n",
             level,
@@ -1207,6 +1376,14 @@ namespace faiss
       }
 
       // 5. 将pt_id加入到其他邻居节点的邻居列表中
+      if (reverse_links)
+      { // deferred build: applied after the batch
+         for (storage_idx_t other_id : neighbors)
+         {
+            reverse_links->push_back({other_id, pt_id, level});
+         }
+         return;
+      }
       omp_unset_lock(&locks[pt_id]);
       for (storage_idx_t other_id : neighbors)
       {
@@ -1290,6 +1467,143 @@ namespace faiss
       }
    }
 
+   void ACORN::add_deferred(
+       DistanceComputer &ptdis,
+       int pt_level,
+       int pt_id,
+       VisitedTable &vt,
+       std::vector<ReverseLink> &reverse_links)
+   {
+      storage_idx_t nearest;
+#pragma omp critical
+      {
+         nearest = entry_point;
+
+         if (nearest == -1)
+         {
+            max_level = pt_level;
+            entry_point = pt_id;
+            for (int i = 0; i <= max_level; i++)
+            {
+               nb_per_level[i] = nb_per_level[i] + 1;
+            }
+         }
+      }
+
+      if (nearest < 0)
+      {
+         return;
+      }
+
+      int level = max_level; // level at which we start adding neighbors
+      float d_nearest = ptdis(nearest);
+
+      std::vector<storage_idx_t> ep_per_level(max_level + 1);
+      ep_per_level[level] = nearest;
+      for (; level > pt_level; level--)
+      {
+         greedy_update_nearest(*this, ptdis, level, nearest, d_nearest);
+         ep_per_level[level] = nearest;
+      }
+
+      for (; level >= 0; level--)
+      {
+         add_links_starting_from(
+             ptdis,
+             pt_id,
+             nearest,
+             d_nearest,
+             level,
+             nullptr,
+             vt,
+             ep_per_level,
+             &reverse_links);
+#pragma omp atomic
+         nb_per_level[level]++;
+      }
+
+      if (pt_level > max_level)
+      {
+#pragma omp critical
+         {
+            if (pt_level > max_level)
+            {
+               max_level = pt_level;
+               entry_point = pt_id;
+            }
+         }
+      }
+   }
+
+   void ACORN::merge_reverse_links(
+       DistanceComputer &qdis,
+       storage_idx_t dest,
+       const storage_idx_t *srcs,
+       size_t n,
+       int level,
+       storage_idx_t *new_list)
+   {
+      size_t begin, end;
+      neighbor_range(dest, level, &begin, &end);
+      size_t nfill = begin;
+      while (nfill < end && neighbors[nfill] != -1)
+      {
+         nfill++;
+      }
+
+      size_t i = 0;
+      if (nfill - begin + n <= end - begin)
+      { // there is enough room
+         for (size_t j = begin; j < nfill; j++)
+         {
+            new_list[i++] = neighbors[j];
+         }
+         for (size_t j = 0; j < n; j++)
+         {
+            new_list[i++] = srcs[j];
+         }
+      }
+      else
+      { // otherwise all candidates fight for the slots, once
+         std::priority_queue<NodeDistCloser> resultSet;
+         for (size_t j = begin; j < nfill; j++)
+         {
+            resultSet.emplace(
+                qdis.symmetric_dis(dest, neighbors[j]), neighbors[j]);
+         }
+         for (size_t j = 0; j < n; j++)
+         {
+            resultSet.emplace(qdis.symmetric_dis(dest, srcs[j]), srcs[j]);
+         }
+
+         if (level == 0)
+         {
+            ::faiss::shrink_neighbor_list(
+                qdis,
+                resultSet,
+                end - begin,
+                gamma,
+                dest,
+                metadata_multi[dest],
+                *this);
+         }
+         while (resultSet.size() > end - begin)
+         {
+            resultSet.pop();
+         }
+
+         while (resultSet.size())
+         {
+            new_list[i++] = resultSet.top().id;
+            resultSet.pop();
+         }
+      }
+      while (i < end - begin)
+      {
+         new_list[i++] = -1;
+      }
+   }
+
    /**************************************************************
     * Searching
     **************************************************************/
@@ -1413,8 +1727,80 @@ namespace faiss
          return nres;
       }
 
+      /* Stats policies for hybrid_search_from_candidates. The search loop is
+       * instantiated once per policy so that the default (no-op) build has no
+       * timer calls or counters in the hot loop at all. */
+      inline uint64_t read_cycle_counter()
+      {
+#if defined(__x86_64__) || defined(__i386__)
+         return __rdtsc();
+#else
+         return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+             .count();
+#endif
+      }
+
+      /* seconds per read_cycle_counter() tick, measured once against
+       * steady_clock */
+      double cycle_counter_period()
+      {
+#if defined(__x86_64__) || defined(__i386__)
+         static const double period = []
+         {
+            auto t0 = std::chrono::steady_clock::now();
+            uint64_t c0 = read_cycle_counter();
+            while (std::chrono::steady_clock::now() - t0 <
+                   std::chrono::milliseconds(10))
+               ;
+            uint64_t c1 = read_cycle_counter();
+            double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - t0)
+                                 .count();
+            return seconds / (double)(c1 - c0);
+         }();
+         return period;
+#else
+         return 1e-9;
+#endif
+      }
+
+      struct NoStatsPolicy
+      {
+         explicit NoStatsPolicy(ACORNStats &) {}
+         inline uint64_t now() const { return 0; }
+         inline void candidates_loop(uint64_t) {}
+         inline void neighbors_loop(uint64_t) {}
+         inline void visit() {}
+         inline void skip() {}
+      };
+
+      struct ProfileStatsPolicy
+      {
+         ACORNStats &stats;
+         const double period;
+         explicit ProfileStatsPolicy(ACORNStats &stats)
+             : stats(stats), period(cycle_counter_period()) {}
+         inline uint64_t now() const { return read_cycle_counter(); }
+         inline void candidates_loop(uint64_t t0)
+         {
+            uint64_t cycles = read_cycle_counter() - t0;
+            stats.candidates_loop_cycles += cycles;
+            stats.candidates_loop += cycles * period;
+         }
+         inline void neighbors_loop(uint64_t t0)
+         {
+            uint64_t cycles = read_cycle_counter() - t0;
+            stats.neighbors_loop_cycles += cycles;
+            stats.neighbors_loop += cycles * period;
+         }
+         inline void visit() { stats.visits += 1; }
+         inline void skip() { stats.skips += 1; }
+      };
+
       // has a filter arg for hybrid search, this only gets called on level 0
-      int hybrid_search_from_candidates(
+      template <class StatsPolicy>
+      int hybrid_search_from_candidates_tpl(
           const ACORN &hnsw,
           DistanceComputer &qdis,
           char *filter_map,
@@ -1433,6 +1819,7 @@ namespace faiss
           const SearchParametersACORN *params = nullptr)
       {
          //  std::cout << "hybrid_search_from_candidates" << std::endl;
+         StatsPolicy sp(stats);
          int nres = nres_in;
          int ndis = 0;
 
@@ -1463,8 +1850,34 @@ namespace faiss
 
          int nstep = 0;
 
-         // timing variables
-         double t1_candidates_loop = elapsed();
+         // ids to score for the current candidate, reused across steps
+         std::vector<storage_idx_t> to_score;
+         to_score.reserve(hnsw.level0_nb_neighbors() * 4);
+
+         // compact level-0 lists are decoded into these buffers
+         bool compact = level == 0 && hnsw.is_level0_compact();
+         std::vector<storage_idx_t> nbr_buf, nbr_buf2;
+         if (compact)
+         {
+            nbr_buf.resize(hnsw.level0_nb_neighbors());
+            nbr_buf2.resize(hnsw.level0_nb_neighbors());
+         }
+         auto get_neighbors = [&](storage_idx_t v,
+                                  std::vector<storage_idx_t> &buf,
+                                  size_t &nn) -> const storage_idx_t *
+         {
+            if (compact)
+            {
+               nn = hnsw.decode_level0(v, buf.data());
+               return buf.data();
+            }
+            size_t b, e;
+            hnsw.neighbor_range(v, level, &b, &e);
+            nn = e - b;
+            return hnsw.neighbors.data() + b;
+         };
+
+         uint64_t t1_candidates_loop = sp.now();
 
          while (candidates.size() > 0)
          { // candidates is heap of size max(efs, k)
@@ -1480,30 +1893,29 @@ namespace faiss
                }
             }
 
-            size_t begin, end;
-            hnsw.neighbor_range(v0, level, &begin, &end);
+            size_t nn0;
+            const storage_idx_t *nbrs0 = get_neighbors(v0, nbr_buf, nn0);
 
             // variable to keep track of search expansion
             int num_found = 0;
-            int num_new = 0;
             bool keep_expanding = true;
 
-            // for debugging, collect all neighbors looked at in a vector
-            std::vector<std::pair<storage_idx_t, int>> neighbors_checked;
+            uint64_t t1_neighbors_loop = sp.now();
 
-            double t1_neighbors_loop = elapsed();
-            for (size_t j = begin; j < end; j++)
+            // first pass: walk the (two-hop) neighborhood and collect the
+            // unvisited ids to score. num_found only depends on the filter,
+            // so the 2M early stop cuts the list at the same point as when
+            // the distances were computed one by one.
+            to_score.clear();
+            for (size_t j = 0; j < nn0; j++)
             {
-               // auto [v1, metadata] = hnsw.neighbors[j];
-               bool promising = 0;
-               bool outerskip = false;
-
-               auto v1 = hnsw.neighbors[j];
+               auto v1 = nbrs0[j];
 
                if (v1 < 0)
                {
                   break;
                }
+               sp.visit();
 
                if (if_bfs_filter) // 原始ACORN：bfs的时候过滤，不符合不再扩展邻
                {                  // 搜索和压入堆的时候都限制了filter
@@ -1514,6 +1926,7 @@ namespace faiss
 
                   if (vt.get(v1))
                   {
+                     sp.skip();
                      continue;
                   }
 
@@ -1521,24 +1934,7 @@ namespace faiss
                   if (filter_map[v1])
                   {
                      vt.set(v1);
-                     num_new = num_new + 1; // increment num new
-                     ndis++;
-                     float d = qdis(v1);
-
-                     if (!sel || sel->is_member(v1))
-                     {
-                        if (nres < k)
-                        {
-                           faiss::maxheap_push(++nres, D, I, d, v1);
-                           promising = 1;
-                        }
-                        else if (d < D[0])
-                        {
-                           faiss::maxheap_replace_top(nres, D, I, d, v1);
-                           promising = 1;
-                        }
-                     }
-                     candidates.push(v1, d);
+                     to_score.push_back(v1);
 
                      if (num_found >= hnsw.M * 2)
                      {
@@ -1547,64 +1943,42 @@ namespace faiss
                      }
                   }
 
-                  if (((j - begin >= hnsw.M_beta) && keep_expanding) ||
+                  if (((j >= hnsw.M_beta) && keep_expanding) ||
                       hnsw.gamma == 1)
                   {
-                     size_t begin2, end2;
-                     hnsw.neighbor_range(v1, level, &begin2, &end2);
-                     // try to parallelize neighbor expansion
-                     for (size_t j2 = begin2; j2 < end2; j2 += 1)
+                     size_t nn1;
+                     const storage_idx_t *nbrs1 =
+                         get_neighbors(v1, nbr_buf2, nn1);
+                     for (size_t j2 = 0; j2 < nn1; j2 += 1)
                      {
-                        auto v2 = hnsw.neighbors[j2];
+                        auto v2 = nbrs1[j2];
 
                         if (v2 < 0)
                         {
-                           // continue;
                            break;
                         }
+                        sp.visit();
 
-                        // if (metadata2 == filter) {
                         if (filter_map[v2])
                         {
                            num_found = num_found + 1; // increment num found
                         }
                         else
                         {
+                           sp.skip();
                            continue;
                         }
 
                         if (vt.get(v2))
                         {
+                           sp.skip();
                            continue;
                         }
 
                         vt.set(v2);
-                        ndis++;
-
-                        float d2 = qdis(v2);
-
-                        if (!sel || sel->is_member(v2))
-                        {
-                           if (nres < k)
-                           {
-                              // debug_search("-----------------pushing new
-                              // candidate, nres: %d (to be incrd)\n", nres);
-                              faiss::maxheap_push(++nres, D, I, d2, v2);
-                              // debug_search("-----------------pushed new
-                              // candidate, nres: %d\n", nres);
-                           }
-                           else if (d2 < D[0])
-                           {
-                              // debug_search("-----------------replacing top,
-                              // nres: %d\n", nres);
-                              faiss::maxheap_replace_top(nres, D, I, d2, v2);
-                           }
-                        }
-                        candidates.push(v2, d2);
+                        to_score.push_back(v2);
                         if (num_found >= hnsw.M * 2)
                         {
-                           // debug_search("------------num_found: %d, 2M: %d -
-                           // triggers break\n", num_found, hnsw.M * 2);
                            keep_expanding = false;
                            break;
                         }
@@ -1615,32 +1989,15 @@ namespace faiss
                {
                   if (vt.get(v1))
                   {
+                     sp.skip();
                      continue;
                   }
                   vt.set(v1);
-                  num_new = num_new + 1; // increment num new
-                  ndis++;
-                  float d = qdis(v1);
+                  to_score.push_back(v1);
 
-                  candidates.push(v1, d);
-
-                  // 只在添加结果时检查条件
                   if (filter_map[v1])
                   {
                      num_found = num_found + 1; // increment num found
-                     if (!sel || sel->is_member(v1))
-                     {
-                        if (nres < k)
-                        {
-                           faiss::maxheap_push(++nres, D, I, d, v1);
-                           promising = 1;
-                        }
-                        else if (d < D[0])
-                        {
-                           faiss::maxheap_replace_top(nres, D, I, d, v1);
-                           promising = 1;
-                        }
-                     }
                   }
                   if (num_found >= hnsw.M * 2)
                   {
@@ -1648,48 +2005,34 @@ namespace faiss
                      break;
                   }
 
-                  if (((j - begin >= hnsw.M_beta) && keep_expanding) ||
+                  if (((j >= hnsw.M_beta) && keep_expanding) ||
                       hnsw.gamma == 1)
                   {
-                     size_t begin2, end2;
-                     hnsw.neighbor_range(v1, level, &begin2, &end2);
-                     // try to parallelize neighbor expansion
-                     for (size_t j2 = begin2; j2 < end2; j2 += 1)
+                     size_t nn1;
+                     const storage_idx_t *nbrs1 =
+                         get_neighbors(v1, nbr_buf2, nn1);
+                     for (size_t j2 = 0; j2 < nn1; j2 += 1)
                      {
-                        auto v2 = hnsw.neighbors[j2];
+                        auto v2 = nbrs1[j2];
 
                         if (v2 < 0)
                         {
-                           // continue;
                            break;
                         }
+                        sp.visit();
                         if (vt.get(v2))
                         {
+                           sp.skip();
                            continue;
                         }
 
                         vt.set(v2);
-                        ndis++;
-                        float d2 = qdis(v2);
-                        candidates.push(v2, d2);
+                        to_score.push_back(v2);
 
-                        // if (metadata2 == filter) {
                         if (filter_map[v2])
                         {
                            num_found = num_found + 1; // increment num found
-                           if (!sel || sel->is_member(v2))
-                           {
-                              if (nres < k)
-                              {
-                                 faiss::maxheap_push(++nres, D, I, d2, v2);
-                              }
-                              else if (d2 < D[0])
-                              {
-                                 faiss::maxheap_replace_top(nres, D, I, d2, v2);
-                              }
-                           }
                         }
-
                         if (num_found >= hnsw.M * 2)
                         {
                            keep_expanding = false;
@@ -1700,12 +2043,60 @@ namespace faiss
                }
             }
 
+            // second pass: score the collected ids 4 at a time, in the
+            // order they were collected
+            auto add_result = [&](storage_idx_t v, float dv)
+            {
+               // only filtered points go to the result (only they are
+               // collected in the bfs-filter mode)
+               if (filter_map[v] && (!sel || sel->is_member(v)))
+               {
+                  if (nres < k)
+                  {
+                     faiss::maxheap_push(++nres, D, I, dv, v);
+                  }
+                  else if (dv < D[0])
+                  {
+                     faiss::maxheap_replace_top(nres, D, I, dv, v);
+                  }
+               }
+               candidates.push(v, dv);
+            };
+
+            size_t n_score = to_score.size();
+            ndis += n_score;
+            size_t js = 0;
+            for (; js + 4 <= n_score; js += 4)
+            {
+               float dis[4];
+               qdis.distances_batch_4(
+                   to_score[js],
+                   to_score[js + 1],
+                   to_score[js + 2],
+                   to_score[js + 3],
+                   dis[0],
+                   dis[1],
+                   dis[2],
+                   dis[3]);
+               for (size_t b = 0; b < 4; b++)
+               {
+                  add_result(to_score[js + b], dis[b]);
+               }
+            }
+            for (; js < n_score; js++)
+            {
+               add_result(to_score[js], qdis(to_score[js]));
+            }
+
+            sp.neighbors_loop(t1_neighbors_loop);
+
             nstep++;
             if (!do_dis_check && nstep > efSearch)
             {
                break;
             }
          }
+         sp.candidates_loop(t1_candidates_loop);
 
          if (level == 0)
          {
@@ -1720,6 +2111,32 @@ namespace faiss
          return nres;
       }
 
+      int hybrid_search_from_candidates(
+          const ACORN &hnsw,
+          DistanceComputer &qdis,
+          char *filter_map,
+          int k,
+          idx_t *I,
+          float *D,
+          MinimaxHeap &candidates,
+          VisitedTable &vt,
+          ACORNStats &stats,
+          bool if_bfs_filter,
+          int level,
+          int nres_in = 0,
+          const SearchParametersACORN *params = nullptr)
+      {
+         if (params && params->collect_stats)
+         {
+            return hybrid_search_from_candidates_tpl<ProfileStatsPolicy>(
+                hnsw, qdis, filter_map, k, I, D, candidates, vt, stats,
+                if_bfs_filter, level, nres_in, params);
+         }
+         return hybrid_search_from_candidates_tpl<NoStatsPolicy>(
+             hnsw, qdis, filter_map, k, I, D, candidates, vt, stats,
+             if_bfs_filter, level, nres_in, params);
+      }
+
    } // anonymous namespace
 
    ACORNStats ACORN::search(
@@ -1731,6 +2148,9 @@ namespace faiss
        const SearchParametersACORN *params) const
    {
       debug("%s\n", "reached");
+      FAISS_THROW_IF_NOT_MSG(
+          !is_level0_compact(),
+          "compact level 0 is only supported by hybrid_search");
       ACORNStats stats;
       if (entry_point == -1)
       {
@@ -1931,7 +2351,9 @@ namespace faiss
                    vt,
                    stats,
                    if_bfs_filter,
-                   0);
+                   0,
+                   0,
+                   params);
             }
             else
             {
@@ -1949,7 +2371,9 @@ namespace faiss
                    vt,
                    stats,
                    if_bfs_filter,
-                   level);
+                   level,
+                   0,
+                   params);
             }
             vt.advance();
          }
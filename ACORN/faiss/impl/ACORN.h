@@ -19,6 +19,7 @@
 #include <faiss/impl/FaissAssert.h>
 #include <faiss/impl/platform_macros.h>
 #include <faiss/utils/Heap.h>
+#include <faiss/utils/PerfCounters.h>
 #include <faiss/utils/random.h>
 
 // #include <nlohmann/json.hpp>
@@ -38,6 +39,14 @@ namespace faiss
       int efSearch = 16;
       bool check_relative_distance = true;
 
+      /// collect per-loop counters and cycle counts in ACORNStats
+      /// (profiling build of the level-0 loop, slower)
+      bool collect_stats = false;
+
+      /// read hardware counters (cycles, instructions, LLC and dTLB misses)
+      /// around each query into ACORNStats::perf, see PerfCounters
+      bool collect_perf_counters = false;
+
       ~SearchParametersACORN() {}
    };
 
@@ -123,6 +132,16 @@ namespace faiss
       /// for all levels. this is where all storage goes.
       std::vector<NeighNode> neighbors; // changed to add metadata
 
+      /// compressed level 0, filled by compact_level0(). Once compact, the
+      /// level-0 slots are removed from neighbors and the lists of vector i
+      /// are stored in level0_codes[level0_code_offsets[i]:...[i+1]]
+      /// (size ntotal + 1)
+      std::vector<uint8_t> level0_codes;
+      std::vector<size_t> level0_code_offsets;
+
+      /// nb of level-0 slots before compaction (0 if not compact)
+      int level0_nb_compact = 0;
+
       /// entry point in the search structure (one of the points with maximum
       /// level
       storage_idx_t entry_point;
@@ -155,6 +174,25 @@ namespace faiss
       /// use bounded queue during exploration
       bool search_bounded_queue = true;
 
+      /// build mode: instead of locking every reverse link, the reverse
+      /// links of an insertion batch are buffered per thread and merged
+      /// (and pruned) per destination after the batch
+      bool deferred_reverse_links = false;
+
+      /// reverse link dest -> src at level, buffered by the deferred build
+      struct ReverseLink
+      {
+         storage_idx_t dest;
+         storage_idx_t src;
+         int level;
+         bool operator<(const ReverseLink &o) const
+         {
+            return dest < o.dest ||
+                   (dest == o.dest &&
+                    (level < o.level || (level == o.level && src < o.src)));
+         }
+      };
+
       // methods that initialize the tree sizes
 
       /// initialize the assign_probas and cum_nneighbor_per_level to
@@ -179,6 +217,28 @@ namespace faiss
       void neighbor_range(idx_t no, int layer_no, size_t *begin, size_t *end)
           const;
 
+      /** Re-encode the level-0 lists after the build: the -1 padding is
+       * dropped and the ids are stored as zigzag varint deltas (the first
+       * one relative to the node id), in list order since the search
+       * relies on the position of a neighbor (M_beta). The index cannot be
+       * added to or written after this. */
+      void compact_level0();
+
+      bool is_level0_compact() const
+      {
+         return level0_nb_compact > 0;
+      }
+
+      /// max nb of level-0 neighbors, whether compact or not
+      int level0_nb_neighbors() const
+      {
+         return is_level0_compact() ? level0_nb_compact : nb_neighbors(0);
+      }
+
+      /// decode the compact level-0 list of no into out (size
+      /// level0_nb_neighbors()), returns the nb of neighbors
+      size_t decode_level0(storage_idx_t no, storage_idx_t *out) const;
+
       /// only mandatory parameter: nb of neighbors
       // explicit HNSW(int M = 32);
       explicit ACORN(int M, int gamma, std::vector<int> &metadata, int M_beta);
@@ -202,7 +262,8 @@ namespace faiss
           int level,
           omp_lock_t *locks,
           VisitedTable &vt,
-          std::vector<storage_idx_t> ep_per_level = {});
+          std::vector<storage_idx_t> ep_per_level = {},
+          std::vector<ReverseLink> *reverse_links = nullptr);
 
       // void hybrid_add_links_starting_from(
       //         DistanceComputer& ptdis,
@@ -223,6 +284,30 @@ namespace faiss
           std::vector<omp_lock_t> &locks,
           VisitedTable &vt);
 
+      /** same as add_with_locks for the deferred build: pt_id's own lists
+       * are written directly, the reverse links are appended to
+       * reverse_links and applied later with merge_reverse_links. Points of
+       * the same batch do not see each other. */
+      void add_deferred(
+          DistanceComputer &ptdis,
+          int pt_level,
+          int pt_id,
+          VisitedTable &vt,
+          std::vector<ReverseLink> &reverse_links);
+
+      /// the list of dest at level with the links dest -> srcs[0..n)
+      /// added, pruned once if it overflows, written to new_list
+      /// (nb_neighbors(level) entries, padded with -1). Only reads the
+      /// graph: the lists of a batch are written back once all of them
+      /// are computed.
+      void merge_reverse_links(
+          DistanceComputer &qdis,
+          storage_idx_t dest,
+          const storage_idx_t *srcs,
+          size_t n,
+          int level,
+          storage_idx_t *new_list);
+
       /// search interface for 1 point, single thread
       ACORNStats search(
           DistanceComputer &qdis,
@@ -293,12 +378,19 @@ namespace faiss
       size_t ndis;
       size_t nreorder;
 
-      // added for timing
-      double candidates_loop;
-      double neighbors_loop;
+      // added for timing, only filled when
+      // SearchParametersACORN::collect_stats is set
+      double candidates_loop; ///< seconds spent in the candidates loop
+      double neighbors_loop;  ///< seconds spent expanding neighbor lists
       double tuple_unwrap;
-      double skips;
-      double visits;
+      double skips;  ///< neighbors rejected (visited or filtered out)
+      double visits; ///< neighbors read from the adjacency lists
+      double candidates_loop_cycles; ///< candidates_loop in cycle counter ticks
+      double neighbors_loop_cycles;  ///< neighbors_loop in cycle counter ticks
+
+      /// hardware counters, only filled when
+      /// SearchParametersACORN::collect_perf_counters is set
+      PerfCounterValues perf;
 
       ACORNStats(
           size_t n1 = 0,
@@ -310,7 +402,9 @@ namespace faiss
           double neighbors_loop = 0.0,
           double tuple_unwrap = 0.0,
           double skips = 0.0,
-          double visits = 0.0)
+          double visits = 0.0,
+          double candidates_loop_cycles = 0.0,
+          double neighbors_loop_cycles = 0.0)
           : n1(n1),
             n2(n2),
             n3(n3),
@@ -320,7 +414,9 @@ namespace faiss
             neighbors_loop(neighbors_loop),
             tuple_unwrap(tuple_unwrap),
             skips(skips),
-            visits(visits) {}
+            visits(visits),
+            candidates_loop_cycles(candidates_loop_cycles),
+            neighbors_loop_cycles(neighbors_loop_cycles) {}
 
       void reset()
       {
@@ -331,9 +427,12 @@ namespace faiss
          // added
          candidates_loop = 0.0;
          neighbors_loop = 0.0;
+         candidates_loop_cycles = 0.0;
+         neighbors_loop_cycles = 0.0;
          tuple_unwrap = 0.0;
          skips = 0.0;
          visits = 0.0;
+         perf = PerfCounterValues();
       }
 
       void combine(const ACORNStats &other)
@@ -347,9 +446,12 @@ namespace faiss
          // added
          candidates_loop += other.candidates_loop;
          neighbors_loop += other.neighbors_loop;
+         candidates_loop_cycles += other.candidates_loop_cycles;
+         neighbors_loop_cycles += other.neighbors_loop_cycles;
          tuple_unwrap += other.tuple_unwrap;
-         skips = other.skips;
-         visits = other.visits;
+         skips += other.skips;
+         visits += other.visits;
+         perf.add(other.perf);
       }
    };
 
@@ -901,6 +901,15 @@ Index* read_index(IOReader* f, int io_flags) {
         read_index_header(imiq, f);
         read_ProductQuantizer(&imiq->pq, f);
         idx = imiq;
+    } else if (h == fourcc("IxRH")) {
+        IndexACORNRefine* idxrf = new IndexACORNRefine();
+        read_index_header(idxrf, f);
+        idxrf->base_index = read_index(f, io_flags);
+        idxrf->refine_index = read_index(f, io_flags);
+        READ1(idxrf->k_factor);
+        idxrf->own_fields = true;
+        idxrf->own_refine_index = true;
+        idx = idxrf;
     } else if (h == fourcc("IxRF")) {
         IndexRefine* idxrf = new IndexRefine();
         read_index_header(idxrf, f);
@@ -974,6 +983,20 @@ Index* read_index(IOReader* f, int io_flags) {
         idxacorn->storage = read_index(f, io_flags);
         idxacorn->own_fields = true;
         idx = idxacorn;
+    } else if (h == fourcc("IHHp") || h == fourcc("IHHs")) {
+        IndexACORN* idxacorn = nullptr;
+        if (h == fourcc("IHHp"))
+            idxacorn = new IndexACORNPQ();
+        if (h == fourcc("IHHs"))
+            idxacorn = new IndexACORNSQ();
+        read_index_header(idxacorn, f);
+        read_ACORN(&idxacorn->acorn, f);
+        idxacorn->storage = read_index(f, io_flags);
+        idxacorn->own_fields = true;
+        if (h == fourcc("IHHp")) {
+            dynamic_cast<IndexPQ*>(idxacorn->storage)->pq.compute_sdc_table();
+        }
+        idx = idxacorn;
     } else if (
             h == fourcc("INSf") || h == fourcc("INSp") || h == fourcc("INSs")) {
         IndexNSG* idxnsg;
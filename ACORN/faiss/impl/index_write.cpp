@@ -320,6 +320,9 @@ static void write_HNSW(const HNSW* hnsw, IOWriter* f) {
 }
 
 static void write_ACORN(const ACORN* hnsw, IOWriter* f) {
+    FAISS_THROW_IF_NOT_MSG(
+            !hnsw->is_level0_compact(),
+            "writing a compacted ACORN index is not supported");
     WRITEVECTOR(hnsw->assign_probas);
     WRITEVECTOR(hnsw->cum_nneighbor_per_level);
     WRITEVECTOR(hnsw->levels);
@@ -748,7 +751,9 @@ void write_index(const Index* idx, IOWriter* f) {
         write_ProductQuantizer(&imiq->pq, f);
     } else if (
             const IndexRefine* idxrf = dynamic_cast<const IndexRefine*>(idx)) {
-        uint32_t h = fourcc("IxRF");
+        uint32_t h = dynamic_cast<const IndexACORNRefine*>(idx)
+                ? fourcc("IxRH")
+                : fourcc("IxRF");
         WRITE1(h);
         write_index_header(idxrf, f);
         write_index(idxrf->base_index, f);
@@ -776,7 +781,9 @@ void write_index(const Index* idx, IOWriter* f) {
         write_HNSW(&idxhnsw->hnsw, f);
         write_index(idxhnsw->storage, f);
     } else if (const IndexACORN* indxacorn = dynamic_cast<const IndexACORN*>(idx)) {
-        uint32_t h = fourcc("IHNH"); // this needs to be a 4 letter header
+        uint32_t h = dynamic_cast<const IndexACORNPQ*>(idx) ? fourcc("IHHp")
+                : dynamic_cast<const IndexACORNSQ*>(idx)   ? fourcc("IHHs")
+                : fourcc("IHNH"); // this needs to be a 4 letter header
         FAISS_THROW_IF_NOT(h != 0);
         WRITE1(h);
         write_index_header(indxacorn, f);
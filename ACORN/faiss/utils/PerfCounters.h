@@ -0,0 +1,26 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+// The implementation is shared with UNG, see common/include/perf_counters.h
+// (installed next to this header).
+#include "perf_counters.h"
+
+namespace faiss {
+
+/// hardware counter values, a counter the kernel does not provide stays 0
+using PerfCounterValues = ANNS::PerfCounterValues;
+
+/** Counters of the calling thread read as one perf_event_open group.
+ *
+ * The object must be created, started and stopped on the same thread.
+ * Without a PMU available() is false and start/stop do nothing.
+ */
+using PerfCounters = ANNS::PerfCounters;
+
+} // namespace faiss
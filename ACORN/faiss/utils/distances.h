@@ -30,6 +30,34 @@ float fvec_L2sqr(const float* x, const float* y, size_t d);
 /// inner product
 float fvec_inner_product(const float* x, const float* y, size_t d);
 
+/// Special version of fvec_L2sqr that computes 4 distances
+/// between x and yi, which is performance oriented.
+void fvec_L2sqr_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3);
+
+/// Special version of fvec_inner_product that computes 4 distances
+/// between x and yi, which is performance oriented.
+void fvec_inner_product_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3);
+
 /// L1 distance
 float fvec_L1(const float* x, const float* y, size_t d);
 
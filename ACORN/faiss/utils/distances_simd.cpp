@@ -1743,4 +1743,154 @@ void fvec_add(size_t d, const float* a, float b, float* c) {
     }
 }
 
+/***************************************************************************
+ * Batched distance computations: one query against 4 vectors that are not
+ * contiguous in memory (eg. the neighbors of a graph node). The query is
+ * loaded once per block and the 4 accumulators hide the FMA latency.
+ ***************************************************************************/
+
+#ifdef __AVX2__
+
+static inline float horizontal_sum_8(const __m256 v) {
+    __m128 s = _mm_add_ps(
+            _mm256_extractf128_ps(v, 0), _mm256_extractf128_ps(v, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+void fvec_L2sqr_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3) {
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 7 < d; i += 8) {
+        const __m256 mx = _mm256_loadu_ps(x + i);
+        const __m256 t0 = _mm256_sub_ps(mx, _mm256_loadu_ps(y0 + i));
+        const __m256 t1 = _mm256_sub_ps(mx, _mm256_loadu_ps(y1 + i));
+        const __m256 t2 = _mm256_sub_ps(mx, _mm256_loadu_ps(y2 + i));
+        const __m256 t3 = _mm256_sub_ps(mx, _mm256_loadu_ps(y3 + i));
+        s0 = _mm256_fmadd_ps(t0, t0, s0);
+        s1 = _mm256_fmadd_ps(t1, t1, s1);
+        s2 = _mm256_fmadd_ps(t2, t2, s2);
+        s3 = _mm256_fmadd_ps(t3, t3, s3);
+    }
+
+    float d0 = horizontal_sum_8(s0);
+    float d1 = horizontal_sum_8(s1);
+    float d2 = horizontal_sum_8(s2);
+    float d3 = horizontal_sum_8(s3);
+
+    // finish non-multiple of 8 remainder
+    for (; i < d; i++) {
+        const float t0 = x[i] - y0[i];
+        const float t1 = x[i] - y1[i];
+        const float t2 = x[i] - y2[i];
+        const float t3 = x[i] - y3[i];
+        d0 += t0 * t0;
+        d1 += t1 * t1;
+        d2 += t2 * t2;
+        d3 += t3 * t3;
+    }
+
+    dis0 = d0;
+    dis1 = d1;
+    dis2 = d2;
+    dis3 = d3;
+}
+
+void fvec_inner_product_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3) {
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 7 < d; i += 8) {
+        const __m256 mx = _mm256_loadu_ps(x + i);
+        s0 = _mm256_fmadd_ps(mx, _mm256_loadu_ps(y0 + i), s0);
+        s1 = _mm256_fmadd_ps(mx, _mm256_loadu_ps(y1 + i), s1);
+        s2 = _mm256_fmadd_ps(mx, _mm256_loadu_ps(y2 + i), s2);
+        s3 = _mm256_fmadd_ps(mx, _mm256_loadu_ps(y3 + i), s3);
+    }
+
+    float d0 = horizontal_sum_8(s0);
+    float d1 = horizontal_sum_8(s1);
+    float d2 = horizontal_sum_8(s2);
+    float d3 = horizontal_sum_8(s3);
+
+    // finish non-multiple of 8 remainder
+    for (; i < d; i++) {
+        d0 += x[i] * y0[i];
+        d1 += x[i] * y1[i];
+        d2 += x[i] * y2[i];
+        d3 += x[i] * y3[i];
+    }
+
+    dis0 = d0;
+    dis1 = d1;
+    dis2 = d2;
+    dis3 = d3;
+}
+
+#else
+
+void fvec_L2sqr_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3) {
+    dis0 = fvec_L2sqr(x, y0, d);
+    dis1 = fvec_L2sqr(x, y1, d);
+    dis2 = fvec_L2sqr(x, y2, d);
+    dis3 = fvec_L2sqr(x, y3, d);
+}
+
+void fvec_inner_product_batch_4(
+        const float* x,
+        const float* y0,
+        const float* y1,
+        const float* y2,
+        const float* y3,
+        const size_t d,
+        float& dis0,
+        float& dis1,
+        float& dis2,
+        float& dis3) {
+    dis0 = fvec_inner_product(x, y0, d);
+    dis1 = fvec_inner_product(x, y1, d);
+    dis2 = fvec_inner_product(x, y2, d);
+    dis3 = fvec_inner_product(x, y3, d);
+}
+
+#endif
+
 } // namespace faiss
@@ -11,6 +11,7 @@ int main(int argc, char **argv)
 
    // common auguments
    std::string data_type, dist_fn, base_bin_file, base_label_file, base_label_info_file, base_label_tree_roots, index_path_prefix, result_path_prefix;
+   std::string base_numeric_file;
    uint32_t num_threads;
    ANNS::IdxType num_cross_edges;
 
@@ -18,6 +19,10 @@ int main(int argc, char **argv)
    std::string index_type, scenario;
    ANNS::IdxType max_degree, Lbuild; // Vamana
    float alpha;                      // Vamana
+   ANNS::IdxType base_first_point, num_base_points;
+   std::string trace_file;
+   std::string reorder;
+   ANNS::ReorderMethod reorder_method;
 
    // if query file is not provided, generate query file
    bool generate_query;
@@ -37,9 +42,15 @@ int main(int argc, char **argv)
       desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
                          "distance function <L2/IP/cosine>");
       desc.add_options()("base_bin_file", po::value<std::string>(&base_bin_file)->required(),
-                         "File containing the base vectors in binary format");
+                         "File containing the base vectors, <bin/fbin/u8bin/i8bin/fvecs/bvecs>");
+      desc.add_options()("base_first_point", po::value<ANNS::IdxType>(&base_first_point)->default_value(0),
+                         "First base vector to load");
+      desc.add_options()("num_base_points", po::value<ANNS::IdxType>(&num_base_points)->default_value(std::numeric_limits<ANNS::IdxType>::max()),
+                         "Number of base vectors to load, all by default");
       desc.add_options()("base_label_file", po::value<std::string>(&base_label_file)->required(),
                          "Base label file in txt format");
+      desc.add_options()("base_numeric_file", po::value<std::string>(&base_numeric_file)->default_value(""),
+                         "Numeric attributes of the base vectors (float .bin, one row per vector), kept in the index");
       desc.add_options()("base_label_info_file", po::value<std::string>(&base_label_info_file)->required(),
                          "Base label info file in log format");
       desc.add_options()("base_label_tree_roots", po::value<std::string>(&base_label_tree_roots)->required(),
@@ -50,6 +61,8 @@ int main(int argc, char **argv)
                          "Path prefix for saving the index");
       desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
                          "Path prefix for saving the results");
+      desc.add_options()("trace_file", po::value<std::string>(&trace_file)->default_value(""),
+                         "Write a Chrome trace-event JSON of the build phases and memory usage to this file");
 
       // parameters for graph indices
       desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("general"),
@@ -64,6 +77,8 @@ int main(int argc, char **argv)
                          "Size of candidate set for building Vamana");
       desc.add_options()("alpha", po::value<float>(&alpha)->default_value(ANNS::default_paras::ALPHA),
                          "Alpha for building Vamana");
+      desc.add_options()("reorder", po::value<std::string>(&reorder)->default_value("none"),
+                         "Renumber the points inside each group by graph locality after building, <none/bfs/rcm/gorder>");
 
       // query file
       desc.add_options()("generate_query", po::value<bool>(&generate_query)->required(),
@@ -85,6 +100,7 @@ int main(int argc, char **argv)
          return 0;
       }
       po::notify(vm);
+      reorder_method = ANNS::parse_reorder_method(reorder);
    }
    catch (const std::exception &ex)
    {
@@ -99,9 +115,19 @@ int main(int argc, char **argv)
       return -1;
    }
 
+   // build trace, covers loading, building and saving
+   std::shared_ptr<ANNS::BuildTrace> build_trace;
+   if (!trace_file.empty())
+      build_trace = std::make_shared<ANNS::BuildTrace>();
+
    // load base data
    std::shared_ptr<ANNS::IStorage> base_storage = ANNS::create_storage(data_type);
-   base_storage->load_from_file(base_bin_file, base_label_file);
+   {
+      ANNS::TraceScope scope(build_trace.get(), "load_base_data", "phase");
+      base_storage->load_from_file(base_bin_file, base_label_file, num_base_points, base_first_point);
+      if (!base_numeric_file.empty())
+         base_storage->load_numeric_attrs(base_numeric_file, base_first_point);
+   }
 
    // preparation
    std::cout << "Building Unified Navigating Graph index based on " << index_type << " algorithm ..." << std::endl;
@@ -109,12 +135,29 @@ int main(int argc, char **argv)
 
    // build index
    ANNS::UniNavGraph index;
+   index.set_build_trace(build_trace);
    auto start_time = std::chrono::high_resolution_clock::now();
    index.build(base_storage, distance_handler, scenario, index_type, num_threads, num_cross_edges, max_degree, Lbuild, alpha);
    std::cout << "Index time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() << "ms" << std::endl;
 
+   // renumber the points inside the groups by graph locality
+   if (reorder_method != ANNS::ReorderMethod::NONE)
+   {
+      ANNS::TraceScope scope(build_trace.get(), "reorder", "phase");
+      index.reorder_groups(reorder_method, num_threads);
+   }
+
    // save index
-   index.save(index_path_prefix, result_path_prefix);
+   {
+      ANNS::TraceScope scope(build_trace.get(), "save", "phase");
+      index.save(index_path_prefix, result_path_prefix);
+   }
+   if (build_trace)
+   {
+      build_trace->sample_rss();
+      build_trace->write(trace_file);
+      std::cout << "Build trace written to " << trace_file << std::endl;
+   }
 
    // 测试读取向量-属性二分图的函数
    // ANNS::UniNavGraph index2;
@@ -133,7 +176,7 @@ int main(int argc, char **argv)
       }
       else if (generate_query_task == "method1_low_coverage") // 极端数据方法1-低覆盖率:选出覆盖率在 (0, coverage_threshold=0.1] 区间且出现次数 ≥ K=10 的组合
       {
-         index.generate_queries_method1_low_coverage(query_file_path, dataset, 1000, base_label_file, 7, 0.1f, 10);
+         index.generate_queries_method1_low_coverage(query_file_path, dataset, 1000, 7, 0.1f, 10);
       }
       else if (generate_query_task == "method2_high_coverage") // 极端数据方法2-高覆盖率
       {
@@ -142,7 +185,7 @@ int main(int argc, char **argv)
       }
       else if (generate_query_task == "method2_low_coverage") // 极端数据方法2-低覆盖率
       {
-         index.generate_queries_method2_low_coverage(query_file_path, dataset, 1000, base_label_file, 7, 10, 50, 5);
+         index.generate_queries_method2_low_coverage(query_file_path, dataset, 1000, 7, 10, 50, 5);
       }
       else
       {
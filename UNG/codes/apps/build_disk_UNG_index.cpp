@@ -0,0 +1,51 @@
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "disk_ung.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, index_path_prefix;
+   uint32_t num_threads;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <float>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the in-memory index, the disk layout is written next to it");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // load the in-memory index and write its disk layout
+   ANNS::UniNavGraph index(1);
+   index.load(index_path_prefix, data_type);
+   try
+   {
+      ANNS::DiskUniNavGraph::write_disk_layout(index, index_path_prefix, num_threads);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+   return 0;
+}
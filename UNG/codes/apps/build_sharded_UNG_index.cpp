@@ -0,0 +1,94 @@
+#include <chrono>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "sharded_ung.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, base_bin_file, base_label_file, base_numeric_file, index_path_prefix, result_path_prefix;
+   std::string index_type, scenario, partition;
+   uint32_t num_threads;
+   ANNS::IdxType num_shards, num_cross_edges, max_degree, Lbuild;
+   float alpha;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2/IP/cosine>");
+      desc.add_options()("base_bin_file", po::value<std::string>(&base_bin_file)->required(),
+                         "File containing the base vectors, <bin/fbin/u8bin/i8bin/fvecs/bvecs>");
+      desc.add_options()("base_label_file", po::value<std::string>(&base_label_file)->required(),
+                         "Base label file in txt or CSR format");
+      desc.add_options()("base_numeric_file", po::value<std::string>(&base_numeric_file)->default_value(""),
+                         "Numeric attributes of the base vectors (float .bin, one row per vector), kept in the shards");
+      desc.add_options()("num_shards", po::value<ANNS::IdxType>(&num_shards)->required(),
+                         "Number of shards, each holds fewer than 2^32 points");
+      desc.add_options()("partition", po::value<std::string>(&partition)->default_value("range"),
+                         "Partition of the base vectors, <range/group> (group keeps each label set in one shard)");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(1),
+                         "Number of threads to use, split among the shards built concurrently");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Path prefix for saving the index");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Path prefix for saving the results");
+
+      // parameters for graph indices
+      desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("general"),
+                         "Scenario for building UniNavGraph, <equality/general>");
+      desc.add_options()("index_type", po::value<std::string>(&index_type)->default_value("Vamana"),
+                         "Type of index to build, <Vamana>");
+      desc.add_options()("num_cross_edges", po::value<ANNS::IdxType>(&num_cross_edges)->default_value(ANNS::default_paras::NUM_CROSS_EDGES),
+                         "Number of cross edges for building Vamana");
+      desc.add_options()("max_degree", po::value<ANNS::IdxType>(&max_degree)->default_value(ANNS::default_paras::MAX_DEGREE),
+                         "Max degree for building Vamana");
+      desc.add_options()("Lbuild", po::value<ANNS::IdxType>(&Lbuild)->default_value(ANNS::default_paras::L_BUILD),
+                         "Size of candidate set for building Vamana");
+      desc.add_options()("alpha", po::value<float>(&alpha)->default_value(ANNS::default_paras::ALPHA),
+                         "Alpha for building Vamana");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // check scenario
+   if (scenario != "general" && scenario != "equality")
+   {
+      std::cerr << "Invalid scenario: " << scenario << std::endl;
+      return -1;
+   }
+
+   // build and save the shards
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   ANNS::ShardedUniNavGraph index;
+   auto start_time = std::chrono::high_resolution_clock::now();
+   try
+   {
+      index.build(data_type, base_bin_file, base_label_file, base_numeric_file, distance_handler, num_shards, partition,
+                  scenario, index_type, num_threads, num_cross_edges, max_degree, Lbuild, alpha);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+   std::cout << "Index time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() << "ms" << std::endl;
+   index.save(index_path_prefix, result_path_prefix);
+   return 0;
+}
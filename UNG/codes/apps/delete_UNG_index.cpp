@@ -0,0 +1,89 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "uni_nav_graph.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, index_path_prefix, new_index_path_prefix, result_path_prefix, delete_id_file;
+   ANNS::IdxType delete_first_id, num_delete_points;
+   uint32_t num_threads;
+   bool consolidate;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2/IP/cosine>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the index to update");
+      desc.add_options()("new_index_path_prefix", po::value<std::string>(&new_index_path_prefix)->required(),
+                         "Prefix for saving the updated index");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Prefix for saving the results");
+      desc.add_options()("delete_id_file", po::value<std::string>(&delete_id_file)->default_value(""),
+                         "File with one id to delete per line");
+      desc.add_options()("delete_first_id", po::value<ANNS::IdxType>(&delete_first_id)->default_value(0),
+                         "First id of the range to delete, used without delete_id_file");
+      desc.add_options()("num_delete_points", po::value<ANNS::IdxType>(&num_delete_points)->default_value(0),
+                         "Number of ids in the range to delete");
+      desc.add_options()("consolidate", po::value<bool>(&consolidate)->default_value(true),
+                         "Repair the graph around the deleted points before saving");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // load index and the ids to delete
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   ANNS::UniNavGraph index(1);
+   index.load(index_path_prefix, data_type);
+   index.load_bipartite_graph(index_path_prefix + "vector_attr_graph");
+   std::vector<ANNS::IdxType> ids;
+   if (!delete_id_file.empty())
+   {
+      std::ifstream in(delete_id_file);
+      if (!in.is_open())
+      {
+         std::cerr << "Error: cannot open " << delete_id_file << std::endl;
+         return -1;
+      }
+      ANNS::IdxType id;
+      while (in >> id)
+         ids.push_back(id);
+   }
+   else
+      for (ANNS::IdxType i = 0; i < num_delete_points; ++i)
+         ids.push_back(delete_first_id + i);
+
+   // tombstone, then consolidate in the background
+   auto start_time = std::chrono::high_resolution_clock::now();
+   auto num_deleted = index.remove(ids);
+   std::cout << "Deleted " << num_deleted << " of " << ids.size() << " ids" << std::endl;
+   if (consolidate)
+      index.consolidate_async(distance_handler, num_threads).wait();
+   std::cout << "Delete time: " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count()
+             << " ms" << std::endl;
+
+   index.save(new_index_path_prefix, result_path_prefix);
+   return 0;
+}
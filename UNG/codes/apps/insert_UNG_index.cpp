@@ -0,0 +1,88 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "uni_nav_graph.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, index_path_prefix, new_index_path_prefix, result_path_prefix;
+   std::string insert_bin_file, insert_label_file, insert_numeric_file;
+   ANNS::IdxType insert_first_point, num_insert_points, batch_size;
+   uint32_t num_threads;
+   bool compact;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2/IP/cosine>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the index to update");
+      desc.add_options()("new_index_path_prefix", po::value<std::string>(&new_index_path_prefix)->required(),
+                         "Prefix for saving the updated index");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Prefix for saving the results");
+      desc.add_options()("insert_bin_file", po::value<std::string>(&insert_bin_file)->required(),
+                         "File containing the vectors to insert");
+      desc.add_options()("insert_label_file", po::value<std::string>(&insert_label_file)->default_value(""),
+                         "Label file of the vectors to insert");
+      desc.add_options()("insert_numeric_file", po::value<std::string>(&insert_numeric_file)->default_value(""),
+                         "Numeric attributes of the vectors to insert, 0 when not given");
+      desc.add_options()("insert_first_point", po::value<ANNS::IdxType>(&insert_first_point)->default_value(0),
+                         "First point of insert_bin_file to insert");
+      desc.add_options()("num_insert_points", po::value<ANNS::IdxType>(&num_insert_points)->default_value(std::numeric_limits<ANNS::IdxType>::max()),
+                         "Number of points to insert");
+      desc.add_options()("batch_size", po::value<ANNS::IdxType>(&batch_size)->default_value(10000),
+                         "Number of points inserted per batch");
+      desc.add_options()("compact", po::value<bool>(&compact)->default_value(false),
+                         "Move the inserted points into the group ranges before saving");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // load index and the points to insert
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   ANNS::UniNavGraph index(1);
+   index.load(index_path_prefix, data_type);
+   index.load_bipartite_graph(index_path_prefix + "vector_attr_graph");
+   std::shared_ptr<ANNS::IStorage> insert_storage = ANNS::create_storage(data_type);
+   insert_storage->load_from_file(insert_bin_file, insert_label_file, num_insert_points, insert_first_point);
+   if (!insert_numeric_file.empty())
+      insert_storage->load_numeric_attrs(insert_numeric_file, insert_first_point);
+
+   // insert in batches
+   auto start_time = std::chrono::high_resolution_clock::now();
+   auto num_points = insert_storage->get_num_points();
+   for (ANNS::IdxType start = 0; start < num_points; start += batch_size)
+   {
+      auto end = std::min(num_points, start + batch_size);
+      index.insert(ANNS::create_storage(insert_storage, start, end), distance_handler, num_threads);
+   }
+   auto insert_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+   std::cout << "Insert time: " << insert_time << " ms, " << num_points * 1000.0 / std::max(insert_time, 1e-3) << " points/s" << std::endl;
+
+   if (compact)
+      index.compact(num_threads);
+   index.save(new_index_path_prefix, result_path_prefix);
+   return 0;
+}
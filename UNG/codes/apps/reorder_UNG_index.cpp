@@ -0,0 +1,58 @@
+#include <chrono>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "uni_nav_graph.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, index_path_prefix, new_index_path_prefix, result_path_prefix, reorder;
+   ANNS::ReorderMethod reorder_method;
+   uint32_t num_threads;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the index to reorder");
+      desc.add_options()("new_index_path_prefix", po::value<std::string>(&new_index_path_prefix)->required(),
+                         "Prefix for saving the reordered index");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Prefix for saving the results");
+      desc.add_options()("reorder", po::value<std::string>(&reorder)->default_value("gorder"),
+                         "Order of the points inside each group, <bfs/rcm/gorder>");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+      reorder_method = ANNS::parse_reorder_method(reorder);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // load index
+   ANNS::UniNavGraph index(1);
+   index.load(index_path_prefix, data_type);
+   index.load_bipartite_graph(index_path_prefix + "vector_attr_graph");
+
+   // reorder and save
+   auto start_time = std::chrono::high_resolution_clock::now();
+   index.reorder_groups(reorder_method, num_threads);
+   std::cout << "Reorder time: " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   index.save(new_index_path_prefix, result_path_prefix);
+   return 0;
+}
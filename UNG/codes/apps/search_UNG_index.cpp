@@ -7,6 +7,7 @@
 #include <boost/program_options.hpp>
 #include "uni_nav_graph.h"
 #include "utils.h"
+#include "latency_histogram.h"
 #include <roaring/roaring.h>
 #include <roaring/roaring.hh>
 
@@ -27,6 +28,10 @@ float calculate_single_query_recall(const std::pair<ANNS::IdxType, float> *gt,
       }
    }
 
+   // 没有满足条件的点 (如范围过滤后为空) 时召回记为 1
+   if (gt_set.empty())
+      return 1.0f;
+
    int correct = 0;
    for (int i = 0; i < K; ++i)
    {
@@ -43,12 +48,19 @@ int main(int argc, char **argv)
 {
    std::string data_type, dist_fn, scenario;
    std::string base_bin_file, query_bin_file, base_label_file, query_label_file, gt_file, index_path_prefix, result_path_prefix;
+   std::string query_filter_file, label_dict_file, query_range_file;
    ANNS::IdxType K, num_entry_points;
    std::vector<ANNS::IdxType> Lsearch_list;
    uint32_t num_threads;
    bool is_new_method = false; // true: use new method
    bool is_ori_ung = false;    // true: use original ung
    int num_repeats = 1;        // 默认重复1次
+   bool perf_counters = false; // true: 每个查询记录硬件计数器
+   bool query_details = false; // true: 输出每个查询的明细 csv
+   std::string numa_policy;    // none/interleave/replicate
+   std::string huge_pages;     // none/thp/hugetlb
+   bool flat_graph = false;    // true: 搜索读取 CSR 形式的邻接表
+   bool intra_query = false;   // true: 查询逐个执行, 每个查询使用 num_threads 个线程
 
    try
    {
@@ -77,7 +89,13 @@ int main(int argc, char **argv)
 
       // graph search parameters
       desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("containment"),
-                         "Scenario for building UniNavGraph, <equality/containment/overlap/nofilter>");
+                         "Scenario for building UniNavGraph, <equality/containment/overlap/nofilter/expression>");
+      desc.add_options()("query_filter_file", po::value<std::string>(&query_filter_file)->default_value(""),
+                         "Boolean filter of each query, one per line (expression scenario)");
+      desc.add_options()("label_dict_file", po::value<std::string>(&label_dict_file)->default_value(""),
+                         "CSR label file whose dictionary resolves label names in the filters");
+      desc.add_options()("query_range_file", po::value<std::string>(&query_range_file)->default_value(""),
+                         "Numeric ranges of each query, one line of \"column lo hi\" triples per query (new method only)");
       desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
                          "Prefix of the path to load the index");
       desc.add_options()("num_entry_points", po::value<ANNS::IdxType>(&num_entry_points)->default_value(ANNS::default_paras::NUM_ENTRY_POINTS),
@@ -90,6 +108,21 @@ int main(int argc, char **argv)
                          "is_ori_ung");
       desc.add_options()("num_repeats", po::value<int>(&num_repeats)->default_value(1),
                          "Number of repeats for each Lsearch value");
+      desc.add_options()("query_details", po::value<bool>(&query_details)->default_value(false),
+                         "Write one CSV row per query, Lsearch and repeat (query_details_repeat*.csv)");
+      desc.add_options()("perf_counters", po::value<bool>(&perf_counters)->default_value(false),
+                         "Record cycles, instructions, LLC and dTLB misses per query in the query details CSV; only search_hybrid "
+                         "(--is_new_method 1) and --scenario expression record them, the other search paths ignore the flag");
+      desc.add_options()("numa_policy", po::value<std::string>(&numa_policy)->default_value("none"),
+                         "Placement of the vectors and graphs, <none/interleave/replicate>; interleave and replicate also pin the search threads to the NUMA nodes");
+      desc.add_options()("huge_pages", po::value<std::string>(&huge_pages)->default_value("none"),
+                         "Backing of the vectors, flattened graphs and visited sets, <none/thp/hugetlb>; hugetlb falls back to thp without reserved pages. "
+                         "The roaring sets are small heap blocks, run with GLIBC_TUNABLES=glibc.malloc.hugetlb=1 for them");
+      desc.add_options()("flat_graph", po::value<bool>(&flat_graph)->default_value(false),
+                         "Search on CSR copies of the graphs (one array, huge pages under huge_pages) instead of the adjacency lists");
+      desc.add_options()("intra_query", po::value<bool>(&intra_query)->default_value(false),
+                         "Run the queries one after another, each on num_threads threads (entry groups in parallel or a shared best-first search); "
+                         "for latency at large Lsearch, original method only");
 
       po::variables_map vm;
       po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -107,20 +140,63 @@ int main(int argc, char **argv)
    }
 
    // check scenario
-   if (scenario != "containment" && scenario != "equality" && scenario != "overlap")
+   if (scenario != "containment" && scenario != "equality" && scenario != "overlap" && scenario != "expression")
    {
       std::cerr << "Invalid scenario: " << scenario << std::endl;
       return -1;
    }
+   if (scenario == "expression" && query_filter_file.empty())
+   {
+      std::cerr << "The expression scenario needs query_filter_file" << std::endl;
+      return -1;
+   }
+   if (intra_query && (is_new_method || scenario == "expression"))
+   {
+      std::cerr << "intra_query needs the original method and a label scenario" << std::endl;
+      return -1;
+   }
+   if (!query_range_file.empty() && !is_new_method)
+   {
+      std::cerr << "query_range_file needs is_new_method" << std::endl;
+      return -1;
+   }
 
    // load query data
    std::shared_ptr<ANNS::IStorage> query_storage = ANNS::create_storage(data_type);
    query_storage->load_from_file(query_bin_file, query_label_file);
 
-   // load index
+   // load index, the big arrays are allocated under the huge page policy
+   try
+   {
+      ANNS::set_huge_page_policy(ANNS::parse_huge_page_policy(huge_pages));
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
    ANNS::UniNavGraph index(query_storage->get_num_points());
    index.load(index_path_prefix, data_type);
    index.load_bipartite_graph(index_path_prefix + "vector_attr_graph");
+   if (flat_graph)
+      index.flatten_graphs();
+   try
+   {
+      index.set_numa_policy(ANNS::parse_numa_policy(numa_policy), num_threads);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   if (huge_pages != "none")
+   {
+      auto stats = ANNS::get_huge_page_stats();
+      std::cout << "Huge page backing: " << stats.hugetlb_bytes / 1048576.0 << " MB hugetlb, " << stats.thp_bytes / 1048576.0
+                << " MB thp, " << stats.small_page_bytes / 1048576.0 << " MB small pages, " << stats.heap_bytes / 1048576.0
+                << " MB heap" << std::endl;
+   }
 
    // preparation
    auto num_queries = query_storage->get_num_points();
@@ -129,17 +205,39 @@ int main(int argc, char **argv)
    ANNS::load_gt_file(gt_file, gt, num_queries, K);
    auto results = new std::pair<ANNS::IdxType, float>[num_queries * K];
 
-   // compute attribute bitmap
+   // compute attribute bitmap, boolean filters are compiled by the index per query
+   std::vector<ANNS::FilterExpr> filters;
+   std::vector<std::vector<ANNS::NumericRange>> query_ranges;
+   if (!query_range_file.empty())
+      query_ranges = ANNS::load_numeric_ranges(query_range_file);
    std::vector<std::pair<std::bitset<10000001>, double>> bitmap_and_time(num_queries);
-   std::vector<std::bitset<10000001>> bitmap(num_queries);
-#pragma omp parallel for
-   for (int id = 0; id < num_queries; id++)
+   std::vector<std::bitset<10000001>> bitmap;
+   if (scenario == "expression")
+   {
+      auto name_to_label = label_dict_file.empty() ? std::unordered_map<std::string, ANNS::LabelType>()
+                                                   : ANNS::load_label_names(label_dict_file);
+      filters = ANNS::load_filter_exprs(query_filter_file, name_to_label);
+   }
+   else
    {
-      bitmap_and_time[id] = index.compute_attribute_bitmap(query_storage->get_label_set(id));
-      bitmap[id] = bitmap_and_time[id].first;
+      bitmap.resize(num_queries);
+#pragma omp parallel for
+      for (int id = 0; id < num_queries; id++)
+      {
+         bitmap_and_time[id] = index.compute_attribute_bitmap(query_storage->get_label_set(id));
+         bitmap[id] = bitmap_and_time[id].first;
+      }
    }
 
+   // the counters need a PMU, the columns are written as 0 without one
+   if (perf_counters && !ANNS::PerfCounters().available())
+      std::cerr << "Warning: hardware performance counters are not available, perf columns will be 0" << std::endl;
+   if (perf_counters && scenario != "expression" && !is_new_method)
+      std::cerr << "Warning: --perf_counters only applies to --is_new_method 1 and --scenario expression, ignored" << std::endl;
+
    std::vector<std::vector<std::vector<ANNS::QueryStats>>> query_stats(num_repeats, std::vector<std::vector<ANNS::QueryStats>>(Lsearch_list.size(), std::vector<ANNS::QueryStats>(num_queries))); //(repeat,Lsearch,queryID)
+   std::vector<std::vector<double>> search_time_ms(num_repeats, std::vector<double>(Lsearch_list.size())); //(repeat,Lsearch)
+   std::vector<std::vector<double>> avg_cmps(num_repeats, std::vector<double>(Lsearch_list.size()));
 
    for (int repeat = 0; repeat < num_repeats; ++repeat)
    {
@@ -155,67 +253,120 @@ int main(int argc, char **argv)
       {
          std::vector<float> num_cmps(num_queries);
          auto start_time = std::chrono::high_resolution_clock::now();
-         if (!is_new_method)
-            index.search(query_storage, distance_handler, num_threads, Lsearch_list[LsearchId], num_entry_points, scenario, K, results, num_cmps, bitmap);
+         if (scenario == "expression")
+            index.search_filter(query_storage, distance_handler, num_threads, Lsearch_list[LsearchId], num_entry_points,
+                                filters, K, results, num_cmps, query_stats[repeat][LsearchId], is_ori_ung, perf_counters);
+         else if (intra_query)
+            index.search_intra_query(query_storage, distance_handler, num_threads, Lsearch_list[LsearchId], num_entry_points,
+                                     scenario, K, results, num_cmps, query_stats[repeat][LsearchId]);
+         else if (!is_new_method)
+            index.search(query_storage, distance_handler, num_threads, Lsearch_list[LsearchId], num_entry_points, scenario, K, results, num_cmps,
+                         query_stats[repeat][LsearchId], bitmap);
          else
             index.search_hybrid(query_storage, distance_handler, num_threads, Lsearch_list[LsearchId],
-                                num_entry_points, scenario, K, results, num_cmps, query_stats[repeat][LsearchId], bitmap, is_ori_ung);
+                                num_entry_points, scenario, K, results, num_cmps, query_stats[repeat][LsearchId], bitmap, is_ori_ung,
+                                perf_counters, query_ranges);
          auto time_cost = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
          for (int i = 0; i < num_queries; ++i)
             query_stats[repeat][LsearchId][i].recall = calculate_single_query_recall(gt + i * K, results + i * K, K);
+         search_time_ms[repeat][LsearchId] = time_cost;
+         avg_cmps[repeat][LsearchId] = std::accumulate(num_cmps.begin(), num_cmps.end(), 0.0) / num_queries;
       }
    }
 
-   // 输出详细文件
-   std::ofstream detail_out(result_path_prefix + "query_details_repeat" + std::to_string(num_repeats) + ".csv");
-   detail_out << "repeat,Lsearch,QueryID,Time(ms),descendants_merge_time(ms),coverage_merge_time(ms),flag_time(ms),bitmap_time(ms),UNG_time(ms),DistanceCalcs,EntryPoints,LNGDescendants,entry_group_total_coverage,QPS,Recall,is_global_search\n";
+   // 汇总: 每个 Lsearch 的吞吐, 召回, 距离计算次数和延迟分位数 (repeat=all 合并所有 repeat)
+   std::ofstream summary_out(result_path_prefix + "summary_repeat" + std::to_string(num_repeats) + ".csv");
+   summary_out << "repeat,Lsearch,QPS,Recall,Cmps,mean_ms,p50_ms,p90_ms,p99_ms,p99.9_ms,max_ms\n";
+   std::cout << "\nrepeat\tLsearch\tQPS\tRecall\tCmps\tp50_ms\tp90_ms\tp99_ms\tp99.9_ms\tmax_ms" << std::endl;
+   for (int LsearchId = 0; LsearchId < Lsearch_list.size(); LsearchId++)
+   {
+      ANNS::LatencyHistogram all_histogram;
+      double all_time_ms = 0, all_recall = 0, all_cmps = 0;
+      for (int repeat = 0; repeat <= num_repeats; repeat++)
+      {
+         ANNS::LatencyHistogram histogram;
+         double time_ms, recall = 0, cmps;
+         std::string repeat_name = repeat < num_repeats ? std::to_string(repeat) : "all";
+         if (repeat < num_repeats)
+         {
+            for (const auto &stats : query_stats[repeat][LsearchId])
+            {
+               histogram.record_ms(stats.time_ms);
+               recall += stats.recall;
+            }
+            recall /= num_queries;
+            time_ms = search_time_ms[repeat][LsearchId];
+            cmps = avg_cmps[repeat][LsearchId];
+            all_histogram.merge(histogram);
+            all_time_ms += time_ms;
+            all_recall += recall;
+            all_cmps += cmps;
+         }
+         else
+         {
+            histogram = all_histogram;
+            time_ms = all_time_ms / num_repeats;
+            recall = all_recall / num_repeats;
+            cmps = all_cmps / num_repeats;
+         }
+         double qps = num_queries * 1000.0 / time_ms;
+         summary_out << repeat_name << "," << Lsearch_list[LsearchId] << "," << qps << "," << recall << "," << cmps << ","
+                     << histogram.mean_ms() << "," << histogram.percentile_ms(0.5) << "," << histogram.percentile_ms(0.9) << ","
+                     << histogram.percentile_ms(0.99) << "," << histogram.percentile_ms(0.999) << "," << histogram.max_ms() << "\n";
+         std::cout << repeat_name << "\t" << Lsearch_list[LsearchId] << "\t" << qps << "\t" << recall << "\t" << cmps << "\t"
+                   << histogram.percentile_ms(0.5) << "\t" << histogram.percentile_ms(0.9) << "\t" << histogram.percentile_ms(0.99) << "\t"
+                   << histogram.percentile_ms(0.999) << "\t" << histogram.max_ms() << std::endl;
+      }
+   }
+   summary_out.close();
 
-   for (int repeat = 0; repeat < num_repeats; repeat++)
+   // 输出详细文件
+   if (query_details)
    {
-      for (int LsearchId = 0; LsearchId < Lsearch_list.size(); LsearchId++)
+      std::ofstream detail_out(result_path_prefix + "query_details_repeat" + std::to_string(num_repeats) + ".csv");
+      detail_out << "repeat,Lsearch,QueryID,Time(ms),descendants_merge_time(ms),coverage_merge_time(ms),flag_time(ms),bitmap_time(ms),UNG_time(ms),DistanceCalcs,EntryPoints,LNGDescendants,entry_group_total_coverage,QPS,Recall,is_global_search";
+      if (perf_counters)
+         detail_out << ",cycles,instructions,LLC_misses,dTLB_misses,IPC";
+      if (scenario == "expression" || !query_ranges.empty())
+         detail_out << ",FilterMatches";
+      detail_out << "\n";
+
+      for (int repeat = 0; repeat < num_repeats; repeat++)
       {
-         for (int i = 0; i < num_queries; ++i)
+         for (int LsearchId = 0; LsearchId < Lsearch_list.size(); LsearchId++)
          {
-            detail_out << repeat << ","
-                       << Lsearch_list[LsearchId] << ","
-                       << i << ","
-                       << query_stats[repeat][LsearchId][i].time_ms << ","
-                       << query_stats[repeat][LsearchId][i].descendants_merge_time_ms << ","
-                       << query_stats[repeat][LsearchId][i].coverage_merge_time_ms << ","
-                       << query_stats[repeat][LsearchId][i].flag_time_ms << ","
-                       << bitmap_and_time[i].second << ","
-                       << query_stats[repeat][LsearchId][i].time_ms - query_stats[repeat][LsearchId][i].flag_time_ms << ","
-                       << query_stats[repeat][LsearchId][i].num_distance_calcs << ","
-                       << query_stats[repeat][LsearchId][i].num_entry_points << ","
-                       << query_stats[repeat][LsearchId][i].num_lng_descendants << ","
-                       << query_stats[repeat][LsearchId][i].entry_group_total_coverage << ","
-                       << 1000.0 / (query_stats[repeat][LsearchId][i].time_ms) << ","
-                       << query_stats[repeat][LsearchId][i].recall << ","
-                       << query_stats[repeat][LsearchId][i].is_global_search << "\n";
+            for (int i = 0; i < num_queries; ++i)
+            {
+               detail_out << repeat << ","
+                          << Lsearch_list[LsearchId] << ","
+                          << i << ","
+                          << query_stats[repeat][LsearchId][i].time_ms << ","
+                          << query_stats[repeat][LsearchId][i].descendants_merge_time_ms << ","
+                          << query_stats[repeat][LsearchId][i].coverage_merge_time_ms << ","
+                          << query_stats[repeat][LsearchId][i].flag_time_ms << ","
+                          << bitmap_and_time[i].second << ","
+                          << query_stats[repeat][LsearchId][i].time_ms - query_stats[repeat][LsearchId][i].flag_time_ms << ","
+                          << query_stats[repeat][LsearchId][i].num_distance_calcs << ","
+                          << query_stats[repeat][LsearchId][i].num_entry_points << ","
+                          << query_stats[repeat][LsearchId][i].num_lng_descendants << ","
+                          << query_stats[repeat][LsearchId][i].entry_group_total_coverage << ","
+                          << 1000.0 / (query_stats[repeat][LsearchId][i].time_ms) << ","
+                          << query_stats[repeat][LsearchId][i].recall << ","
+                          << query_stats[repeat][LsearchId][i].is_global_search;
+               if (perf_counters)
+               {
+                  const auto &perf = query_stats[repeat][LsearchId][i].perf;
+                  detail_out << "," << perf.cycles << "," << perf.instructions << "," << perf.llc_misses << ","
+                             << perf.dtlb_misses << "," << (perf.cycles > 0 ? (double)perf.instructions / perf.cycles : 0.0);
+               }
+               if (scenario == "expression" || !query_ranges.empty())
+                  detail_out << "," << query_stats[repeat][LsearchId][i].num_filter_matches;
+               detail_out << "\n";
+            }
          }
       }
+      detail_out.close();
    }
-   detail_out.close();
-   // std::cout << "- Lsearch=" << Lsearch_list[LsearchId] << ", time=" << time_cost << "ms" << std::endl;
-   // all_qpss.push_back(num_queries * 1000.0 / time_cost);
-   // all_cmps.push_back(std::accumulate(num_cmps.begin(), num_cmps.end(), 0.00f) / num_queries);
-   // all_recalls.push_back(ANNS::calculate_recall(gt, results, num_queries, K));
-   // std::ofstream out(result_path_prefix + "result_avg_repeat" + std::to_string(repeat) + ".csv");
-   // out << "L,Cmps,QPS,Recall,Time(ms),Flag_time(ms),Bitmap_time(ms),EntryPoints,LNGDescendants,entry_group_total_coverage\n";
-   // for (auto i = 0; i < Lsearch_list.size(); i++)
-   // {
-   //    out << Lsearch_list[i] << ","
-   //        << all_cmps[i] << ","
-   //        << all_qpss[i] << ","
-   //        << all_recalls[i] / 100.00 << ","
-   //        << all_time_ms[i] << ","
-   //        << all_flag_time[i] << ","
-   //        << all_bitmap_time[i] << ","
-   //        << all_entry_points[i] << ","
-   //        << all_lng_descendants[i] << ","
-   //        << all_entry_group_coverage[i] << "\n";
-   // }
-   // out.close();
 
    std::cout << "- all done" << std::endl;
    return 0;
@@ -0,0 +1,123 @@
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "disk_ung.h"
+#include "utils.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, scenario, query_bin_file, query_label_file, gt_file, index_path_prefix, result_path_prefix;
+   std::string io_engine;
+   ANNS::IdxType K, num_entry_points, beam_width;
+   std::vector<ANNS::IdxType> Lsearch_list;
+   uint32_t num_threads, num_io_threads;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2>");
+      desc.add_options()("query_bin_file", po::value<std::string>(&query_bin_file)->required(),
+                         "File containing the query vectors in binary format");
+      desc.add_options()("query_label_file", po::value<std::string>(&query_label_file)->default_value(""),
+                         "Query label file in txt format");
+      desc.add_options()("gt_file", po::value<std::string>(&gt_file)->default_value(""),
+                         "Ground truth in binary format, recall is not computed without it");
+      desc.add_options()("K", po::value<ANNS::IdxType>(&K)->required(),
+                         "Number of nearest neighbors to search");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of search threads");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Path to save the querying result file");
+      desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("containment"),
+                         "Scenario for the search, <equality/containment/overlap/nofilter>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the index with its disk layout (build_disk_UNG_index)");
+      desc.add_options()("num_entry_points", po::value<ANNS::IdxType>(&num_entry_points)->default_value(ANNS::default_paras::NUM_ENTRY_POINTS),
+                         "Number of entry points in each entry group");
+      desc.add_options()("Lsearch", po::value<std::vector<ANNS::IdxType>>(&Lsearch_list)->multitoken()->required(),
+                         "Number of candidates to search in the graph");
+      desc.add_options()("beam_width", po::value<ANNS::IdxType>(&beam_width)->default_value(4),
+                         "Number of nodes read from the disk per round");
+      desc.add_options()("io_engine", po::value<std::string>(&io_engine)->default_value("auto"),
+                         "Reads of the nodes, <auto/io_uring/pread>; auto uses io_uring when the kernel allows it");
+      desc.add_options()("num_io_threads", po::value<uint32_t>(&num_io_threads)->default_value(0),
+                         "Threads running the reads of a round in parallel for pread, 0 reads them in the search thread");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // check scenario
+   if (scenario != "containment" && scenario != "equality" && scenario != "overlap" && scenario != "nofilter")
+   {
+      std::cerr << "Invalid scenario: " << scenario << std::endl;
+      return -1;
+   }
+
+   // load query data and index
+   std::shared_ptr<ANNS::IStorage> query_storage = ANNS::create_storage(data_type);
+   query_storage->load_from_file(query_bin_file, query_label_file);
+   ANNS::DiskUniNavGraph index;
+   try
+   {
+      index.load(index_path_prefix, data_type, io_engine, num_io_threads);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // preparation
+   auto num_queries = query_storage->get_num_points();
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   std::vector<std::pair<ANNS::IdxType, float>> gt;
+   if (!gt_file.empty())
+   {
+      gt.resize((size_t)num_queries * K);
+      ANNS::load_gt_file(gt_file, gt.data(), num_queries, K);
+   }
+   std::vector<std::pair<ANNS::IdxType, float>> results((size_t)num_queries * K);
+   std::vector<float> num_cmps(num_queries), num_ios(num_queries);
+
+   // search
+   std::ofstream summary_out(result_path_prefix + "disk_summary.csv");
+   summary_out << "Lsearch,beam_width,io_engine,QPS,Recall,Cmps,IOs\n";
+   std::cout << "\nLsearch\tQPS\tRecall\tCmps\tIOs" << std::endl;
+   for (auto Lsearch : Lsearch_list)
+   {
+      auto start_time = std::chrono::high_resolution_clock::now();
+      index.search(query_storage, distance_handler, num_threads, Lsearch, beam_width, num_entry_points, scenario, K,
+                   results.data(), num_cmps, num_ios);
+      auto time_cost = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+      // statistics
+      float recall = gt.empty() ? 0 : ANNS::calculate_recall(gt.data(), results.data(), num_queries, K);
+      float qps = num_queries / (time_cost / 1000);
+      float avg_cmps = std::accumulate(num_cmps.begin(), num_cmps.end(), 0.0) / num_queries;
+      float avg_ios = std::accumulate(num_ios.begin(), num_ios.end(), 0.0) / num_queries;
+      std::cout << Lsearch << "\t" << qps << "\t" << recall << "\t" << avg_cmps << "\t" << avg_ios << std::endl;
+      summary_out << Lsearch << "," << beam_width << "," << index.get_io_engine() << "," << qps << "," << recall << ","
+                  << avg_cmps << "," << avg_ios << "\n";
+   }
+   return 0;
+}
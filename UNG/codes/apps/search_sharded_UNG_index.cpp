@@ -0,0 +1,121 @@
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "sharded_ung.h"
+#include "utils.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, scenario, query_bin_file, query_label_file, gt_file, index_path_prefix, result_path_prefix;
+   ANNS::IdxType K, num_entry_points;
+   std::vector<ANNS::IdxType> Lsearch_list;
+   uint32_t num_threads;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2/IP/cosine>");
+      desc.add_options()("query_bin_file", po::value<std::string>(&query_bin_file)->required(),
+                         "File containing the query vectors in binary format");
+      desc.add_options()("query_label_file", po::value<std::string>(&query_label_file)->default_value(""),
+                         "Query label file in txt format");
+      desc.add_options()("gt_file", po::value<std::string>(&gt_file)->default_value(""),
+                         "Ground truth in binary format (ids below 2^32), recall is not computed without it");
+      desc.add_options()("K", po::value<ANNS::IdxType>(&K)->required(),
+                         "Number of nearest neighbors to search");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads, split among the shards searched concurrently");
+      desc.add_options()("result_path_prefix", po::value<std::string>(&result_path_prefix)->required(),
+                         "Path to save the querying result file");
+      desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("containment"),
+                         "Scenario for the search, <equality/containment/overlap/nofilter>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the path to load the sharded index");
+      desc.add_options()("num_entry_points", po::value<ANNS::IdxType>(&num_entry_points)->default_value(ANNS::default_paras::NUM_ENTRY_POINTS),
+                         "Number of entry points in each entry group");
+      desc.add_options()("Lsearch", po::value<std::vector<ANNS::IdxType>>(&Lsearch_list)->multitoken()->required(),
+                         "Number of candidates to search in the graph");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   // check scenario
+   if (scenario != "containment" && scenario != "equality" && scenario != "overlap" && scenario != "nofilter")
+   {
+      std::cerr << "Invalid scenario: " << scenario << std::endl;
+      return -1;
+   }
+
+   // load query data and index
+   std::shared_ptr<ANNS::IStorage> query_storage = ANNS::create_storage(data_type);
+   query_storage->load_from_file(query_bin_file, query_label_file);
+   ANNS::ShardedUniNavGraph index;
+   index.load(index_path_prefix, data_type, num_threads);
+   std::cout << "Loaded " << index.get_num_shards() << " shards with " << index.get_num_points() << " points" << std::endl;
+
+   // preparation
+   auto num_queries = query_storage->get_num_points();
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   std::vector<std::pair<ANNS::IdxType, float>> gt;
+   if (!gt_file.empty())
+   {
+      if (index.get_num_points() > std::numeric_limits<ANNS::IdxType>::max())
+      {
+         std::cerr << "The ground truth file cannot hold ids of " << index.get_num_points() << " points" << std::endl;
+         return -1;
+      }
+      gt.resize((size_t)num_queries * K);
+      ANNS::load_gt_file(gt_file, gt.data(), num_queries, K);
+   }
+   std::vector<std::pair<ANNS::GlobalIdxType, float>> results((size_t)num_queries * K);
+   std::vector<std::pair<ANNS::IdxType, float>> results_32((size_t)num_queries * K);
+   std::vector<float> num_cmps(num_queries);
+   std::vector<ANNS::IdxType> num_searched_shards(num_queries);
+
+   // search
+   std::ofstream summary_out(result_path_prefix + "sharded_summary.csv");
+   summary_out << "Lsearch,QPS,Recall,Cmps,SearchedShards\n";
+   std::cout << "\nLsearch\tQPS\tRecall\tCmps\tShards" << std::endl;
+   for (auto Lsearch : Lsearch_list)
+   {
+      auto start_time = std::chrono::high_resolution_clock::now();
+      index.search(query_storage, distance_handler, num_threads, Lsearch, num_entry_points, scenario, K, results.data(),
+                   num_cmps, num_searched_shards);
+      auto time_cost = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+      // statistics
+      float recall = 0;
+      if (!gt.empty())
+      {
+         for (size_t i = 0; i < results.size(); ++i)
+            results_32[i] = {static_cast<ANNS::IdxType>(results[i].first), results[i].second};
+         recall = ANNS::calculate_recall(gt.data(), results_32.data(), num_queries, K);
+      }
+      float qps = num_queries / (time_cost / 1000);
+      float avg_cmps = std::accumulate(num_cmps.begin(), num_cmps.end(), 0.0) / num_queries;
+      float avg_shards = std::accumulate(num_searched_shards.begin(), num_searched_shards.end(), 0.0) / num_queries;
+      std::cout << Lsearch << "\t" << qps << "\t" << recall << "\t" << avg_cmps << "\t" << avg_shards << std::endl;
+      summary_out << Lsearch << "," << qps << "," << recall << "," << avg_cmps << "," << avg_shards << "\n";
+   }
+   return 0;
+}
@@ -0,0 +1,379 @@
+#include <omp.h>
+#include <sched.h>
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <boost/program_options.hpp>
+#include "utils.h"
+#include "uni_nav_graph.h"
+
+#include <faiss/IndexACORN.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/NSG.h>
+#include <faiss/utils/Heap.h>
+
+namespace po = boost::program_options;
+
+/*
+end-to-end filtered search benchmark of UNG and ACORN on the same workload (containment scenario, float L2):
+the base and query sets are loaded once, the exact filtered ground truth and the selectivity of each query are
+computed once, then both engines run the same queries with the same threads over their parameter sweeps
+(Lsearch for UNG, efSearch for ACORN). One CSV row per engine, parameter and selectivity bucket.
+*/
+
+namespace
+{
+   struct RunResult
+   {
+      std::string engine;
+      uint32_t param;
+      double wall_ms;
+      std::vector<double> latency_ms;
+      std::vector<double> cmps;
+      std::vector<float> recall;
+   };
+
+   // pin each OpenMP thread to one core, the pool is reused by the later parallel regions
+   void pin_threads(uint32_t num_threads)
+   {
+      uint32_t num_cpus = std::max<long>(1, sysconf(_SC_NPROCESSORS_ONLN));
+      omp_set_num_threads(num_threads);
+#pragma omp parallel
+      {
+         cpu_set_t cpu_set;
+         CPU_ZERO(&cpu_set);
+         CPU_SET(omp_get_thread_num() % num_cpus, &cpu_set);
+         sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+      }
+   }
+
+   bool contains(ANNS::LabelSpan base_labels, ANNS::LabelSpan query_labels)
+   {
+      return std::includes(base_labels.begin(), base_labels.end(), query_labels.begin(), query_labels.end());
+   }
+
+   float query_recall(const std::pair<ANNS::IdxType, float> *gt, const std::vector<ANNS::IdxType> &res, ANNS::IdxType K)
+   {
+      std::unordered_set<ANNS::IdxType> gt_set;
+      for (ANNS::IdxType k = 0; k < K; ++k)
+         if (gt[k].first != (ANNS::IdxType)-1)
+            gt_set.insert(gt[k].first);
+      if (gt_set.empty())
+         return 1.0f;
+      ANNS::IdxType correct = 0;
+      for (auto id : res)
+         correct += gt_set.count(id);
+      return (float)correct / gt_set.size();
+   }
+
+   double percentile(std::vector<double> sorted_values, double p)
+   {
+      if (sorted_values.empty())
+         return 0;
+      std::sort(sorted_values.begin(), sorted_values.end());
+      size_t rank = std::min(sorted_values.size() - 1, (size_t)std::ceil(p * sorted_values.size()) - (p > 0));
+      return sorted_values[rank];
+   }
+}
+
+int main(int argc, char **argv)
+{
+   std::string base_bin_file, base_label_file, query_bin_file, query_label_file, gt_file, ung_index_path_prefix;
+   std::string engines, output_file;
+   std::vector<ANNS::IdxType> Lsearch_list, efs_list;
+   ANNS::IdxType K, num_entry_points;
+   uint32_t num_threads, warmup_rounds;
+   bool is_ori_ung, pin, if_bfs_filter, acorn_collect_stats;
+   int acorn_M, acorn_gamma, acorn_M_beta;
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("base_bin_file", po::value<std::string>(&base_bin_file)->required(),
+                         "Base vectors (float), <bin/fbin/fvecs>");
+      desc.add_options()("base_label_file", po::value<std::string>(&base_label_file)->required(),
+                         "Base labels, txt or CSR");
+      desc.add_options()("query_bin_file", po::value<std::string>(&query_bin_file)->required(),
+                         "Query vectors (float)");
+      desc.add_options()("query_label_file", po::value<std::string>(&query_label_file)->required(),
+                         "Query labels, txt or CSR");
+      desc.add_options()("gt_file", po::value<std::string>(&gt_file)->default_value(""),
+                         "UNG ground truth file, computed by a filtered scan if empty");
+      desc.add_options()("K", po::value<ANNS::IdxType>(&K)->default_value(10), "Number of neighbors");
+      desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(1), "Search threads");
+      desc.add_options()("pin_threads", po::value<bool>(&pin)->default_value(true), "Pin search threads to cores");
+      desc.add_options()("warmup_rounds", po::value<uint32_t>(&warmup_rounds)->default_value(1),
+                         "Untimed passes over the queries before each timed run");
+      desc.add_options()("engines", po::value<std::string>(&engines)->default_value("ung,acorn"),
+                         "Comma separated engines <ung,acorn>");
+      desc.add_options()("output_file", po::value<std::string>(&output_file)->default_value("filtered_search.csv"),
+                         "CSV output");
+
+      // UNG
+      desc.add_options()("ung_index_path_prefix", po::value<std::string>(&ung_index_path_prefix)->default_value(""),
+                         "UNG index built by build_UNG_index");
+      desc.add_options()("Lsearch", po::value<std::vector<ANNS::IdxType>>(&Lsearch_list)->multitoken(),
+                         "UNG Lsearch sweep");
+      desc.add_options()("num_entry_points", po::value<ANNS::IdxType>(&num_entry_points)->default_value(ANNS::default_paras::NUM_ENTRY_POINTS),
+                         "UNG entry points");
+      desc.add_options()("is_ori_ung", po::value<bool>(&is_ori_ung)->default_value(true),
+                         "UNG without the global-search switch");
+
+      // ACORN
+      desc.add_options()("efs", po::value<std::vector<ANNS::IdxType>>(&efs_list)->multitoken(),
+                         "ACORN efSearch sweep");
+      desc.add_options()("acorn_M", po::value<int>(&acorn_M)->default_value(32), "ACORN M");
+      desc.add_options()("acorn_gamma", po::value<int>(&acorn_gamma)->default_value(12), "ACORN gamma");
+      desc.add_options()("acorn_M_beta", po::value<int>(&acorn_M_beta)->default_value(64), "ACORN M_beta");
+      desc.add_options()("if_bfs_filter", po::value<bool>(&if_bfs_filter)->default_value(true),
+                         "ACORN filtered neighbor expansion");
+      desc.add_options()("acorn_collect_stats", po::value<bool>(&acorn_collect_stats)->default_value(false),
+                         "One extra untimed ACORN pass per efSearch with the level-0 loop profiling stats");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+   bool run_ung = engines.find("ung") != std::string::npos, run_acorn = engines.find("acorn") != std::string::npos;
+   if (run_ung && (ung_index_path_prefix.empty() || Lsearch_list.empty()))
+   {
+      std::cerr << "Error: UNG needs --ung_index_path_prefix and --Lsearch" << std::endl;
+      return -1;
+   }
+   if (run_acorn && efs_list.empty())
+   {
+      std::cerr << "Error: ACORN needs --efs" << std::endl;
+      return -1;
+   }
+   if (pin)
+      pin_threads(num_threads);
+   omp_set_num_threads(num_threads);
+
+   // load the workload once
+   auto base_storage = ANNS::create_storage("float");
+   base_storage->load_from_file(base_bin_file, base_label_file);
+   auto query_storage = ANNS::create_storage("float");
+   query_storage->load_from_file(query_bin_file, query_label_file);
+   ANNS::IdxType num_points = base_storage->get_num_points(), num_queries = query_storage->get_num_points();
+   ANNS::IdxType dim = base_storage->get_dim();
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+
+   // selectivity and exact ground truth by a filtered scan, the ACORN filter map comes from the same test
+   std::cout << "Computing selectivity and ground truth ..." << std::endl;
+   auto start_time = std::chrono::high_resolution_clock::now();
+   std::vector<double> selectivity(num_queries);
+   std::vector<char> filter_map(run_acorn ? (size_t)num_queries * num_points : 0);
+   auto gt = new std::pair<ANNS::IdxType, float>[(size_t)num_queries * K];
+   bool compute_gt = gt_file.empty();
+   if (!compute_gt)
+      ANNS::load_gt_file(gt_file, gt, num_queries, K);
+#pragma omp parallel for schedule(dynamic, 1)
+   for (ANNS::IdxType q = 0; q < num_queries; ++q)
+   {
+      const auto &query_labels = query_storage->get_label_set(q);
+      std::vector<std::pair<float, ANNS::IdxType>> candidates;
+      size_t num_matches = 0;
+      for (ANNS::IdxType i = 0; i < num_points; ++i)
+      {
+         if (!contains(base_storage->get_label_span(i), query_labels))
+            continue;
+         ++num_matches;
+         if (run_acorn)
+            filter_map[(size_t)q * num_points + i] = 1;
+         if (compute_gt)
+            candidates.emplace_back(distance_handler->compute(query_storage->get_vector(q), base_storage->get_vector(i), dim), i);
+      }
+      selectivity[q] = (double)num_matches / num_points;
+      if (compute_gt)
+      {
+         size_t num_gt = std::min<size_t>(K, candidates.size());
+         std::partial_sort(candidates.begin(), candidates.begin() + num_gt, candidates.end());
+         for (ANNS::IdxType k = 0; k < K; ++k)
+            gt[(size_t)q * K + k] = k < num_gt ? std::make_pair(candidates[k].second, candidates[k].first)
+                                               : std::make_pair((ANNS::IdxType)-1, 0.0f);
+      }
+   }
+   std::cout << "- Finished in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+
+   std::vector<RunResult> runs;
+
+   // UNG
+   if (run_ung)
+   {
+      ANNS::UniNavGraph index(num_queries);
+      index.load(ung_index_path_prefix, "float");
+      index.load_bipartite_graph(ung_index_path_prefix + "vector_attr_graph");
+
+      // the bitmaps are only read by the global search
+      std::vector<std::bitset<10000001>> bitmaps;
+      if (!is_ori_ung)
+      {
+         bitmaps.resize(num_queries);
+#pragma omp parallel for
+         for (ANNS::IdxType q = 0; q < num_queries; ++q)
+            bitmaps[q] = index.compute_attribute_bitmap(query_storage->get_label_set(q)).first;
+      }
+
+      auto results = new std::pair<ANNS::IdxType, float>[(size_t)num_queries * K];
+      for (auto Lsearch : Lsearch_list)
+      {
+         std::vector<float> num_cmps(num_queries);
+         std::vector<ANNS::QueryStats> query_stats;
+         for (uint32_t r = 0; r < warmup_rounds; ++r)
+            index.search_hybrid(query_storage, distance_handler, num_threads, Lsearch, num_entry_points, "containment",
+                                K, results, num_cmps, query_stats, bitmaps, is_ori_ung);
+
+         RunResult run{"UNG", Lsearch};
+         auto run_start = std::chrono::high_resolution_clock::now();
+         index.search_hybrid(query_storage, distance_handler, num_threads, Lsearch, num_entry_points, "containment",
+                             K, results, num_cmps, query_stats, bitmaps, is_ori_ung);
+         run.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - run_start).count();
+         for (ANNS::IdxType q = 0; q < num_queries; ++q)
+         {
+            std::vector<ANNS::IdxType> res;
+            for (ANNS::IdxType k = 0; k < K; ++k)
+               res.push_back(results[(size_t)q * K + k].first);
+            run.latency_ms.push_back(query_stats[q].time_ms);
+            run.cmps.push_back(num_cmps[q]);
+            run.recall.push_back(query_recall(gt + (size_t)q * K, res, K));
+         }
+         runs.emplace_back(std::move(run));
+      }
+      delete[] results;
+   }
+
+   // ACORN, built here from the same base vectors and labels
+   if (run_acorn)
+   {
+      std::vector<std::vector<int>> metadata_multi(num_points);
+      for (ANNS::IdxType i = 0; i < num_points; ++i)
+      {
+         auto labels = base_storage->get_label_span(i);
+         metadata_multi[i].assign(labels.begin(), labels.end());
+      }
+      std::cout << "Building ACORN index ..." << std::endl;
+      auto build_start = std::chrono::high_resolution_clock::now();
+      faiss::IndexACORNFlat acorn_index(dim, acorn_M, acorn_gamma, metadata_multi, acorn_M_beta);
+      acorn_index.add(num_points, (const float *)base_storage->get_vector(0));
+      std::cout << "- Finished in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - build_start).count() << " ms" << std::endl;
+
+      const float *queries = (const float *)query_storage->get_vector(0);
+      std::vector<faiss::idx_t> labels((size_t)num_queries * K);
+      std::vector<float> distances((size_t)num_queries * K);
+      std::vector<double> latency_ms(num_queries), ndis(num_queries); // ndis is ACORNStats::n3
+
+      // per-query loop of IndexACORN::search, keeping the latency and the stats of each query
+      std::vector<faiss::ACORNStats> query_stats(num_queries);
+      auto search_all = [&](const faiss::SearchParametersACORN &params)
+      {
+#pragma omp parallel
+         {
+            faiss::VisitedTable vt(num_points);
+            faiss::DistanceComputer *dis = faiss::nsg::storage_distance_computer(acorn_index.storage);
+            faiss::ScopeDeleter1<faiss::DistanceComputer> del(dis);
+#pragma omp for schedule(dynamic, 1)
+            for (ANNS::IdxType q = 0; q < num_queries; ++q)
+            {
+               auto query_start = std::chrono::high_resolution_clock::now();
+               faiss::idx_t *idxi = labels.data() + (size_t)q * K;
+               float *simi = distances.data() + (size_t)q * K;
+               dis->set_query(queries + (size_t)q * dim);
+               faiss::maxheap_heapify(K, simi, idxi);
+               auto stats = acorn_index.acorn.hybrid_search(*dis, K, idxi, simi, vt, filter_map.data() + (size_t)q * num_points,
+                                                            if_bfs_filter, &params);
+               faiss::maxheap_reorder(K, simi, idxi);
+               latency_ms[q] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - query_start).count();
+               ndis[q] = stats.n3;
+               query_stats[q] = stats;
+            }
+         }
+      };
+
+      for (auto efs : efs_list)
+      {
+         // the queue size comes from the index, the stopping condition from the params
+         acorn_index.acorn.efSearch = efs;
+         faiss::SearchParametersACORN params;
+         params.efSearch = efs;
+         for (uint32_t r = 0; r < warmup_rounds; ++r)
+            search_all(params);
+
+         RunResult run{"ACORN", efs};
+         auto run_start = std::chrono::high_resolution_clock::now();
+         search_all(params);
+         run.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - run_start).count();
+         for (ANNS::IdxType q = 0; q < num_queries; ++q)
+         {
+            std::vector<ANNS::IdxType> res(labels.begin() + (size_t)q * K, labels.begin() + (size_t)(q + 1) * K);
+            run.latency_ms.push_back(latency_ms[q]);
+            run.cmps.push_back(ndis[q]);
+            run.recall.push_back(query_recall(gt + (size_t)q * K, res, K));
+         }
+         runs.emplace_back(std::move(run));
+
+         // the profiling build of the loop is slower, so its pass is not timed
+         if (acorn_collect_stats)
+         {
+            params.collect_stats = true;
+            search_all(params);
+            faiss::ACORNStats total;
+            for (const auto &stats : query_stats)
+               total.combine(stats);
+            std::cout << "ACORN efSearch " << efs << " per query: candidates loop "
+                      << total.candidates_loop * 1000 / num_queries << " ms ("
+                      << total.candidates_loop_cycles / num_queries << " cycles), neighbors loop "
+                      << total.neighbors_loop * 1000 / num_queries << " ms ("
+                      << total.neighbors_loop_cycles / num_queries << " cycles), visits "
+                      << total.visits / num_queries << ", skips " << total.skips / num_queries << std::endl;
+         }
+      }
+   }
+
+   // report per selectivity bucket, QPS of a bucket is its share of the wall time
+   const std::vector<std::pair<std::string, std::pair<double, double>>> buckets = {
+       {"all", {0.0, 1.1}}, {"<0.1%", {0.0, 0.001}}, {"0.1-1%", {0.001, 0.01}}, {"1-10%", {0.01, 0.1}}, {">=10%", {0.1, 1.1}}};
+   std::ofstream out(output_file);
+   out << "engine,param,threads,bucket,num_queries,QPS,p50_ms,p95_ms,p99_ms,p99.9_ms,avg_cmps,recall\n";
+   for (const auto &run : runs)
+   {
+      double total_latency = std::accumulate(run.latency_ms.begin(), run.latency_ms.end(), 0.0);
+      for (const auto &bucket : buckets)
+      {
+         std::vector<double> latency;
+         double cmps = 0, recall = 0, bucket_latency = 0;
+         for (ANNS::IdxType q = 0; q < num_queries; ++q)
+         {
+            if (selectivity[q] < bucket.second.first || selectivity[q] >= bucket.second.second)
+               continue;
+            latency.push_back(run.latency_ms[q]);
+            bucket_latency += run.latency_ms[q];
+            cmps += run.cmps[q];
+            recall += run.recall[q];
+         }
+         if (latency.empty())
+            continue;
+         double bucket_wall_ms = total_latency > 0 ? run.wall_ms * bucket_latency / total_latency : run.wall_ms;
+         out << run.engine << "," << run.param << "," << num_threads << "," << bucket.first << "," << latency.size() << ","
+             << latency.size() * 1000.0 / bucket_wall_ms << "," << percentile(latency, 0.5) << "," << percentile(latency, 0.95) << ","
+             << percentile(latency, 0.99) << "," << percentile(latency, 0.999) << "," << cmps / latency.size() << ","
+             << recall / latency.size() << "\n";
+      }
+   }
+   out.close();
+   std::cout << "Results written to " << output_file << std::endl;
+   delete[] gt;
+   return 0;
+}
@@ -0,0 +1,401 @@
+#include <chrono>
+#include <random>
+#include <limits>
+#include <numeric>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <boost/program_options.hpp>
+#include "trie.h"
+#include "utils.h"
+#include "distance.h"
+#include "visited_set.h"
+#include "search_queue.h"
+#include "huge_pages.h"
+#include "perf_counters.h"
+#include "uni_nav_graph.h"
+
+namespace po = boost::program_options;
+
+/*
+microbenchmarks of the UNG building blocks, one JSON object per line:
+   {"bench": name, "param": parameter, "ops": operations per run, "ns_per_op_min": .., "ns_per_op_median": ..}
+the index benchmarks use --index_path_prefix (and --query_label_file) if given,
+otherwise a small synthetic index is built in --tmp_dir
+*/
+
+namespace
+{
+   std::ofstream g_out;
+   int g_repeats = 5;
+
+   // volatile sink so that the benchmarked work is not optimized away
+   volatile double g_sink = 0;
+
+   // run fn repeats times, each call does num_ops operations
+   // with count_tlb the timed runs are also counted by PerfCounters, "dtlb_misses_per_op" is added if the PMU is available
+   void run_bench(const std::string &bench, const std::string &param, size_t num_ops, const std::function<void()> &fn,
+                  bool count_tlb = false)
+   {
+      fn(); // warmup
+      std::vector<double> ns_per_op;
+      ANNS::PerfCounters counters;
+      ANNS::PerfCounterValues counter_values;
+      for (int r = 0; r < g_repeats; ++r)
+      {
+         if (count_tlb)
+            counters.start();
+         auto start_time = std::chrono::high_resolution_clock::now();
+         fn();
+         double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start_time).count();
+         if (count_tlb)
+            counter_values.add(counters.stop());
+         ns_per_op.push_back(ns / num_ops);
+      }
+      std::sort(ns_per_op.begin(), ns_per_op.end());
+      std::ostringstream line;
+      line << "{\"bench\": \"" << bench << "\", \"param\": \"" << param << "\", \"ops\": " << num_ops
+           << ", \"ns_per_op_min\": " << ns_per_op.front() << ", \"ns_per_op_median\": " << ns_per_op[ns_per_op.size() / 2];
+      if (count_tlb && counters.available())
+         line << ", \"dtlb_misses_per_op\": " << (double)counter_values.dtlb_misses / g_repeats / num_ops;
+      line << "}";
+      g_out << line.str() << std::endl;
+      std::cerr << line.str() << std::endl;
+   }
+
+   void bench_search_queue(std::mt19937 &gen)
+   {
+      const size_t num_inserts = 1 << 20;
+      std::uniform_real_distribution<float> dis(0, 1);
+      std::vector<float> distances(num_inserts);
+      for (auto &d : distances)
+         d = dis(gen);
+      for (int32_t capacity : {10, 50, 100, 500, 1000, 5000})
+      {
+         ANNS::SearchQueue queue;
+         queue.reserve(capacity);
+         run_bench("search_queue_insert", "capacity=" + std::to_string(capacity), num_inserts, [&]()
+                   {
+            queue.clear();
+            for (size_t i = 0; i < num_inserts; ++i)
+               queue.insert(i, distances[i]);
+            g_sink = queue[0].distance; });
+      }
+   }
+
+   void bench_visited_set(std::mt19937 &gen)
+   {
+      const size_t num_checks = 1 << 16;
+      for (ANNS::IdxType num_elements : {100000u, 1000000u, 10000000u})
+      {
+         std::uniform_int_distribution<ANNS::IdxType> dis(0, num_elements - 1);
+         std::vector<ANNS::IdxType> ids(num_checks);
+         for (auto &id : ids)
+            id = dis(gen);
+         ANNS::VisitedSet visited_set;
+         visited_set.init(num_elements);
+
+         // clear includes the full memset every 65535 calls
+         run_bench("visited_set_clear", "n=" + std::to_string(num_elements), 1 << 16, [&]()
+                   {
+            for (int i = 0; i < (1 << 16); ++i)
+               visited_set.clear(); });
+
+         // one query: clear, then check and set random ids
+         run_bench("visited_set_check_set", "n=" + std::to_string(num_elements), num_checks, [&]()
+                   {
+            visited_set.clear();
+            size_t hits = 0;
+            for (auto id : ids)
+            {
+               if (visited_set.check(id))
+                  ++hits;
+               else
+                  visited_set.set(id);
+            }
+            g_sink = hits; });
+      }
+   }
+
+   void bench_l2_distance(std::mt19937 &gen)
+   {
+      const size_t num_vecs = 4096, num_ops = 1 << 18;
+      auto handler = ANNS::get_distance_handler("float", "L2");
+      std::uniform_real_distribution<float> dis(-1, 1);
+      for (ANNS::IdxType dim : {16u, 32u, 64u, 96u, 100u, 128u, 200u, 256u, 384u, 768u, 960u})
+      {
+         auto data = static_cast<float *>(std::aligned_alloc(32, num_vecs * dim * sizeof(float)));
+         for (size_t i = 0; i < num_vecs * dim; ++i)
+            data[i] = dis(gen);
+         run_bench("float_l2_compute", "dim=" + std::to_string(dim), num_ops, [&]()
+                   {
+            double sum = 0;
+            for (size_t i = 0; i < num_ops; ++i)
+               sum += handler->compute((const char *)data, (const char *)(data + (i % num_vecs) * dim), dim);
+            g_sink = sum; });
+         std::free(data);
+      }
+   }
+
+   // dependent random reads over a huge_alloc block under each huge page policy, one 64-byte line per hop as in a
+   // graph walk over the vectors; the gap between the policies is the page walk cost the huge pages save
+   void bench_huge_pages(std::mt19937 &gen, size_t num_bytes)
+   {
+      const size_t line_size = 64, num_hops = 1 << 20;
+      size_t num_lines = num_bytes / line_size;
+      if (num_lines < 2 || num_lines > std::numeric_limits<uint32_t>::max())
+      {
+         std::cerr << "Skip huge page benchmark of " << num_bytes << " bytes" << std::endl;
+         return;
+      }
+
+      // a single cycle through all lines (Sattolo), the next line is stored in the current one
+      std::vector<uint32_t> next(num_lines);
+      std::iota(next.begin(), next.end(), 0);
+      for (size_t i = num_lines - 1; i > 0; --i)
+         std::swap(next[i], next[std::uniform_int_distribution<size_t>(0, i - 1)(gen)]);
+
+      for (auto name : {"none", "thp", "hugetlb"})
+      {
+         ANNS::set_huge_page_policy(ANNS::parse_huge_page_policy(name));
+         auto block = static_cast<char *>(ANNS::huge_alloc(num_lines * line_size));
+         for (size_t i = 0; i < num_lines; ++i)
+            *reinterpret_cast<uint32_t *>(block + i * line_size) = next[i];
+         auto stats = ANNS::get_huge_page_stats();
+         std::string backing = stats.hugetlb_bytes > 0 ? "hugetlb" : stats.thp_bytes > 0 ? "thp"
+                                                                       : stats.small_page_bytes > 0 ? "small"
+                                                                                                    : "heap";
+         run_bench("huge_page_walk", "policy=" + std::string(name) + ",backing=" + backing + ",mb=" +
+                   std::to_string(num_bytes >> 20), num_hops, [&]()
+                   {
+            uint32_t cur = 0;
+            for (size_t i = 0; i < num_hops; ++i)
+               cur = *reinterpret_cast<const uint32_t *>(block + (size_t)cur * line_size);
+            g_sink = cur; }, true);
+         ANNS::huge_free(block);
+      }
+      ANNS::set_huge_page_policy(ANNS::HugePagePolicy::NONE);
+   }
+
+   // sample query label sets as subsets of base label sets, so that they have answers
+   std::vector<std::vector<ANNS::LabelType>> sample_query_label_sets(std::shared_ptr<ANNS::IStorage> base_storage,
+                                                                     size_t num_queries, std::mt19937 &gen)
+   {
+      std::uniform_int_distribution<ANNS::IdxType> dis(0, base_storage->get_num_points() - 1);
+      std::vector<std::vector<ANNS::LabelType>> query_label_sets(num_queries);
+      for (auto &label_set : query_label_sets)
+      {
+         auto base_label_set = base_storage->get_label_span(dis(gen));
+         for (auto label : base_label_set)
+            if (label_set.empty() || gen() % 2)
+               label_set.emplace_back(label);
+      }
+      return query_label_sets;
+   }
+
+   void bench_trie(std::shared_ptr<ANNS::IStorage> base_storage,
+                   const std::vector<std::vector<ANNS::LabelType>> &query_label_sets)
+   {
+      ANNS::TrieIndex trie_index;
+      ANNS::IdxType new_group_id = 1;
+      for (ANNS::IdxType i = 0; i < base_storage->get_num_points(); ++i)
+         trie_index.insert(base_storage->get_label_span(i), new_group_id);
+      std::vector<std::shared_ptr<ANNS::TrieNode>> entrances;
+      run_bench("trie_get_super_set_entrances", "groups=" + std::to_string(new_group_id - 1), query_label_sets.size(), [&]()
+                {
+         size_t num_entrances = 0;
+         for (const auto &label_set : query_label_sets)
+         {
+            entrances.clear();
+            trie_index.get_super_set_entrances(label_set, entrances, false, true);
+            num_entrances += entrances.size();
+         }
+         g_sink = num_entrances; });
+   }
+
+   void bench_index(ANNS::UniNavGraph &index, const std::vector<std::vector<ANNS::LabelType>> &query_label_sets)
+   {
+      std::string param = "points=" + std::to_string(index._num_points);
+      size_t num_queries = query_label_sets.size();
+
+      std::vector<std::vector<ANNS::IdxType>> entry_group_ids(num_queries);
+      run_bench("get_min_super_sets", param, num_queries, [&]()
+                {
+         for (size_t q = 0; q < num_queries; ++q)
+         {
+            entry_group_ids[q].clear();
+            index.get_min_super_sets(query_label_sets[q], entry_group_ids[q], true, true);
+         } });
+
+      // the two merges of search_hybrid
+      auto merge = [&](const std::vector<roaring::Roaring> &sets)
+      {
+         size_t total = 0;
+         for (const auto &group_ids : entry_group_ids)
+         {
+            roaring::Roaring combined;
+            for (auto group_id : group_ids)
+               if (group_id > 0 && group_id < sets.size())
+                  combined |= sets[group_id];
+            total += combined.cardinality();
+         }
+         g_sink = total;
+      };
+      run_bench("roaring_merge_lng_descendants", param, num_queries, [&]()
+                { merge(index._lng_descendants_rb); });
+      run_bench("roaring_merge_covered_sets", param, num_queries, [&]()
+                { merge(index._covered_sets_rb); });
+
+      // the bitmap is 1.25MB, fewer queries
+      size_t num_bitmap_queries = std::min<size_t>(num_queries, 200);
+      run_bench("compute_attribute_bitmap", param, num_bitmap_queries, [&]()
+                {
+         size_t total = 0;
+         for (size_t q = 0; q < num_bitmap_queries; ++q)
+            total += index.compute_attribute_bitmap(query_label_sets[q]).first.count();
+         g_sink = total; });
+   }
+
+   // small synthetic dataset, zipf-like labels
+   std::shared_ptr<ANNS::IStorage> make_synthetic_storage(const std::string &tmp_dir, ANNS::IdxType num_points,
+                                                          ANNS::IdxType dim, ANNS::IdxType num_labels, std::mt19937 &gen)
+   {
+      std::string bin_file = tmp_dir + "/bench_base.bin", label_file = tmp_dir + "/bench_base_labels.txt";
+      std::ofstream bin_out(bin_file, std::ios::binary);
+      bin_out.write((char *)&num_points, sizeof(ANNS::IdxType));
+      bin_out.write((char *)&dim, sizeof(ANNS::IdxType));
+      std::uniform_real_distribution<float> dis(-1, 1);
+      for (size_t i = 0; i < (size_t)num_points * dim; ++i)
+      {
+         float value = dis(gen);
+         bin_out.write((char *)&value, sizeof(float));
+      }
+      bin_out.close();
+
+      std::vector<double> weights(num_labels);
+      for (ANNS::IdxType l = 0; l < num_labels; ++l)
+         weights[l] = 1.0 / (l + 1);
+      std::discrete_distribution<int> label_dis(weights.begin(), weights.end());
+      std::ofstream label_out(label_file);
+      for (ANNS::IdxType i = 0; i < num_points; ++i)
+      {
+         std::vector<int> labels;
+         int num = 1 + gen() % 3;
+         for (int j = 0; j < num; ++j)
+            labels.push_back(label_dis(gen) + 1);
+         std::sort(labels.begin(), labels.end());
+         labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+         for (size_t j = 0; j < labels.size(); ++j)
+            label_out << (j ? "," : "") << labels[j];
+         label_out << std::endl;
+      }
+      label_out.close();
+
+      auto storage = ANNS::create_storage("float", false);
+      storage->load_from_file(bin_file, label_file);
+      return storage;
+   }
+}
+
+int main(int argc, char **argv)
+{
+   std::string output_file, index_path_prefix, data_type, query_label_file, tmp_dir, benches;
+   ANNS::IdxType num_points, num_queries;
+   size_t huge_page_mb;
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("output_file", po::value<std::string>(&output_file)->default_value("bench_results.jsonl"),
+                         "JSON lines output");
+      desc.add_options()("benches", po::value<std::string>(&benches)->default_value("all"),
+                         "Comma separated subset of <queue,visited,distance,hugepages,trie,index> or all");
+      desc.add_options()("repeats", po::value<int>(&g_repeats)->default_value(5),
+                         "Timed runs per benchmark");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->default_value(""),
+                         "Real UNG index for the trie/index benchmarks, synthetic if empty");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->default_value("float"),
+                         "Data type of the real index <int8/uint8/float>");
+      desc.add_options()("query_label_file", po::value<std::string>(&query_label_file)->default_value(""),
+                         "Query labels for the real index, sampled from the base labels if empty");
+      desc.add_options()("num_points", po::value<ANNS::IdxType>(&num_points)->default_value(20000),
+                         "Number of synthetic base points");
+      desc.add_options()("num_queries", po::value<ANNS::IdxType>(&num_queries)->default_value(1000),
+                         "Number of sampled query label sets");
+      desc.add_options()("huge_page_mb", po::value<size_t>(&huge_page_mb)->default_value(1024),
+                         "Size of the block walked by the huge page benchmark, well above the dTLB reach");
+      desc.add_options()("tmp_dir", po::value<std::string>(&tmp_dir)->default_value("/tmp"),
+                         "Directory for the synthetic dataset");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   g_out.open(output_file);
+   auto enabled = [&](const std::string &name)
+   { return benches == "all" || ("," + benches + ",").find("," + name + ",") != std::string::npos; };
+   std::mt19937 gen(2024);
+
+   if (enabled("queue"))
+      bench_search_queue(gen);
+   if (enabled("visited"))
+      bench_visited_set(gen);
+   if (enabled("distance"))
+      bench_l2_distance(gen);
+   if (enabled("hugepages"))
+      bench_huge_pages(gen, huge_page_mb << 20);
+   if (!enabled("trie") && !enabled("index"))
+      return 0;
+
+   // label-side benchmarks on a real or synthetic index
+   ANNS::UniNavGraph index;
+   std::shared_ptr<ANNS::IStorage> base_storage;
+   if (!index_path_prefix.empty())
+   {
+      index.load(index_path_prefix, data_type);
+      base_storage = ANNS::create_storage(data_type, false);
+      base_storage->load_from_file(index_path_prefix + "vecs.bin", index_path_prefix + "labels.txt");
+   }
+   else
+   {
+      base_storage = make_synthetic_storage(tmp_dir, num_points, 16, 50, gen);
+      auto distance_handler = ANNS::get_distance_handler("float", "L2");
+      index.build(base_storage, std::move(distance_handler), "general", "Vamana", 1, 6, 16, 50, 1.2);
+   }
+
+   std::vector<std::vector<ANNS::LabelType>> query_label_sets;
+   if (!query_label_file.empty())
+   {
+      std::ifstream in(query_label_file);
+      std::string line, label;
+      while (std::getline(in, line))
+      {
+         std::vector<ANNS::LabelType> query_label_set;
+         std::stringstream ss(line);
+         while (std::getline(ss, label, ','))
+            query_label_set.emplace_back(std::stoi(label));
+         std::sort(query_label_set.begin(), query_label_set.end());
+         query_label_sets.emplace_back(std::move(query_label_set));
+      }
+   }
+   else
+      query_label_sets = sample_query_label_sets(base_storage, num_queries, gen);
+
+   if (enabled("trie"))
+      bench_trie(base_storage, query_label_sets);
+   if (enabled("index"))
+      bench_index(index, query_label_sets);
+   return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef ANNS_BUILD_TRACE_H
+#define ANNS_BUILD_TRACE_H
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace ANNS
+{
+
+   // resident set size of the process in bytes, current and peak (0 if unknown)
+   size_t get_current_rss();
+   size_t get_peak_rss();
+
+   // build trace in the Chrome trace-event format (chrome://tracing, Perfetto)
+   // spans are complete events on the thread (OpenMP thread id) that records them,
+   // counters are sampled explicitly, e.g. RSS and structure sizes at phase boundaries
+   class BuildTrace
+   {
+   public:
+      using Clock = std::chrono::steady_clock;
+
+      BuildTrace() : _start(Clock::now()) {}
+
+      // span [start, now), args is a JSON object body like "\"group_id\":3" or empty
+      void add_span(const std::string &name, const std::string &cat, Clock::time_point start,
+                    const std::string &args = "");
+
+      // counter track, one series per (key, value)
+      void add_counter(const std::string &name, const std::vector<std::pair<std::string, double>> &values);
+
+      // current and peak RSS as a counter track
+      void sample_rss();
+
+      void write(const std::string &filename) const;
+
+   private:
+      Clock::time_point _start;
+      mutable std::mutex _mutex;
+      std::vector<std::string> _events;
+
+      double to_us(Clock::time_point t) const { return std::chrono::duration<double, std::micro>(t - _start).count(); }
+   };
+
+   // records a span from construction to destruction, does nothing without a trace
+   class TraceScope
+   {
+   public:
+      TraceScope(BuildTrace *trace, const char *name, const char *cat)
+          : _trace(trace), _name(name), _cat(cat)
+      {
+         if (_trace)
+            _begin = BuildTrace::Clock::now();
+      }
+      ~TraceScope()
+      {
+         if (_trace)
+            _trace->add_span(_name, _cat, _begin, _args);
+      }
+      TraceScope(const TraceScope &) = delete;
+      TraceScope &operator=(const TraceScope &) = delete;
+
+      void arg(const char *key, double value)
+      {
+         if (!_trace)
+            return;
+         if (!_args.empty())
+            _args += ",";
+         _args += "\"" + std::string(key) + "\":" + std::to_string(value);
+      }
+
+   private:
+      BuildTrace *_trace;
+      const char *_name, *_cat;
+      BuildTrace::Clock::time_point _begin;
+      std::string _args;
+   };
+}
+
+#endif // ANNS_BUILD_TRACE_H
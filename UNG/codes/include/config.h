@@ -11,6 +11,9 @@ namespace ANNS
    using IdxType = uint32_t;
    using AtrType = uint32_t;
 
+   // type for the ids across the shards of a ShardedUniNavGraph, which may exceed IdxType
+   using GlobalIdxType = uint64_t;
+
    // type for storing the label of vectors
    using LabelType = uint16_t;
 
@@ -0,0 +1,80 @@
+#ifndef ANNS_DISK_READER_H
+#define ANNS_DISK_READER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace ANNS
+{
+
+   const size_t SECTOR_SIZE = 4096;
+
+   // one read of a batch, offset, len and buf are SECTOR_SIZE-aligned for files opened with O_DIRECT
+   struct ReadRequest
+   {
+      uint64_t offset;
+      size_t len;
+      char *buf;
+   };
+
+   // batched reads of an index file, read() returns when all the requests of the batch are complete and throws
+   // std::runtime_error on I/O errors; each search thread owns its reader
+   class DiskReader
+   {
+   public:
+      virtual ~DiskReader() = default;
+      virtual void read(std::vector<ReadRequest> &requests) = 0;
+      virtual std::string get_name() const = 0;
+   };
+
+   // the file stays open as long as one of its readers
+   class DiskFile
+   {
+   public:
+      // O_DIRECT when the file system supports it, the page cache otherwise
+      DiskFile(const std::string &filename);
+      ~DiskFile();
+      int get_fd() const { return _fd; }
+      bool is_direct() const { return _direct; }
+
+   private:
+      int _fd;
+      bool _direct;
+   };
+
+   // threads running the preads of all the readers, the thread of read() also takes reads of the queue while its
+   // batch is pending
+   class IoThreadPool
+   {
+   public:
+      IoThreadPool(uint32_t num_threads);
+      ~IoThreadPool();
+      void run(int fd, std::vector<ReadRequest> &requests);
+      uint32_t get_num_threads() const;
+
+   private:
+      struct State;
+      std::unique_ptr<State> _state;
+   };
+
+   // <auto/io_uring/pread>: io_uring submits a batch of up to queue_depth reads with one system call, pread spreads
+   // it over io_pool (or reads it in turn when io_pool is nullptr); auto uses io_uring when the kernel allows it
+   std::unique_ptr<DiskReader> create_disk_reader(std::shared_ptr<DiskFile> file, const std::string &engine,
+                                                  uint32_t queue_depth, std::shared_ptr<IoThreadPool> io_pool);
+
+   // SECTOR_SIZE-aligned buffer for the reads
+   struct AlignedBuffer
+   {
+      AlignedBuffer(size_t bytes);
+      ~AlignedBuffer();
+      AlignedBuffer(const AlignedBuffer &) = delete;
+      AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+      char *data;
+      size_t size;
+   };
+}
+
+#endif // ANNS_DISK_READER_H
@@ -0,0 +1,68 @@
+#ifndef ANNS_DISK_UNG_H
+#define ANNS_DISK_UNG_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "config.h"
+#include "storage.h"
+#include "distance.h"
+#include "disk_reader.h"
+#include "uni_nav_graph.h"
+#include "scalar_quantizer.h"
+
+namespace ANNS
+{
+
+   // SSD-resident UNG: the routing structures of the index (trie, LNG, group ranges, covered sets, tombstones) and
+   // 8-bit SQ codes of the vectors stay in memory, the full vectors and the adjacency lists are co-located on disk in
+   // the UNG id order, so that the points of a group are stored together
+   //   disk_index: node u is [vector | uint32 num_neighbors | uint32 neighbors[max_degree]], packed into whole
+   //               SECTOR_SIZE sectors (several nodes per sector, or several sectors per node)
+   //   disk_meta: the layout parameters
+   //   sq_codes, sq_quantizer: dim bytes per point and the ranges of the quantizer
+   // a search is a beam search on the SQ distances: each round reads the nodes of the beam_width closest unexpanded
+   // candidates in one batch, their exact distances form the results and their neighbors join the candidates
+   class DiskUniNavGraph
+   {
+   public:
+      DiskUniNavGraph() = default;
+
+      // the disk files of a loaded in-memory index (float vectors), written next to it under index_path_prefix
+      static void write_disk_layout(UniNavGraph &index, const std::string &index_path_prefix, uint32_t num_threads);
+
+      // loads the routing part of the index and the SQ codes, the readers of the searches use io_engine
+      // <auto/io_uring/pread> with num_io_threads threads for pread
+      void load(const std::string &index_path_prefix, const std::string &data_type, const std::string &io_engine,
+                uint32_t num_io_threads);
+
+      // scenarios equality, containment, overlap and nofilter; the results are external ids, -1 when fewer points
+      // match; num_ios[i] is the number of nodes read for query i
+      void search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                  uint32_t num_threads, IdxType Lsearch, IdxType beam_width, IdxType num_entry_points,
+                  const std::string &scenario, IdxType K, std::pair<IdxType, float> *results,
+                  std::vector<float> &num_cmps, std::vector<float> &num_ios);
+
+      std::string get_io_engine() const { return _io_engine; }
+      bool is_direct_io() const { return _file != nullptr && _file->is_direct(); }
+
+   private:
+      // disk layout
+      IdxType _num_points = 0, _dim = 0, _max_degree = 0;
+      size_t _node_size = 0, _nodes_per_sector = 0, _sectors_per_node = 0;
+      uint64_t get_node_offset(IdxType id) const;
+      size_t get_node_read_size() const { return _nodes_per_sector > 0 ? SECTOR_SIZE : _sectors_per_node * SECTOR_SIZE; }
+
+      // memory part
+      UniNavGraph _index{1};
+      ScalarQuantizer _quantizer;
+      std::vector<uint8_t> _codes;
+
+      // I/O
+      std::string _io_engine;
+      std::shared_ptr<DiskFile> _file;
+      std::shared_ptr<IoThreadPool> _io_pool;
+   };
+}
+
+#endif // ANNS_DISK_UNG_H
@@ -0,0 +1,79 @@
+#ifndef ANNS_FILTER_EXPR_H
+#define ANNS_FILTER_EXPR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <roaring/roaring.hh>
+#include "config.h"
+#include "label_span.h"
+
+namespace ANNS
+{
+
+   // boolean filter over the labels of a point, e.g. "(3 OR 5) AND NOT 7" or "(brand:A || brand:B) && !discontinued"
+   // grammar: expr := term (OR term)*, term := factor (AND factor)*, factor := NOT factor | '(' expr ')' | label | '*'
+   // operators: AND / && / &, OR / || / |, NOT / ! (keywords are case insensitive), '*' matches every point
+   // a label is a label id or a name of the label dictionary
+   class FilterExpr
+   {
+   public:
+      enum class Op
+      {
+         ANY,
+         LABEL,
+         NOT,
+         AND,
+         OR
+      };
+
+      FilterExpr() = default;
+
+      // throws std::runtime_error on syntax errors and unknown label names
+      static FilterExpr parse(const std::string &text,
+                              const std::unordered_map<std::string, LabelType> &name_to_label = {});
+
+      // label_set is sorted in ascending order
+      bool matches(LabelSpan label_set) const;
+
+      // ids satisfying the expression, NOT is taken relative to universe; AND subtracts negated children
+      // instead of building their complement
+      roaring::Roaring evaluate(const std::function<const roaring::Roaring &(LabelType)> &posting_list,
+                                const roaring::Roaring &universe) const;
+
+      // label sets L_1..L_n such that every matching label set contains some L_i (an empty L_i means no
+      // constraint), i.e. the conjunctive part of each disjunct; at most max_sets are returned
+      std::vector<std::vector<LabelType>> get_conjunctive_label_sets(size_t max_sets = 16) const;
+
+      std::string to_string() const;
+      bool empty() const { return _nodes.empty(); }
+
+   private:
+      struct Node
+      {
+         Op op;
+         LabelType label = 0;
+         std::vector<IdxType> children;
+      };
+      std::vector<Node> _nodes;
+      IdxType _root = 0;
+
+      bool matches(IdxType node_id, LabelSpan label_set) const;
+      roaring::Roaring evaluate(IdxType node_id, const std::function<const roaring::Roaring &(LabelType)> &posting_list,
+                                const roaring::Roaring &universe) const;
+      std::vector<std::vector<LabelType>> get_conjunctive_label_sets(IdxType node_id, size_t max_sets) const;
+      std::string to_string(IdxType node_id) const;
+
+      friend class FilterParser;
+   };
+
+   // name -> label id of the dictionary in a CSR label file (see label_csr.h), empty without a dictionary
+   std::unordered_map<std::string, LabelType> load_label_names(const std::string &label_csr_file);
+
+   // one expression per line
+   std::vector<FilterExpr> load_filter_exprs(const std::string &filename,
+                                             const std::unordered_map<std::string, LabelType> &name_to_label = {});
+}
+
+#endif // ANNS_FILTER_EXPR_H
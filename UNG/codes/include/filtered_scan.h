@@ -4,6 +4,8 @@
 #include "storage.h"
 #include "trie.h"
 #include "distance.h"
+#include "filter_expr.h"
+#include "numeric_index.h"
 
 
 namespace ANNS {
@@ -23,6 +25,14 @@ namespace ANNS {
                      std::shared_ptr<DistanceHandler> distance_handler, std::string scenario, 
                      uint32_t num_threads, IdxType K, std::pair<IdxType, float>* results);
 
+            // for computing groundtruth of boolean filters: query i scans the base groups satisfying filters[i]
+            void run(std::shared_ptr<IStorage> base_storage, std::shared_ptr<IStorage> query_storage,
+                     std::shared_ptr<DistanceHandler> distance_handler, const std::vector<FilterExpr>& filters,
+                     uint32_t num_threads, IdxType K, std::pair<IdxType, float>* results);
+
+            // numeric ranges each query must also satisfy (one entry per query), not owned
+            void set_query_ranges(const std::vector<std::vector<NumericRange>>* query_ranges) { _query_ranges = query_ranges; }
+
         private:
 
             // data
@@ -30,6 +40,7 @@ namespace ANNS {
             std::shared_ptr<DistanceHandler> _distance_handler;
             std::pair<IdxType, float>* _results;
             IdxType _K;
+            const std::vector<std::vector<NumericRange>>* _query_ranges = nullptr;
 
             // trie index for label sets
             TrieIndex base_trie_index, query_trie_index;
@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include "config.h"
+#include "huge_pages.h"
 
 
 namespace ANNS {
@@ -13,8 +16,8 @@ namespace ANNS {
     class Graph {
             
         public:
-            std::vector<IdxType>* neighbors;
-            std::mutex* neighbor_locks;
+            std::vector<IdxType>* neighbors = nullptr;
+            std::mutex* neighbor_locks = nullptr;
 
             Graph() = default;
 
@@ -30,11 +33,20 @@ namespace ANNS {
                 _num_points = end - start;
             };
 
+            // the adjacency lists are freed with the last reference, for graphs that are replaced
+            // while searches may still read them
+            static std::shared_ptr<Graph> create(IdxType num_points) {
+                return std::shared_ptr<Graph>(new Graph(num_points), [](Graph* graph) {
+                    graph->clean();
+                    delete graph;
+                });
+            }
+
             void save(std::string& filename) {
                 std::ofstream out(filename);
                 for (IdxType i = 0; i < _num_points; i++) {
                     out << i << " ";
-                    for (auto& neighbor : neighbors[i])
+                    for (auto& neighbor : get_neighbors(i))
                         out << neighbor << " ";
                     out << std::endl;
                 }
@@ -55,16 +67,79 @@ namespace ANNS {
                 in.close();
             }
 
+            // grow the graph to num_points nodes, the adjacency lists are moved, so views created
+            // by Graph(graph, start, end) are invalid afterwards
+            void resize(IdxType num_points) {
+                unflatten();
+                auto new_neighbors = new std::vector<IdxType>[num_points];
+                for (IdxType i = 0; i < std::min(num_points, _num_points); i++)
+                    new_neighbors[i] = std::move(neighbors[i]);
+                clean();
+                neighbors = new_neighbors;
+                neighbor_locks = new std::mutex[num_points];
+                _num_points = num_points;
+            }
+
+            IdxType get_num_points() const { return _num_points; }
+
+            // read-only view of one adjacency list
+            struct NeighborRange {
+                const IdxType* first;
+                const IdxType* last;
+                size_t size() const { return last - first; }
+                const IdxType& operator[](size_t i) const { return first[i]; }
+                const IdxType* begin() const { return first; }
+                const IdxType* end() const { return last; }
+            };
+
+            // adjacency list for the searches, from the CSR copy once the graph is flattened
+            NeighborRange get_neighbors(IdxType id) const {
+                if (_flat_ids != nullptr)
+                    return {_flat_ids + _flat_offsets[id], _flat_ids + _flat_offsets[id + 1]};
+                return {neighbors[id].data(), neighbors[id].data() + neighbors[id].size()};
+            }
+
+            // move the adjacency lists into one CSR block from huge_alloc, so that a search hop reads one array
+            // instead of a heap block per node; the lists are freed, readers use get_neighbors and updates must
+            // unflatten() first. Neither may run while the graph is searched
+            void flatten() {
+                if (is_flat())
+                    return;
+                _flat_offsets = static_cast<size_t*>(huge_alloc(sizeof(size_t) * (_num_points + 1)));
+                _flat_offsets[0] = 0;
+                for (IdxType i = 0; i < _num_points; i++)
+                    _flat_offsets[i + 1] = _flat_offsets[i] + neighbors[i].size();
+                _flat_ids = static_cast<IdxType*>(huge_alloc(sizeof(IdxType) * std::max<size_t>(_flat_offsets[_num_points], 1)));
+                for (IdxType i = 0; i < _num_points; i++) {
+                    std::copy(neighbors[i].begin(), neighbors[i].end(), _flat_ids + _flat_offsets[i]);
+                    std::vector<IdxType>().swap(neighbors[i]);
+                }
+            }
+
+            // restore the adjacency lists from the CSR block and free it
+            void unflatten() {
+                if (!is_flat())
+                    return;
+                for (IdxType i = 0; i < _num_points; i++)
+                    neighbors[i].assign(_flat_ids + _flat_offsets[i], _flat_ids + _flat_offsets[i + 1]);
+                free_flat();
+            }
+
+            bool is_flat() const { return _flat_ids != nullptr; }
+
             float get_index_size() {
                 float index_size = 0;
                 for (IdxType i = 0; i < _num_points; i++)
-                    index_size += neighbors[i].size() * sizeof(IdxType);
+                    index_size += get_neighbors(i).size() * sizeof(IdxType);
                 return index_size;
             }
 
             void clean() {
+                free_flat();
                 delete[] neighbors;
                 delete[] neighbor_locks;
+                neighbors = nullptr;
+                neighbor_locks = nullptr;
             }
 
             ~Graph() = default;
@@ -72,7 +147,15 @@ namespace ANNS {
         private:
 
             IdxType _num_points;
-            
+            size_t* _flat_offsets = nullptr;
+            IdxType* _flat_ids = nullptr;
+
+            void free_flat() {
+                huge_free(_flat_offsets);
+                huge_free(_flat_ids);
+                _flat_offsets = nullptr;
+                _flat_ids = nullptr;
+            }
     };
 }
 
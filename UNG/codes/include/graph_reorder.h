@@ -0,0 +1,34 @@
+#ifndef ANNS_GRAPH_REORDER_H
+#define ANNS_GRAPH_REORDER_H
+
+#include <string>
+#include <vector>
+#include "graph.h"
+
+namespace ANNS
+{
+
+   // renumbering of the points of a group by graph locality, so that the vectors read while expanding a node are
+   // close in memory
+   //   BFS: breadth-first from the group entry point, neighbors in their list order
+   //   RCM: reverse Cuthill-McKee, breadth-first from a min-degree point, neighbors by ascending degree
+   //   GORDER: greedy window heuristic of Gorder, the next point has the most edges and common in-neighbors with
+   //           the last window points
+   enum class ReorderMethod
+   {
+      NONE,
+      BFS,
+      RCM,
+      GORDER
+   };
+
+   // <none/bfs/rcm/gorder>, throws std::runtime_error otherwise
+   ReorderMethod parse_reorder_method(const std::string &name);
+
+   // new order of the points [first, last) of graph, as their current ids; only the edges inside the range count,
+   // start is the first point of BFS and GORDER, points it does not reach follow in their current order
+   std::vector<IdxType> locality_order(const Graph &graph, IdxType first, IdxType last, IdxType start,
+                                       ReorderMethod method, IdxType window = 5);
+}
+
+#endif // ANNS_GRAPH_REORDER_H
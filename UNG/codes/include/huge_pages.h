@@ -0,0 +1,50 @@
+#ifndef ANNS_HUGE_PAGES_H
+#define ANNS_HUGE_PAGES_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ANNS
+{
+
+   // backing of the big search arrays (vectors, flattened adjacency, visited marks), random accesses over GBs of 4KB
+   // pages miss the dTLB on almost every hop
+   //   NONE: std::aligned_alloc
+   //   TRANSPARENT: anonymous mapping with madvise(MADV_HUGEPAGE), needs THP in "madvise" or "always" mode
+   //   EXPLICIT: MAP_HUGETLB from the reserved pool (vm.nr_hugepages), TRANSPARENT when the pool is too small
+   enum class HugePagePolicy
+   {
+      NONE,
+      TRANSPARENT,
+      EXPLICIT
+   };
+
+   // <none/thp/hugetlb>, throws std::runtime_error otherwise
+   HugePagePolicy parse_huge_page_policy(const std::string &name);
+
+   // policy of the following huge_alloc calls, set it before loading the index
+   void set_huge_page_policy(HugePagePolicy policy);
+   HugePagePolicy get_huge_page_policy();
+
+   const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+   // 64-byte aligned, uninitialized, throws std::bad_alloc
+   // blocks below HUGE_PAGE_SIZE always come from the heap, a huge page would be mostly empty
+   void *huge_alloc(size_t bytes);
+
+   // frees a block of huge_alloc, nullptr is ignored
+   void huge_free(void *ptr);
+
+   // bytes currently allocated by huge_alloc, per backing
+   struct HugePageStats
+   {
+      size_t heap_bytes = 0;
+      size_t thp_bytes = 0;      // advised, the kernel may still split or not collapse them
+      size_t hugetlb_bytes = 0;
+      size_t small_page_bytes = 0; // mappings the kernel refused to advise
+   };
+   HugePageStats get_huge_page_stats();
+}
+
+#endif // ANNS_HUGE_PAGES_H
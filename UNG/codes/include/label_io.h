@@ -0,0 +1,39 @@
+#ifndef ANNS_LABEL_IO_H
+#define ANNS_LABEL_IO_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "config.h"
+#include "label_csr.h"
+
+namespace ANNS
+{
+
+   // load labels of points [first_point, first_point + num_points) into label_sets,
+   // label_cnts[l] is the number of loaded points with label l
+   // the text format is one line per point with comma separated labels
+   void load_label_txt(const std::string &filename, std::vector<LabelType> *label_sets, size_t first_point,
+                       IdxType num_points, std::vector<IdxType> &label_cnts);
+   void load_label_csr(const std::string &filename, std::vector<LabelType> *label_sets, size_t first_point,
+                       IdxType num_points, std::vector<IdxType> &label_cnts);
+
+   // map a CSR label file for reading in place, label_cnts as above; null when the file has fewer than
+   // first_point + num_points rows
+   std::shared_ptr<LabelCSR> open_label_csr(const std::string &filename, size_t first_point, IdxType num_points,
+                                            std::vector<IdxType> &label_cnts);
+
+   // write labels as a CSR file (format in label_csr.h), dictionary[l] is the original name of label l
+   void write_label_csr(const std::string &filename, const std::vector<LabelType> *label_sets, IdxType num_points,
+                        const std::vector<std::string> &dictionary = {});
+
+   // convert a text label file to CSR, with remap the labels are read as strings and renumbered from 1 in
+   // order of first appearance, the names of dict_file (a CSR file) are kept so that base and query agree
+   void convert_label_txt_to_csr(const std::string &txt_file, const std::string &csr_file, bool remap,
+                                 const std::string &dict_file = "");
+
+   // convert a CSR label file to text, dictionary names are written when with_names is set
+   void convert_label_csr_to_txt(const std::string &csr_file, const std::string &txt_file, bool with_names);
+}
+
+#endif // ANNS_LABEL_IO_H
@@ -0,0 +1,40 @@
+#ifndef ANNS_LABEL_SPAN_H
+#define ANNS_LABEL_SPAN_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include "config.h"
+
+namespace ANNS
+{
+
+   // read-only view of the sorted label set of one point, either in a std::vector or in a CSR label array,
+   // valid as long as the storage it comes from is not modified
+   class LabelSpan
+   {
+   public:
+      LabelSpan() = default;
+      LabelSpan(const LabelType *first, const LabelType *last) : _first(first), _last(last) {}
+      LabelSpan(const std::vector<LabelType> &label_set)
+          : _first(label_set.data()), _last(label_set.data() + label_set.size()) {}
+
+      const LabelType *begin() const { return _first; }
+      const LabelType *end() const { return _last; }
+      size_t size() const { return _last - _first; }
+      bool empty() const { return _first == _last; }
+      LabelType operator[](size_t i) const { return _first[i]; }
+      LabelType front() const { return *_first; }
+      LabelType back() const { return *(_last - 1); }
+
+      std::vector<LabelType> to_vector() const { return std::vector<LabelType>(_first, _last); }
+
+      friend bool operator==(LabelSpan a, LabelSpan b) { return std::equal(a.begin(), a.end(), b.begin(), b.end()); }
+      friend bool operator!=(LabelSpan a, LabelSpan b) { return !(a == b); }
+
+   private:
+      const LabelType *_first = nullptr, *_last = nullptr;
+   };
+}
+
+#endif // ANNS_LABEL_SPAN_H
@@ -0,0 +1,89 @@
+#ifndef ANNS_LATENCY_HISTOGRAM_H
+#define ANNS_LATENCY_HISTOGRAM_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace ANNS
+{
+
+   // log-bucketed latency histogram (HDR-style): values below SUB_COUNT nanoseconds are exact, larger values
+   // fall into one of SUB_COUNT / 2 linear sub-buckets of their power of two, so a reported percentile is at most
+   // 1 / 128 above the recorded value, whatever the range; fixed memory, record is O(1) and histograms merge by addition
+   class LatencyHistogram
+   {
+   public:
+      LatencyHistogram() : _counts(num_buckets(), 0) {}
+
+      void record_ns(uint64_t value)
+      {
+         ++_counts[bucket_index(value)];
+         ++_total;
+         _min = std::min(_min, value);
+         _max = std::max(_max, value);
+         _sum += value;
+      }
+      void record_ms(double value) { record_ns(value > 0 ? (uint64_t)(value * 1e6) : 0); }
+
+      void merge(const LatencyHistogram &other)
+      {
+         for (size_t i = 0; i < _counts.size(); ++i)
+            _counts[i] += other._counts[i];
+         _total += other._total;
+         _min = std::min(_min, other._min);
+         _max = std::max(_max, other._max);
+         _sum += other._sum;
+      }
+
+      uint64_t count() const { return _total; }
+      double max_ms() const { return _total ? _max / 1e6 : 0; }
+      double min_ms() const { return _total ? _min / 1e6 : 0; }
+      double mean_ms() const { return _total ? _sum / 1e6 / _total : 0; }
+
+      // smallest recorded bucket covering a fraction p in [0, 1] of the values, as its upper bound
+      double percentile_ms(double p) const
+      {
+         if (_total == 0)
+            return 0;
+         uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p * _total + 0.5));
+         uint64_t seen = 0;
+         for (size_t i = 0; i < _counts.size(); ++i)
+         {
+            seen += _counts[i];
+            if (seen >= rank)
+               return std::min(bucket_upper_bound(i), _max) / 1e6;
+         }
+         return _max / 1e6;
+      }
+
+   private:
+      static const int SUB_BITS = 8;
+      static const uint64_t SUB_COUNT = 1ull << SUB_BITS, HALF_COUNT = SUB_COUNT / 2;
+
+      std::vector<uint64_t> _counts;
+      uint64_t _total = 0, _min = UINT64_MAX, _max = 0;
+      double _sum = 0;
+
+      static size_t num_buckets() { return SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT; }
+
+      static size_t bucket_index(uint64_t value)
+      {
+         if (value < SUB_COUNT)
+            return value;
+         int shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+         return SUB_COUNT + (shift - 1) * HALF_COUNT + ((value >> shift) - HALF_COUNT);
+      }
+
+      static uint64_t bucket_upper_bound(size_t index)
+      {
+         if (index < SUB_COUNT)
+            return index;
+         int shift = (index - SUB_COUNT) / HALF_COUNT + 1;
+         uint64_t mantissa = (index - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+         return ((mantissa + 1) << shift) - 1;
+      }
+   };
+}
+
+#endif // ANNS_LATENCY_HISTOGRAM_H
@@ -0,0 +1,58 @@
+#ifndef ANNS_NUMA_PLACEMENT_H
+#define ANNS_NUMA_PLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ANNS
+{
+
+   // placement of the read-only search data (vectors and graphs) on a multi-socket machine
+   //   NONE: first touch by the loading thread
+   //   INTERLEAVE: one copy with its pages spread over all nodes
+   //   REPLICATE: one copy per node, each search thread reads the copy of the node it is pinned to
+   enum class NumaPolicy
+   {
+      NONE,
+      INTERLEAVE,
+      REPLICATE
+   };
+
+   // <none/interleave/replicate>, throws std::runtime_error otherwise
+   NumaPolicy parse_numa_policy(const std::string &name);
+
+   // nodes and their cpus from /sys/devices/system/node, a single node with all cpus without it
+   class NumaTopology
+   {
+   public:
+      static const NumaTopology &get();
+
+      uint32_t num_nodes() const { return _node_cpus.size(); }
+      int node_id(uint32_t node) const { return _node_ids[node]; } // id in /sys, may be sparse
+      const std::vector<int> &node_cpus(uint32_t node) const { return _node_cpus[node]; }
+      uint32_t node_of_cpu(int cpu) const;
+      uint32_t current_node() const; // node of the cpu the calling thread runs on
+
+   private:
+      NumaTopology();
+      std::vector<int> _node_ids;
+      std::vector<std::vector<int>> _node_cpus;
+      std::vector<uint32_t> _cpu_to_node;
+   };
+
+   // the calls below use the raw syscalls (no libnuma) and return false when the kernel refuses, e.g. in containers
+   // restricted by seccomp or cpusets; the data is then placed as with NONE
+
+   // memory policy of the calling thread for the pages it touches next: REPLICATE binds them to node, INTERLEAVE
+   // spreads them over all nodes, NONE restores the default (local) policy
+   bool set_thread_memory_policy(NumaPolicy policy, uint32_t node = 0);
+
+   // restrict the calling thread to the cpus of node
+   bool pin_thread_to_node(uint32_t node);
+
+   // pin the threads of the OpenMP pool, thread t to node t % num_nodes, the pool keeps them for later regions
+   void pin_omp_threads(uint32_t num_threads);
+}
+
+#endif // ANNS_NUMA_PLACEMENT_H
@@ -0,0 +1,68 @@
+#ifndef ANNS_NUMERIC_INDEX_H
+#define ANNS_NUMERIC_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <roaring/roaring.hh>
+#include "config.h"
+#include "storage.h"
+
+namespace ANNS
+{
+
+   // lo <= value of numeric attribute column <= hi
+   struct NumericRange
+   {
+      IdxType column;
+      float lo, hi;
+   };
+
+   // the build uses -Ofast, whose -ffinite-math-only folds std::isnan and comparisons with NaN, so NaN is
+   // recognized by its bits
+   inline bool is_nan_value(float value)
+   {
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return (bits & 0x7fffffffu) > 0x7f800000u;
+   }
+
+   // a NaN value or bound is in no range
+   inline bool in_ranges(const float *numeric_attrs, const std::vector<NumericRange> &ranges)
+   {
+      for (const auto &range : ranges)
+      {
+         float value = numeric_attrs[range.column];
+         if (is_nan_value(value) || is_nan_value(range.lo) || is_nan_value(range.hi) ||
+             !(value >= range.lo && value <= range.hi))
+            return false;
+      }
+      return true;
+   }
+
+   // range -> bitmap index of one numeric column: the (value, id) pairs are sorted and cut into buckets of equal
+   // size with a roaring set each, a range is the union of the buckets it covers plus the ids of at most two
+   // partially covered buckets found by binary search
+   class NumericRangeIndex
+   {
+   public:
+      NumericRangeIndex() = default;
+
+      void build(std::shared_ptr<IStorage> storage, IdxType column, IdxType num_buckets = 256);
+      roaring::Roaring range(float lo, float hi) const;
+      IdxType get_num_points() const { return _sorted.size(); } // points whose value is not NaN
+
+   private:
+      std::vector<std::pair<float, IdxType>> _sorted;
+      std::vector<size_t> _bucket_offsets; // bucket b holds _sorted[_bucket_offsets[b], _bucket_offsets[b + 1])
+      std::vector<roaring::Roaring> _buckets;
+   };
+
+   // one line per query, each "column lo hi" triple is a range and a query matches all of them,
+   // an empty line has no range
+   std::vector<std::vector<NumericRange>> load_numeric_ranges(const std::string &filename);
+}
+
+#endif // ANNS_NUMERIC_INDEX_H
@@ -0,0 +1,40 @@
+#ifndef ANNS_SCALAR_QUANTIZER_H
+#define ANNS_SCALAR_QUANTIZER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "storage.h"
+
+namespace ANNS
+{
+
+   // 8-bit scalar quantizer of float vectors, each dimension is mapped linearly from its [min, max] over the base
+   // vectors to 0..255; the codes route the searches of the SSD mode, the full vectors re-rank the results
+   class ScalarQuantizer
+   {
+   public:
+      ScalarQuantizer() = default;
+
+      // per-dimension ranges of the points of storage
+      void train(std::shared_ptr<IStorage> storage, uint32_t num_threads);
+
+      // dim bytes per vector
+      void encode(const float *vec, uint8_t *code) const;
+
+      // squared L2 distance between a full-precision query and a code
+      float compute_l2(const float *query, const uint8_t *code) const;
+
+      IdxType get_dim() const { return _dim; }
+
+      // I/O, the file holds dim, the minimums and the scales
+      void save(const std::string &filename) const;
+      void load(const std::string &filename);
+
+   private:
+      IdxType _dim = 0;
+      std::vector<float> _min, _scale;
+   };
+}
+
+#endif // ANNS_SCALAR_QUANTIZER_H
@@ -3,6 +3,8 @@
 
 #include <mutex>
 #include <deque>
+#include <memory>
+#include <vector>
 #include "visited_set.h"
 #include "search_queue.h"
 
@@ -59,6 +61,24 @@ namespace ANNS
       IdxType _visited_set_size;
       // int32_t _search_queue_capacity;
    };
+
+   // one SearchCacheList per NUMA node; with several nodes the caches are created on demand by the threads pinned to
+   // the node, so that their visited sets and queues are first touched there
+   class NodeSearchCacheLists
+   {
+   public:
+      NodeSearchCacheLists(uint32_t num_nodes, uint32_t num_cache, IdxType visited_set_size, int32_t search_queue_capacity)
+      {
+         for (uint32_t node = 0; node < num_nodes; node++)
+            _lists.emplace_back(std::make_unique<SearchCacheList>(num_nodes > 1 ? 0 : num_cache, visited_set_size,
+                                                                  search_queue_capacity));
+      }
+
+      SearchCacheList &get(uint32_t node) { return *_lists[node % _lists.size()]; }
+
+   private:
+      std::vector<std::unique_ptr<SearchCacheList>> _lists;
+   };
 }
 
 #endif // SEARCH_CACHE_H
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef ANNS_SHARDED_UNG_H
+#define ANNS_SHARDED_UNG_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "config.h"
+#include "storage.h"
+#include "distance.h"
+#include "uni_nav_graph.h"
+
+namespace ANNS
+{
+
+   // a UniNavGraph per shard, the base points are partitioned by
+   //   "range": contiguous id ranges of equal size
+   //   "group": whole label-set groups, the largest first to the smallest shard, so that every group stays in one shard
+   // each shard holds fewer than 2^32 points, the ids across shards are GlobalIdxType; shards are built, loaded and
+   // searched concurrently, a query only visits the shards whose covered sets contain a matching point
+   class ShardedUniNavGraph
+   {
+   public:
+      ShardedUniNavGraph() = default;
+
+      // base_label_file and base_numeric_file may be empty
+      void build(const std::string &data_type, const std::string &base_bin_file, const std::string &base_label_file,
+                 const std::string &base_numeric_file, std::shared_ptr<DistanceHandler> distance_handler,
+                 IdxType num_shards, const std::string &partition, std::string scenario, std::string index_name,
+                 uint32_t num_threads, IdxType num_cross_edges, IdxType max_degree, IdxType Lbuild, float alpha);
+
+      // results[i * K, (i + 1) * K) are the merged top-K of query i in global ids, -1 when fewer points match;
+      // num_searched_shards[i] is the number of shards query i was sent to
+      void search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                  uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario, IdxType K,
+                  std::pair<GlobalIdxType, float> *results, std::vector<float> &num_cmps,
+                  std::vector<IdxType> &num_searched_shards);
+
+      // I/O, shard s is saved under <index_path_prefix>shard_<s>/
+      void save(const std::string &index_path_prefix, const std::string &results_path_prefix);
+      void load(const std::string &index_path_prefix, const std::string &data_type, uint32_t num_threads);
+
+      IdxType get_num_shards() const { return _shards.size(); }
+      GlobalIdxType get_num_points() const { return _num_points; }
+
+   private:
+      std::string _data_type, _partition;
+      GlobalIdxType _num_points = 0;
+      std::vector<std::shared_ptr<UniNavGraph>> _shards;
+      std::vector<GlobalIdxType> _shard_offsets;                // range: global id = offset + id in the shard
+      std::vector<std::vector<GlobalIdxType>> _shard_global_ids; // group: id in the shard -> global id
+
+      GlobalIdxType to_global_id(IdxType shard_id, IdxType id) const
+      {
+         return _partition == "group" ? _shard_global_ids[shard_id][id] : _shard_offsets[shard_id] + id;
+      }
+
+      // shard storages
+      std::vector<std::shared_ptr<IStorage>> load_range_shards(const std::string &data_type, const std::string &base_bin_file,
+                                                               const std::string &base_label_file,
+                                                               const std::string &base_numeric_file, size_t num_points,
+                                                               IdxType num_shards);
+      std::vector<std::shared_ptr<IStorage>> load_group_shards(const std::string &data_type, const std::string &base_bin_file,
+                                                               const std::string &base_label_file,
+                                                               const std::string &base_numeric_file, size_t num_points,
+                                                               IdxType num_shards);
+
+      // runs task(shard_id, num_threads_per_shard) for the shards, at most num_threads shards at a time
+      void run_on_shards(const std::vector<IdxType> &shard_ids, uint32_t num_threads,
+                         const std::function<void(IdxType, uint32_t)> &task) const;
+   };
+}
+
+#endif // ANNS_SHARDED_UNG_H
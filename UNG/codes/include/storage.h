@@ -5,36 +5,61 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <cstdlib>
 #include <xmmintrin.h>
 #include <immintrin.h>
 #include "config.h"
 #include "distance.h"
+#include "huge_pages.h"
+#include "label_span.h"
 
 
 namespace ANNS {
 
+    class LabelCSR;
+
     // interface for storage
     class IStorage {
         public:
             virtual ~IStorage() = default;
 
             // I/O
+            // bin_file may be a UNG .bin, .fbin/.u8bin/.i8bin or .fvecs/.bvecs file, points
+            // [first_point, first_point + max_num_points) are loaded
+            // a CSR label file stays mapped and is read through get_label_span, it is only expanded into one vector
+            // per point by get_label_set, append and reserve
             virtual void load_from_file(const std::string& bin_file, const std::string& label_file, 
-                                        IdxType max_num_points = std::numeric_limits<IdxType>::max()) = 0;
+                                        IdxType max_num_points = std::numeric_limits<IdxType>::max(),
+                                        size_t first_point = 0) = 0;
             virtual void write_to_file(const std::string& bin_file, const std::string& label_file) = 0;
 
+            // numeric attributes (e.g. price, timestamp), get_num_numeric_attrs() floats per point, the file has the
+            // layout of a float .bin (uint32 num_points, uint32 num_attrs, row-major values)
+            // rows [first_point, first_point + get_num_points()) of attr_file are loaded
+            virtual void load_numeric_attrs(const std::string& attr_file, size_t first_point = 0) = 0;
+            virtual void write_numeric_attrs(const std::string& attr_file) = 0;
+
             // reorder the vector data
             virtual void reorder_data(const std::vector<IdxType>& new_to_old_ids) = 0;
 
+            // append a point after the last one and return its id, the buffers grow geometrically, so pointers from
+            // get_vector and the views of create_storage(storage, start, end) are invalid once the capacity is exceeded
+            // numeric_attrs may be null, the attributes are set to 0 then
+            virtual IdxType append(const char* vec, LabelSpan label_set, const float* numeric_attrs = nullptr) = 0;
+            virtual void reserve(IdxType capacity) = 0;
+
             // get statistics
             virtual DataType get_data_type() const = 0;
             virtual IdxType get_num_points() const = 0;
             virtual IdxType get_dim() const = 0;
+            virtual IdxType get_num_numeric_attrs() const = 0;
 
             // get data
-            virtual std::vector<LabelType>* get_offseted_label_sets(IdxType idx) = 0;
             virtual char* get_vector(IdxType idx) = 0;
-            virtual std::vector<LabelType>& get_label_set(IdxType idx) = 0;
+            virtual LabelSpan get_label_span(IdxType idx) const = 0;
+            virtual const std::vector<LabelType>& get_label_set(IdxType idx) = 0;
+            virtual float* get_numeric_attrs(IdxType idx) = 0;
             virtual inline void prefetch_vec_by_id(IdxType idx) const = 0;
 
             // obtain a point cloest to the center
@@ -47,7 +72,12 @@ namespace ANNS {
 
     // obtain corresponding storage class
     std::shared_ptr<IStorage> create_storage(const std::string& data_type, bool verbose = true);
+    // empty storage of dim-dimensional points to be filled by append()
+    std::shared_ptr<IStorage> create_storage(const std::string& data_type, IdxType dim, IdxType num_numeric_attrs,
+                                             bool verbose = false);
     std::shared_ptr<IStorage> create_storage(std::shared_ptr<IStorage> storage, IdxType start, IdxType end);
+    // deep copy, the buffers are first touched by the calling thread (NUMA replicas)
+    std::shared_ptr<IStorage> copy_storage(std::shared_ptr<IStorage> storage);
 
 
     // storage class
@@ -56,27 +86,49 @@ namespace ANNS {
 
         public:
             Storage(DataType data_type, bool verbose);
+            Storage(DataType data_type, IdxType dim, IdxType num_numeric_attrs, bool verbose);
             Storage(std::shared_ptr<IStorage> storage, IdxType start, IdxType end);
             ~Storage() = default;
 
             // I/O
-            void load_from_file(const std::string& bin_file, const std::string& label_file, IdxType max_num_points);
+            void load_from_file(const std::string& bin_file, const std::string& label_file, IdxType max_num_points,
+                                size_t first_point);
             void write_to_file(const std::string& bin_file, const std::string& label_file);
+            void load_numeric_attrs(const std::string& attr_file, size_t first_point);
+            void write_numeric_attrs(const std::string& attr_file);
 
             // reorder the vector data
             void reorder_data(const std::vector<IdxType>& new_to_old_ids);
 
+            // append points
+            IdxType append(const char* vec, LabelSpan label_set, const float* numeric_attrs = nullptr);
+            void reserve(IdxType capacity);
+
             // get statistics
             DataType get_data_type() const { return data_type; };
             IdxType get_num_points() const { return num_points; };
             IdxType get_dim() const { return dim; };
+            IdxType get_num_numeric_attrs() const { return num_numeric_attrs; };
 
             // get data
-            std::vector<LabelType>* get_offseted_label_sets(IdxType idx) { return label_sets + idx; }
-            char* get_vector(IdxType idx) { return reinterpret_cast<char *>(vecs + idx * dim); }
-            std::vector<LabelType>& get_label_set(IdxType idx) { return label_sets[idx]; }
+            char* get_vector(IdxType idx) { return reinterpret_cast<char *>(vecs + (size_t)idx * dim); }
+            LabelSpan get_label_span(IdxType idx) const {
+                if (label_offsets)
+                    return LabelSpan(label_data + label_offsets[idx], label_data + label_offsets[idx + 1]);
+                if (label_parent)
+                    return label_parent->get_label_span(label_start + idx);
+                return LabelSpan(label_sets[idx]);
+            }
+            const std::vector<LabelType>& get_label_set(IdxType idx) {
+                if (label_parent)
+                    return label_parent->get_label_set(label_start + idx);
+                if (label_offsets)
+                    std::call_once(expand_flag, [this]() { expand_label_sets(); });
+                return label_sets[idx];
+            }
+            float* get_numeric_attrs(IdxType idx) { return numeric_attrs + (size_t)idx * num_numeric_attrs; }
             inline void prefetch_vec_by_id(IdxType idx) const {
-                for (size_t d = 0; d < prefetch_byte_num; d += 64) _mm_prefetch((const char *)(vecs + idx * dim) + d, _MM_HINT_T0);
+                for (size_t d = 0; d < prefetch_byte_num; d += 64) _mm_prefetch((const char *)(vecs + (size_t)idx * dim) + d, _MM_HINT_T0);
             }
 
             // obtain a point cloest to the center
@@ -85,17 +137,38 @@ namespace ANNS {
             // clean
             void clean() {
                 if (vecs)
-                    delete[] vecs;
+                    huge_free(vecs);    // allocated by huge_alloc
                 if (label_sets)
                     delete[] label_sets;
+                if (numeric_attrs)
+                    delete[] numeric_attrs;
+                release_label_csr();
             }
 
         private:
             DataType data_type;
             IdxType num_points, dim;
+            IdxType capacity = 0;   // 0 for views, they do not own the buffers
             T* vecs = nullptr;
             size_t prefetch_byte_num;
             std::vector<LabelType>* label_sets = nullptr;
+            IdxType num_numeric_attrs = 0;
+            float* numeric_attrs = nullptr;
+
+            // CSR labels, the labels of point i are label_data[label_offsets[i], label_offsets[i + 1]) in the mapped
+            // label file, or in the owned buffers once reordered; label_sets stays null until it is expanded
+            std::shared_ptr<LabelCSR> label_csr;
+            std::vector<uint64_t> owned_label_offsets;
+            std::vector<LabelType> owned_label_data;
+            const uint64_t* label_offsets = nullptr;
+            const LabelType* label_data = nullptr;
+            std::once_flag expand_flag;
+            void expand_label_sets();
+            void release_label_csr();
+
+            // views read the labels of points [label_start, label_start + num_points) of label_parent
+            std::shared_ptr<IStorage> label_parent;
+            IdxType label_start = 0;
 
             // for logs
             bool verbose;
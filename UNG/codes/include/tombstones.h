@@ -0,0 +1,67 @@
+#ifndef TOMBSTONES_H
+#define TOMBSTONES_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "config.h"
+
+
+
+namespace ANNS {
+
+    // bitmap of deleted points, set() may run while searches call check(), neither takes a lock
+    class TombstoneSet {
+        public:
+            TombstoneSet() = default;
+
+            // grows to num_points keeping the marks, must not run concurrently with set/check
+            void resize(IdxType num_points) {
+                size_t num_words = (static_cast<size_t>(num_points) + 63) / 64;
+                auto words = std::make_unique<std::atomic<uint64_t>[]>(num_words);
+                for (size_t i = 0; i < num_words; i++)
+                    words[i].store(i < _num_words ? _words[i].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+                _words = std::move(words);
+                _num_words = num_words;
+                _num_points = num_points;
+            }
+
+            // returns false if idx was already marked
+            inline bool set(IdxType idx) {
+                uint64_t bit = uint64_t(1) << (idx & 63);
+                if (_words[idx >> 6].fetch_or(bit, std::memory_order_relaxed) & bit)
+                    return false;
+                _num_marked.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            inline bool check(IdxType idx) const {
+                return (_words[idx >> 6].load(std::memory_order_relaxed) >> (idx & 63)) & 1;
+            }
+
+            void clear() {
+                for (size_t i = 0; i < _num_words; i++)
+                    _words[i].store(0, std::memory_order_relaxed);
+                _num_marked.store(0, std::memory_order_relaxed);
+            }
+
+            std::vector<IdxType> get_marked() const {
+                std::vector<IdxType> marked;
+                for (IdxType idx = 0; idx < _num_points; idx++)
+                    if (check(idx))
+                        marked.push_back(idx);
+                return marked;
+            }
+
+            IdxType size() const { return _num_points; }
+            IdxType count() const { return _num_marked.load(std::memory_order_relaxed); }
+
+        private:
+            std::unique_ptr<std::atomic<uint64_t>[]> _words;
+            size_t _num_words = 0;
+            IdxType _num_points = 0;
+            std::atomic<IdxType> _num_marked{0};
+    };
+}
+
+#endif // TOMBSTONES_H
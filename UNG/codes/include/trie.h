@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 #include "config.h"
+#include "label_span.h"
 
 
 namespace ANNS {
@@ -34,12 +35,12 @@ namespace ANNS {
             TrieIndex();
 
             // construction
-            IdxType insert(const std::vector<LabelType>& label_set, IdxType& new_label_set_id);
+            IdxType insert(LabelSpan label_set, IdxType& new_label_set_id);
 
             // query
             LabelType get_max_label_id() const { return _max_label_id; }
-            std::shared_ptr<TrieNode> find_exact_match(const std::vector<LabelType>& label_set) const;
-            void get_super_set_entrances(const std::vector<LabelType>& label_set, 
+            std::shared_ptr<TrieNode> find_exact_match(LabelSpan label_set) const;
+            void get_super_set_entrances(LabelSpan label_set, 
                                          std::vector<std::shared_ptr<TrieNode>>& super_set_entrances, 
                                          bool avoid_self=false, bool need_containment=true) const;
 
@@ -54,8 +55,8 @@ namespace ANNS {
             std::vector<std::vector<std::shared_ptr<TrieNode>>> _label_to_nodes;
 
             // help function for get_super_set_entrances
-            bool examine_smallest(const std::vector<LabelType>& label_set, const std::shared_ptr<TrieNode>& node) const;
-            bool examine_containment(const std::vector<LabelType>& label_set, const std::shared_ptr<TrieNode>& node) const;
+            bool examine_smallest(LabelSpan label_set, const std::shared_ptr<TrieNode>& node) const;
+            bool examine_containment(LabelSpan label_set, const std::shared_ptr<TrieNode>& node) const;
     };
 }
 
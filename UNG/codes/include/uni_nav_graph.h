@@ -6,9 +6,17 @@
 #include "distance.h"
 #include "search_cache.h"
 #include "label_nav_graph.h"
+#include "perf_counters.h"
+#include "build_trace.h"
+#include "tombstones.h"
+#include "filter_expr.h"
+#include "numeric_index.h"
+#include "numa_placement.h"
+#include "graph_reorder.h"
 #include "vamana/vamana.h"
 #include <unordered_map>
 #include <bitset>
+#include <future>
 #include <boost/dynamic_bitset.hpp>
 #include <roaring/roaring.h>
 #include <roaring/roaring.hh>
@@ -29,7 +37,42 @@ namespace ANNS
       size_t num_entry_points;
       size_t num_lng_descendants;
       bool is_global_search;
+      size_t num_filter_matches; // search_filter 和带数值范围的 search_hybrid: 满足过滤条件的点数
+      PerfCounterValues perf; // 硬件计数器, 仅在 collect_perf_counters 时填写
    };
+
+   // fxy_add: 按选择率区间生成查询负载 (containment 场景)
+   // band i 覆盖选择率 [band_bounds[i], band_bounds[i + 1])
+   struct WorkloadConfig
+   {
+      std::vector<double> band_bounds;
+      IdxType queries_per_band = 100;
+      IdxType K = 10;
+      uint32_t num_threads = 1;
+      uint64_t seed = 0;
+      IdxType max_rounds = 100;       // 每轮并行尝试 attempts_per_round 个候选标签集
+      IdxType attempts_per_round = 4096;
+   };
+
+   // state read by searches, consolidate() replaces it as a whole so that searches never wait for it
+   struct SearchSnapshot
+   {
+      std::shared_ptr<Graph> graph, global_graph;
+      std::vector<IdxType> group_entry_points;
+      IdxType global_entry_point;
+      std::unordered_map<IdxType, std::vector<IdxType>> group_redirects; // groups emptied by deletes -> closest non-empty super sets
+      std::shared_ptr<const std::vector<roaring::Roaring>> covered_sets_rb;
+      IdxType num_live_points;
+   };
+
+   // data read by a search thread: that of the snapshot, or the NUMA replica of the node the thread runs on
+   struct SearchData
+   {
+      const Graph *graph, *global_graph;
+      IStorage *storage;
+      uint32_t node;
+   };
+
    class UniNavGraph
    {
    public:
@@ -41,10 +84,25 @@ namespace ANNS
                  std::string scenario, std::string index_name, uint32_t num_threads, IdxType num_cross_edges,
                  IdxType max_degree, IdxType Lbuild, float alpha);
 
+      // build phases, per-group builds and memory usage are recorded in build_trace when set
+      void set_build_trace(std::shared_ptr<BuildTrace> build_trace) { _build_trace = build_trace; }
+
+      // query_stats[i] gets the time and the distance computations of query i
       void search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
                   uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario,
                   IdxType K, std::pair<IdxType, float> *results, std::vector<float> &num_cmps,
-                  std::vector<std::bitset<10000001>> &bitmap);
+                  std::vector<QueryStats> &query_stats, std::vector<std::bitset<10000001>> &bitmap);
+      // intra-query parallel search for latency-bound traffic with large Lsearch: the queries run one after another,
+      // each on num_threads workers. Overlap and nofilter queries with at least num_threads entry groups search the
+      // groups on different threads and merge the results; the other searches are best-first expansions by all the
+      // workers over a shared candidate queue. As in search, the groups of a query share one visited set.
+      // query_stats[i] gets the time and the distance computations of query i
+      void search_intra_query(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                              uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario,
+                              IdxType K, std::pair<IdxType, float> *results, std::vector<float> &num_cmps,
+                              std::vector<QueryStats> &query_stats);
+      // query_ranges[i] (optional) are numeric ranges that query i must also satisfy, they are intersected with the
+      // label condition before the routing so that the coverage covers both
       void search_hybrid(std::shared_ptr<IStorage> query_storage,
                          std::shared_ptr<DistanceHandler> distance_handler,
                          uint32_t num_threads, IdxType Lsearch,
@@ -53,11 +111,69 @@ namespace ANNS
                          std::vector<float> &num_cmps,
                          std::vector<QueryStats> &query_stats,
                          std::vector<std::bitset<10000001>> &bitmaps,
-                         bool is_ori_ung);
+                         bool is_ori_ung,
+                         bool collect_perf_counters = false,
+                         const std::vector<std::vector<NumericRange>> &query_ranges = {});
+
+      // boolean filters: filters[i] is compiled into a roaring set of the matching points from the label posting
+      // lists, the entry groups are the minimum super sets of its conjunctive part in the LNG; filters matching at
+      // most Lsearch points are answered exactly, the others are routed to the UNG or the global graph as in
+      // search_hybrid and collect the matching points they visit
+      void search_filter(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                         uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points,
+                         const std::vector<FilterExpr> &filters, IdxType K, std::pair<IdxType, float> *results,
+                         std::vector<float> &num_cmps, std::vector<QueryStats> &query_stats, bool is_ori_ung,
+                         bool collect_perf_counters = false);
+
+      // NUMA placement of the vectors and graphs read by search, search_hybrid and search_filter, the copies are made
+      // from the current snapshot by threads bound to their nodes and the search threads are pinned round-robin to the
+      // nodes. Inserts drop the copies and a consolidated snapshot is read directly, call again after updates
+      void set_numa_policy(NumaPolicy policy, uint32_t num_threads);
+
+      // move the graphs of the current snapshot into CSR blocks for search, search_hybrid and search_filter, in huge
+      // pages under set_huge_page_policy, the adjacency lists are freed; call before set_numa_policy, the replicas copy
+      // the layout. The graphs are changed in place, so this must not run concurrently with search. Inserts, compact
+      // and reorder_groups unflatten the graphs, a consolidated snapshot is read from the adjacency lists
+      void flatten_graphs();
+
+      // online inserts: new points are appended to a segment behind the contiguous group ranges and linked into their
+      // groups and the global graph, a new label set creates its trie node, LNG node and edges; returns the ids
+      // reported by search.
+      // compact() moves the segment into the group ranges. Updates must not run concurrently with search
+      std::vector<IdxType> insert(std::shared_ptr<IStorage> new_points, std::shared_ptr<DistanceHandler> distance_handler,
+                                  uint32_t num_threads);
+      void compact(uint32_t num_threads);
+      IdxType get_segment_size() const { return _num_points - _segment_start; }
+
+      // renumber the points inside each group range by the locality of the group's subgraph (inserted points are
+      // compacted first); vectors, graphs, id maps, entry points and posting lists follow, the NUMA copies are dropped
+      void reorder_groups(ReorderMethod method, uint32_t num_threads);
+
+      // deletes: the points are tombstoned at once, they still route searches but are never returned; returns the
+      // number of newly deleted ids. consolidate() repairs the in-neighbors of the deleted points, shrinks the covered
+      // sets and bypasses emptied groups, then publishes a new snapshot. Both may run concurrently with search,
+      // not with insert or compact
+      IdxType remove(const std::vector<IdxType> &ids);
+      void consolidate(std::shared_ptr<DistanceHandler> distance_handler, uint32_t num_threads);
+      std::future<void> consolidate_async(std::shared_ptr<DistanceHandler> distance_handler, uint32_t num_threads);
+      IdxType get_num_deleted() const { return _tombstones.count(); }
 
       // I/O
       void save(std::string index_path_prefix, std::string results_path_prefix);
-      void load(std::string index_path_prefix, const std::string &data_type);
+      // without load_search_data only the routing structures are loaded (trie, LNG, groups, covered sets, id maps and
+      // tombstones), for indices whose vectors and graph live elsewhere
+      void load(std::string index_path_prefix, const std::string &data_type, bool load_search_data = true);
+
+      // routing for searches outside of the in-memory graphs: entry points of a query label set for equality,
+      // containment, overlap or nofilter, empty when no group matches
+      std::vector<IdxType> get_query_entry_points(const std::vector<LabelType> &query_label_set, const std::string &scenario,
+                                                  IdxType num_entry_points, VisitedSet &visited_set);
+      bool is_deleted(IdxType id) const { return _tombstones.check(id); }
+      IdxType get_external_id(IdxType id) const { return _new_to_old_vec_ids[id]; }
+      IdxType get_num_points() const { return _num_points; }
+      IdxType get_max_degree() const { return _max_degree; }
+      std::shared_ptr<IStorage> get_base_storage() const { return _base_storage; }
+      std::shared_ptr<Graph> get_graph() const { return _graph; }
 
       // query generator
       void query_generate(std::string &output_prefix, int n, float keep_prob, bool stratified_sampling, bool verify);
@@ -74,7 +190,6 @@ namespace ANNS
           std::string &output_prefix,
           std::string dataset,
           int query_n,
-          std::string &base_label_file,
           int num_of_per_query_labels,
           float coverage_threshold,
           int K);
@@ -83,17 +198,23 @@ namespace ANNS
           std::string &output_prefix,
           std::string dataset,
           int query_n,
-          std::string &base_label_file,
           std::string &base_label_info_file);
       void generate_queries_method2_low_coverage(
           std::string &output_prefix,
           std::string dataset,
           int query_n,
-          std::string &base_label_file,
           int num_of_per_query_labels,
           int K,
           int max_K,
           int min_K);
+
+      // in-memory workload generator: samples label sets per selectivity band from the LNG groups and the base label
+      // sets, selectivity is exact (roaring posting lists), query vectors come from query_pool (or the base vectors, each
+      // excluded from the ground truth of its own query),
+      // writes <output_prefix><dataset>_query.bin, _query_labels.txt, _gt_labels_containment.bin and _workload_stats.csv
+      void generate_workload(const WorkloadConfig &config, std::shared_ptr<DistanceHandler> distance_handler,
+                             const std::string &output_prefix, const std::string &dataset,
+                             std::shared_ptr<IStorage> query_pool = nullptr);
       void load_bipartite_graph(const std::string &filename);
       bool compare_graphs(const ANNS::UniNavGraph &g1, const ANNS::UniNavGraph &g2);
       IdxType _num_points;
@@ -104,6 +225,14 @@ namespace ANNS
 
       std::pair<std::bitset<10000001>, double> compute_attribute_bitmap(const std::vector<LabelType> &query_attributes) const; // 构建bitmap
 
+      // entry groups of a query label set (minimum super sets in the LNG)
+      void get_min_super_sets(const std::vector<LabelType> &query_label_set, std::vector<IdxType> &min_super_set_ids,
+                              bool avoid_self = false, bool need_containment = true);
+
+      // number of live points a query of the scenario may return, from the covered sets of its entry groups
+      // (an upper bound for overlap); 0 means the index has no matching point
+      IdxType count_matching_points(const std::vector<LabelType> &query_label_set, const std::string &scenario);
+
       // 求search中flag需要的数据结构
       std::vector<BitsetType> _lng_descendants_bits; // 每个 group 的后代集合
       std::vector<BitsetType> _covered_sets_bits;    // 每个 group 的覆盖集合
@@ -128,8 +257,6 @@ namespace ANNS
 
       // label navigating graph
       std::shared_ptr<LabelNavGraph> _label_nav_graph = nullptr;
-      void get_min_super_sets(const std::vector<LabelType> &query_label_set, std::vector<IdxType> &min_super_set_ids,
-                              bool avoid_self = false, bool need_containment = true);
       void cal_f_coverage_ratio();
       void build_label_nav_graph();
       size_t count_all_descendants(IdxType group_id) const;
@@ -187,19 +314,84 @@ namespace ANNS
       void add_offset_for_uni_nav_graph();
 
       // obtain entry_points
-      std::vector<IdxType> get_entry_points(const std::vector<LabelType> &query_label_set,
+      std::vector<IdxType> get_entry_points(const SearchSnapshot &snapshot, const std::vector<LabelType> &query_label_set,
                                             IdxType num_entry_points, VisitedSet &visited_set);
-      void get_entry_points_given_group_id(IdxType num_entry_points, VisitedSet &visited_set,
+      void get_entry_points_given_group_id(const SearchSnapshot &snapshot, IdxType num_entry_points, VisitedSet &visited_set,
                                            IdxType group_id, std::vector<IdxType> &entry_points);
+      void resolve_entry_groups(const SearchSnapshot &snapshot, std::vector<IdxType> &entry_group_ids) const;
 
-      // search in graph
-      IdxType iterate_to_fixed_point(const char *query, std::shared_ptr<SearchCache> search_cache,
-                                     IdxType target_id, const std::vector<IdxType> &entry_points,
+      // search in graph, adjacency lists of a snapshot are read without locks
+      IdxType iterate_to_fixed_point(const Graph &graph, IStorage &storage, const char *query,
+                                     std::shared_ptr<SearchCache> search_cache, IdxType target_id, const std::vector<IdxType> &entry_points,
                                      bool clear_search_queue = true, bool clear_visited_set = true);
       // search in global graph
-      IdxType iterate_to_fixed_point_global(const char *query, std::shared_ptr<SearchCache> search_cache,
-                                            IdxType target_id, const std::vector<IdxType> &entry_points,
+      IdxType iterate_to_fixed_point_global(const Graph &graph, IStorage &storage, const char *query,
+                                            std::shared_ptr<SearchCache> search_cache, IdxType target_id, const std::vector<IdxType> &entry_points,
                                             bool clear_search_queue = true, bool clear_visited_set = true);
+      // search in graph by num_threads workers, the visited set is not cleared
+      IdxType iterate_to_fixed_point_parallel(const Graph &graph, IStorage &storage, const char *query, SearchQueue &search_queue,
+                                              ConcurrentVisitedSet &visited_set, const std::vector<IdxType> &entry_points,
+                                              uint32_t num_threads);
+      // search in graph, the visited points in filter are also kept in filtered_result; the visited set is not cleared
+      IdxType iterate_to_fixed_point_filtered(const Graph &graph, IStorage &storage, const char *query,
+                                              std::shared_ptr<SearchCache> search_cache, const std::vector<IdxType> &entry_points, const roaring::Roaring &filter,
+                                              SearchQueue &filtered_result);
+
+      // posting list of each label as a roaring set, built from _vector_attr_graph on the first filtered search
+      std::vector<roaring::Roaring> _label_postings_rb;
+      std::mutex _label_postings_mutex;
+      void prepare_label_postings();
+      bool has_matching_descendant(const FilterExpr &filter, IdxType group_id) const;
+
+      // range -> bitmap index of each numeric attribute column, built on the first search with ranges
+      std::vector<NumericRangeIndex> _numeric_indexes;
+      std::mutex _numeric_indexes_mutex;
+      void prepare_numeric_indexes();
+      roaring::Roaring get_range_set(const std::vector<NumericRange> &ranges) const;
+      roaring::Roaring get_group_points(const std::vector<IdxType> &group_ids, bool with_descendants) const;
+
+      // online inserts, points [_segment_start, _num_points) are in the appendable segment
+      IdxType _segment_start = 0;
+      std::vector<std::vector<IdxType>> _group_id_to_segment_ids;
+      IdxType _next_external_id = 0;
+      bool _lng_edges_ready = false;
+      std::shared_ptr<Vamana> _update_vamana; // robust pruning on _graph
+      void prepare_for_updates(std::shared_ptr<DistanceHandler> distance_handler);
+      void compute_label_nav_graph_edges();
+      void add_group(IdxType group_id, const std::vector<LabelType> &label_set, IdxType entry_point);
+      void link_inserted_point(IdxType vec_id, std::shared_ptr<SearchCache> search_cache, bool is_group_entry);
+      IdxType iterate_to_fixed_point_in_group(const char *query, std::shared_ptr<SearchCache> search_cache,
+                                              IdxType group_id, IdxType target_id = -1);
+      void inter_insert_in_group(IdxType src, const std::vector<IdxType> &src_neighbors,
+                                 std::shared_ptr<SearchCache> search_cache);
+      void add_cross_edge(IdxType from, IdxType to, float distance, bool force);
+      // new_to_cur[new_id] is the current id of the point moved to new_id, new_ranges become the group ranges
+      void apply_layout(const std::vector<IdxType> &new_to_cur, std::vector<std::pair<IdxType, IdxType>> &new_ranges);
+      void append_to_vector_attr_graph(IdxType first_id);
+
+      // NUMA replicas (one per node for REPLICATE, a single interleaved one for INTERLEAVE) of _numa_snapshot
+      struct NumaReplica
+      {
+         std::shared_ptr<IStorage> storage;
+         std::shared_ptr<Graph> graph, global_graph;
+      };
+      NumaPolicy _numa_policy = NumaPolicy::NONE;
+      std::vector<NumaReplica> _numa_replicas;
+      std::shared_ptr<const SearchSnapshot> _numa_snapshot;
+      SearchData get_search_data(const SearchSnapshot &snapshot) const;
+      void drop_numa_replicas();
+
+      // deletes and snapshots
+      std::shared_ptr<const SearchSnapshot> _snapshot;
+      TombstoneSet _tombstones;
+      std::mutex _delete_mutex;                 // guards _pending_deletes and _old_to_new_vec_ids
+      std::vector<IdxType> _pending_deletes;    // tombstoned, not consolidated yet
+      std::vector<IdxType> _old_to_new_vec_ids; // built on the first remove after a change of the ids
+      std::vector<bool> _is_emptied_group;
+      void publish_snapshot();
+      void sync_covered_sets();
+      void update_emptied_groups(const std::vector<IdxType> &group_ids);
+      std::unordered_map<IdxType, std::vector<IdxType>> get_group_redirects() const;
 
       // statistics
       float _index_time = 0, _label_processing_time = 0, _build_graph_time = 0, _build_vector_attr_graph_time = 0, _cal_descendants_time = 0, _cal_coverage_ratio_time = 0;
@@ -207,6 +399,10 @@ namespace ANNS
       float _index_size;
       IdxType _graph_num_edges, _LNG_num_edges;
       void statistics();
+
+      // build trace, RSS and bytes of the main structures are sampled at phase boundaries
+      std::shared_ptr<BuildTrace> _build_trace;
+      void trace_memory_usage();
    };
 }
 
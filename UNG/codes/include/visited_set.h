@@ -1,8 +1,11 @@
 #ifndef VISITED_SET_H
 #define VISITED_SET_H
 
+#include <atomic>
+#include <memory>
 #include <cstring>
 #include "config.h"
+#include "huge_pages.h"
 
 
 
@@ -14,9 +17,8 @@ namespace ANNS {
             void init(IdxType num_elements) {
                 _curValue = -1;
                 _num_elements = num_elements;
-                if (_marks != nullptr)
-                    delete[] _marks;
-                _marks = new MarkType[num_elements];
+                huge_free(_marks);
+                _marks = static_cast<MarkType*>(huge_alloc(sizeof(MarkType) * num_elements));
             }
 
             void clear() {
@@ -40,7 +42,7 @@ namespace ANNS {
             }
 
             ~VisitedSet() { 
-                delete[] _marks; 
+                huge_free(_marks); 
             }
 
         private:
@@ -48,6 +50,46 @@ namespace ANNS {
             MarkType* _marks = nullptr;
             IdxType _num_elements;
     };
+
+    // visited set shared by the workers of one query, test_and_set marks a point for exactly one of them
+    class ConcurrentVisitedSet {
+        public:
+            ConcurrentVisitedSet() = default;
+
+            void init(IdxType num_elements) {
+                _curValue = 0;
+                _num_elements = num_elements;
+                _marks.reset(new std::atomic<MarkType>[num_elements]);
+                for (IdxType i = 0; i < num_elements; ++i)
+                    _marks[i].store(0, std::memory_order_relaxed);
+            }
+
+            // not concurrently with the workers
+            void clear() {
+                _curValue++;
+                if (_curValue == 0) {
+                    for (IdxType i = 0; i < _num_elements; ++i)
+                        _marks[i].store(0, std::memory_order_relaxed);
+                    _curValue++;
+                }
+            }
+
+            // true if the point was visited already
+            inline bool test_and_set(IdxType idx) {
+                if (_marks[idx].load(std::memory_order_relaxed) == _curValue)
+                    return true;
+                return _marks[idx].exchange(_curValue, std::memory_order_relaxed) == _curValue;
+            }
+
+            inline bool check(IdxType idx) const {
+                return _marks[idx].load(std::memory_order_relaxed) == _curValue;
+            }
+
+        private:
+            MarkType _curValue = 0;
+            std::unique_ptr<std::atomic<MarkType>[]> _marks;
+            IdxType _num_elements = 0;
+    };
 }
 
 #endif // VISITED_SET_H
\ No newline at end of file
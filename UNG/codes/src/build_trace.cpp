@@ -0,0 +1,89 @@
+#include <omp.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "build_trace.h"
+
+namespace ANNS
+{
+
+   size_t get_current_rss()
+   {
+      FILE *file = fopen("/proc/self/statm", "r");
+      if (!file)
+         return 0;
+      long pages = 0, resident = 0;
+      int ret = fscanf(file, "%ld %ld", &pages, &resident);
+      fclose(file);
+      return ret == 2 ? (size_t)resident * sysconf(_SC_PAGESIZE) : 0;
+   }
+
+   size_t get_peak_rss()
+   {
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) != 0)
+         return 0;
+      return (size_t)usage.ru_maxrss * 1024;
+   }
+
+   static std::string escape_json(const std::string &s)
+   {
+      std::string out;
+      out.reserve(s.size());
+      for (char c : s)
+      {
+         if (c == '"' || c == '\\')
+            out += '\\';
+         out += c;
+      }
+      return out;
+   }
+
+   void BuildTrace::add_span(const std::string &name, const std::string &cat, Clock::time_point start,
+                             const std::string &args)
+   {
+      auto end = Clock::now();
+      char buf[128];
+      snprintf(buf, sizeof(buf), "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+               to_us(start), std::chrono::duration<double, std::micro>(end - start).count(), omp_get_thread_num());
+      std::string event = "{\"name\":\"" + escape_json(name) + "\",\"cat\":\"" + escape_json(cat) + "\"," + buf +
+                          ",\"args\":{" + args + "}}";
+      std::lock_guard<std::mutex> lock(_mutex);
+      _events.emplace_back(std::move(event));
+   }
+
+   void BuildTrace::add_counter(const std::string &name, const std::vector<std::pair<std::string, double>> &values)
+   {
+      char buf[96];
+      snprintf(buf, sizeof(buf), "\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":0", to_us(Clock::now()));
+      std::string event = "{\"name\":\"" + escape_json(name) + "\"," + buf + ",\"args\":{";
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+         if (i > 0)
+            event += ",";
+         event += "\"" + escape_json(values[i].first) + "\":" + std::to_string(values[i].second);
+      }
+      event += "}}";
+      std::lock_guard<std::mutex> lock(_mutex);
+      _events.emplace_back(std::move(event));
+   }
+
+   void BuildTrace::sample_rss()
+   {
+      add_counter("rss_bytes", {{"current", (double)get_current_rss()}, {"peak", (double)get_peak_rss()}});
+   }
+
+   void BuildTrace::write(const std::string &filename) const
+   {
+      std::ofstream out(filename);
+      if (!out.is_open())
+         throw std::runtime_error("Failed to open file: " + filename);
+      std::lock_guard<std::mutex> lock(_mutex);
+      out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      for (size_t i = 0; i < _events.size(); ++i)
+         out << _events[i] << (i + 1 < _events.size() ? ",\n" : "\n");
+      out << "]}\n";
+   }
+}
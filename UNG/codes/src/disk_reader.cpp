@@ -0,0 +1,403 @@
+#include <new>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <exception>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "disk_reader.h"
+
+namespace ANNS
+{
+
+   // =====================================begin 文件与缓冲=========================================
+   DiskFile::DiskFile(const std::string &filename)
+   {
+      _direct = true;
+      _fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+      if (_fd < 0 && errno == EINVAL)
+      {
+         _direct = false;
+         _fd = open(filename.c_str(), O_RDONLY);
+      }
+      if (_fd < 0)
+         throw std::runtime_error("Cannot open " + filename + ": " + std::strerror(errno));
+   }
+
+   DiskFile::~DiskFile()
+   {
+      close(_fd);
+   }
+
+   AlignedBuffer::AlignedBuffer(size_t bytes)
+   {
+      size = (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+      data = static_cast<char *>(std::aligned_alloc(SECTOR_SIZE, size == 0 ? SECTOR_SIZE : size));
+      if (data == nullptr)
+         throw std::bad_alloc();
+      std::memset(data, 0, size);
+   }
+
+   AlignedBuffer::~AlignedBuffer()
+   {
+      std::free(data);
+   }
+
+   // the layout is written in whole sectors, a read reaching the end of the file has a bad offset
+   static void pread_full(int fd, const ReadRequest &request)
+   {
+      size_t done = 0;
+      while (done < request.len)
+      {
+         auto ret = pread(fd, request.buf + done, request.len - done, request.offset + done);
+         if (ret < 0 && errno == EINTR)
+            continue;
+         if (ret < 0)
+            throw std::runtime_error(std::string("pread failed: ") + std::strerror(errno));
+         if (ret == 0)
+            throw std::runtime_error("pread reached the end of the file at offset " + std::to_string(request.offset + done));
+         done += ret;
+      }
+   }
+   // =====================================end 文件与缓冲=========================================
+
+   // =====================================begin pread=========================================
+   struct PendingBatch
+   {
+      std::atomic<size_t> remaining;
+      std::mutex mutex;
+      std::condition_variable done;
+      std::exception_ptr error;
+   };
+
+   struct ReadTask
+   {
+      int fd;
+      const ReadRequest *request;
+      PendingBatch *batch;
+   };
+
+   struct IoThreadPool::State
+   {
+      std::mutex mutex;
+      std::condition_variable has_task;
+      std::deque<ReadTask> tasks;
+      std::vector<std::thread> threads;
+      bool stop = false;
+
+      bool try_pop(ReadTask &task)
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (tasks.empty())
+            return false;
+         task = tasks.front();
+         tasks.pop_front();
+         return true;
+      }
+
+      // the batch lives on the stack of run(), which returns as soon as it sees remaining == 0: the count is
+      // decremented under the batch mutex so that the batch is not touched after the waiter can see it
+      static void execute(const ReadTask &task)
+      {
+         std::exception_ptr error;
+         try
+         {
+            pread_full(task.fd, *task.request);
+         }
+         catch (...)
+         {
+            error = std::current_exception();
+         }
+         std::lock_guard<std::mutex> lock(task.batch->mutex);
+         if (error)
+            task.batch->error = error;
+         if (--task.batch->remaining == 0)
+            task.batch->done.notify_all();
+      }
+
+      void work()
+      {
+         while (true)
+         {
+            ReadTask task;
+            {
+               std::unique_lock<std::mutex> lock(mutex);
+               has_task.wait(lock, [&]
+                             { return stop || !tasks.empty(); });
+               if (tasks.empty())
+                  return;
+               task = tasks.front();
+               tasks.pop_front();
+            }
+            execute(task);
+         }
+      }
+   };
+
+   IoThreadPool::IoThreadPool(uint32_t num_threads) : _state(new State())
+   {
+      for (uint32_t i = 0; i < num_threads; ++i)
+         _state->threads.emplace_back([this]
+                                      { _state->work(); });
+   }
+
+   IoThreadPool::~IoThreadPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(_state->mutex);
+         _state->stop = true;
+      }
+      _state->has_task.notify_all();
+      for (auto &thread : _state->threads)
+         thread.join();
+   }
+
+   uint32_t IoThreadPool::get_num_threads() const
+   {
+      return _state->threads.size();
+   }
+
+   void IoThreadPool::run(int fd, std::vector<ReadRequest> &requests)
+   {
+      if (requests.empty())
+         return;
+      PendingBatch batch;
+      batch.remaining = requests.size();
+      {
+         std::lock_guard<std::mutex> lock(_state->mutex);
+         for (const auto &request : requests)
+            _state->tasks.push_back({fd, &request, &batch});
+      }
+      _state->has_task.notify_all();
+
+      // help until the queue is empty, then wait for the reads still running
+      ReadTask task;
+      while (batch.remaining.load() > 0 && _state->try_pop(task))
+         State::execute(task);
+      std::unique_lock<std::mutex> lock(batch.mutex);
+      batch.done.wait(lock, [&]
+                      { return batch.remaining.load() == 0; });
+      if (batch.error)
+         std::rethrow_exception(batch.error);
+   }
+
+   class PreadReader : public DiskReader
+   {
+   public:
+      PreadReader(std::shared_ptr<DiskFile> file, std::shared_ptr<IoThreadPool> io_pool)
+          : _file(file), _io_pool(io_pool) {}
+
+      void read(std::vector<ReadRequest> &requests) override
+      {
+         if (_io_pool != nullptr && _io_pool->get_num_threads() > 0 && requests.size() > 1)
+            _io_pool->run(_file->get_fd(), requests);
+         else
+            for (const auto &request : requests)
+               pread_full(_file->get_fd(), request);
+      }
+
+      std::string get_name() const override { return "pread"; }
+
+   private:
+      std::shared_ptr<DiskFile> _file;
+      std::shared_ptr<IoThreadPool> _io_pool;
+   };
+   // =====================================end pread=========================================
+
+   // =====================================begin io_uring=========================================
+   // the rings are set up with the raw system calls, liburing is not required
+   class IoUringReader : public DiskReader
+   {
+   public:
+      IoUringReader(std::shared_ptr<DiskFile> file, uint32_t queue_depth) : _file(file)
+      {
+         io_uring_params params;
+         std::memset(&params, 0, sizeof(params));
+         _ring_fd = syscall(__NR_io_uring_setup, std::max<uint32_t>(queue_depth, 1), &params);
+         if (_ring_fd < 0)
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+
+         // submission and completion rings share one mapping on kernels with IORING_FEAT_SINGLE_MMAP
+         _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+         _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+         bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+         if (single_mmap)
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+         _sq_ring = map_ring(_sq_ring_size, IORING_OFF_SQ_RING);
+         _cq_ring = single_mmap ? _sq_ring : map_ring(_cq_ring_size, IORING_OFF_CQ_RING);
+         _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+         _sqes = static_cast<io_uring_sqe *>(map_ring(_sqes_size, IORING_OFF_SQES));
+
+         _sq_tail = ring_field(_sq_ring, params.sq_off.tail);
+         _sq_mask = *ring_field(_sq_ring, params.sq_off.ring_mask);
+         _sq_array = ring_field(_sq_ring, params.sq_off.array);
+         _cq_head = ring_field(_cq_ring, params.cq_off.head);
+         _cq_tail = ring_field(_cq_ring, params.cq_off.tail);
+         _cq_mask = *ring_field(_cq_ring, params.cq_off.ring_mask);
+         _cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(_cq_ring) + params.cq_off.cqes);
+         _depth = params.sq_entries;
+      }
+
+      ~IoUringReader() override
+      {
+         if (_sqes != nullptr)
+            munmap(_sqes, _sqes_size);
+         if (_cq_ring != nullptr && _cq_ring != _sq_ring)
+            munmap(_cq_ring, _cq_ring_size);
+         if (_sq_ring != nullptr)
+            munmap(_sq_ring, _sq_ring_size);
+         close(_ring_fd);
+      }
+
+      void read(std::vector<ReadRequest> &requests) override
+      {
+         if (_broken)
+            throw std::runtime_error("io_uring reader is unusable after a failed io_uring_enter");
+         for (size_t first = 0; first < requests.size(); first += _depth)
+         {
+            size_t num_requests = std::min<size_t>(_depth, requests.size() - first);
+
+            // queue the reads, the kernel sees them after the release of the tail
+            uint32_t tail = *_sq_tail;
+            for (size_t i = 0; i < num_requests; ++i)
+            {
+               const auto &request = requests[first + i];
+               uint32_t index = (tail + i) & _sq_mask;
+               auto &sqe = _sqes[index];
+               std::memset(&sqe, 0, sizeof(sqe));
+               sqe.opcode = IORING_OP_READ;
+               sqe.fd = _file->get_fd();
+               sqe.off = request.offset;
+               sqe.addr = reinterpret_cast<uint64_t>(request.buf);
+               sqe.len = request.len;
+               sqe.user_data = first + i;
+               _sq_array[index] = index;
+            }
+            __atomic_store_n(_sq_tail, tail + num_requests, __ATOMIC_RELEASE);
+
+            // submit and wait for all of them. After a failed read the others are still waited for: the kernel
+            // writes into their buffers, and their completions must not be left in the ring for the next batch
+            size_t num_submitted = 0, num_completed = 0;
+            std::exception_ptr error;
+            while (num_completed < (_broken ? num_submitted : num_requests))
+            {
+               size_t num_to_submit = _broken ? 0 : num_requests - num_submitted;
+               size_t num_to_wait = (_broken ? num_submitted : num_requests) - num_completed;
+               auto ret = syscall(__NR_io_uring_enter, _ring_fd, num_to_submit, num_to_wait, IORING_ENTER_GETEVENTS,
+                                  nullptr, 0);
+               if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+               {
+                  if (!error)
+                     error = std::make_exception_ptr(
+                         std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno)));
+                  // the reads that are not submitted stay queued and cannot be taken back, only the submitted ones
+                  // are waited for; if even that fails the ring is given up
+                  if (_broken)
+                     break;
+                  _broken = true;
+                  continue;
+               }
+               if (ret > 0)
+                  num_submitted += ret;
+               num_completed += reap(requests, error);
+            }
+            if (error)
+               std::rethrow_exception(error);
+         }
+      }
+
+      std::string get_name() const override { return "io_uring"; }
+
+   private:
+      std::shared_ptr<DiskFile> _file;
+      int _ring_fd;
+      void *_sq_ring = nullptr, *_cq_ring = nullptr;
+      io_uring_sqe *_sqes = nullptr;
+      size_t _sq_ring_size, _cq_ring_size, _sqes_size;
+      uint32_t *_sq_tail, *_sq_array, *_cq_head, *_cq_tail;
+      uint32_t _sq_mask, _cq_mask, _depth;
+      io_uring_cqe *_cqes;
+      bool _broken = false;
+
+      void *map_ring(size_t size, off_t offset)
+      {
+         void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, offset);
+         if (ptr == MAP_FAILED)
+         {
+            close(_ring_fd);
+            throw std::runtime_error(std::string("io_uring mmap failed: ") + std::strerror(errno));
+         }
+         return ptr;
+      }
+
+      static uint32_t *ring_field(void *ring, uint32_t offset)
+      {
+         return reinterpret_cast<uint32_t *>(static_cast<char *>(ring) + offset);
+      }
+
+      // consume the completions available now, short reads are finished with pread; the first failure is kept in
+      // error and the remaining completions are still consumed
+      size_t reap(std::vector<ReadRequest> &requests, std::exception_ptr &error)
+      {
+         uint32_t head = *_cq_head;
+         uint32_t tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+         size_t num_completed = 0;
+         for (; head != tail; ++head, ++num_completed)
+         {
+            const auto &cqe = _cqes[head & _cq_mask];
+            auto &request = requests[cqe.user_data];
+            try
+            {
+               if (cqe.res < 0)
+                  throw std::runtime_error(std::string("io_uring read failed: ") + std::strerror(-cqe.res));
+               if (cqe.res == 0 && request.len > 0)
+                  throw std::runtime_error("io_uring read reached the end of the file at offset " + std::to_string(request.offset));
+               if (static_cast<size_t>(cqe.res) < request.len)
+                  pread_full(_file->get_fd(), {request.offset + cqe.res, request.len - cqe.res, request.buf + cqe.res});
+            }
+            catch (...)
+            {
+               if (!error)
+                  error = std::current_exception();
+            }
+         }
+         __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+         return num_completed;
+      }
+   };
+   // =====================================end io_uring=========================================
+
+   std::unique_ptr<DiskReader> create_disk_reader(std::shared_ptr<DiskFile> file, const std::string &engine,
+                                                  uint32_t queue_depth, std::shared_ptr<IoThreadPool> io_pool)
+   {
+      if (engine == "pread")
+         return std::unique_ptr<DiskReader>(new PreadReader(file, io_pool));
+      if (engine == "io_uring")
+         return std::unique_ptr<DiskReader>(new IoUringReader(file, queue_depth));
+      if (engine != "auto")
+         throw std::runtime_error("Invalid I/O engine " + engine + ", use auto, io_uring or pread");
+
+      // io_uring may be missing, disabled (io_uring_disabled, seccomp) or lack IORING_OP_READ, probe it with a read
+      try
+      {
+         std::unique_ptr<DiskReader> reader(new IoUringReader(file, queue_depth));
+         AlignedBuffer buffer(SECTOR_SIZE);
+         std::vector<ReadRequest> probe = {{0, SECTOR_SIZE, buffer.data}};
+         reader->read(probe);
+         return reader;
+      }
+      catch (const std::exception &)
+      {
+         return std::unique_ptr<DiskReader>(new PreadReader(file, io_pool));
+      }
+   }
+}
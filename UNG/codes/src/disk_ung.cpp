@@ -0,0 +1,277 @@
+#include <omp.h>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "utils.h"
+#include "disk_ung.h"
+
+namespace ANNS
+{
+
+   // =====================================begin 磁盘布局=========================================
+   void DiskUniNavGraph::write_disk_layout(UniNavGraph &index, const std::string &index_path_prefix, uint32_t num_threads)
+   {
+      auto start_time = std::chrono::high_resolution_clock::now();
+      auto storage = index.get_base_storage();
+      auto graph = index.get_graph();
+      if (storage == nullptr || graph == nullptr)
+         throw std::runtime_error("write_disk_layout needs an index loaded with its vectors and graph");
+      if (storage->get_data_type() != DataType::FLOAT)
+         throw std::runtime_error("The SSD layout only supports float vectors");
+      IdxType num_points = storage->get_num_points();
+      IdxType dim = storage->get_dim();
+
+      // the slots fit the largest adjacency list, cross-group edges included
+      IdxType max_degree = 0;
+      for (IdxType id = 0; id < num_points; ++id)
+         max_degree = std::max<IdxType>(max_degree, graph->get_neighbors(id).size());
+      size_t vec_size = dim * sizeof(float);
+      size_t node_size = vec_size + sizeof(IdxType) * (max_degree + 1);
+      size_t nodes_per_sector = SECTOR_SIZE / node_size;
+      size_t sectors_per_node = nodes_per_sector > 0 ? 0 : (node_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+      size_t num_sectors = nodes_per_sector > 0 ? (num_points + nodes_per_sector - 1) / nodes_per_sector
+                                                : num_points * sectors_per_node;
+
+      // nodes, a chunk of sectors at a time
+      std::string disk_index_filename = index_path_prefix + "disk_index";
+      std::ofstream out(disk_index_filename, std::ios::binary);
+      if (!out)
+         throw std::runtime_error("Cannot write " + disk_index_filename);
+      const size_t chunk_sectors = 4096;
+      std::vector<char> chunk(chunk_sectors * SECTOR_SIZE);
+      omp_set_num_threads(num_threads);
+      for (size_t first_sector = 0; first_sector < num_sectors; first_sector += chunk_sectors)
+      {
+         size_t last_sector = std::min(num_sectors, first_sector + chunk_sectors);
+         std::fill(chunk.begin(), chunk.end(), 0);
+         IdxType first_id, last_id;
+         if (nodes_per_sector > 0)
+         {
+            first_id = first_sector * nodes_per_sector;
+            last_id = std::min<size_t>(num_points, last_sector * nodes_per_sector);
+         }
+         else
+         {
+            first_id = first_sector / sectors_per_node;
+            last_id = last_sector / sectors_per_node;
+         }
+#pragma omp parallel for schedule(static, 256)
+         for (IdxType id = first_id; id < last_id; ++id)
+         {
+            size_t offset = nodes_per_sector > 0 ? (id / nodes_per_sector - first_sector) * SECTOR_SIZE + id % nodes_per_sector * node_size
+                                                 : (static_cast<size_t>(id) * sectors_per_node - first_sector) * SECTOR_SIZE;
+            char *node = chunk.data() + offset;
+            std::copy(storage->get_vector(id), storage->get_vector(id) + vec_size, node);
+            auto neighbors = graph->get_neighbors(id);
+            IdxType num_neighbors = neighbors.size();
+            std::copy(reinterpret_cast<const char *>(&num_neighbors), reinterpret_cast<const char *>(&num_neighbors + 1), node + vec_size);
+            std::copy(reinterpret_cast<const char *>(neighbors.begin()), reinterpret_cast<const char *>(neighbors.end()),
+                      node + vec_size + sizeof(IdxType));
+         }
+         out.write(chunk.data(), (last_sector - first_sector) * SECTOR_SIZE);
+      }
+      out.close();
+      if (!out)
+         throw std::runtime_error("Failed to write " + disk_index_filename);
+
+      // SQ codes
+      ScalarQuantizer quantizer;
+      quantizer.train(storage, num_threads);
+      quantizer.save(index_path_prefix + "sq_quantizer");
+      std::vector<uint8_t> codes(static_cast<size_t>(num_points) * dim);
+#pragma omp parallel for schedule(static, 4096)
+      for (IdxType id = 0; id < num_points; ++id)
+         quantizer.encode(reinterpret_cast<const float *>(storage->get_vector(id)), codes.data() + static_cast<size_t>(id) * dim);
+      std::ofstream codes_out(index_path_prefix + "sq_codes", std::ios::binary);
+      codes_out.write(reinterpret_cast<const char *>(codes.data()), codes.size());
+      if (!codes_out)
+         throw std::runtime_error("Cannot write " + index_path_prefix + "sq_codes");
+
+      // layout
+      std::map<std::string, std::string> meta_data;
+      meta_data["num_points"] = std::to_string(num_points);
+      meta_data["dim"] = std::to_string(dim);
+      meta_data["max_degree"] = std::to_string(max_degree);
+      meta_data["node_size"] = std::to_string(node_size);
+      meta_data["nodes_per_sector"] = std::to_string(nodes_per_sector);
+      meta_data["sectors_per_node"] = std::to_string(sectors_per_node);
+      meta_data["num_sectors"] = std::to_string(num_sectors);
+      write_kv_file(index_path_prefix + "disk_meta", meta_data);
+
+      std::cout << "- Disk layout: " << num_sectors << " sectors, " << node_size << " bytes per node, "
+                << (nodes_per_sector > 0 ? std::to_string(nodes_per_sector) + " nodes per sector" : std::to_string(sectors_per_node) + " sectors per node")
+                << ", written in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   }
+
+   uint64_t DiskUniNavGraph::get_node_offset(IdxType id) const
+   {
+      if (_nodes_per_sector > 0)
+         return id / _nodes_per_sector * SECTOR_SIZE + id % _nodes_per_sector * _node_size;
+      return static_cast<uint64_t>(id) * _sectors_per_node * SECTOR_SIZE;
+   }
+   // =====================================end 磁盘布局=========================================
+
+   void DiskUniNavGraph::load(const std::string &index_path_prefix, const std::string &data_type, const std::string &io_engine,
+                              uint32_t num_io_threads)
+   {
+      if (data_type != "float")
+         throw std::runtime_error("The SSD mode only supports float vectors");
+      _index.load(index_path_prefix, data_type, false);
+
+      // layout
+      auto meta_data = parse_kv_file(index_path_prefix + "disk_meta");
+      _num_points = std::stoul(meta_data["num_points"]);
+      _dim = std::stoul(meta_data["dim"]);
+      _max_degree = std::stoul(meta_data["max_degree"]);
+      _node_size = std::stoull(meta_data["node_size"]);
+      _nodes_per_sector = std::stoull(meta_data["nodes_per_sector"]);
+      _sectors_per_node = std::stoull(meta_data["sectors_per_node"]);
+      if (_num_points != _index.get_num_points())
+         throw std::runtime_error("The disk layout has " + std::to_string(_num_points) + " points, the index " +
+                                  std::to_string(_index.get_num_points()));
+      if (_node_size < _dim * sizeof(float) + (static_cast<size_t>(_max_degree) + 1) * sizeof(IdxType) ||
+          (_nodes_per_sector > 0 ? _nodes_per_sector * _node_size > SECTOR_SIZE : _sectors_per_node * SECTOR_SIZE < _node_size))
+         throw std::runtime_error("Invalid disk layout in " + index_path_prefix + "disk_meta");
+
+      // SQ codes
+      _quantizer.load(index_path_prefix + "sq_quantizer");
+      if (_quantizer.get_dim() != _dim)
+         throw std::runtime_error("The quantizer does not match the disk layout");
+      _codes.resize(static_cast<size_t>(_num_points) * _dim);
+      std::ifstream codes_in(index_path_prefix + "sq_codes", std::ios::binary);
+      if (!codes_in.read(reinterpret_cast<char *>(_codes.data()), _codes.size()))
+         throw std::runtime_error("Cannot read " + index_path_prefix + "sq_codes");
+
+      // auto is resolved once, the search threads create readers of the same engine
+      _file = std::make_shared<DiskFile>(index_path_prefix + "disk_index");
+      _io_pool = num_io_threads > 0 ? std::make_shared<IoThreadPool>(num_io_threads) : nullptr;
+      _io_engine = create_disk_reader(_file, io_engine, 1, _io_pool)->get_name();
+      std::cout << "- SSD index: " << _num_points << " points, " << _codes.size() / (1024 * 1024) << " MB of SQ codes, I/O engine "
+                << _io_engine << (_file->is_direct() ? " with O_DIRECT" : " through the page cache") << std::endl;
+   }
+
+   void DiskUniNavGraph::search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                                uint32_t num_threads, IdxType Lsearch, IdxType beam_width, IdxType num_entry_points,
+                                const std::string &scenario, IdxType K, std::pair<IdxType, float> *results,
+                                std::vector<float> &num_cmps, std::vector<float> &num_ios)
+   {
+      if (K > Lsearch)
+      {
+         std::cerr << "Error: K should be less than or equal to Lsearch" << std::endl;
+         exit(-1);
+      }
+      if (query_storage->get_dim() != _dim)
+      {
+         std::cerr << "Error: the queries have dimension " << query_storage->get_dim() << ", the index " << _dim << std::endl;
+         exit(-1);
+      }
+      beam_width = std::max<IdxType>(beam_width, 1);
+
+      // per-thread readers, buffers and queues
+      struct SearchContext
+      {
+         std::unique_ptr<DiskReader> reader;
+         std::unique_ptr<AlignedBuffer> buffer;
+         VisitedSet visited_set;
+         SearchQueue candidates, result;
+         std::vector<IdxType> frontier;
+         std::vector<ReadRequest> requests;
+      };
+      std::vector<SearchContext> contexts(num_threads);
+      size_t read_size = get_node_read_size();
+      for (auto &context : contexts)
+      {
+         context.reader = create_disk_reader(_file, _io_engine, beam_width, _io_pool);
+         context.buffer.reset(new AlignedBuffer(read_size * beam_width));
+         context.visited_set.init(_num_points);
+         context.candidates.reserve(Lsearch);
+         context.result.reserve(K);
+      }
+
+      // neighbor ids read from disk are checked, a corrupt node fails the search after the parallel loop
+      std::atomic<bool> has_invalid_neighbor(false);
+
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (IdxType id = 0; id < query_storage->get_num_points(); ++id)
+      {
+         auto &context = contexts[omp_get_thread_num()];
+         auto query = query_storage->get_vector(id);
+         auto query_vec = reinterpret_cast<const float *>(query);
+         context.candidates.clear();
+         context.result.clear();
+         num_cmps[id] = num_ios[id] = 0;
+
+         // routing on the in-memory part
+         auto entry_points = _index.get_query_entry_points(query_storage->get_label_set(id), scenario, num_entry_points, context.visited_set);
+         for (auto entry_point : entry_points)
+         {
+            context.visited_set.set(entry_point);
+            context.candidates.insert(entry_point, _quantizer.compute_l2(query_vec, _codes.data() + static_cast<size_t>(entry_point) * _dim));
+         }
+         num_cmps[id] += entry_points.size();
+
+         // beam search, one batch of reads per round
+         while (context.candidates.has_unexpanded_node())
+         {
+            context.frontier.clear();
+            context.requests.clear();
+            while (context.frontier.size() < beam_width && context.candidates.has_unexpanded_node())
+            {
+               IdxType cur_id = context.candidates.get_closest_unexpanded().id;
+               auto offset = get_node_offset(cur_id);
+               context.requests.push_back({offset / SECTOR_SIZE * SECTOR_SIZE, read_size,
+                                           context.buffer->data + context.frontier.size() * read_size});
+               context.frontier.push_back(cur_id);
+            }
+            context.reader->read(context.requests);
+            num_ios[id] += context.requests.size();
+
+            for (size_t i = 0; i < context.frontier.size(); ++i)
+            {
+               IdxType cur_id = context.frontier[i];
+               const char *node = context.requests[i].buf + get_node_offset(cur_id) % SECTOR_SIZE;
+
+               // re-rank with the full vector, deleted points only route the search
+               if (!_index.is_deleted(cur_id))
+                  context.result.insert(cur_id, distance_handler->compute(query, node, _dim));
+               num_cmps[id]++;
+
+               // neighbors by SQ distance
+               auto adjacency = reinterpret_cast<const IdxType *>(node + _dim * sizeof(float));
+               IdxType num_neighbors = std::min(adjacency[0], _max_degree);
+               for (IdxType k = 1; k <= num_neighbors; ++k)
+               {
+                  IdxType neighbor = adjacency[k];
+                  if (neighbor >= _num_points)
+                  {
+                     has_invalid_neighbor = true;
+                     continue;
+                  }
+                  if (context.visited_set.check(neighbor))
+                     continue;
+                  context.visited_set.set(neighbor);
+                  context.candidates.insert(neighbor, _quantizer.compute_l2(query_vec, _codes.data() + static_cast<size_t>(neighbor) * _dim));
+                  num_cmps[id]++;
+               }
+            }
+         }
+
+         // write results
+         IdxType num_results = 0;
+         for (; num_results < context.result.size(); ++num_results)
+         {
+            results[id * K + num_results].first = _index.get_external_id(context.result[num_results].id);
+            results[id * K + num_results].second = context.result[num_results].distance;
+         }
+         for (; num_results < K; ++num_results)
+            results[id * K + num_results].first = -1;
+      }
+      if (has_invalid_neighbor)
+         throw std::runtime_error("The disk layout has neighbor ids out of range, it does not belong to this index");
+   }
+}
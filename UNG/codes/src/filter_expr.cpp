@@ -0,0 +1,377 @@
+#include <cctype>
+#include <limits>
+#include <fstream>
+#include <charconv>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include "label_csr.h"
+#include "filter_expr.h"
+
+namespace ANNS
+{
+
+   // recursive descent parser, appends the nodes of the expression to expr._nodes
+   class FilterParser
+   {
+   public:
+      FilterParser(const std::string &text, const std::unordered_map<std::string, LabelType> &name_to_label,
+                   FilterExpr &expr)
+          : _text(text), _name_to_label(name_to_label), _expr(expr) {}
+
+      IdxType parse()
+      {
+         next_token();
+         auto root = parse_or();
+         if (!_token.empty())
+            error("unexpected '" + _token + "'");
+         return root;
+      }
+
+   private:
+      const std::string &_text;
+      const std::unordered_map<std::string, LabelType> &_name_to_label;
+      FilterExpr &_expr;
+      size_t _pos = 0, _token_pos = 0;
+      std::string _token;
+
+      [[noreturn]] void error(const std::string &message) const
+      {
+         throw std::runtime_error("Invalid filter expression '" + _text + "' at " + std::to_string(_token_pos) + ": " + message);
+      }
+
+      static bool is_keyword(const std::string &token, const char *keyword)
+      {
+         if (token.size() != std::char_traits<char>::length(keyword))
+            return false;
+         for (size_t i = 0; i < token.size(); ++i)
+            if (std::toupper(static_cast<unsigned char>(token[i])) != keyword[i])
+               return false;
+         return true;
+      }
+      bool is_and() const { return _token == "&&" || _token == "&" || is_keyword(_token, "AND"); }
+      bool is_or() const { return _token == "||" || _token == "|" || is_keyword(_token, "OR"); }
+      bool is_not() const { return _token == "!" || is_keyword(_token, "NOT"); }
+
+      // operators and parentheses, the other tokens end at a space or an operator
+      void next_token()
+      {
+         while (_pos < _text.size() && std::isspace(static_cast<unsigned char>(_text[_pos])))
+            ++_pos;
+         _token_pos = _pos;
+         _token.clear();
+         if (_pos == _text.size())
+            return;
+         char c = _text[_pos];
+         if (c == '(' || c == ')' || c == '!' || c == '*')
+            _token = _text.substr(_pos++, 1);
+         else if (c == '&' || c == '|')
+         {
+            size_t len = _pos + 1 < _text.size() && _text[_pos + 1] == c ? 2 : 1;
+            _token = _text.substr(_pos, len);
+            _pos += len;
+         }
+         else
+         {
+            while (_pos < _text.size() && !std::isspace(static_cast<unsigned char>(_text[_pos])) &&
+                   std::string("()!&|").find(_text[_pos]) == std::string::npos)
+               ++_pos;
+            _token = _text.substr(_token_pos, _pos - _token_pos);
+         }
+      }
+
+      IdxType add_node(FilterExpr::Op op, std::vector<IdxType> children = {}, LabelType label = 0)
+      {
+         _expr._nodes.push_back({op, label, std::move(children)});
+         return _expr._nodes.size() - 1;
+      }
+
+      IdxType parse_or()
+      {
+         std::vector<IdxType> children = {parse_and()};
+         while (is_or())
+         {
+            next_token();
+            children.push_back(parse_and());
+         }
+         return children.size() == 1 ? children[0] : add_node(FilterExpr::Op::OR, std::move(children));
+      }
+
+      IdxType parse_and()
+      {
+         std::vector<IdxType> children = {parse_factor()};
+         while (is_and())
+         {
+            next_token();
+            children.push_back(parse_factor());
+         }
+         return children.size() == 1 ? children[0] : add_node(FilterExpr::Op::AND, std::move(children));
+      }
+
+      IdxType parse_factor()
+      {
+         if (_token.empty())
+            error("unexpected end");
+         if (is_not())
+         {
+            next_token();
+            return add_node(FilterExpr::Op::NOT, {parse_factor()});
+         }
+         if (_token == "(")
+         {
+            next_token();
+            auto node_id = parse_or();
+            if (_token != ")")
+               error("expected ')'");
+            next_token();
+            return node_id;
+         }
+         if (_token == "*")
+         {
+            next_token();
+            return add_node(FilterExpr::Op::ANY);
+         }
+         if (_token == ")" || is_and() || is_or())
+            error("unexpected '" + _token + "'");
+
+         // label id or name
+         LabelType label;
+         auto iter = _name_to_label.find(_token);
+         if (iter != _name_to_label.end())
+            label = iter->second;
+         else
+         {
+            uint32_t value = 0;
+            auto res = std::from_chars(_token.data(), _token.data() + _token.size(), value);
+            if (res.ec != std::errc() || res.ptr != _token.data() + _token.size() || value > std::numeric_limits<LabelType>::max())
+               error("unknown label '" + _token + "'");
+            label = value;
+         }
+         next_token();
+         return add_node(FilterExpr::Op::LABEL, {}, label);
+      }
+   };
+
+   FilterExpr FilterExpr::parse(const std::string &text, const std::unordered_map<std::string, LabelType> &name_to_label)
+   {
+      FilterExpr expr;
+      if (std::all_of(text.begin(), text.end(), [](char c)
+                      { return std::isspace(static_cast<unsigned char>(c)); }))
+      {
+         expr._nodes.push_back({Op::ANY});
+         return expr;
+      }
+      expr._root = FilterParser(text, name_to_label, expr).parse();
+      return expr;
+   }
+
+   bool FilterExpr::matches(LabelSpan label_set) const
+   {
+      return _nodes.empty() || matches(_root, label_set);
+   }
+
+   bool FilterExpr::matches(IdxType node_id, LabelSpan label_set) const
+   {
+      const auto &node = _nodes[node_id];
+      switch (node.op)
+      {
+      case Op::ANY:
+         return true;
+      case Op::LABEL:
+         return std::binary_search(label_set.begin(), label_set.end(), node.label);
+      case Op::NOT:
+         return !matches(node.children[0], label_set);
+      case Op::AND:
+         for (auto child : node.children)
+            if (!matches(child, label_set))
+               return false;
+         return true;
+      case Op::OR:
+         for (auto child : node.children)
+            if (matches(child, label_set))
+               return true;
+         return false;
+      }
+      return false;
+   }
+
+   roaring::Roaring FilterExpr::evaluate(const std::function<const roaring::Roaring &(LabelType)> &posting_list,
+                                         const roaring::Roaring &universe) const
+   {
+      if (_nodes.empty())
+         return universe;
+      return evaluate(_root, posting_list, universe);
+   }
+
+   roaring::Roaring FilterExpr::evaluate(IdxType node_id, const std::function<const roaring::Roaring &(LabelType)> &posting_list,
+                                         const roaring::Roaring &universe) const
+   {
+      const auto &node = _nodes[node_id];
+      switch (node.op)
+      {
+      case Op::ANY:
+         return universe;
+      case Op::LABEL:
+         return posting_list(node.label);
+      case Op::NOT:
+         return universe - evaluate(node.children[0], posting_list, universe);
+      case Op::AND:
+      {
+         // intersect the positive children, smallest posting lists first, then remove the negated ones
+         std::vector<IdxType> positives, negatives;
+         for (auto child : node.children)
+            (_nodes[child].op == Op::NOT ? negatives : positives).push_back(child);
+         std::sort(positives.begin(), positives.end(), [&](IdxType a, IdxType b)
+                   {
+                      auto size = [&](IdxType c)
+                      { return _nodes[c].op == Op::LABEL ? posting_list(_nodes[c].label).cardinality() : UINT64_MAX; };
+                      return size(a) < size(b); });
+         roaring::Roaring result = positives.empty() ? universe : evaluate(positives[0], posting_list, universe);
+         for (size_t i = 1; i < positives.size() && !result.isEmpty(); ++i)
+         {
+            if (_nodes[positives[i]].op == Op::LABEL)
+               result &= posting_list(_nodes[positives[i]].label);
+            else
+               result &= evaluate(positives[i], posting_list, universe);
+         }
+         for (size_t i = 0; i < negatives.size() && !result.isEmpty(); ++i)
+         {
+            auto child = _nodes[negatives[i]].children[0];
+            if (_nodes[child].op == Op::LABEL)
+               result -= posting_list(_nodes[child].label);
+            else
+               result -= evaluate(child, posting_list, universe);
+         }
+         return result;
+      }
+      case Op::OR:
+      {
+         roaring::Roaring result;
+         for (auto child : node.children)
+         {
+            if (_nodes[child].op == Op::LABEL)
+               result |= posting_list(_nodes[child].label);
+            else
+               result |= evaluate(child, posting_list, universe);
+         }
+         return result;
+      }
+      }
+      return roaring::Roaring();
+   }
+
+   std::vector<std::vector<LabelType>> FilterExpr::get_conjunctive_label_sets(size_t max_sets) const
+   {
+      if (_nodes.empty())
+         return {{}};
+      auto label_sets = get_conjunctive_label_sets(_root, std::max<size_t>(max_sets, 1));
+
+      // drop duplicates and the sets containing another one, they add no entry groups
+      std::sort(label_sets.begin(), label_sets.end(), [](const auto &a, const auto &b)
+                { return a.size() < b.size() || (a.size() == b.size() && a < b); });
+      label_sets.erase(std::unique(label_sets.begin(), label_sets.end()), label_sets.end());
+      std::vector<std::vector<LabelType>> minimal_sets;
+      for (const auto &label_set : label_sets)
+         if (std::none_of(minimal_sets.begin(), minimal_sets.end(), [&](const auto &min_set)
+                          { return std::includes(label_set.begin(), label_set.end(), min_set.begin(), min_set.end()); }))
+            minimal_sets.push_back(label_set);
+      return minimal_sets;
+   }
+
+   std::vector<std::vector<LabelType>> FilterExpr::get_conjunctive_label_sets(IdxType node_id, size_t max_sets) const
+   {
+      const auto &node = _nodes[node_id];
+      switch (node.op)
+      {
+      case Op::LABEL:
+         return {{node.label}};
+      case Op::AND:
+      {
+         // cross product of the children, a child is skipped when the product grows too large
+         std::vector<std::vector<LabelType>> label_sets = {{}};
+         for (auto child : node.children)
+         {
+            auto child_sets = get_conjunctive_label_sets(child, max_sets);
+            if (label_sets.size() * child_sets.size() > max_sets)
+               continue;
+            std::vector<std::vector<LabelType>> product;
+            for (const auto &a : label_sets)
+               for (const auto &b : child_sets)
+               {
+                  product.emplace_back();
+                  std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(product.back()));
+               }
+            label_sets = std::move(product);
+         }
+         return label_sets;
+      }
+      case Op::OR:
+      {
+         std::vector<std::vector<LabelType>> label_sets;
+         for (auto child : node.children)
+         {
+            auto child_sets = get_conjunctive_label_sets(child, max_sets);
+            label_sets.insert(label_sets.end(), child_sets.begin(), child_sets.end());
+         }
+         if (label_sets.size() > max_sets)
+            return {{}};
+         return label_sets;
+      }
+      default: // ANY and NOT do not require a label
+         return {{}};
+      }
+   }
+
+   std::string FilterExpr::to_string() const
+   {
+      return _nodes.empty() ? "*" : to_string(_root);
+   }
+
+   std::string FilterExpr::to_string(IdxType node_id) const
+   {
+      const auto &node = _nodes[node_id];
+      switch (node.op)
+      {
+      case Op::ANY:
+         return "*";
+      case Op::LABEL:
+         return std::to_string(node.label);
+      case Op::NOT:
+         return "NOT " + to_string(node.children[0]);
+      default:
+      {
+         std::string text = "(";
+         for (size_t i = 0; i < node.children.size(); ++i)
+         {
+            if (i > 0)
+               text += node.op == Op::AND ? " AND " : " OR ";
+            text += to_string(node.children[i]);
+         }
+         return text + ")";
+      }
+      }
+   }
+
+   std::unordered_map<std::string, LabelType> load_label_names(const std::string &label_csr_file)
+   {
+      std::unordered_map<std::string, LabelType> name_to_label;
+      LabelCSR csr(label_csr_file);
+      const auto &dictionary = csr.dictionary();
+      for (size_t label = 1; label < dictionary.size(); ++label)
+         name_to_label[dictionary[label]] = label;
+      return name_to_label;
+   }
+
+   std::vector<FilterExpr> load_filter_exprs(const std::string &filename,
+                                             const std::unordered_map<std::string, LabelType> &name_to_label)
+   {
+      std::ifstream in(filename);
+      if (!in.is_open())
+         throw std::runtime_error("Failed to open file: " + filename);
+      std::vector<FilterExpr> filters;
+      std::string line;
+      while (std::getline(in, line))
+         filters.push_back(FilterExpr::parse(line, name_to_label));
+      return filters;
+   }
+}
@@ -2,6 +2,7 @@
 #include <queue>
 #include <numeric>
 #include <iostream>
+#include <stdexcept>
 #include "search_queue.h"
 #include "filtered_scan.h"
 
@@ -95,6 +96,37 @@ namespace ANNS
       }
    }
 
+   // for computing groundtruth of boolean filters
+   void FilteredScan::run(std::shared_ptr<IStorage> base_storage, std::shared_ptr<IStorage> query_storage,
+                          std::shared_ptr<DistanceHandler> distance_handler, const std::vector<FilterExpr> &filters,
+                          uint32_t num_threads, IdxType K, std::pair<IdxType, float> *results)
+   {
+      _base_storage = base_storage;
+      _query_storage = query_storage;
+      _distance_handler = distance_handler;
+      _results = results;
+      _K = K;
+      if (filters.size() != _query_storage->get_num_points())
+         throw std::runtime_error("the number of filters does not match the number of queries");
+
+      // init trie index only for base label sets
+      std::cout << "- Scenario: expression" << std::endl;
+      init_trie_index(false);
+
+      // a base group is scanned if its label set satisfies the filter
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (auto query_vec_id = 0; query_vec_id < _query_storage->get_num_points(); ++query_vec_id)
+      {
+         std::vector<IdxType> target_group_ids;
+         for (auto group_id = 1; group_id < base_group_id_to_vec_ids.size(); ++group_id)
+            if (!base_group_id_to_vec_ids[group_id].empty() &&
+                filters[query_vec_id].matches(_base_storage->get_label_span(base_group_id_to_vec_ids[group_id][0])))
+               target_group_ids.emplace_back(group_id);
+         answer_one_query(query_vec_id, target_group_ids);
+      }
+   }
+
    // initialize trie index for base and query label sets
    void FilteredScan::init_trie_index(bool for_query)
    {
@@ -103,7 +135,7 @@ namespace ANNS
       IdxType new_group_id = 1;
       for (auto vec_id = 0; vec_id < _base_storage->get_num_points(); ++vec_id)
       {
-         auto group_id = base_trie_index.insert(_base_storage->get_label_set(vec_id), new_group_id);
+         auto group_id = base_trie_index.insert(_base_storage->get_label_span(vec_id), new_group_id);
          if (group_id + 1 > base_group_id_to_vec_ids.size())
             base_group_id_to_vec_ids.resize(group_id + 1);
          base_group_id_to_vec_ids[group_id].emplace_back(vec_id);
@@ -163,6 +195,7 @@ namespace ANNS
       float num_cmps = 0;
 
       // iterate each base vector in each target group
+      const auto *ranges = _query_ranges ? &(*_query_ranges)[query_vec_id] : nullptr;
       for (const auto &base_group_id : target_group_ids)
       {
          for (IdxType i = 0; i < base_group_id_to_vec_ids[base_group_id].size(); ++i)
@@ -170,6 +203,8 @@ namespace ANNS
             if (i + 1 < base_group_id_to_vec_ids[base_group_id].size())
                _base_storage->prefetch_vec_by_id(base_group_id_to_vec_ids[base_group_id][i + 1]);
             const auto &base_vec_id = base_group_id_to_vec_ids[base_group_id][i];
+            if (ranges && !in_ranges(_base_storage->get_numeric_attrs(base_vec_id), *ranges))
+               continue;
             float distance = _distance_handler->compute(_query_storage->get_vector(query_vec_id),
                                                         _base_storage->get_vector(base_vec_id), dim);
             search_queue.insert(base_vec_id, distance);
@@ -0,0 +1,288 @@
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "graph_reorder.h"
+
+namespace ANNS
+{
+
+   ReorderMethod parse_reorder_method(const std::string &name)
+   {
+      if (name == "none")
+         return ReorderMethod::NONE;
+      if (name == "bfs")
+         return ReorderMethod::BFS;
+      if (name == "rcm")
+         return ReorderMethod::RCM;
+      if (name == "gorder")
+         return ReorderMethod::GORDER;
+      throw std::runtime_error("Invalid reorder method " + name + ", use none, bfs, rcm or gorder");
+   }
+
+   // edges inside the range as CSR over local ids (id - first), both directions
+   struct LocalAdjacency
+   {
+      std::vector<size_t> out_offsets, in_offsets;
+      std::vector<IdxType> out_ids, in_ids;
+
+      template <typename Visit>
+      void for_each_out(IdxType u, Visit visit) const
+      {
+         for (auto i = out_offsets[u]; i < out_offsets[u + 1]; ++i)
+            visit(out_ids[i]);
+      }
+      template <typename Visit>
+      void for_each_in(IdxType u, Visit visit) const
+      {
+         for (auto i = in_offsets[u]; i < in_offsets[u + 1]; ++i)
+            visit(in_ids[i]);
+      }
+      IdxType degree(IdxType u) const
+      {
+         return out_offsets[u + 1] - out_offsets[u] + in_offsets[u + 1] - in_offsets[u];
+      }
+   };
+
+   static LocalAdjacency get_local_adjacency(const Graph &graph, IdxType first, IdxType last)
+   {
+      IdxType num_points = last - first;
+      LocalAdjacency adj;
+      adj.out_offsets.assign(num_points + 1, 0);
+      adj.in_offsets.assign(num_points + 1, 0);
+      auto is_local = [&](IdxType u, IdxType neighbor)
+      { return neighbor >= first && neighbor < last && neighbor != first + u; };
+      for (IdxType u = 0; u < num_points; ++u)
+         for (auto neighbor : graph.get_neighbors(first + u))
+            if (is_local(u, neighbor))
+            {
+               adj.out_offsets[u + 1]++;
+               adj.in_offsets[neighbor - first + 1]++;
+            }
+      for (IdxType u = 0; u < num_points; ++u)
+      {
+         adj.out_offsets[u + 1] += adj.out_offsets[u];
+         adj.in_offsets[u + 1] += adj.in_offsets[u];
+      }
+      adj.out_ids.resize(adj.out_offsets[num_points]);
+      adj.in_ids.resize(adj.in_offsets[num_points]);
+      std::vector<size_t> in_pos(adj.in_offsets.begin(), adj.in_offsets.end() - 1);
+      size_t out_pos = 0;
+      for (IdxType u = 0; u < num_points; ++u)
+         for (auto neighbor : graph.get_neighbors(first + u))
+            if (is_local(u, neighbor))
+            {
+               adj.out_ids[out_pos++] = neighbor - first;
+               adj.in_ids[in_pos[neighbor - first]++] = u;
+            }
+      return adj;
+   }
+
+   // max-priority queue of points whose keys change by one (the unit heap of Gorder), points of equal key are
+   // bucketed in doubly linked lists
+   class UnitHeap
+   {
+   public:
+      UnitHeap(IdxType num_points)
+          : _key(num_points, 0), _prev(num_points), _next(num_points), _removed(num_points, false), _head(1, NONE)
+      {
+         // the lowest id is popped first among keys 0
+         for (IdxType u = num_points; u-- > 0;)
+            link(u);
+      }
+
+      void increment(IdxType u)
+      {
+         if (_removed[u])
+            return;
+         unlink(u);
+         if (++_key[u] >= _head.size())
+            _head.push_back(NONE);
+         _top = std::max(_top, _key[u]);
+         link(u);
+      }
+
+      void decrement(IdxType u)
+      {
+         if (_removed[u])
+            return;
+         unlink(u);
+         --_key[u];
+         link(u);
+      }
+
+      void remove(IdxType u)
+      {
+         unlink(u);
+         _removed[u] = true;
+      }
+
+      // the heap must not be empty
+      IdxType pop()
+      {
+         while (_top > 0 && _head[_top] == NONE)
+            --_top;
+         IdxType u = _head[_top];
+         remove(u);
+         return u;
+      }
+
+   private:
+      static constexpr IdxType NONE = std::numeric_limits<IdxType>::max();
+      std::vector<IdxType> _key, _prev, _next;
+      std::vector<bool> _removed;
+      std::vector<IdxType> _head;
+      IdxType _top = 0;
+
+      void link(IdxType u)
+      {
+         auto &head = _head[_key[u]];
+         _prev[u] = NONE;
+         _next[u] = head;
+         if (head != NONE)
+            _prev[head] = u;
+         head = u;
+      }
+
+      void unlink(IdxType u)
+      {
+         if (_prev[u] != NONE)
+            _next[_prev[u]] = _next[u];
+         else
+            _head[_key[u]] = _next[u];
+         if (_next[u] != NONE)
+            _prev[_next[u]] = _prev[u];
+      }
+   };
+
+   static std::vector<IdxType> bfs_order(const LocalAdjacency &adj, IdxType num_points, IdxType start)
+   {
+      std::vector<IdxType> order;
+      order.reserve(num_points);
+      std::vector<bool> placed(num_points, false);
+      auto bfs_from = [&](IdxType root)
+      {
+         placed[root] = true;
+         order.push_back(root);
+         auto visit = [&](IdxType v)
+         {
+            if (!placed[v])
+            {
+               placed[v] = true;
+               order.push_back(v);
+            }
+         };
+         for (size_t head = order.size() - 1; head < order.size(); ++head)
+         {
+            adj.for_each_out(order[head], visit);
+            adj.for_each_in(order[head], visit);
+         }
+      };
+      bfs_from(start);
+      for (IdxType u = 0; u < num_points; ++u)
+         if (!placed[u])
+            bfs_from(u);
+      return order;
+   }
+
+   static std::vector<IdxType> rcm_order(const LocalAdjacency &adj, IdxType num_points)
+   {
+      std::vector<IdxType> by_degree(num_points);
+      for (IdxType u = 0; u < num_points; ++u)
+         by_degree[u] = u;
+      std::stable_sort(by_degree.begin(), by_degree.end(), [&](IdxType a, IdxType b)
+                       { return adj.degree(a) < adj.degree(b); });
+
+      std::vector<IdxType> order, neighbors;
+      order.reserve(num_points);
+      std::vector<bool> placed(num_points, false);
+      for (auto root : by_degree)
+      {
+         if (placed[root])
+            continue;
+         placed[root] = true;
+         order.push_back(root);
+         for (size_t head = order.size() - 1; head < order.size(); ++head)
+         {
+            neighbors.clear();
+            auto collect = [&](IdxType v)
+            {
+               if (!placed[v])
+               {
+                  placed[v] = true;
+                  neighbors.push_back(v);
+               }
+            };
+            adj.for_each_out(order[head], collect);
+            adj.for_each_in(order[head], collect);
+            std::stable_sort(neighbors.begin(), neighbors.end(), [&](IdxType a, IdxType b)
+                             { return adj.degree(a) < adj.degree(b); });
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+         }
+      }
+      std::reverse(order.begin(), order.end());
+      return order;
+   }
+
+   static std::vector<IdxType> gorder_order(const LocalAdjacency &adj, IdxType num_points, IdxType start, IdxType window)
+   {
+      // score of a candidate: edges to the window points plus in-neighbors shared with them
+      UnitHeap heap(num_points);
+      auto update = [&](IdxType u, bool enter)
+      {
+         auto change = [&](IdxType v)
+         {
+            if (v == u)
+               return;
+            if (enter)
+               heap.increment(v);
+            else
+               heap.decrement(v);
+         };
+         adj.for_each_out(u, change);
+         adj.for_each_in(u, change);
+         adj.for_each_in(u, [&](IdxType w)
+                         { adj.for_each_out(w, change); });
+      };
+
+      std::vector<IdxType> order;
+      order.reserve(num_points);
+      heap.remove(start);
+      order.push_back(start);
+      update(start, true);
+      while (order.size() < num_points)
+      {
+         IdxType u = heap.pop();
+         order.push_back(u);
+         update(u, true);
+         if (order.size() > window)
+            update(order[order.size() - 1 - window], false);
+      }
+      return order;
+   }
+
+   std::vector<IdxType> locality_order(const Graph &graph, IdxType first, IdxType last, IdxType start,
+                                       ReorderMethod method, IdxType window)
+   {
+      IdxType num_points = last - first;
+      std::vector<IdxType> order;
+      if (method == ReorderMethod::NONE || num_points <= 2)
+      {
+         order.resize(num_points);
+         for (IdxType u = 0; u < num_points; ++u)
+            order[u] = first + u;
+         return order;
+      }
+
+      auto adj = get_local_adjacency(graph, first, last);
+      IdxType local_start = start >= first && start < last ? start - first : 0;
+      if (method == ReorderMethod::BFS)
+         order = bfs_order(adj, num_points, local_start);
+      else if (method == ReorderMethod::RCM)
+         order = rcm_order(adj, num_points);
+      else
+         order = gorder_order(adj, num_points, local_start, std::max<IdxType>(window, 1));
+      for (auto &u : order)
+         u += first;
+      return order;
+   }
+}
@@ -0,0 +1,131 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/mman.h>
+#include "huge_pages.h"
+
+namespace ANNS
+{
+
+   // the header in front of each block tells huge_free how it was allocated
+   enum BlockKind : uint32_t
+   {
+      HEAP_BLOCK,
+      THP_BLOCK,
+      HUGETLB_BLOCK,
+      SMALL_PAGE_BLOCK
+   };
+   struct BlockHeader
+   {
+      size_t mapped_bytes; // bytes of the mapping or the heap block, header included
+      BlockKind kind;
+   };
+   static const size_t HEADER_SIZE = 64; // keeps the returned pointers 64-byte aligned
+
+   static std::atomic<HugePagePolicy> g_policy(HugePagePolicy::NONE);
+   static std::atomic<size_t> g_bytes[4];
+
+   HugePagePolicy parse_huge_page_policy(const std::string &name)
+   {
+      if (name == "none")
+         return HugePagePolicy::NONE;
+      if (name == "thp")
+         return HugePagePolicy::TRANSPARENT;
+      if (name == "hugetlb")
+         return HugePagePolicy::EXPLICIT;
+      throw std::runtime_error("Invalid huge page policy " + name + ", use none, thp or hugetlb");
+   }
+
+   void set_huge_page_policy(HugePagePolicy policy)
+   {
+      g_policy = policy;
+   }
+
+   HugePagePolicy get_huge_page_policy()
+   {
+      return g_policy;
+   }
+
+   // anonymous mapping of bytes starting at a huge page boundary, nullptr on failure
+   static char *map_aligned(size_t bytes)
+   {
+      // over-map by one huge page and trim both ends, so that the kernel can back it with whole huge pages
+      size_t total = bytes + HUGE_PAGE_SIZE;
+      void *ptr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ptr == MAP_FAILED)
+         return nullptr;
+      auto start = reinterpret_cast<uintptr_t>(ptr);
+      auto aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+      if (aligned > start)
+         munmap(ptr, aligned - start);
+      if (start + total > aligned + bytes)
+         munmap(reinterpret_cast<void *>(aligned + bytes), start + total - aligned - bytes);
+      return reinterpret_cast<char *>(aligned);
+   }
+
+   void *huge_alloc(size_t bytes)
+   {
+      auto policy = get_huge_page_policy();
+      size_t total = bytes + HEADER_SIZE;
+      char *base = nullptr;
+      BlockHeader header;
+
+      if (policy == HugePagePolicy::NONE || total < HUGE_PAGE_SIZE)
+      {
+         header = {(total + 63) / 64 * 64, HEAP_BLOCK};
+         base = static_cast<char *>(std::aligned_alloc(64, header.mapped_bytes));
+      }
+      else
+      {
+         header = {(total + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE, HUGETLB_BLOCK};
+
+         // 1. reserved huge pages, the mapping fails at once if the pool is too small
+         if (policy == HugePagePolicy::EXPLICIT)
+         {
+            void *ptr = mmap(nullptr, header.mapped_bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED)
+               base = static_cast<char *>(ptr);
+         }
+
+         // 2. transparent huge pages, the pages are still placed at first touch (NUMA policies keep working)
+         if (base == nullptr)
+         {
+            base = map_aligned(header.mapped_bytes);
+            header.kind = THP_BLOCK;
+            if (base != nullptr && madvise(base, header.mapped_bytes, MADV_HUGEPAGE) != 0)
+               header.kind = SMALL_PAGE_BLOCK;
+         }
+      }
+      if (base == nullptr)
+         throw std::bad_alloc();
+
+      *reinterpret_cast<BlockHeader *>(base) = header;
+      g_bytes[header.kind] += header.mapped_bytes;
+      return base + HEADER_SIZE;
+   }
+
+   void huge_free(void *ptr)
+   {
+      if (ptr == nullptr)
+         return;
+      char *base = static_cast<char *>(ptr) - HEADER_SIZE;
+      auto header = *reinterpret_cast<BlockHeader *>(base);
+      g_bytes[header.kind] -= header.mapped_bytes;
+      if (header.kind == HEAP_BLOCK)
+         std::free(base);
+      else
+         munmap(base, header.mapped_bytes);
+   }
+
+   HugePageStats get_huge_page_stats()
+   {
+      HugePageStats stats;
+      stats.heap_bytes = g_bytes[HEAP_BLOCK];
+      stats.thp_bytes = g_bytes[THP_BLOCK];
+      stats.hugetlb_bytes = g_bytes[HUGETLB_BLOCK];
+      stats.small_page_bytes = g_bytes[SMALL_PAGE_BLOCK];
+      return stats;
+   }
+}
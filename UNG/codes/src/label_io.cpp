@@ -0,0 +1,307 @@
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cctype>
+#include <limits>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <unordered_map>
+#include <charconv>
+#include <algorithm>
+#include <stdexcept>
+#include "utils.h"
+#include "label_io.h"
+
+namespace ANNS
+{
+
+   // parse one line "l1,l2,..." into a sorted label set, an empty line is an empty set; false if a label is not a
+   // decimal number in range or the separators are not single commas (one trailing comma, as written by
+   // UniNavGraph::query_generate, trailing spaces and '\r' are ignored)
+   static bool parse_label_line(const char *begin, const char *end, std::vector<LabelType> &label_set,
+                                std::vector<IdxType> &label_cnts)
+   {
+      while (end > begin && std::isspace(static_cast<unsigned char>(end[-1])))
+         --end;
+      const char *p = begin;
+      while (p < end)
+      {
+         uint32_t label = 0;
+         auto res = std::from_chars(p, end, label);
+         if (res.ec != std::errc() || label >= label_cnts.size())
+            return false;
+         label_set.emplace_back(label);
+         label_cnts[label]++;
+         p = res.ptr;
+         if (p < end && *p++ != ',')
+            return false;
+      }
+      std::sort(label_set.begin(), label_set.end());
+      label_set.shrink_to_fit();
+      return true;
+   }
+
+   void load_label_txt(const std::string &filename, std::vector<LabelType> *label_sets, size_t first_point,
+                       IdxType num_points, std::vector<IdxType> &label_cnts)
+   {
+      // the file is parsed in place from a read-only mapping
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+         throw std::runtime_error("Failed to open file: " + filename);
+      struct stat st;
+      fstat(fd, &st);
+      size_t num_bytes = st.st_size;
+      const char *data = nullptr;
+      if (num_bytes > 0)
+      {
+         void *addr = mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (addr == MAP_FAILED)
+         {
+            close(fd);
+            throw std::runtime_error("Failed to mmap file: " + filename);
+         }
+         madvise(addr, num_bytes, MADV_SEQUENTIAL);
+         data = static_cast<const char *>(addr);
+      }
+      close(fd);
+
+      // split into newline-aligned chunks
+      uint32_t num_threads = omp_get_max_threads();
+      size_t num_chunks = std::max<size_t>(1, std::min<size_t>(num_threads * 4, num_bytes >> 20));
+      std::vector<size_t> chunk_starts(num_chunks + 1, num_bytes);
+      chunk_starts[0] = 0;
+      for (size_t c = 1; c < num_chunks; ++c)
+      {
+         size_t pos = std::max(chunk_starts[c - 1], c * (num_bytes / num_chunks));
+         while (pos < num_bytes && pos > 0 && data[pos - 1] != '\n')
+            ++pos;
+         chunk_starts[c] = pos;
+      }
+
+      // line id of the first line of each chunk
+      std::vector<size_t> chunk_lines(num_chunks + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (size_t c = 0; c < num_chunks; ++c)
+         chunk_lines[c + 1] = std::count(data + chunk_starts[c], data + chunk_starts[c + 1], '\n');
+      for (size_t c = 0; c < num_chunks; ++c)
+         chunk_lines[c + 1] += chunk_lines[c];
+
+      // parse, each thread counts labels locally
+      const size_t max_num_labels = size_t(std::numeric_limits<LabelType>::max()) + 1;
+      std::vector<std::vector<IdxType>> thread_cnts(num_threads);
+      size_t bad_line = std::numeric_limits<size_t>::max();
+#pragma omp parallel for schedule(dynamic, 1)
+      for (size_t c = 0; c < num_chunks; ++c)
+      {
+         auto &cnts = thread_cnts[omp_get_thread_num()];
+         if (cnts.empty())
+            cnts.resize(max_num_labels, 0);
+         const char *p = data + chunk_starts[c];
+         const char *chunk_end = data + chunk_starts[c + 1];
+         size_t end_line = first_point + num_points;
+         for (size_t line_id = chunk_lines[c]; p < chunk_end && line_id < end_line; ++line_id)
+         {
+            const char *line_end = static_cast<const char *>(std::memchr(p, '\n', chunk_end - p));
+            if (line_end == nullptr)
+               line_end = chunk_end;
+            if (line_id < first_point)
+            {
+               p = line_end + 1;
+               continue;
+            }
+            if (!parse_label_line(p, line_end, label_sets[line_id - first_point], cnts))
+            {
+#pragma omp critical
+               bad_line = std::min(bad_line, line_id);
+            }
+            p = line_end + 1;
+         }
+      }
+      if (num_bytes > 0)
+         munmap(const_cast<char *>(data), num_bytes);
+      if (bad_line != std::numeric_limits<size_t>::max())
+         throw std::runtime_error("Invalid label on line " + std::to_string(bad_line + 1) + " of file: " + filename);
+
+      label_cnts.assign(max_num_labels, 0);
+      for (auto &cnts : thread_cnts)
+         for (size_t l = 0; l < cnts.size(); ++l)
+            label_cnts[l] += cnts[l];
+   }
+
+   void load_label_csr(const std::string &filename, std::vector<LabelType> *label_sets, size_t first_point,
+                       IdxType num_points, std::vector<IdxType> &label_cnts)
+   {
+      static_assert(sizeof(LabelType) == sizeof(uint16_t), "CSR label files store uint16 labels");
+      LabelCSR csr(filename);
+      csr.advise_sequential();
+      uint64_t begin_row = std::min<uint64_t>(csr.num_points(), first_point);
+      uint64_t num_rows = std::min<uint64_t>(csr.num_points() - begin_row, num_points);
+
+      uint32_t num_threads = omp_get_max_threads();
+      const size_t max_num_labels = size_t(std::numeric_limits<LabelType>::max()) + 1;
+      std::vector<std::vector<IdxType>> thread_cnts(num_threads);
+#pragma omp parallel for schedule(dynamic, 4096)
+      for (uint64_t i = 0; i < num_rows; ++i)
+      {
+         auto &cnts = thread_cnts[omp_get_thread_num()];
+         if (cnts.empty())
+            cnts.resize(max_num_labels, 0);
+         label_sets[i].assign(csr.begin(begin_row + i), csr.end(begin_row + i));
+         for (auto label : label_sets[i])
+            cnts[label]++;
+      }
+
+      label_cnts.assign(max_num_labels, 0);
+      for (auto &cnts : thread_cnts)
+         for (size_t l = 0; l < cnts.size(); ++l)
+            label_cnts[l] += cnts[l];
+   }
+
+   std::shared_ptr<LabelCSR> open_label_csr(const std::string &filename, size_t first_point, IdxType num_points,
+                                            std::vector<IdxType> &label_cnts)
+   {
+      static_assert(sizeof(LabelType) == sizeof(uint16_t), "CSR label files store uint16 labels");
+      auto csr = std::make_shared<LabelCSR>(filename);
+      if (csr->num_points() < first_point + num_points)
+         return nullptr;
+
+      // count the labels of the rows, which also faults in their pages
+      uint32_t num_threads = omp_get_max_threads();
+      const size_t max_num_labels = size_t(std::numeric_limits<LabelType>::max()) + 1;
+      std::vector<std::vector<IdxType>> thread_cnts(num_threads);
+      const uint16_t *labels = csr->labels();
+      uint64_t begin = csr->offsets()[first_point], end = csr->offsets()[first_point + num_points];
+#pragma omp parallel for schedule(static, 1 << 16)
+      for (uint64_t i = begin; i < end; ++i)
+      {
+         auto &cnts = thread_cnts[omp_get_thread_num()];
+         if (cnts.empty())
+            cnts.resize(max_num_labels, 0);
+         cnts[labels[i]]++;
+      }
+
+      label_cnts.assign(max_num_labels, 0);
+      for (auto &cnts : thread_cnts)
+         for (size_t l = 0; l < cnts.size(); ++l)
+            label_cnts[l] += cnts[l];
+      return csr;
+   }
+
+   void write_label_csr(const std::string &filename, const std::vector<LabelType> *label_sets, IdxType num_points,
+                        const std::vector<std::string> &dictionary)
+   {
+      std::ofstream out(filename, std::ios::binary);
+      if (!out.is_open())
+         throw std::runtime_error("Failed to open file: " + filename);
+
+      std::vector<uint64_t> offsets(num_points + 1, 0);
+      for (IdxType i = 0; i < num_points; ++i)
+         offsets[i + 1] = offsets[i] + label_sets[i].size();
+
+      uint32_t header[2] = {LABEL_CSR_MAGIC, LABEL_CSR_VERSION};
+      uint64_t sizes[2] = {num_points, offsets[num_points]};
+      out.write((char *)header, sizeof(header));
+      out.write((char *)sizes, sizeof(sizes));
+      out.write((char *)offsets.data(), offsets.size() * sizeof(uint64_t));
+      for (IdxType i = 0; i < num_points; ++i)
+      {
+         std::vector<LabelType> sorted_labels(label_sets[i]);
+         std::sort(sorted_labels.begin(), sorted_labels.end());
+         out.write((char *)sorted_labels.data(), sorted_labels.size() * sizeof(LabelType));
+      }
+
+      // label dictionary
+      uint64_t dict_size = dictionary.size();
+      out.write((char *)&dict_size, sizeof(uint64_t));
+      for (const auto &name : dictionary)
+      {
+         uint32_t len = name.size();
+         out.write((char *)&len, sizeof(uint32_t));
+         out.write(name.data(), len);
+      }
+      out.close();
+   }
+
+   void convert_label_txt_to_csr(const std::string &txt_file, const std::string &csr_file, bool remap,
+                                 const std::string &dict_file)
+   {
+      std::vector<std::vector<LabelType>> label_sets;
+      std::vector<std::string> dictionary;
+      if (!remap)
+      {
+         // count the lines, then use the parallel parser
+         std::ifstream in(txt_file);
+         if (!in.is_open())
+            throw std::runtime_error("Failed to open file: " + txt_file);
+         IdxType num_lines = std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n');
+         auto sets = new std::vector<LabelType>[num_lines + 1];
+         std::vector<IdxType> label_cnts;
+         load_label_txt(txt_file, sets, 0, num_lines + 1, label_cnts);
+         bool last_line = !sets[num_lines].empty();
+         label_sets.assign(std::make_move_iterator(sets), std::make_move_iterator(sets + num_lines + last_line));
+         delete[] sets;
+      }
+      else
+      {
+         std::unordered_map<std::string, LabelType> name_to_label;
+         if (!dict_file.empty())
+            dictionary = LabelCSR(dict_file).dictionary();
+         if (dictionary.empty())
+            dictionary.emplace_back("");
+         for (size_t l = 1; l < dictionary.size(); ++l)
+            name_to_label[dictionary[l]] = l;
+
+         std::ifstream in(txt_file);
+         if (!in.is_open())
+            throw std::runtime_error("Failed to open file: " + txt_file);
+         std::string line, name;
+         while (std::getline(in, line))
+         {
+            std::vector<LabelType> label_set;
+            std::stringstream ss(line);
+            while (std::getline(ss, name, ','))
+            {
+               name.erase(std::remove_if(name.begin(), name.end(), ::isspace), name.end());
+               if (name.empty())
+                  continue;
+               auto iter = name_to_label.find(name);
+               if (iter == name_to_label.end())
+               {
+                  if (dictionary.size() > std::numeric_limits<LabelType>::max())
+                     throw std::runtime_error("Too many labels in " + txt_file);
+                  iter = name_to_label.emplace(name, dictionary.size()).first;
+                  dictionary.emplace_back(name);
+               }
+               label_set.emplace_back(iter->second);
+            }
+            label_sets.emplace_back(std::move(label_set));
+         }
+      }
+      write_label_csr(csr_file, label_sets.data(), label_sets.size(), dictionary);
+   }
+
+   void convert_label_csr_to_txt(const std::string &csr_file, const std::string &txt_file, bool with_names)
+   {
+      LabelCSR csr(csr_file);
+      const auto &dictionary = csr.dictionary();
+      std::ofstream out(txt_file);
+      for (uint64_t i = 0; i < csr.num_points(); ++i)
+      {
+         for (auto p = csr.begin(i); p != csr.end(i); ++p)
+         {
+            if (p != csr.begin(i))
+               out << ",";
+            if (with_names && *p < dictionary.size())
+               out << dictionary[*p];
+            else
+               out << *p;
+         }
+         out << std::endl;
+      }
+      out.close();
+   }
+}
@@ -0,0 +1,157 @@
+#include <omp.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <boost/filesystem.hpp>
+#include "numa_placement.h"
+
+namespace fs = boost::filesystem;
+
+namespace ANNS
+{
+
+   // modes of set_mempolicy(2), linux/mempolicy.h
+   static const int MEMPOLICY_DEFAULT = 0;
+   static const int MEMPOLICY_BIND = 2;
+   static const int MEMPOLICY_INTERLEAVE = 3;
+
+   NumaPolicy parse_numa_policy(const std::string &name)
+   {
+      if (name == "none")
+         return NumaPolicy::NONE;
+      if (name == "interleave")
+         return NumaPolicy::INTERLEAVE;
+      if (name == "replicate")
+         return NumaPolicy::REPLICATE;
+      throw std::runtime_error("Invalid NUMA policy " + name + ", use none, interleave or replicate");
+   }
+
+   // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+   static std::vector<int> parse_cpu_list(const std::string &text)
+   {
+      std::vector<int> cpus;
+      std::stringstream in(text);
+      std::string range;
+      while (std::getline(in, range, ','))
+      {
+         if (range.find_first_of("0123456789") == std::string::npos)
+            continue;
+         auto dash = range.find('-');
+         int first = std::stoi(range.substr(0, dash));
+         int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+         for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+      }
+      return cpus;
+   }
+
+   NumaTopology::NumaTopology()
+   {
+      // nodes with cpus, in the order of their ids
+      std::vector<std::pair<int, std::vector<int>>> nodes;
+      boost::system::error_code ec;
+      for (fs::directory_iterator it("/sys/devices/system/node", ec), end; !ec && it != end; it.increment(ec))
+      {
+         auto name = it->path().filename().string();
+         if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+             !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+            continue;
+         std::ifstream in(it->path().string() + "/cpulist");
+         std::string text;
+         std::getline(in, text);
+         auto cpus = parse_cpu_list(text);
+         if (!cpus.empty())
+            nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+      }
+      std::sort(nodes.begin(), nodes.end());
+
+      // without the sysfs nodes, all cpus form node 0
+      if (nodes.empty())
+      {
+         std::vector<int> cpus(std::max<long>(1, sysconf(_SC_NPROCESSORS_CONF)));
+         for (size_t cpu = 0; cpu < cpus.size(); ++cpu)
+            cpus[cpu] = cpu;
+         nodes.emplace_back(0, std::move(cpus));
+      }
+      for (uint32_t node = 0; node < nodes.size(); ++node)
+      {
+         _node_ids.push_back(nodes[node].first);
+         _node_cpus.push_back(nodes[node].second);
+         for (auto cpu : nodes[node].second)
+         {
+            if (cpu >= (int)_cpu_to_node.size())
+               _cpu_to_node.resize(cpu + 1, 0);
+            _cpu_to_node[cpu] = node;
+         }
+      }
+   }
+
+   const NumaTopology &NumaTopology::get()
+   {
+      static const NumaTopology topology;
+      return topology;
+   }
+
+   uint32_t NumaTopology::node_of_cpu(int cpu) const
+   {
+      return cpu >= 0 && cpu < (int)_cpu_to_node.size() ? _cpu_to_node[cpu] : 0;
+   }
+
+   uint32_t NumaTopology::current_node() const
+   {
+      return num_nodes() == 1 ? 0 : node_of_cpu(sched_getcpu());
+   }
+
+   bool set_thread_memory_policy(NumaPolicy policy, uint32_t node)
+   {
+      const auto &topology = NumaTopology::get();
+      const size_t bits_per_word = 8 * sizeof(unsigned long);
+      int max_node_id = topology.node_id(topology.num_nodes() - 1);
+      std::vector<unsigned long> mask(max_node_id / bits_per_word + 1, 0);
+      auto add_node = [&](uint32_t n)
+      {
+         int id = topology.node_id(n);
+         mask[id / bits_per_word] |= 1UL << (id % bits_per_word);
+      };
+
+      int mode = MEMPOLICY_DEFAULT;
+      if (policy == NumaPolicy::REPLICATE)
+      {
+         mode = MEMPOLICY_BIND;
+         add_node(node);
+      }
+      else if (policy == NumaPolicy::INTERLEAVE)
+      {
+         mode = MEMPOLICY_INTERLEAVE;
+         for (uint32_t n = 0; n < topology.num_nodes(); ++n)
+            add_node(n);
+      }
+
+      // maxnode is one more than the bits of the mask
+      if (mode == MEMPOLICY_DEFAULT)
+         return syscall(SYS_set_mempolicy, mode, nullptr, 0) == 0;
+      return syscall(SYS_set_mempolicy, mode, mask.data(), mask.size() * bits_per_word + 1) == 0;
+   }
+
+   bool pin_thread_to_node(uint32_t node)
+   {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (auto cpu : NumaTopology::get().node_cpus(node))
+         if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpu_set);
+      return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+   }
+
+   void pin_omp_threads(uint32_t num_threads)
+   {
+      uint32_t num_nodes = NumaTopology::get().num_nodes();
+      omp_set_num_threads(num_threads);
+#pragma omp parallel
+      pin_thread_to_node(omp_get_thread_num() % num_nodes);
+   }
+}
@@ -0,0 +1,101 @@
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include "numeric_index.h"
+
+namespace ANNS
+{
+
+   void NumericRangeIndex::build(std::shared_ptr<IStorage> storage, IdxType column, IdxType num_buckets)
+   {
+      if (column >= storage->get_num_numeric_attrs())
+         throw std::runtime_error("Numeric attribute column " + std::to_string(column) + " out of range");
+      // NaN is in no range (see in_ranges) and has no order, such points are left out of the index
+      _sorted.clear();
+      _sorted.reserve(storage->get_num_points());
+      for (IdxType id = 0; id < storage->get_num_points(); ++id)
+      {
+         float value = storage->get_numeric_attrs(id)[column];
+         if (!is_nan_value(value))
+            _sorted.emplace_back(value, id);
+      }
+      std::sort(_sorted.begin(), _sorted.end());
+      IdxType num_points = _sorted.size();
+
+      // buckets of equal size
+      num_buckets = std::max<IdxType>(1, std::min(num_buckets, num_points));
+      _bucket_offsets.resize(num_buckets + 1);
+      _buckets.assign(num_buckets, roaring::Roaring());
+      for (IdxType b = 0; b <= num_buckets; ++b)
+         _bucket_offsets[b] = (size_t)num_points * b / num_buckets;
+      for (IdxType b = 0; b < num_buckets; ++b)
+      {
+         std::vector<IdxType> ids;
+         ids.reserve(_bucket_offsets[b + 1] - _bucket_offsets[b]);
+         for (size_t i = _bucket_offsets[b]; i < _bucket_offsets[b + 1]; ++i)
+            ids.push_back(_sorted[i].second);
+         std::sort(ids.begin(), ids.end());
+         _buckets[b].addMany(ids.size(), ids.data());
+         _buckets[b].runOptimize();
+      }
+   }
+
+   roaring::Roaring NumericRangeIndex::range(float lo, float hi) const
+   {
+      roaring::Roaring result;
+      if (is_nan_value(lo) || is_nan_value(hi) || lo > hi || _sorted.empty())
+         return result;
+
+      // positions [begin, end) of the sorted values in the range
+      size_t begin = std::lower_bound(_sorted.begin(), _sorted.end(), lo, [](const std::pair<float, IdxType> &a, float v)
+                                      { return a.first < v; }) -
+                     _sorted.begin();
+      size_t end = std::upper_bound(_sorted.begin(), _sorted.end(), hi, [](float v, const std::pair<float, IdxType> &a)
+                                    { return v < a.first; }) -
+                   _sorted.begin();
+      if (begin >= end)
+         return result;
+
+      // buckets entirely inside [begin, end), the rest is added point by point
+      size_t first_bucket = std::lower_bound(_bucket_offsets.begin(), _bucket_offsets.end(), begin) - _bucket_offsets.begin();
+      size_t last_bucket = std::upper_bound(_bucket_offsets.begin(), _bucket_offsets.end(), end) - _bucket_offsets.begin() - 1;
+      if (first_bucket >= last_bucket)
+      {
+         for (size_t i = begin; i < end; ++i)
+            result.add(_sorted[i].second);
+         return result;
+      }
+      std::vector<const roaring::Roaring *> buckets;
+      for (size_t b = first_bucket; b < last_bucket; ++b)
+         buckets.push_back(&_buckets[b]);
+      result = roaring::Roaring::fastunion(buckets.size(), buckets.data());
+      for (size_t i = begin; i < _bucket_offsets[first_bucket]; ++i)
+         result.add(_sorted[i].second);
+      for (size_t i = _bucket_offsets[last_bucket]; i < end; ++i)
+         result.add(_sorted[i].second);
+      return result;
+   }
+
+   std::vector<std::vector<NumericRange>> load_numeric_ranges(const std::string &filename)
+   {
+      std::ifstream in(filename);
+      if (!in.is_open())
+         throw std::runtime_error("Failed to open file: " + filename);
+      std::vector<std::vector<NumericRange>> query_ranges;
+      std::string line;
+      while (std::getline(in, line))
+      {
+         std::istringstream line_in(line);
+         std::vector<std::string> tokens{std::istream_iterator<std::string>(line_in), std::istream_iterator<std::string>()};
+         if (tokens.size() % 3 != 0)
+            throw std::runtime_error("Invalid range line " + std::to_string(query_ranges.size() + 1) + " in " + filename);
+         std::vector<NumericRange> ranges;
+         for (size_t i = 0; i < tokens.size(); i += 3)
+            ranges.push_back({static_cast<IdxType>(std::stoul(tokens[i])), std::stof(tokens[i + 1]), std::stof(tokens[i + 2])});
+         query_ranges.push_back(std::move(ranges));
+      }
+      return query_ranges;
+   }
+}
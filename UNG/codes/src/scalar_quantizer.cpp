@@ -0,0 +1,96 @@
+#include <omp.h>
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include "scalar_quantizer.h"
+
+namespace ANNS
+{
+
+   void ScalarQuantizer::train(std::shared_ptr<IStorage> storage, uint32_t num_threads)
+   {
+      if (storage->get_data_type() != DataType::FLOAT)
+         throw std::runtime_error("ScalarQuantizer: only float vectors are supported");
+      _dim = storage->get_dim();
+      _min.assign(_dim, std::numeric_limits<float>::max());
+      std::vector<float> max(_dim, std::numeric_limits<float>::lowest());
+
+      // per-thread ranges, merged afterwards
+      omp_set_num_threads(num_threads);
+#pragma omp parallel
+      {
+         std::vector<float> local_min(_dim, std::numeric_limits<float>::max());
+         std::vector<float> local_max(_dim, std::numeric_limits<float>::lowest());
+#pragma omp for schedule(static, 4096)
+         for (IdxType id = 0; id < storage->get_num_points(); ++id)
+         {
+            auto vec = reinterpret_cast<const float *>(storage->get_vector(id));
+            for (IdxType d = 0; d < _dim; ++d)
+            {
+               local_min[d] = std::min(local_min[d], vec[d]);
+               local_max[d] = std::max(local_max[d], vec[d]);
+            }
+         }
+#pragma omp critical
+         for (IdxType d = 0; d < _dim; ++d)
+         {
+            _min[d] = std::min(_min[d], local_min[d]);
+            max[d] = std::max(max[d], local_max[d]);
+         }
+      }
+
+      // constant dimensions keep a scale of 1, all their codes are 0
+      _scale.resize(_dim);
+      for (IdxType d = 0; d < _dim; ++d)
+      {
+         if (_min[d] > max[d])
+            _min[d] = max[d] = 0;
+         _scale[d] = max[d] > _min[d] ? (max[d] - _min[d]) / 255 : 1;
+      }
+   }
+
+   void ScalarQuantizer::encode(const float *vec, uint8_t *code) const
+   {
+      for (IdxType d = 0; d < _dim; ++d)
+      {
+         float value = std::round((vec[d] - _min[d]) / _scale[d]);
+         code[d] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value)));
+      }
+   }
+
+   float ScalarQuantizer::compute_l2(const float *query, const uint8_t *code) const
+   {
+      float distance = 0;
+      for (IdxType d = 0; d < _dim; ++d)
+      {
+         float diff = query[d] - (_min[d] + code[d] * _scale[d]);
+         distance += diff * diff;
+      }
+      return distance;
+   }
+
+   void ScalarQuantizer::save(const std::string &filename) const
+   {
+      std::ofstream out(filename, std::ios::binary);
+      if (!out)
+         throw std::runtime_error("Cannot write " + filename);
+      out.write(reinterpret_cast<const char *>(&_dim), sizeof(IdxType));
+      out.write(reinterpret_cast<const char *>(_min.data()), _dim * sizeof(float));
+      out.write(reinterpret_cast<const char *>(_scale.data()), _dim * sizeof(float));
+   }
+
+   void ScalarQuantizer::load(const std::string &filename)
+   {
+      std::ifstream in(filename, std::ios::binary);
+      if (!in.read(reinterpret_cast<char *>(&_dim), sizeof(IdxType)))
+         throw std::runtime_error("Cannot read " + filename);
+      _min.resize(_dim);
+      _scale.resize(_dim);
+      in.read(reinterpret_cast<char *>(_min.data()), _dim * sizeof(float));
+      in.read(reinterpret_cast<char *>(_scale.data()), _dim * sizeof(float));
+      if (!in)
+         throw std::runtime_error("Truncated quantizer file " + filename);
+   }
+}
@@ -0,0 +1,354 @@
+#include <omp.h>
+#include <map>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <thread>
+#include <numeric>
+#include <limits>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <boost/filesystem.hpp>
+#include "utils.h"
+#include "label_io.h"
+#include "vecs_io.h"
+#include "sharded_ung.h"
+
+namespace fs = boost::filesystem;
+
+namespace ANNS
+{
+
+   void ShardedUniNavGraph::build(const std::string &data_type, const std::string &base_bin_file,
+                                  const std::string &base_label_file, const std::string &base_numeric_file,
+                                  std::shared_ptr<DistanceHandler> distance_handler, IdxType num_shards,
+                                  const std::string &partition, std::string scenario, std::string index_name,
+                                  uint32_t num_threads, IdxType num_cross_edges, IdxType max_degree, IdxType Lbuild,
+                                  float alpha)
+   {
+      if (num_shards == 0)
+         throw std::runtime_error("The number of shards must be positive");
+      if (partition != "range" && partition != "group")
+         throw std::runtime_error("Invalid shard partition " + partition + ", use range or group");
+      _data_type = data_type;
+      _partition = partition;
+      auto info = sniff_vecs_file(base_bin_file, data_type == "float" ? sizeof(float) : 1, data_type != "uint8");
+      _num_points = info.num_points;
+
+      // 1. partition the base points into shard storages
+      std::cout << "Partitioning " << _num_points << " points into " << num_shards << " shards by " << partition << " ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      std::vector<std::shared_ptr<IStorage>> shard_storages;
+      if (partition == "range")
+         shard_storages = load_range_shards(data_type, base_bin_file, base_label_file, base_numeric_file, _num_points, num_shards);
+      else
+         shard_storages = load_group_shards(data_type, base_bin_file, base_label_file, base_numeric_file, _num_points, num_shards);
+      std::cout << "- Partition time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+
+      // 2. build the shards concurrently, the threads are split among them
+      start_time = std::chrono::high_resolution_clock::now();
+      _shards.clear();
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+         _shards.push_back(std::make_shared<UniNavGraph>());
+      std::vector<IdxType> shard_ids(num_shards);
+      std::iota(shard_ids.begin(), shard_ids.end(), 0);
+      run_on_shards(shard_ids, num_threads, [&](IdxType shard_id, uint32_t shard_num_threads)
+                    { _shards[shard_id]->build(shard_storages[shard_id], distance_handler, scenario, index_name,
+                                               shard_num_threads, num_cross_edges, max_degree, Lbuild, alpha); });
+      std::cout << "- Shards built in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   }
+
+   // shard s holds points [s * num_points / num_shards, (s + 1) * num_points / num_shards)
+   std::vector<std::shared_ptr<IStorage>> ShardedUniNavGraph::load_range_shards(const std::string &data_type,
+                                                                              const std::string &base_bin_file,
+                                                                              const std::string &base_label_file,
+                                                                              const std::string &base_numeric_file,
+                                                                              size_t num_points, IdxType num_shards)
+   {
+      if ((num_points + num_shards - 1) / num_shards >= std::numeric_limits<IdxType>::max())
+         throw std::runtime_error("Too many points per shard, use more shards");
+      if (num_points < num_shards)
+         throw std::runtime_error("Fewer points than shards");
+      std::vector<std::shared_ptr<IStorage>> shard_storages(num_shards);
+      _shard_offsets.resize(num_shards);
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+      {
+         size_t first_point = num_points * shard_id / num_shards;
+         size_t end_point = num_points * (shard_id + 1) / num_shards;
+         _shard_offsets[shard_id] = first_point;
+         shard_storages[shard_id] = create_storage(data_type, false);
+         shard_storages[shard_id]->load_from_file(base_bin_file, base_label_file, end_point - first_point, first_point);
+         if (!base_numeric_file.empty())
+            shard_storages[shard_id]->load_numeric_attrs(base_numeric_file, first_point);
+      }
+      return shard_storages;
+   }
+
+   // whole groups are assigned to shards, then the points are streamed into the shards chunk by chunk
+   std::vector<std::shared_ptr<IStorage>> ShardedUniNavGraph::load_group_shards(const std::string &data_type,
+                                                                              const std::string &base_bin_file,
+                                                                              const std::string &base_label_file,
+                                                                              const std::string &base_numeric_file,
+                                                                              size_t num_points, IdxType num_shards)
+   {
+      // a text label file is read whole for every chunk, large data should use a CSR label file
+      if (!std::ifstream(base_label_file).good())
+         throw std::runtime_error("The group partition needs the base label file");
+      const size_t chunk_size = 1 << 22;
+      bool is_csr = is_label_csr_file(base_label_file);
+
+      // 1. size of each group (label set), the labels are scanned in chunks
+      std::map<std::vector<LabelType>, GlobalIdxType> group_sizes;
+      {
+         std::vector<std::vector<LabelType>> label_sets(std::min(chunk_size, num_points));
+         std::vector<IdxType> label_cnts;
+         for (size_t first_point = 0; first_point < num_points; first_point += chunk_size)
+         {
+            IdxType num_chunk_points = std::min(chunk_size, num_points - first_point);
+            if (is_csr)
+               load_label_csr(base_label_file, label_sets.data(), first_point, num_chunk_points, label_cnts);
+            else
+               load_label_txt(base_label_file, label_sets.data(), first_point, num_chunk_points, label_cnts);
+            for (IdxType i = 0; i < num_chunk_points; ++i)
+            {
+               std::sort(label_sets[i].begin(), label_sets[i].end());
+               group_sizes[label_sets[i]]++;
+            }
+         }
+      }
+
+      // 2. the largest groups first, each to the shard with the fewest points
+      std::vector<std::pair<GlobalIdxType, const std::vector<LabelType> *>> groups;
+      for (const auto &group : group_sizes)
+         groups.emplace_back(group.second, &group.first);
+      std::sort(groups.begin(), groups.end(), [](const auto &a, const auto &b)
+                { return a.first > b.first; });
+      std::priority_queue<std::pair<GlobalIdxType, IdxType>, std::vector<std::pair<GlobalIdxType, IdxType>>,
+                          std::greater<std::pair<GlobalIdxType, IdxType>>>
+          shard_sizes;
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+         shard_sizes.emplace(0, shard_id);
+      std::map<std::vector<LabelType>, IdxType> group_to_shard;
+      std::vector<GlobalIdxType> shard_num_points(num_shards, 0);
+      for (const auto &group : groups)
+      {
+         auto smallest = shard_sizes.top();
+         shard_sizes.pop();
+         if (smallest.first + group.first >= std::numeric_limits<IdxType>::max())
+            throw std::runtime_error("Too many points per shard, use more shards");
+         group_to_shard[*group.second] = smallest.second;
+         shard_num_points[smallest.second] += group.first;
+         shard_sizes.emplace(smallest.first + group.first, smallest.second);
+      }
+      std::cout << "- " << groups.size() << " groups, shard sizes:";
+      for (auto size : shard_num_points)
+         std::cout << " " << size;
+      std::cout << std::endl;
+      if (groups.size() < num_shards)
+         throw std::runtime_error("Fewer groups than shards");
+
+      // 3. stream the points into their shards
+      IdxType num_numeric_attrs = base_numeric_file.empty() ? 0 : sniff_vecs_file(base_numeric_file, sizeof(float), true).dim;
+      std::vector<std::shared_ptr<IStorage>> shard_storages(num_shards);
+      _shard_global_ids.assign(num_shards, std::vector<GlobalIdxType>());
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+         _shard_global_ids[shard_id].reserve(shard_num_points[shard_id]);
+      std::vector<IdxType> point_to_shard(std::min(chunk_size, num_points));
+      for (size_t first_point = 0; first_point < num_points; first_point += chunk_size)
+      {
+         auto chunk_storage = create_storage(data_type, false);
+         chunk_storage->load_from_file(base_bin_file, base_label_file, chunk_size, first_point);
+         if (num_numeric_attrs > 0)
+            chunk_storage->load_numeric_attrs(base_numeric_file, first_point);
+         IdxType num_chunk_points = chunk_storage->get_num_points();
+         if (first_point == 0)
+            for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+            {
+               shard_storages[shard_id] = create_storage(data_type, chunk_storage->get_dim(), num_numeric_attrs);
+               shard_storages[shard_id]->reserve(shard_num_points[shard_id]);
+            }
+
+#pragma omp parallel for schedule(static, 4096)
+         for (IdxType i = 0; i < num_chunk_points; ++i)
+         {
+            auto label_set = chunk_storage->get_label_span(i).to_vector();
+            std::sort(label_set.begin(), label_set.end());
+            point_to_shard[i] = group_to_shard.at(label_set);
+         }
+#pragma omp parallel for schedule(dynamic, 1)
+         for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+            for (IdxType i = 0; i < num_chunk_points; ++i)
+               if (point_to_shard[i] == shard_id)
+               {
+                  shard_storages[shard_id]->append(chunk_storage->get_vector(i), chunk_storage->get_label_span(i),
+                                                   num_numeric_attrs > 0 ? chunk_storage->get_numeric_attrs(i) : nullptr);
+                  _shard_global_ids[shard_id].push_back(first_point + i);
+               }
+         chunk_storage->clean();
+      }
+      return shard_storages;
+   }
+
+   void ShardedUniNavGraph::run_on_shards(const std::vector<IdxType> &shard_ids, uint32_t num_threads,
+                                          const std::function<void(IdxType, uint32_t)> &task) const
+   {
+      uint32_t num_workers = std::max<uint32_t>(1, std::min<size_t>(shard_ids.size(), num_threads));
+      uint32_t num_threads_per_shard = std::max<uint32_t>(1, num_threads / num_workers);
+      std::atomic<size_t> next_shard(0);
+      std::exception_ptr error = nullptr;
+      std::mutex error_mutex;
+      std::vector<std::thread> workers;
+      for (uint32_t w = 0; w < num_workers; ++w)
+         workers.emplace_back([&]()
+                              {
+                                 for (size_t i = next_shard++; i < shard_ids.size(); i = next_shard++)
+                                 {
+                                    try
+                                    {
+                                       task(shard_ids[i], num_threads_per_shard);
+                                    }
+                                    catch (...)
+                                    {
+                                       std::lock_guard<std::mutex> lock(error_mutex);
+                                       if (!error)
+                                          error = std::current_exception();
+                                    }
+                                 } });
+      for (auto &worker : workers)
+         worker.join();
+      if (error)
+         std::rethrow_exception(error);
+   }
+
+   void ShardedUniNavGraph::search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                                   uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario,
+                                   IdxType K, std::pair<GlobalIdxType, float> *results, std::vector<float> &num_cmps,
+                                   std::vector<IdxType> &num_searched_shards)
+   {
+      IdxType num_queries = query_storage->get_num_points();
+      IdxType num_shards = _shards.size();
+
+      // 1. shards whose covered sets contain a matching point of the query, query_pos[s][i] is the position of
+      // query i in the batch of shard s (-1 if skipped)
+      std::vector<std::vector<IdxType>> query_pos(num_shards, std::vector<IdxType>(num_queries, -1));
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 16)
+      for (IdxType id = 0; id < num_queries; ++id)
+         for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+            if (_shards[shard_id]->count_matching_points(query_storage->get_label_set(id), scenario) > 0)
+               query_pos[shard_id][id] = 0;
+      std::vector<std::vector<IdxType>> shard_queries(num_shards);
+      std::vector<IdxType> active_shard_ids;
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+      {
+         for (IdxType id = 0; id < num_queries; ++id)
+            if (query_pos[shard_id][id] != -1)
+            {
+               query_pos[shard_id][id] = shard_queries[shard_id].size();
+               shard_queries[shard_id].push_back(id);
+            }
+         if (!shard_queries[shard_id].empty())
+            active_shard_ids.push_back(shard_id);
+      }
+
+      // 2. each shard answers its batch, the shards run concurrently
+      std::vector<std::vector<std::pair<IdxType, float>>> shard_results(num_shards);
+      std::vector<std::vector<float>> shard_num_cmps(num_shards);
+      run_on_shards(active_shard_ids, num_threads, [&](IdxType shard_id, uint32_t shard_num_threads)
+                    {
+                       const auto &query_ids = shard_queries[shard_id];
+                       auto shard_query_storage = create_storage(_data_type, query_storage->get_dim(), 0);
+                       shard_query_storage->reserve(query_ids.size());
+                       for (auto id : query_ids)
+                          shard_query_storage->append(query_storage->get_vector(id), query_storage->get_label_set(id));
+                       shard_results[shard_id].resize((size_t)query_ids.size() * K);
+                       shard_num_cmps[shard_id].resize(query_ids.size());
+                       std::vector<QueryStats> query_stats;
+                       std::vector<std::bitset<10000001>> bitmaps;
+                       _shards[shard_id]->search(shard_query_storage, distance_handler, shard_num_threads, Lsearch,
+                                                 num_entry_points, scenario, K, shard_results[shard_id].data(),
+                                                 shard_num_cmps[shard_id], query_stats, bitmaps);
+                       shard_query_storage->clean(); });
+
+      // 3. merge the top-K of the shards
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 16)
+      for (IdxType id = 0; id < num_queries; ++id)
+      {
+         std::vector<std::pair<float, GlobalIdxType>> candidates;
+         num_cmps[id] = 0;
+         num_searched_shards[id] = 0;
+         for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+         {
+            auto pos = query_pos[shard_id][id];
+            if (pos == -1)
+               continue;
+            num_cmps[id] += shard_num_cmps[shard_id][pos];
+            num_searched_shards[id]++;
+            for (IdxType k = 0; k < K; ++k)
+            {
+               const auto &result = shard_results[shard_id][(size_t)pos * K + k];
+               if (result.first == -1)
+                  break;
+               candidates.emplace_back(result.second, to_global_id(shard_id, result.first));
+            }
+         }
+         IdxType num_results = std::min<size_t>(K, candidates.size());
+         std::partial_sort(candidates.begin(), candidates.begin() + num_results, candidates.end());
+         for (IdxType k = 0; k < num_results; ++k)
+            results[(size_t)id * K + k] = {candidates[k].second, candidates[k].first};
+         for (IdxType k = num_results; k < K; ++k)
+            results[(size_t)id * K + k].first = -1;
+      }
+   }
+
+   void ShardedUniNavGraph::save(const std::string &index_path_prefix, const std::string &results_path_prefix)
+   {
+      fs::create_directories(index_path_prefix);
+      std::map<std::string, std::string> meta_data;
+      meta_data["num_shards"] = std::to_string(_shards.size());
+      meta_data["num_points"] = std::to_string(_num_points);
+      meta_data["partition"] = _partition;
+      write_kv_file(index_path_prefix + "shard_meta", meta_data);
+      if (_partition == "range")
+         write_1d_vector(index_path_prefix + "shard_offsets", _shard_offsets);
+      for (IdxType shard_id = 0; shard_id < _shards.size(); ++shard_id)
+      {
+         std::string shard_prefix = index_path_prefix + "shard_" + std::to_string(shard_id) + "/";
+         _shards[shard_id]->save(shard_prefix, results_path_prefix + "shard_" + std::to_string(shard_id) + "_");
+         if (_partition == "group")
+            write_1d_vector(shard_prefix + "global_ids", _shard_global_ids[shard_id]);
+      }
+   }
+
+   void ShardedUniNavGraph::load(const std::string &index_path_prefix, const std::string &data_type, uint32_t num_threads)
+   {
+      auto meta_data = parse_kv_file(index_path_prefix + "shard_meta");
+      IdxType num_shards = std::stoul(meta_data["num_shards"]);
+      _num_points = std::stoull(meta_data["num_points"]);
+      _partition = meta_data["partition"];
+      _data_type = data_type;
+      if (_partition == "range")
+         load_1d_vector(index_path_prefix + "shard_offsets", _shard_offsets);
+      else
+         _shard_global_ids.assign(num_shards, std::vector<GlobalIdxType>());
+
+      // the shards are loaded concurrently
+      _shards.clear();
+      for (IdxType shard_id = 0; shard_id < num_shards; ++shard_id)
+         _shards.push_back(std::make_shared<UniNavGraph>(1));
+      std::vector<IdxType> shard_ids(num_shards);
+      std::iota(shard_ids.begin(), shard_ids.end(), 0);
+      run_on_shards(shard_ids, num_threads, [&](IdxType shard_id, uint32_t)
+                    {
+                       std::string shard_prefix = index_path_prefix + "shard_" + std::to_string(shard_id) + "/";
+                       _shards[shard_id]->load(shard_prefix, data_type);
+                       if (_partition == "group")
+                          load_1d_vector(shard_prefix + "global_ids", _shard_global_ids[shard_id]); });
+   }
+}
@@ -6,8 +6,11 @@
 #include <sstream>
 #include <chrono>
 #include <algorithm>
+#include <new>
 #include "utils.h"
 #include "storage.h"
+#include "label_io.h"
+#include "vecs_io.h"
 
 namespace ANNS
 {
@@ -33,6 +36,22 @@ namespace ANNS
       }
    }
 
+   // obtain an empty storage to be filled by append()
+   std::shared_ptr<IStorage> create_storage(const std::string &data_type, IdxType dim, IdxType num_numeric_attrs, bool verbose)
+   {
+      if (data_type == "float")
+         return std::make_shared<Storage<float>>(DataType::FLOAT, dim, num_numeric_attrs, verbose);
+      else if (data_type == "int8")
+         return std::make_shared<Storage<int8_t>>(DataType::INT8, dim, num_numeric_attrs, verbose);
+      else if (data_type == "uint8")
+         return std::make_shared<Storage<uint8_t>>(DataType::UINT8, dim, num_numeric_attrs, verbose);
+      else
+      {
+         std::cerr << "Error: invalid data type " << data_type << std::endl;
+         exit(-1);
+      }
+   }
+
    // obtain the corresponding storage class
    std::shared_ptr<IStorage> create_storage(std::shared_ptr<IStorage> storage, IdxType start, IdxType end)
    {
@@ -50,12 +69,49 @@ namespace ANNS
       }
    }
 
+   // deep copy
+   std::shared_ptr<IStorage> copy_storage(std::shared_ptr<IStorage> storage)
+   {
+      std::shared_ptr<IStorage> copy;
+      DataType data_type = storage->get_data_type();
+      IdxType dim = storage->get_dim(), num_numeric_attrs = storage->get_num_numeric_attrs();
+      if (data_type == DataType::FLOAT)
+         copy = std::make_shared<Storage<float>>(data_type, dim, num_numeric_attrs, false);
+      else if (data_type == DataType::INT8)
+         copy = std::make_shared<Storage<int8_t>>(data_type, dim, num_numeric_attrs, false);
+      else if (data_type == DataType::UINT8)
+         copy = std::make_shared<Storage<uint8_t>>(data_type, dim, num_numeric_attrs, false);
+      else
+      {
+         std::cerr << "Error: invalid data type " << data_type << std::endl;
+         exit(-1);
+      }
+      copy->reserve(storage->get_num_points());
+      for (IdxType i = 0; i < storage->get_num_points(); ++i)
+         copy->append(storage->get_vector(i), storage->get_label_span(i),
+                      num_numeric_attrs > 0 ? storage->get_numeric_attrs(i) : nullptr);
+      return copy;
+   }
+
    // construct the class
    template <typename T>
    Storage<T>::Storage(DataType data_type, bool verbose)
    {
       this->data_type = data_type;
       this->verbose = verbose;
+      num_points = dim = 0;
+   }
+
+   // construct an empty storage, the buffers are allocated by reserve() or append()
+   template <typename T>
+   Storage<T>::Storage(DataType data_type, IdxType dim, IdxType num_numeric_attrs, bool verbose)
+   {
+      this->data_type = data_type;
+      this->verbose = verbose;
+      this->dim = dim;
+      this->num_numeric_attrs = num_numeric_attrs;
+      num_points = 0;
+      prefetch_byte_num = dim * sizeof(T);
    }
 
    // load from storage without copying data
@@ -66,67 +122,63 @@ namespace ANNS
       num_points = end - start;
       dim = storage->get_dim();
       vecs = reinterpret_cast<T *>(storage->get_vector(start));
-      label_sets = storage->get_offseted_label_sets(start);
+      label_parent = storage;
+      label_start = start;
+      num_numeric_attrs = storage->get_num_numeric_attrs();
+      if (num_numeric_attrs > 0)
+         numeric_attrs = storage->get_numeric_attrs(start);
       prefetch_byte_num = dim * sizeof(T);
       verbose = false;
    }
 
    // load data
    template <typename T>
-   void Storage<T>::load_from_file(const std::string &bin_file, const std::string &label_file, IdxType max_num_points)
+   void Storage<T>::load_from_file(const std::string &bin_file, const std::string &label_file, IdxType max_num_points,
+                                   size_t first_point)
    {
       if (verbose)
          std::cout << "Loading data from " << bin_file << " and " << label_file << " ..." << std::endl;
       auto start_time = std::chrono::high_resolution_clock::now();
 
-      // open the binary file
-      std::ifstream file(bin_file, std::ios::binary | std::ios::ate);
-      if (!file.is_open())
-         throw std::runtime_error("Failed to open file: " + bin_file);
-
-      // read vector data
-      file.seekg(0, std::ios::beg);
-      file.read((char *)&num_points, sizeof(IdxType));
-      file.read((char *)&dim, sizeof(IdxType));
-      num_points = std::min(num_points, max_num_points);
-      vecs = static_cast<T *>(std::aligned_alloc(32, num_points * dim * sizeof(T)));
-      file.read((char *)vecs, num_points * dim * sizeof(T));
-      file.close();
+      // read vector data, the format is sniffed from the file
+      auto info = sniff_vecs_file(bin_file, sizeof(T), std::is_signed<T>::value);
+      if (first_point > info.num_points)
+         throw std::runtime_error("First point out of range: " + bin_file);
+      num_points = std::min<size_t>(info.num_points - first_point, max_num_points);
+      dim = info.dim;
+      vecs = static_cast<T *>(huge_alloc((size_t)num_points * dim * sizeof(T)));
+      capacity = num_points;
+      read_vecs(bin_file, info, first_point, first_point + num_points, vecs);
 
       // for prefetch
       prefetch_byte_num = dim * sizeof(T);
 
-      // read label data if exists
-      std::map<LabelType, IdxType> label_cnts;
-      label_sets = new std::vector<LabelType>[num_points];
-      file.open(label_file);
-      if (file.is_open())
+      // read label data if exists, text (one line per point) or binary CSR, a CSR file with rows for all the
+      // points is used in place
+      std::vector<IdxType> label_cnts;
+      if (std::ifstream(label_file).good() && is_label_csr_file(label_file) &&
+          (label_csr = open_label_csr(label_file, first_point, num_points, label_cnts)))
       {
-         std::string line, label;
-         for (auto i = 0; i < num_points && i < max_num_points; ++i)
-         {
-            std::getline(file, line);
-            std::stringstream ss(line);
-            while (std::getline(ss, label, ','))
-            {
-               label_sets[i].emplace_back(std::stoi(label));
-               if (label_cnts.find(std::stoi(label)) == label_cnts.end())
-                  label_cnts[std::stoi(label)] = 1;
-               else
-                  label_cnts[std::stoi(label)]++;
-            }
-            std::sort(label_sets[i].begin(), label_sets[i].end());
-            label_sets[i].shrink_to_fit();
-         }
-         file.close();
+         label_offsets = label_csr->offsets() + first_point;
+         label_data = reinterpret_cast<const LabelType *>(label_csr->labels());
+      }
+      else if (std::ifstream(label_file).good())
+      {
+         label_sets = new std::vector<LabelType>[num_points];
+         if (is_label_csr_file(label_file))
+            load_label_csr(label_file, label_sets, first_point, num_points, label_cnts);
+         else
+            load_label_txt(label_file, label_sets, first_point, num_points, label_cnts);
 
          // unfiltered ANNS when label file not found
       }
       else
       {
          std::cout << "- Warning: label file not found, set all labels to 1" << std::endl;
-         for (auto i = 0; i < num_points && i < max_num_points; ++i)
+         label_sets = new std::vector<LabelType>[num_points];
+         for (auto i = 0; i < num_points; ++i)
             label_sets[i] = {1};
+         label_cnts.assign(2, 0);
          label_cnts[1] = num_points;
       }
 
@@ -135,7 +187,7 @@ namespace ANNS
       {
          std::cout << "- Number of points: " << num_points << std::endl;
          std::cout << "- Dimension: " << dim << std::endl;
-         std::cout << "- Number of labels: " << label_cnts.size() << std::endl;
+         std::cout << "- Number of labels: " << label_cnts.size() - std::count(label_cnts.begin(), label_cnts.end(), 0) << std::endl;
          std::cout << "- Time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
          std::cout << SEP_LINE;
       }
@@ -160,38 +212,223 @@ namespace ANNS
       }
       for (auto i = 0; i < num_points; ++i)
       {
-         int size = label_sets[i].size();
+         auto label_set = get_label_span(i);
+         int size = label_set.size();
          if (size == 0) // 检查是否为空
          {
             continue;
          }
-         file << label_sets[i][0];
+         file << label_set[0];
          for (auto j = 1; j < size; ++j)
-            file << "," << label_sets[i][j];
+            file << "," << label_set[j];
          file << std::endl;
       }
       file.close();
    }
 
+   // load numeric attributes of the loaded points
+   template <typename T>
+   void Storage<T>::load_numeric_attrs(const std::string &attr_file, size_t first_point)
+   {
+      auto info = sniff_vecs_file(attr_file, sizeof(float), true);
+      if (info.elem_size != sizeof(float))
+         throw std::runtime_error("Numeric attributes must be float: " + attr_file);
+      if (first_point + num_points > info.num_points)
+         throw std::runtime_error("Fewer numeric attribute rows than points: " + attr_file);
+      if (numeric_attrs && capacity > 0)
+         delete[] numeric_attrs;
+      num_numeric_attrs = info.dim;
+      numeric_attrs = new float[(size_t)std::max(capacity, num_points) * num_numeric_attrs];
+      read_vecs(attr_file, info, first_point, first_point + num_points, numeric_attrs);
+      if (verbose)
+         std::cout << "- Number of numeric attributes: " << num_numeric_attrs << std::endl;
+   }
+
+   // write numeric attributes
+   template <typename T>
+   void Storage<T>::write_numeric_attrs(const std::string &attr_file)
+   {
+      std::ofstream file(attr_file, std::ios::binary);
+      file.write((char *)&num_points, sizeof(IdxType));
+      file.write((char *)&num_numeric_attrs, sizeof(IdxType));
+      file.write((char *)numeric_attrs, (size_t)num_points * num_numeric_attrs * sizeof(float));
+   }
+
    // reorder the vector data
    template <typename T>
    void Storage<T>::reorder_data(const std::vector<IdxType> &new_to_old_ids)
    {
+      // CSR labels are permuted into owned buffers, expanded ones along with the vectors
+      bool reorder_label_sets = label_sets != nullptr;
+      if (label_offsets && !reorder_label_sets)
+      {
+         std::vector<uint64_t> new_offsets(num_points + 1, 0);
+         for (IdxType i = 0; i < num_points; ++i)
+            new_offsets[i + 1] = new_offsets[i] + label_offsets[new_to_old_ids[i] + 1] - label_offsets[new_to_old_ids[i]];
+         std::vector<LabelType> new_data(new_offsets[num_points]);
+#pragma omp parallel for schedule(static, 4096)
+         for (IdxType i = 0; i < num_points; ++i)
+            std::copy(label_data + label_offsets[new_to_old_ids[i]], label_data + label_offsets[new_to_old_ids[i] + 1],
+                      new_data.begin() + new_offsets[i]);
+         release_label_csr();
+         owned_label_offsets = std::move(new_offsets);
+         owned_label_data = std::move(new_data);
+         label_offsets = owned_label_offsets.data();
+         label_data = owned_label_data.data();
+      }
+      else
+         release_label_csr();
 
-      // move the vectors and labels
-      auto new_vecs = static_cast<T *>(std::aligned_alloc(32, num_points * dim * sizeof(T)));
-      auto new_label_sets = new std::vector<LabelType>[num_points];
-      for (auto i = 0; i < num_points; ++i)
+      // in-place reorder along the cycles of the permutation: position i takes the data of new_to_old_ids[i].
+      // long cycles are cut into segments of at most segment_len positions so that they can be moved in
+      // parallel, only the head of each segment is buffered (extra memory: num_points / segment_len rows)
+      struct Segment
       {
-         std::memcpy(new_vecs + i * dim, vecs + new_to_old_ids[i] * dim, dim * sizeof(T));
-         new_label_sets[i] = label_sets[new_to_old_ids[i]];
+         IdxType head, len;
+         size_t next; // next segment on the same cycle
+      };
+      const IdxType segment_len = 4096;
+      std::vector<Segment> segments;
+      std::vector<bool> visited(num_points, false);
+      for (IdxType i = 0; i < num_points; ++i)
+      {
+         if (visited[i] || new_to_old_ids[i] == i)
+            continue;
+         size_t first_segment = segments.size();
+         IdxType pos = i;
+         while (!visited[pos])
+         {
+            Segment segment{pos, 0, 0};
+            for (; segment.len < segment_len && !visited[pos]; ++segment.len)
+            {
+               visited[pos] = true;
+               pos = new_to_old_ids[pos];
+            }
+            segment.next = segments.size() + 1;
+            segments.emplace_back(segment);
+         }
+         segments.back().next = first_segment;
       }
+      std::vector<bool>().swap(visited);
 
-      // clean up
-      delete[] vecs;
-      delete[] label_sets;
+      // save the heads, they are overwritten first
+      size_t row_size = dim * sizeof(T);
+      // aligned_alloc needs a size that is a multiple of the alignment
+      size_t head_bytes = (std::max<size_t>(segments.size(), 1) * row_size + 31) & ~size_t(31);
+      auto head_vecs = static_cast<T *>(std::aligned_alloc(32, head_bytes));
+      if (head_vecs == nullptr)
+         throw std::bad_alloc();
+      std::vector<std::vector<LabelType>> head_label_sets(segments.size());
+#pragma omp parallel for schedule(static, 1024)
+      for (size_t s = 0; s < segments.size(); ++s)
+      {
+         std::memcpy(head_vecs + s * dim, vecs + (size_t)segments[s].head * dim, row_size);
+         if (reorder_label_sets)
+            head_label_sets[s] = std::move(label_sets[segments[s].head]);
+      }
+
+      // move the vectors and labels, the last position of a segment takes the head of the next one
+#pragma omp parallel for schedule(dynamic, 16)
+      for (size_t s = 0; s < segments.size(); ++s)
+      {
+         IdxType pos = segments[s].head;
+         for (IdxType j = 1; j < segments[s].len; ++j)
+         {
+            IdxType src = new_to_old_ids[pos];
+            std::memcpy(vecs + (size_t)pos * dim, vecs + (size_t)src * dim, row_size);
+            if (reorder_label_sets)
+               label_sets[pos] = std::move(label_sets[src]);
+            pos = src;
+         }
+         std::memcpy(vecs + (size_t)pos * dim, head_vecs + segments[s].next * dim, row_size);
+         if (reorder_label_sets)
+            label_sets[pos] = std::move(head_label_sets[segments[s].next]);
+      }
+      std::free(head_vecs);
+
+      // numeric attributes are small, they are permuted through a copy
+      if (num_numeric_attrs > 0)
+      {
+         std::vector<float> old_attrs(numeric_attrs, numeric_attrs + (size_t)num_points * num_numeric_attrs);
+#pragma omp parallel for schedule(static, 4096)
+         for (IdxType i = 0; i < num_points; ++i)
+            std::memcpy(numeric_attrs + (size_t)i * num_numeric_attrs,
+                        old_attrs.data() + (size_t)new_to_old_ids[i] * num_numeric_attrs, num_numeric_attrs * sizeof(float));
+      }
+   }
+
+   // grow the buffers to hold capacity points
+   template <typename T>
+   void Storage<T>::reserve(IdxType new_capacity)
+   {
+      if (capacity == 0 && vecs != nullptr)
+         throw std::runtime_error("Cannot grow a storage view");
+      if (new_capacity <= capacity)
+         return;
+      if (label_offsets)
+      {
+         std::call_once(expand_flag, [this]() { expand_label_sets(); });
+         release_label_csr();
+      }
+      auto new_vecs = static_cast<T *>(huge_alloc((size_t)new_capacity * dim * sizeof(T)));
+      auto new_label_sets = new std::vector<LabelType>[new_capacity];
+      float *new_numeric_attrs = num_numeric_attrs > 0 ? new float[(size_t)new_capacity * num_numeric_attrs] : nullptr;
+      if (vecs)
+         std::memcpy(new_vecs, vecs, (size_t)num_points * dim * sizeof(T));
+      for (IdxType i = 0; i < num_points; ++i)
+         new_label_sets[i] = std::move(label_sets[i]);
+      if (new_numeric_attrs)
+         std::memcpy(new_numeric_attrs, numeric_attrs, (size_t)num_points * num_numeric_attrs * sizeof(float));
+      clean();
       vecs = new_vecs;
       label_sets = new_label_sets;
+      numeric_attrs = new_numeric_attrs;
+      capacity = new_capacity;
+   }
+
+   // append a point after the last one
+   template <typename T>
+   IdxType Storage<T>::append(const char *vec, LabelSpan label_set, const float *new_numeric_attrs)
+   {
+      if (num_points == capacity)
+         reserve(std::max<IdxType>(1024, capacity * 2));
+      else if (label_offsets)
+      {
+         std::call_once(expand_flag, [this]() { expand_label_sets(); });
+         release_label_csr();
+      }
+      std::memcpy(vecs + (size_t)num_points * dim, vec, dim * sizeof(T));
+      label_sets[num_points].assign(label_set.begin(), label_set.end());
+      if (num_numeric_attrs > 0)
+      {
+         float *row = numeric_attrs + (size_t)num_points * num_numeric_attrs;
+         if (new_numeric_attrs)
+            std::memcpy(row, new_numeric_attrs, num_numeric_attrs * sizeof(float));
+         else
+            std::fill(row, row + num_numeric_attrs, 0.0f);
+      }
+      return num_points++;
+   }
+
+   // one vector per point from the CSR labels, for the callers of get_label_set
+   template <typename T>
+   void Storage<T>::expand_label_sets()
+   {
+      label_sets = new std::vector<LabelType>[std::max(capacity, num_points)];
+#pragma omp parallel for schedule(static, 4096)
+      for (IdxType i = 0; i < num_points; ++i)
+         label_sets[i].assign(label_data + label_offsets[i], label_data + label_offsets[i + 1]);
+   }
+
+   // switch to the expanded label sets
+   template <typename T>
+   void Storage<T>::release_label_csr()
+   {
+      label_csr.reset();
+      std::vector<uint64_t>().swap(owned_label_offsets);
+      std::vector<LabelType>().swap(owned_label_data);
+      label_offsets = nullptr;
+      label_data = nullptr;
    }
 
    // obtain a point cloest to the center
@@ -15,7 +15,7 @@ namespace ANNS
    }
 
    // insert a new label set into the trie tree, increase the group size
-   IdxType TrieIndex::insert(const std::vector<LabelType> &label_set, IdxType &new_label_set_id)
+   IdxType TrieIndex::insert(LabelSpan label_set, IdxType &new_label_set_id)
    {
       std::shared_ptr<TrieNode> cur = _root;
       for (const LabelType label : label_set)
@@ -52,7 +52,7 @@ namespace ANNS
    }
 
    // find the exact match of the label set
-   std::shared_ptr<TrieNode> TrieIndex::find_exact_match(const std::vector<LabelType> &label_set) const
+   std::shared_ptr<TrieNode> TrieIndex::find_exact_match(LabelSpan label_set) const
    {
       std::shared_ptr<TrieNode> cur = _root;
       for (const LabelType label : label_set)
@@ -69,7 +69,7 @@ namespace ANNS
    }
 
    // get the top entrances of all super sets in the trie tree, assume the label_set has been sorted in ascending order
-   void TrieIndex::get_super_set_entrances(const std::vector<LabelType> &label_set,
+   void TrieIndex::get_super_set_entrances(LabelSpan label_set,
                                            std::vector<std::shared_ptr<TrieNode>> &super_set_entrances,
                                            bool avoid_self, bool need_containment) const
    {
@@ -90,9 +90,12 @@ namespace ANNS
       else
       {
 
-         // if need containing the input label set, obtain candidate nodes for the last label
+         // if need containing the input label set, obtain candidate nodes for the last label,
+         // labels unknown to the trie (e.g. kept in another shard) have no nodes
          if (need_containment)
          {
+            if (label_set.back() >= _label_to_nodes.size())
+               return;
             for (auto node : _label_to_nodes[label_set[label_set.size() - 1]])
                if (examine_containment(label_set, node))
                   q.push(node);
@@ -102,9 +105,10 @@ namespace ANNS
          else
          {
             for (auto label : label_set)
-               for (auto node : _label_to_nodes[label])
-                  if (examine_smallest(label_set, node))
-                     q.push(node);
+               if (label < _label_to_nodes.size())
+                  for (auto node : _label_to_nodes[label])
+                     if (examine_smallest(label_set, node))
+                        q.push(node);
          }
       }
 
@@ -130,7 +134,7 @@ namespace ANNS
    }
 
    // bottom to top, examine whether the current node is the smallest in the label set
-   bool TrieIndex::examine_smallest(const std::vector<LabelType> &label_set,
+   bool TrieIndex::examine_smallest(LabelSpan label_set,
                                     const std::shared_ptr<TrieNode> &node) const
    {
       auto cur = node->parent;
@@ -144,7 +148,7 @@ namespace ANNS
    }
 
    // bottom to top, examine whether is a super set of the label set
-   bool TrieIndex::examine_containment(const std::vector<LabelType> &label_set,
+   bool TrieIndex::examine_containment(LabelSpan label_set,
                                        const std::shared_ptr<TrieNode> &node) const
    {
       auto cur = node->parent;
@@ -247,10 +251,11 @@ namespace ANNS
          }
       }
 
-      // build label_to_nodes
+      // build label_to_nodes, the root is not a label node
       _label_to_nodes.resize(_max_label_id + 1);
       for (const auto each : nodes)
-         _label_to_nodes[each->label].push_back(each);
+         if (each != _root)
+            _label_to_nodes[each->label].push_back(each);
    }
 
    float TrieIndex::get_index_size()
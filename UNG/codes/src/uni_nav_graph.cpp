@@ -9,11 +9,18 @@
 #include <bitset>
 
 #include <random>
+#include <set>
+#include <map>
+#include <numeric>
+#include <cstring>
 #include <fstream>
 #include <algorithm>
 #include <unordered_set>
 #include <cassert>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
 #include <boost/program_options.hpp>
@@ -23,6 +30,7 @@
 #include <boost/dynamic_bitset.hpp>
 
 #include "utils.h"
+#include "label_csr.h"
 #include "vamana/vamana.h"
 #include "include/uni_nav_graph.h"
 #include <roaring/roaring.h>
@@ -76,41 +84,90 @@ namespace ANNS
       _scenario = scenario;
 
       std::cout << "Dividing groups and building the trie tree index ..." << std::endl;
+      TraceScope build_scope(_build_trace.get(), "build", "build");
+      if (_build_trace)
+         trace_memory_usage();
       auto start_time = std::chrono::high_resolution_clock::now();
-      build_trie_and_divide_groups();
-      _graph = std::make_shared<ANNS::Graph>(base_storage->get_num_points());
-      _global_graph = std::make_shared<ANNS::Graph>(base_storage->get_num_points());
-      std::cout << "begin prepare_group_storages_graphs" << std::endl;
-      prepare_group_storages_graphs();
+      {
+         TraceScope scope(_build_trace.get(), "label_processing", "phase");
+         {
+            TraceScope sub_scope(_build_trace.get(), "build_trie_and_divide_groups", "subphase");
+            build_trie_and_divide_groups();
+         }
+         _graph = ANNS::Graph::create(base_storage->get_num_points());
+         _global_graph = ANNS::Graph::create(base_storage->get_num_points());
+         std::cout << "begin prepare_group_storages_graphs" << std::endl;
+         {
+            TraceScope sub_scope(_build_trace.get(), "prepare_group_storages_graphs", "subphase");
+            prepare_group_storages_graphs();
+         }
+      }
       _label_processing_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
       std::cout << "- Finished in " << _label_processing_time << " ms" << std::endl;
+      if (_build_trace)
+         trace_memory_usage();
 
       // build graph index for each group
-      build_graph_for_all_groups();
+      {
+         TraceScope scope(_build_trace.get(), "build_graph_for_all_groups", "phase");
+         build_graph_for_all_groups();
+      }
+      if (_build_trace)
+         trace_memory_usage();
       // build_global_vamana_graph();
-      build_vector_and_attr_graph(); // fxy_add
+      {
+         TraceScope scope(_build_trace.get(), "build_vector_and_attr_graph", "phase");
+         build_vector_and_attr_graph(); // fxy_add
+      }
+      if (_build_trace)
+         trace_memory_usage();
 
       // for label equality scenario, there is no need for label navigating graph and cross-group edges
       if (_scenario == "equality")
       {
+         TraceScope scope(_build_trace.get(), "add_offset_for_uni_nav_graph", "phase");
          add_offset_for_uni_nav_graph();
       }
       else
       {
 
          // build the label navigating graph
-         build_label_nav_graph();
-         get_descendants_info(); // fxy_add
+         {
+            TraceScope scope(_build_trace.get(), "build_label_nav_graph", "phase");
+            build_label_nav_graph();
+         }
+         {
+            TraceScope scope(_build_trace.get(), "get_descendants_info", "phase");
+            get_descendants_info(); // fxy_add
+         }
+         if (_build_trace)
+            trace_memory_usage();
 
          // calculate the coverage ratio
-         cal_f_coverage_ratio(); // fxy_add
+         {
+            TraceScope scope(_build_trace.get(), "cal_f_coverage_ratio", "phase");
+            cal_f_coverage_ratio(); // fxy_add
+         }
+         if (_build_trace)
+            trace_memory_usage();
 
          // initialize_lng_descendants_coverage_bitsets();
-         initialize_roaring_bitsets();
+         {
+            TraceScope scope(_build_trace.get(), "initialize_roaring_bitsets", "phase");
+            initialize_roaring_bitsets();
+         }
+         if (_build_trace)
+            trace_memory_usage();
 
          // build cross-group edges
-         build_cross_group_edges();
+         {
+            TraceScope scope(_build_trace.get(), "build_cross_group_edges", "phase");
+            build_cross_group_edges();
+         }
       }
+      if (_build_trace)
+         trace_memory_usage();
+      publish_snapshot();
 
       // index time
       _index_time = std::chrono::duration<double, std::milli>(
@@ -118,13 +175,48 @@ namespace ANNS
                         .count();
    }
 
+   // fxy_add: 采样 RSS 和主要数据结构的字节数
+   void UniNavGraph::trace_memory_usage()
+   {
+      _build_trace->sample_rss();
+
+      double graph_bytes = _graph ? _graph->get_index_size() : 0;
+      double trie_bytes = _trie_index.get_index_size();
+      double vector_attr_graph_bytes = 0;
+      for (const auto &neighbors : _vector_attr_graph)
+         vector_attr_graph_bytes += neighbors.capacity() * sizeof(IdxType);
+      double roaring_bytes = 0;
+      for (const auto &rb : _lng_descendants_rb)
+         roaring_bytes += rb.getSizeInBytes();
+      for (const auto &rb : _covered_sets_rb)
+         roaring_bytes += rb.getSizeInBytes();
+
+      // unordered_set: one node (value + next pointer + cached hash) per element plus the bucket array
+      double covered_sets_bytes = 0, lng_bytes = 0;
+      if (_label_nav_graph)
+      {
+         for (const auto &covered_set : _label_nav_graph->covered_sets)
+            covered_sets_bytes += covered_set.size() * (sizeof(IdxType) + 2 * sizeof(void *)) +
+                                  covered_set.bucket_count() * sizeof(void *);
+         for (IdxType i = 0; i < _label_nav_graph->in_neighbors.size(); ++i)
+            lng_bytes += (_label_nav_graph->in_neighbors[i].capacity() + _label_nav_graph->out_neighbors[i].capacity()) *
+                         sizeof(IdxType);
+      }
+      _build_trace->add_counter("structure_bytes", {{"graph", graph_bytes},
+                                                    {"trie", trie_bytes},
+                                                    {"vector_attr_graph", vector_attr_graph_bytes},
+                                                    {"lng", lng_bytes},
+                                                    {"covered_sets", covered_sets_bytes},
+                                                    {"roaring_sets", roaring_bytes}});
+   }
+
    void UniNavGraph::build_trie_and_divide_groups()
    {
       // create groups for base label sets
       IdxType new_group_id = 1;
       for (auto vec_id = 0; vec_id < _num_points; ++vec_id)
       {
-         const auto &label_set = _base_storage->get_label_set(vec_id);
+         auto label_set = _base_storage->get_label_span(vec_id);
          auto group_id = _trie_index.insert(label_set, new_group_id);
 
          // deal with new label setinver
@@ -132,7 +224,7 @@ namespace ANNS
          {
             _group_id_to_vec_ids.resize(group_id + 1);
             _group_id_to_label_set.resize(group_id + 1);
-            _group_id_to_label_set[group_id] = label_set;
+            _group_id_to_label_set[group_id] = label_set.to_vector();
          }
          _group_id_to_vec_ids[group_id].emplace_back(vec_id);
       }
@@ -206,17 +298,26 @@ namespace ANNS
       for (auto group_id = 1; group_id <= _num_groups; ++group_id)
       {
          _group_id_to_range[group_id].first = new_vec_id;
+         new_vec_id += _group_id_to_vec_ids[group_id].size();
+         _group_id_to_range[group_id].second = new_vec_id;
+      }
+      omp_set_num_threads(_num_threads);
+#pragma omp parallel for schedule(dynamic, 64)
+      for (auto group_id = 1; group_id <= _num_groups; ++group_id)
+      {
+         IdxType id = _group_id_to_range[group_id].first;
          for (auto old_vec_id : _group_id_to_vec_ids[group_id])
          {
-            _new_to_old_vec_ids[new_vec_id] = old_vec_id;
-            _new_vec_id_to_group_id[new_vec_id] = group_id;
-            ++new_vec_id;
+            _new_to_old_vec_ids[id] = old_vec_id;
+            _new_vec_id_to_group_id[id] = group_id;
+            ++id;
          }
-         _group_id_to_range[group_id].second = new_vec_id;
       }
 
-      // reorder the underlying storage
+      // reorder the underlying storage in place
       _base_storage->reorder_data(_new_to_old_vec_ids);
+      _segment_start = _num_points;
+      _group_id_to_segment_ids.assign(_num_groups + 1, std::vector<IdxType>());
 
       // init storage and graph for each group
       _group_storages.resize(_num_groups + 1);
@@ -250,6 +351,9 @@ namespace ANNS
 
             // if there are less than _max_degree points in the group, just build a complete graph
             const auto &range = _group_id_to_range[group_id];
+            TraceScope scope(_build_trace.get(), "vamana_group", "group");
+            scope.arg("group_id", group_id);
+            scope.arg("num_points", range.second - range.first);
             if (range.second - range.first <= _max_degree)
             {
                build_complete_graph(_group_graphs[group_id], range.second - range.first);
@@ -310,12 +414,13 @@ namespace ANNS
       _attr_to_id.clear();
       _id_to_attr.clear();
       _vector_attr_graph.clear();
+      _label_postings_rb.clear();
 
       // 第一遍：收集所有唯一属性并分配ID
       AtrType attr_id = 0;
       for (IdxType vec_id = 0; vec_id < _num_points; ++vec_id)
       {
-         const auto &label_set = _base_storage->get_label_set(vec_id);
+         auto label_set = _base_storage->get_label_span(vec_id);
          for (const auto &label : label_set)
          {
             if (_attr_to_id.find(label) == _attr_to_id.end())
@@ -333,7 +438,7 @@ namespace ANNS
       // 第二遍：构建图结构
       for (IdxType vec_id = 0; vec_id < _num_points; ++vec_id)
       {
-         const auto &label_set = _base_storage->get_label_set(vec_id);
+         auto label_set = _base_storage->get_label_span(vec_id);
          for (const auto &label : label_set)
          {
             AtrType a_id = _attr_to_id[label];
@@ -539,6 +644,7 @@ namespace ANNS
 
       // 4. 读取邻接表数据
       _vector_attr_graph.clear();
+      _label_postings_rb.clear();
 
       // 4.1 读取节点总数
       uint64_t total_nodes;
@@ -940,6 +1046,20 @@ namespace ANNS
       auto start_time = std::chrono::high_resolution_clock::now();
       _label_nav_graph = std::make_shared<LabelNavGraph>(_num_groups + 1);
       omp_set_num_threads(_num_threads);
+      compute_label_nav_graph_edges();
+
+      _build_LNG_time = std::chrono::duration<double, std::milli>(
+                            std::chrono::high_resolution_clock::now() - start_time)
+                            .count();
+      std::cout << "\r- Finished in " << _build_LNG_time << " ms" << std::endl;
+   }
+
+   // out-neighbors of a group are its minimum super sets, also used to restore the LNG edges of a loaded index
+   void UniNavGraph::compute_label_nav_graph_edges()
+   {
+      size_t num_nodes = std::max(_label_nav_graph->out_neighbors.size(), static_cast<size_t>(_num_groups) + 1);
+      _label_nav_graph->out_neighbors.assign(num_nodes, std::vector<IdxType>());
+      _label_nav_graph->in_neighbors.assign(num_nodes, std::vector<IdxType>());
 
 // obtain out-neighbors
 #pragma omp parallel for schedule(dynamic, 256)
@@ -956,11 +1076,7 @@ namespace ANNS
       for (auto group_id = 1; group_id <= _num_groups; ++group_id)
          for (auto each : _label_nav_graph->out_neighbors[group_id])
             _label_nav_graph->in_neighbors[each].emplace_back(group_id);
-
-      _build_LNG_time = std::chrono::duration<double, std::milli>(
-                            std::chrono::high_resolution_clock::now() - start_time)
-                            .count();
-      std::cout << "\r- Finished in " << _build_LNG_time << " ms" << std::endl;
+      _lng_edges_ready = true;
    }
 
    // fxy_add : 打印信息的build_label_nav_graph
@@ -1049,7 +1165,7 @@ namespace ANNS
          _covered_sets_bits[group_id].resize(_num_points);
 
          // 填充后代的group的集合
-         const auto &descendants = _label_nav_graph->_lng_descendants[group_id];
+         const auto &descendants = _label_nav_graph->_lng_descendants[group_id - 1]; // indexed from group 1
          for (auto id : descendants)
          {
             _lng_descendants_bits[group_id].set(id);
@@ -1076,7 +1192,7 @@ namespace ANNS
       for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
       {
          // std::cout << "group_id: " << group_id << std::endl;
-         const auto &descendants = _label_nav_graph->_lng_descendants[group_id];
+         const auto &descendants = _label_nav_graph->_lng_descendants[group_id - 1]; // indexed from group 1
          const auto &coverage = _label_nav_graph->covered_sets[group_id];
 
          // 初始化后代 bitset
@@ -1143,9 +1259,14 @@ namespace ANNS
                }
 
                // for each in-neighbor group
+               TraceScope scope(_build_trace.get(), "cross_edges_group", "group");
+               scope.arg("group_id", group_id);
+               scope.arg("num_in_groups", _label_nav_graph->in_neighbors[group_id].size());
+               IdxType num_queries = 0;
                for (auto in_group_id : _label_nav_graph->in_neighbors[group_id])
                {
                   const auto &range = _group_id_to_range[in_group_id];
+                  num_queries += range.second - range.first;
 
 // take each vector in the group as the query
 #pragma omp parallel for schedule(dynamic, 1)
@@ -1162,6 +1283,7 @@ namespace ANNS
                      search_cache_list.release_cache(search_cache);
                   }
                }
+               scope.arg("num_queries", num_queries);
 
                // if none of the above
             }
@@ -1174,6 +1296,7 @@ namespace ANNS
       }
 
       // add additional edges
+      auto phase_start = BuildTrace::Clock::now();
       std::vector<std::vector<std::pair<IdxType, IdxType>>> additional_edges(_num_groups + 1);
 #pragma omp parallel for schedule(dynamic, 256)
       for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
@@ -1207,7 +1330,11 @@ namespace ANNS
             }
       }
 
+      if (_build_trace)
+         _build_trace->add_span("additional_edges", "subphase", phase_start);
+
       // add offset for uni-nav graph
+      phase_start = BuildTrace::Clock::now();
       add_offset_for_uni_nav_graph();
 
 // merge cross-group edges
@@ -1223,6 +1350,8 @@ namespace ANNS
          for (const auto &[from_id, to_id] : additional_edges[group_id])
             _graph->neighbors[from_id].emplace_back(to_id);
       }
+      if (_build_trace)
+         _build_trace->add_span("merge_cross_edges", "subphase", phase_start);
 
       _build_cross_edges_time = std::chrono::duration<double, std::milli>(
                                     std::chrono::high_resolution_clock::now() - start_time)
@@ -1233,7 +1362,7 @@ namespace ANNS
    void UniNavGraph::search(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
                             uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario,
                             IdxType K, std::pair<IdxType, float> *results, std::vector<float> &num_cmps,
-                            std::vector<std::bitset<10000001>> &bitmap)
+                            std::vector<QueryStats> &query_stats, std::vector<std::bitset<10000001>> &bitmap)
    {
       auto num_queries = query_storage->get_num_points();
       _query_storage = query_storage;
@@ -1246,13 +1375,23 @@ namespace ANNS
          std::cerr << "Error: K should be less than or equal to Lsearch" << std::endl;
          exit(-1);
       }
-      SearchCacheList search_cache_list(num_threads, _num_points, Lsearch);
+      query_stats.assign(num_queries, QueryStats());
+      auto snapshot = std::atomic_load(&_snapshot);
+
+      // NUMA: the threads are pinned to the nodes and get the caches of their node
+      bool use_replicas = _numa_policy != NumaPolicy::NONE && _numa_snapshot == snapshot;
+      if (use_replicas)
+         pin_omp_threads(num_threads);
+      NodeSearchCacheLists search_cache_lists(use_replicas ? _numa_replicas.size() : 1, num_threads, _num_points, Lsearch);
 
       // run queries
       omp_set_num_threads(num_threads);
 #pragma omp parallel for schedule(dynamic, 1)
       for (auto id = 0; id < num_queries; ++id)
       {
+         auto start_time = std::chrono::high_resolution_clock::now();
+         auto local = get_search_data(*snapshot);
+         auto &search_cache_list = search_cache_lists.get(local.node);
          auto search_cache = search_cache_list.get_free_cache();
          const char *query = _query_storage->get_vector(id);
          SearchQueue cur_result;
@@ -1270,17 +1409,19 @@ namespace ANNS
                get_min_super_sets(_query_storage->get_label_set(id), entry_group_ids, false, false);
             else
                get_min_super_sets({}, entry_group_ids, true, true);
+            resolve_entry_groups(*snapshot, entry_group_ids);
 
             // for each entry group
             for (const auto &group_id : entry_group_ids)
             {
                std::vector<IdxType> entry_points;
-               get_entry_points_given_group_id(num_entry_points, search_cache->visited_set, group_id, entry_points);
+               get_entry_points_given_group_id(*snapshot, num_entry_points, search_cache->visited_set, group_id, entry_points);
 
                // graph search and dump to current result
-               num_cmps[id] += iterate_to_fixed_point(query, search_cache, id, entry_points, true, false);
-               for (auto k = 0; k < search_cache->search_queue.size() && k < K; ++k)
-                  cur_result.insert(search_cache->search_queue[k].id, search_cache->search_queue[k].distance);
+               num_cmps[id] += iterate_to_fixed_point(*local.graph, *local.storage, query, search_cache, id, entry_points, true, false);
+               for (auto k = 0; k < search_cache->search_queue.size(); ++k)
+                  if (!_tombstones.check(search_cache->search_queue[k].id))
+                     cur_result.insert(search_cache->search_queue[k].id, search_cache->search_queue[k].distance);
             }
 
             // for the other scenarios: containment, equality
@@ -1289,37 +1430,230 @@ namespace ANNS
          {
 
             // obtain entry points
-            auto entry_points = get_entry_points(_query_storage->get_label_set(id), num_entry_points, search_cache->visited_set);
+            auto entry_points = get_entry_points(*snapshot, _query_storage->get_label_set(id), num_entry_points, search_cache->visited_set);
             if (entry_points.empty())
             {
                num_cmps[id] = 0;
                for (auto k = 0; k < K; ++k)
                   results[id * K + k].first = -1;
+               query_stats[id].time_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+               search_cache_list.release_cache(search_cache);
                continue;
             }
 
             // graph search
-            num_cmps[id] = iterate_to_fixed_point(query, search_cache, id, entry_points);
+            num_cmps[id] = iterate_to_fixed_point(*local.graph, *local.storage, query, search_cache, id, entry_points);
             cur_result = search_cache->search_queue;
          }
 
-         // write results
-         for (auto k = 0; k < K; ++k)
-         {
-            if (k < cur_result.size())
+         // write results, deleted points only route the search
+         IdxType num_results = 0;
+         for (auto k = 0; k < cur_result.size() && num_results < K; ++k)
+            if (!_tombstones.check(cur_result[k].id))
             {
-               results[id * K + k].first = _new_to_old_vec_ids[cur_result[k].id];
-               results[id * K + k].second = cur_result[k].distance;
+               results[id * K + num_results].first = _new_to_old_vec_ids[cur_result[k].id];
+               results[id * K + num_results].second = cur_result[k].distance;
+               num_results++;
             }
-            else
-               results[id * K + k].first = -1;
-         }
+         for (; num_results < K; ++num_results)
+            results[id * K + num_results].first = -1;
+         query_stats[id].time_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+         query_stats[id].num_distance_calcs = num_cmps[id];
 
          // clean
          search_cache_list.release_cache(search_cache);
       }
    }
 
+   // =====================================begin 查询内并行=========================================
+   void UniNavGraph::search_intra_query(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                                        uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points, std::string scenario,
+                                        IdxType K, std::pair<IdxType, float> *results, std::vector<float> &num_cmps,
+                                        std::vector<QueryStats> &query_stats)
+   {
+      auto num_queries = query_storage->get_num_points();
+      _query_storage = query_storage;
+      _distance_handler = distance_handler;
+      _scenario = scenario;
+
+      // preparation
+      if (K > Lsearch)
+      {
+         std::cerr << "Error: K should be less than or equal to Lsearch" << std::endl;
+         exit(-1);
+      }
+      num_threads = std::max<uint32_t>(num_threads, 1);
+      query_stats.assign(num_queries, QueryStats());
+      auto snapshot = std::atomic_load(&_snapshot);
+      auto local = get_search_data(*snapshot);
+      SearchCacheList search_cache_list(num_threads + 1, _num_points, Lsearch);
+      auto entry_cache = search_cache_list.get_free_cache(); // samples the entry points
+      ConcurrentVisitedSet visited_set;
+      visited_set.init(_num_points);
+      SearchQueue search_queue;
+      search_queue.reserve(Lsearch);
+      bool per_group = scenario == "overlap" || scenario == "nofilter";
+
+      for (IdxType id = 0; id < num_queries; ++id)
+      {
+         auto start_time = std::chrono::high_resolution_clock::now();
+         const char *query = _query_storage->get_vector(id);
+         SearchQueue cur_result;
+         cur_result.reserve(K);
+         num_cmps[id] = 0;
+         entry_cache->visited_set.clear();
+
+         // obtain entry groups for overlap and nofilter
+         std::vector<IdxType> entry_group_ids;
+         if (scenario == "overlap")
+            get_min_super_sets(_query_storage->get_label_set(id), entry_group_ids, false, false);
+         else if (scenario == "nofilter")
+            get_min_super_sets({}, entry_group_ids, true, true);
+         resolve_entry_groups(*snapshot, entry_group_ids);
+
+         if (per_group && entry_group_ids.size() >= num_threads)
+         {
+            // groups on different threads, merged afterwards; as in search, the groups of the query share one visited
+            // set, so a point reached from several groups is expanded once (which group expands it depends on timing)
+            std::vector<std::vector<IdxType>> group_entry_points(entry_group_ids.size());
+            for (size_t i = 0; i < entry_group_ids.size(); ++i)
+               get_entry_points_given_group_id(*snapshot, num_entry_points, entry_cache->visited_set, entry_group_ids[i],
+                                               group_entry_points[i]);
+            visited_set.clear();
+            std::vector<SearchQueue> thread_results(num_threads);
+            std::vector<IdxType> thread_cmps(num_threads, 0);
+            for (auto &thread_result : thread_results)
+               thread_result.reserve(K);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+            for (size_t i = 0; i < entry_group_ids.size(); ++i)
+            {
+               auto thread_id = omp_get_thread_num();
+               auto search_cache = search_cache_list.get_free_cache();
+               auto &group_queue = search_cache->search_queue;
+               thread_cmps[thread_id] += iterate_to_fixed_point_parallel(*local.graph, *local.storage, query, group_queue,
+                                                                         visited_set, group_entry_points[i], 1);
+               for (auto k = 0; k < group_queue.size(); ++k)
+                  if (!_tombstones.check(group_queue[k].id))
+                     thread_results[thread_id].insert(group_queue[k].id, group_queue[k].distance);
+               search_cache_list.release_cache(search_cache);
+            }
+            for (uint32_t thread_id = 0; thread_id < num_threads; ++thread_id)
+            {
+               num_cmps[id] += thread_cmps[thread_id];
+               for (auto k = 0; k < thread_results[thread_id].size(); ++k)
+                  cur_result.insert(thread_results[thread_id][k].id, thread_results[thread_id][k].distance);
+            }
+         }
+         else if (per_group)
+         {
+            // few groups: one after another, each by all the workers
+            visited_set.clear();
+            for (const auto &group_id : entry_group_ids)
+            {
+               std::vector<IdxType> entry_points;
+               get_entry_points_given_group_id(*snapshot, num_entry_points, entry_cache->visited_set, group_id, entry_points);
+               num_cmps[id] += iterate_to_fixed_point_parallel(*local.graph, *local.storage, query, search_queue, visited_set,
+                                                               entry_points, num_threads);
+               for (auto k = 0; k < search_queue.size(); ++k)
+                  if (!_tombstones.check(search_queue[k].id))
+                     cur_result.insert(search_queue[k].id, search_queue[k].distance);
+            }
+         }
+         else
+         {
+            // containment, equality: one search from the entry points of all the groups
+            auto entry_points = get_entry_points(*snapshot, _query_storage->get_label_set(id), num_entry_points, entry_cache->visited_set);
+            if (!entry_points.empty())
+            {
+               visited_set.clear();
+               num_cmps[id] = iterate_to_fixed_point_parallel(*local.graph, *local.storage, query, search_queue, visited_set,
+                                                              entry_points, num_threads);
+               cur_result = search_queue;
+            }
+         }
+
+         // write results, deleted points only route the search
+         IdxType num_results = 0;
+         for (auto k = 0; k < cur_result.size() && num_results < K; ++k)
+            if (!_tombstones.check(cur_result[k].id))
+            {
+               results[id * K + num_results].first = _new_to_old_vec_ids[cur_result[k].id];
+               results[id * K + num_results].second = cur_result[k].distance;
+               num_results++;
+            }
+         for (; num_results < K; ++num_results)
+            results[id * K + num_results].first = -1;
+
+         query_stats[id].time_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+         query_stats[id].num_distance_calcs = num_cmps[id];
+      }
+   }
+
+   IdxType UniNavGraph::iterate_to_fixed_point_parallel(const Graph &graph, IStorage &storage, const char *query, SearchQueue &search_queue,
+                                                        ConcurrentVisitedSet &visited_set, const std::vector<IdxType> &entry_points,
+                                                        uint32_t num_threads)
+   {
+      auto dim = storage.get_dim();
+      search_queue.clear();
+
+      // entry point, inserted even when an earlier search of the query visited it, as in iterate_to_fixed_point
+      for (const auto &entry_point : entry_points)
+      {
+         visited_set.test_and_set(entry_point);
+         search_queue.insert(entry_point, _distance_handler->compute(query, storage.get_vector(entry_point), dim));
+      }
+      std::atomic<IdxType> num_cmps(entry_points.size());
+
+      // each worker takes the closest unexpanded node, computes the distances of its unvisited neighbors without the
+      // lock and inserts them at once; idle workers sleep until an expansion ends, the search ends when no node is
+      // left and no worker is expanding one
+      std::mutex queue_mutex;
+      std::condition_variable queue_changed;
+      uint32_t num_expanding = 0;
+#pragma omp parallel num_threads(num_threads)
+      {
+         std::vector<Candidate> candidates;
+         IdxType local_cmps = 0;
+         std::unique_lock<std::mutex> lock(queue_mutex);
+         while (true)
+         {
+            queue_changed.wait(lock, [&]
+                               { return search_queue.has_unexpanded_node() || num_expanding == 0; });
+            if (!search_queue.has_unexpanded_node())
+               break;
+            IdxType cur_id = search_queue.get_closest_unexpanded().id;
+            num_expanding++;
+            lock.unlock();
+
+            // iterate neighbors
+            candidates.clear();
+            auto neighbors = graph.get_neighbors(cur_id);
+            for (auto i = 0; i < neighbors.size(); ++i)
+            {
+               if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
+                  storage.prefetch_vec_by_id(neighbors[i + 1]);
+               auto neighbor = neighbors[i];
+               if (visited_set.test_and_set(neighbor))
+                  continue;
+               candidates.emplace_back(neighbor, _distance_handler->compute(query, storage.get_vector(neighbor), dim));
+            }
+            local_cmps += candidates.size();
+
+            // push to search queue
+            lock.lock();
+            for (const auto &candidate : candidates)
+               search_queue.insert(candidate.id, candidate.distance);
+            num_expanding--;
+            if (!candidates.empty() || num_expanding == 0)
+               queue_changed.notify_all();
+         }
+         lock.unlock();
+         num_cmps += local_cmps;
+      }
+      return num_cmps;
+   }
+   // =====================================end 查询内并行=========================================
+
    // fxy_add
    void UniNavGraph::search_hybrid(std::shared_ptr<IStorage> query_storage,
                                    std::shared_ptr<DistanceHandler> distance_handler,
@@ -1329,7 +1663,9 @@ namespace ANNS
                                    std::vector<float> &num_cmps,
                                    std::vector<QueryStats> &query_stats,
                                    std::vector<std::bitset<10000001>> &bitmaps,
-                                   bool is_ori_ung)
+                                   bool is_ori_ung,
+                                   bool collect_perf_counters,
+                                   const std::vector<std::vector<NumericRange>> &query_ranges)
    {
       auto num_queries = query_storage->get_num_points();
       _query_storage = query_storage;
@@ -1349,14 +1685,57 @@ namespace ANNS
       // 搜索参数
       const float COVERAGE_THRESHOLD = 0.8f;
       const int MIN_LNG_DESCENDANTS_THRESHOLD = _num_points / 2.5;
-      SearchCacheList search_cache_list(num_threads, _num_points, Lsearch);
+      auto snapshot = std::atomic_load(&_snapshot);
+      const auto &covered_sets_rb = *snapshot->covered_sets_rb;
+
+      bool has_global_graph = snapshot->global_entry_point < _num_points &&
+                              snapshot->global_graph->get_neighbors(snapshot->global_entry_point).size() > 0;
+
+      // 数值范围条件, 只支持 containment 和 equality
+      if (!query_ranges.empty())
+      {
+         if (query_ranges.size() != num_queries || (scenario != "containment" && scenario != "equality"))
+         {
+            std::cerr << "Error: numeric ranges need one line per query and the containment or equality scenario" << std::endl;
+            exit(-1);
+         }
+         for (const auto &ranges : query_ranges)
+            for (const auto &range : ranges)
+               if (range.column >= _base_storage->get_num_numeric_attrs())
+               {
+                  std::cerr << "Error: numeric attribute column " << range.column << " out of range" << std::endl;
+                  exit(-1);
+               }
+         omp_set_num_threads(num_threads);
+         prepare_numeric_indexes();
+      }
+
+      // 每个线程一组硬件计数器, 由该线程自己打开
+      std::vector<std::unique_ptr<PerfCounters>> perf_counters(collect_perf_counters ? num_threads : 0);
+
+      // NUMA: 线程绑定到各节点, 使用本节点的数据副本和缓存
+      bool use_replicas = _numa_policy != NumaPolicy::NONE && _numa_snapshot == snapshot;
+      if (use_replicas)
+         pin_omp_threads(num_threads);
+      NodeSearchCacheLists search_cache_lists(use_replicas ? _numa_replicas.size() : 1, num_threads, _num_points, Lsearch);
 
       // 并行查询处理
       omp_set_num_threads(num_threads);
 #pragma omp parallel for schedule(dynamic, 1)
       for (auto id = 0; id < num_queries; ++id)
       {
+         auto local = get_search_data(*snapshot);
+         auto &search_cache_list = search_cache_lists.get(local.node);
          auto &stats = query_stats[id];
+         PerfCounters *counters = nullptr;
+         if (collect_perf_counters)
+         {
+            auto &thread_counters = perf_counters[omp_get_thread_num()];
+            if (!thread_counters)
+               thread_counters = std::make_unique<PerfCounters>();
+            counters = thread_counters.get();
+            counters->start();
+         }
          auto total_search_start_time = std::chrono::high_resolution_clock::now();
 
          auto search_cache = search_cache_list.get_free_cache();
@@ -1366,14 +1745,11 @@ namespace ANNS
 
          // 获取查询标签集
          const auto &query_labels = _query_storage->get_label_set(id);
-         for (auto i = 0; i < query_labels.size(); ++i)
-         {
-            std::cout << query_labels[i] << " ";
-         }
 
          // 计算入口组信息
          std::vector<IdxType> entry_group_ids;
          get_min_super_sets(query_labels, entry_group_ids, true, true);
+         resolve_entry_groups(*snapshot, entry_group_ids);
          stats.num_entry_points = entry_group_ids.size();
 
          // 使用局部作用域限制变量生命周期
@@ -1405,14 +1781,37 @@ namespace ANNS
             {
                if (group_id > 0 && group_id <= _num_groups)
                {
-                  combined_coverage |= _covered_sets_rb[group_id];
+                  combined_coverage |= covered_sets_rb[group_id];
                }
             }
             auto cov_end = std::chrono::high_resolution_clock::now();
             stats.coverage_merge_time_ms = std::chrono::duration<double, std::milli>(cov_end - cov_start).count();
-            return static_cast<float>(combined_coverage.cardinality()) / _num_points;
+            return static_cast<float>(combined_coverage.cardinality()) / snapshot->num_live_points;
          }();
 
+         // 3. 数值范围与标签条件求交, 覆盖率按交集计算
+         roaring::Roaring filter;
+         bool has_ranges = !query_ranges.empty() && !query_ranges[id].empty();
+         stats.num_filter_matches = 0;
+         if (has_ranges)
+         {
+            std::vector<IdxType> label_group_ids;
+            if (scenario == "equality")
+            {
+               auto node = _trie_index.find_exact_match(query_labels);
+               if (node != nullptr && !snapshot->group_redirects.count(node->group_id))
+                  label_group_ids.push_back(node->group_id);
+            }
+            else
+            {
+               get_min_super_sets(query_labels, label_group_ids);
+               resolve_entry_groups(*snapshot, label_group_ids);
+            }
+            filter = get_group_points(label_group_ids, scenario != "equality") & get_range_set(query_ranges[id]);
+            stats.num_filter_matches = filter.cardinality();
+            total_unique_coverage = static_cast<float>(stats.num_filter_matches) / snapshot->num_live_points;
+         }
+
          stats.entry_group_total_coverage = total_unique_coverage;
          bool use_global_search = (total_unique_coverage > COVERAGE_THRESHOLD) ||
                                   (stats.num_lng_descendants > MIN_LNG_DESCENDANTS_THRESHOLD);
@@ -1421,21 +1820,39 @@ namespace ANNS
                                   std::chrono::high_resolution_clock::now() - flag_start_time)
                                   .count();
 
-         if (is_ori_ung)
+         if (is_ori_ung || (has_ranges && !has_global_graph))
             use_global_search = false;
          stats.is_global_search = use_global_search;
 
          // 4. 执行搜索
-         if (use_global_search)
+         if (has_ranges && stats.num_filter_matches <= Lsearch)
+         {
+            // 4.0 满足条件的点不多于 Lsearch, 直接计算距离
+            auto dim = local.storage->get_dim();
+            for (auto vec_id : filter)
+               if (!_tombstones.check(vec_id))
+                  cur_result.insert(vec_id, _distance_handler->compute(query, local.storage->get_vector(vec_id), dim));
+            num_cmps[id] = stats.num_filter_matches;
+            stats.num_distance_calcs = num_cmps[id];
+         }
+         else if (use_global_search && has_ranges)
+         {
+            // 4.1 全局图搜索, 收集访问到的满足条件的点
+            search_cache->visited_set.clear();
+            num_cmps[id] = iterate_to_fixed_point_filtered(*local.global_graph, *local.storage, query, search_cache,
+                                                           {snapshot->global_entry_point}, filter, cur_result);
+            stats.num_distance_calcs = num_cmps[id];
+         }
+         else if (use_global_search)
          {
             // 4.1 全局图搜索模式
             search_cache->visited_set.clear();
 
             // 获取全局入口点
             std::vector<IdxType> global_entry_points;
-            if (_global_vamana_entry_point != -1)
+            if (snapshot->global_entry_point != -1)
             {
-               global_entry_points.push_back(_global_vamana_entry_point);
+               global_entry_points.push_back(snapshot->global_entry_point);
             }
             else
             {
@@ -1447,7 +1864,7 @@ namespace ANNS
             }
 
             // 记录初始距离计算次数
-            num_cmps[id] = iterate_to_fixed_point_global(query, search_cache, id, global_entry_points);
+            num_cmps[id] = iterate_to_fixed_point_global(*local.global_graph, *local.storage, query, search_cache, id, global_entry_points);
             stats.num_distance_calcs = num_cmps[id];
 
             // 过滤结果
@@ -1455,9 +1872,11 @@ namespace ANNS
             for (size_t k = 0; k < search_cache->search_queue.size() && valid_count < K; k++)
             {
                auto candidate = search_cache->search_queue[k];
-               const auto &candidate_labels = _base_storage->get_label_set(candidate.id);
+               auto candidate_labels = _base_storage->get_label_span(candidate.id);
 
-               // 检查候选是否满足查询条件
+               // 检查候选是否满足查询条件, 已删除的点不返回
+               if (_tombstones.check(candidate.id))
+                  continue;
                bool is_valid = true;
                if (scenario == "equality")
                {
@@ -1496,7 +1915,7 @@ namespace ANNS
                for (const auto &group_id : entry_group_ids)
                {
                   std::vector<IdxType> group_entry_points;
-                  get_entry_points_given_group_id(num_entry_points,
+                  get_entry_points_given_group_id(*snapshot, num_entry_points,
                                                   search_cache->visited_set,
                                                   group_id,
                                                   group_entry_points);
@@ -1506,223 +1925,1569 @@ namespace ANNS
                }
 
                // 执行搜索
-               num_cmps[id] = iterate_to_fixed_point(query, search_cache, id,
+               num_cmps[id] = iterate_to_fixed_point(*local.graph, *local.storage, query, search_cache, id,
                                                      entry_points, true, false);
                stats.num_distance_calcs = num_cmps[id];
 
                // 收集结果
-               for (auto k = 0; k < search_cache->search_queue.size() && k < K; ++k)
+               for (auto k = 0; k < search_cache->search_queue.size(); ++k)
                {
-                  cur_result.insert(search_cache->search_queue[k].id,
-                                    search_cache->search_queue[k].distance);
+                  if (!_tombstones.check(search_cache->search_queue[k].id))
+                     cur_result.insert(search_cache->search_queue[k].id,
+                                       search_cache->search_queue[k].distance);
                }
             }
             else
             {
                // containment/equality场景
-               auto entry_points = get_entry_points(query_labels, num_entry_points,
+               auto entry_points = get_entry_points(*snapshot, query_labels, num_entry_points,
                                                     search_cache->visited_set);
                if (entry_points.empty())
                {
-                  stats.num_distance_calcs = 0;
-                  continue;
+                  // 没有匹配的 group, 结果为空, 仍记录时间和计数器
+                  num_cmps[id] = 0;
+               }
+               else if (has_ranges)
+               {
+                  num_cmps[id] = iterate_to_fixed_point_filtered(*local.graph, *local.storage, query, search_cache, entry_points,
+                                                                 filter, cur_result);
+               }
+               else
+               {
+                  num_cmps[id] = iterate_to_fixed_point(*local.graph, *local.storage, query, search_cache, id, entry_points);
+                  cur_result = search_cache->search_queue;
                }
-
-               num_cmps[id] = iterate_to_fixed_point(query, search_cache, id, entry_points);
                stats.num_distance_calcs = num_cmps[id];
-               cur_result = search_cache->search_queue;
             }
          }
 
-         // 5. 记录结果
-         for (auto k = 0; k < K; ++k)
+         // 5. 记录结果, 已删除的点只参与路由
+         IdxType num_results = 0;
+         for (auto k = 0; k < cur_result.size() && num_results < K; ++k)
          {
-            if (k < cur_result.size())
+            if (!_tombstones.check(cur_result[k].id))
             {
-               results[id * K + k].first = _new_to_old_vec_ids[cur_result[k].id];
-               results[id * K + k].second = cur_result[k].distance;
-            }
-            else
-            {
-               results[id * K + k].first = -1;
+               results[id * K + num_results].first = _new_to_old_vec_ids[cur_result[k].id];
+               results[id * K + num_results].second = cur_result[k].distance;
+               num_results++;
             }
          }
+         for (; num_results < K; ++num_results)
+         {
+            results[id * K + num_results].first = -1;
+            results[id * K + num_results].second = std::numeric_limits<float>::max();
+         }
 
          // 6. 记录统计信息
          stats.time_ms = std::chrono::duration<double, std::milli>(
                              std::chrono::high_resolution_clock::now() - total_search_start_time)
                              .count();
+         if (counters)
+            stats.perf = counters->stop();
 
          search_cache_list.release_cache(search_cache);
       }
    }
 
-   std::vector<IdxType> UniNavGraph::get_entry_points(const std::vector<LabelType> &query_label_set,
-                                                      IdxType num_entry_points, VisitedSet &visited_set)
+   // fxy_add: 布尔过滤表达式, 用标签的 posting list 把表达式编译成 roaring 集合
+   void UniNavGraph::search_filter(std::shared_ptr<IStorage> query_storage, std::shared_ptr<DistanceHandler> distance_handler,
+                                   uint32_t num_threads, IdxType Lsearch, IdxType num_entry_points,
+                                   const std::vector<FilterExpr> &filters, IdxType K, std::pair<IdxType, float> *results,
+                                   std::vector<float> &num_cmps, std::vector<QueryStats> &query_stats, bool is_ori_ung,
+                                   bool collect_perf_counters)
    {
-      std::vector<IdxType> entry_points;
-      entry_points.reserve(num_entry_points);
-      visited_set.clear();
-
-      // obtain entry points for label-equality scenario
-      if (_scenario == "equality")
-      {
-         auto node = _trie_index.find_exact_match(query_label_set);
-         if (node == nullptr)
-            return entry_points;
-         get_entry_points_given_group_id(num_entry_points, visited_set, node->group_id, entry_points);
-
-         // obtain entry points for label-containment scenario
-      }
-      else if (_scenario == "containment")
+      auto num_queries = query_storage->get_num_points();
+      _query_storage = query_storage;
+      _distance_handler = distance_handler;
+      query_stats.resize(num_queries);
+      if (K > Lsearch)
       {
-         std::vector<IdxType> min_super_set_ids;
-         get_min_super_sets(query_label_set, min_super_set_ids);
-         for (auto group_id : min_super_set_ids)
-            get_entry_points_given_group_id(num_entry_points, visited_set, group_id, entry_points);
+         std::cerr << "Error: K should be less than or equal to Lsearch" << std::endl;
+         exit(-1);
       }
-      else
+      if (filters.size() != num_queries)
       {
-         std::cerr << "Error: invalid scenario " << _scenario << std::endl;
+         std::cerr << "Error: " << filters.size() << " filters for " << num_queries << " queries" << std::endl;
          exit(-1);
       }
 
-      return entry_points;
-   }
-
-   void UniNavGraph::get_entry_points_given_group_id(IdxType num_entry_points, VisitedSet &visited_set,
-                                                     IdxType group_id, std::vector<IdxType> &entry_points)
-   {
-      const auto &group_range = _group_id_to_range[group_id];
+      // same routing thresholds as search_hybrid
+      const float COVERAGE_THRESHOLD = 0.8f;
+      const int MIN_LNG_DESCENDANTS_THRESHOLD = _num_points / 2.5;
+      auto snapshot = std::atomic_load(&_snapshot);
+      const auto &covered_sets_rb = *snapshot->covered_sets_rb;
+      bool has_global_graph = snapshot->global_entry_point < _num_points &&
+                              snapshot->global_graph->get_neighbors(snapshot->global_entry_point).size() > 0;
 
-      // not enough entry points, use all of them
-      if (group_range.second - group_range.first <= num_entry_points)
+      // posting lists and the set of all points for NOT
+      omp_set_num_threads(num_threads);
+      prepare_label_postings();
+      static const roaring::Roaring empty_posting;
+      auto posting_list = [&](LabelType label) -> const roaring::Roaring &
       {
-         for (auto i = 0; i < group_range.second - group_range.first; ++i)
-            entry_points.emplace_back(i + group_range.first);
-         return;
-      }
+         auto iter = _attr_to_id.find(label);
+         return iter == _attr_to_id.end() ? empty_posting : _label_postings_rb[iter->second];
+      };
+      roaring::Roaring universe;
+      universe.addRange(0, _num_points);
 
-      // add the entry point of the group
-      const auto &group_entry_point = _group_entry_points[group_id];
-      visited_set.set(group_entry_point);
-      entry_points.emplace_back(group_entry_point);
+      std::vector<std::unique_ptr<PerfCounters>> perf_counters(collect_perf_counters ? num_threads : 0);
 
-      // randomly sample the other entry points
-      for (auto i = 1; i < num_entry_points; ++i)
+      // NUMA: 线程绑定到各节点, 使用本节点的数据副本和缓存
+      bool use_replicas = _numa_policy != NumaPolicy::NONE && _numa_snapshot == snapshot;
+      if (use_replicas)
+         pin_omp_threads(num_threads);
+      NodeSearchCacheLists search_cache_lists(use_replicas ? _numa_replicas.size() : 1, num_threads, _num_points, Lsearch);
+
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (auto id = 0; id < num_queries; ++id)
       {
-         auto entry_point = rand() % (group_range.second - group_range.first) + group_range.first;
-         if (visited_set.check(entry_point) == false)
+         auto local = get_search_data(*snapshot);
+         auto &search_cache_list = search_cache_lists.get(local.node);
+         auto &stats = query_stats[id];
+         PerfCounters *counters = nullptr;
+         if (collect_perf_counters)
          {
-            visited_set.set(entry_point);
-            entry_points.emplace_back(i + group_range.first);
+            auto &thread_counters = perf_counters[omp_get_thread_num()];
+            if (!thread_counters)
+               thread_counters = std::make_unique<PerfCounters>();
+            counters = thread_counters.get();
+            counters->start();
          }
-      }
-   }
+         auto total_search_start_time = std::chrono::high_resolution_clock::now();
+         auto search_cache = search_cache_list.get_free_cache();
+         const char *query = _query_storage->get_vector(id);
+         SearchQueue cur_result;
+         cur_result.reserve(K);
 
-   IdxType UniNavGraph::iterate_to_fixed_point(const char *query, std::shared_ptr<SearchCache> search_cache,
-                                               IdxType target_id, const std::vector<IdxType> &entry_points,
-                                               bool clear_search_queue, bool clear_visited_set)
-   {
-      auto dim = _base_storage->get_dim();
-      auto &search_queue = search_cache->search_queue;
-      auto &visited_set = search_cache->visited_set;
-      std::vector<IdxType> neighbors;
-      if (clear_search_queue)
-         search_queue.clear();
-      if (clear_visited_set)
-         visited_set.clear();
+         // 1. 编译过滤表达式
+         auto flag_start_time = std::chrono::high_resolution_clock::now();
+         roaring::Roaring filter = filters[id].evaluate(posting_list, universe);
+         stats.num_filter_matches = filter.cardinality();
 
-      // entry point
-      for (const auto &entry_point : entry_points)
-         search_queue.insert(entry_point, _distance_handler->compute(query, _base_storage->get_vector(entry_point), dim));
-      IdxType num_cmps = entry_points.size();
+         // 2. 合取部分在 LNG 中的最小超集作为入口组, 去掉后代中没有满足表达式的组
+         std::vector<IdxType> entry_group_ids;
+         for (const auto &label_set : filters[id].get_conjunctive_label_sets())
+         {
+            std::vector<IdxType> group_ids;
+            if (label_set.empty())
+               get_min_super_sets({}, group_ids, true, true);
+            else
+               get_min_super_sets(label_set, group_ids);
+            entry_group_ids.insert(entry_group_ids.end(), group_ids.begin(), group_ids.end());
+         }
+         resolve_entry_groups(*snapshot, entry_group_ids);
+         entry_group_ids.erase(std::remove_if(entry_group_ids.begin(), entry_group_ids.end(), [&](IdxType group_id)
+                                              { return !has_matching_descendant(filters[id], group_id); }),
+                               entry_group_ids.end());
+         stats.num_entry_points = entry_group_ids.size();
 
-      // greedily expand closest nodes
-      while (search_queue.has_unexpanded_node())
-      {
-         const Candidate &cur = search_queue.get_closest_unexpanded();
+         // 3. 与 search_hybrid 相同的路由
+         roaring::Roaring combined_descendants, combined_coverage;
+         for (auto group_id : entry_group_ids)
+            if (group_id > 0 && group_id <= _num_groups)
+            {
+               combined_descendants |= _lng_descendants_rb[group_id];
+               combined_coverage |= covered_sets_rb[group_id];
+            }
+         stats.num_lng_descendants = combined_descendants.cardinality();
+         stats.entry_group_total_coverage = static_cast<float>(combined_coverage.cardinality()) / snapshot->num_live_points;
+         bool use_global_search = has_global_graph && !is_ori_ung &&
+                                  (stats.entry_group_total_coverage > COVERAGE_THRESHOLD ||
+                                   stats.num_lng_descendants > MIN_LNG_DESCENDANTS_THRESHOLD);
+         stats.is_global_search = use_global_search;
+         stats.flag_time_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::high_resolution_clock::now() - flag_start_time)
+                                  .count();
 
-         // iterate neighbors
+         // 4. 执行搜索
+         if (stats.num_filter_matches <= Lsearch)
          {
-            std::lock_guard<std::mutex> lock(_graph->neighbor_locks[cur.id]);
-            neighbors = _graph->neighbors[cur.id];
+            // 4.1 满足条件的点不多于 Lsearch, 直接计算距离
+            auto dim = local.storage->get_dim();
+            for (auto vec_id : filter)
+               if (!_tombstones.check(vec_id))
+                  cur_result.insert(vec_id, _distance_handler->compute(query, local.storage->get_vector(vec_id), dim));
+            num_cmps[id] = stats.num_filter_matches;
          }
-         for (auto i = 0; i < neighbors.size(); ++i)
+         else if (use_global_search)
          {
-
-            // prefetch
-            if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
-               _base_storage->prefetch_vec_by_id(neighbors[i + 1]);
-
-            // skip if visited
+            // 4.2 全局图搜索模式
+            search_cache->visited_set.clear();
+            num_cmps[id] = iterate_to_fixed_point_filtered(*local.global_graph, *local.storage, query, search_cache,
+                                                           {snapshot->global_entry_point}, filter, cur_result);
+         }
+         else
+         {
+            // 4.3 从各入口组出发在 UNG 上搜索
+            search_cache->visited_set.clear();
+            std::vector<IdxType> entry_points;
+            for (const auto &group_id : entry_group_ids)
+               get_entry_points_given_group_id(*snapshot, num_entry_points, search_cache->visited_set, group_id, entry_points);
+            num_cmps[id] = entry_points.empty() ? 0 : iterate_to_fixed_point_filtered(*local.graph, *local.storage, query, search_cache,
+                                                                                     entry_points, filter, cur_result);
+         }
+         stats.num_distance_calcs = num_cmps[id];
+
+         // 5. 记录结果
+         IdxType num_results = 0;
+         for (auto k = 0; k < cur_result.size() && num_results < K; ++k)
+         {
+            results[id * K + num_results].first = _new_to_old_vec_ids[cur_result[k].id];
+            results[id * K + num_results].second = cur_result[k].distance;
+            num_results++;
+         }
+         for (; num_results < K; ++num_results)
+            results[id * K + num_results].first = -1;
+
+         stats.time_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::high_resolution_clock::now() - total_search_start_time)
+                             .count();
+         if (counters)
+            stats.perf = counters->stop();
+         search_cache_list.release_cache(search_cache);
+      }
+   }
+
+   void UniNavGraph::prepare_label_postings()
+   {
+      std::lock_guard<std::mutex> lock(_label_postings_mutex);
+      if (_label_postings_rb.size() == _num_attributes)
+         return;
+      if (_vector_attr_graph.size() != static_cast<size_t>(_num_points) + _num_attributes)
+         throw std::runtime_error("the vector-attribute graph is not loaded");
+      _label_postings_rb.assign(_num_attributes, roaring::Roaring());
+#pragma omp parallel for schedule(dynamic, 64)
+      for (AtrType attr_id = 0; attr_id < _num_attributes; ++attr_id)
+      {
+         const auto &posting = _vector_attr_graph[_num_points + attr_id];
+         _label_postings_rb[attr_id].addMany(posting.size(), posting.data());
+         _label_postings_rb[attr_id].runOptimize();
+      }
+   }
+
+   // the group or one of its LNG descendants has a label set satisfying filter
+   bool UniNavGraph::has_matching_descendant(const FilterExpr &filter, IdxType group_id) const
+   {
+      if (filter.matches(_group_id_to_label_set[group_id]) || group_id >= _lng_descendants_rb.size())
+         return true;
+      for (auto descendant : _lng_descendants_rb[group_id])
+         if (filter.matches(_group_id_to_label_set[descendant]))
+            return true;
+      return false;
+   }
+
+   void UniNavGraph::prepare_numeric_indexes()
+   {
+      std::lock_guard<std::mutex> lock(_numeric_indexes_mutex);
+      IdxType num_columns = _base_storage->get_num_numeric_attrs();
+      if (_numeric_indexes.size() == num_columns)
+         return;
+      _numeric_indexes.assign(num_columns, NumericRangeIndex());
+#pragma omp parallel for schedule(dynamic, 1)
+      for (IdxType column = 0; column < num_columns; ++column)
+         _numeric_indexes[column].build(_base_storage, column);
+   }
+
+   // points satisfying all ranges, the most selective range first
+   roaring::Roaring UniNavGraph::get_range_set(const std::vector<NumericRange> &ranges) const
+   {
+      std::vector<roaring::Roaring> range_sets;
+      for (const auto &range : ranges)
+         range_sets.push_back(_numeric_indexes[range.column].range(range.lo, range.hi));
+      std::sort(range_sets.begin(), range_sets.end(), [](const roaring::Roaring &a, const roaring::Roaring &b)
+                { return a.cardinality() < b.cardinality(); });
+      roaring::Roaring result = std::move(range_sets[0]);
+      for (size_t i = 1; i < range_sets.size() && !result.isEmpty(); ++i)
+         result &= range_sets[i];
+      return result;
+   }
+
+   // points of the groups, and of their LNG descendants (super sets) if with_descendants
+   roaring::Roaring UniNavGraph::get_group_points(const std::vector<IdxType> &group_ids, bool with_descendants) const
+   {
+      roaring::Roaring groups;
+      for (auto group_id : group_ids)
+      {
+         groups.add(group_id);
+         if (with_descendants && group_id < _lng_descendants_rb.size())
+            groups |= _lng_descendants_rb[group_id];
+      }
+      roaring::Roaring points;
+      for (auto group_id : groups)
+      {
+         const auto &range = _group_id_to_range[group_id];
+         if (range.first < range.second)
+            points.addRange(range.first, range.second);
+         if (group_id < _group_id_to_segment_ids.size())
+            points.addMany(_group_id_to_segment_ids[group_id].size(), _group_id_to_segment_ids[group_id].data());
+      }
+      return points;
+   }
+
+   IdxType UniNavGraph::count_matching_points(const std::vector<LabelType> &query_label_set, const std::string &scenario)
+   {
+      auto snapshot = std::atomic_load(&_snapshot);
+      if (scenario == "nofilter")
+         return snapshot->num_live_points;
+
+      // equality: the points of the exact group
+      if (scenario == "equality")
+      {
+         auto node = _trie_index.find_exact_match(query_label_set);
+         if (node == nullptr || snapshot->group_redirects.count(node->group_id))
+            return 0;
+         return get_group_points({node->group_id}, false).cardinality();
+      }
+
+      // containment and overlap: union of the covered sets of the entry groups
+      std::vector<IdxType> entry_group_ids;
+      get_min_super_sets(query_label_set, entry_group_ids, false, scenario != "overlap");
+      resolve_entry_groups(*snapshot, entry_group_ids);
+      std::vector<const roaring::Roaring *> covered_sets;
+      for (auto group_id : entry_group_ids)
+         covered_sets.push_back(&(*snapshot->covered_sets_rb)[group_id]);
+      if (covered_sets.empty())
+         return 0;
+      return roaring::Roaring::fastunion(covered_sets.size(), covered_sets.data()).cardinality();
+   }
+
+   std::vector<IdxType> UniNavGraph::get_entry_points(const SearchSnapshot &snapshot, const std::vector<LabelType> &query_label_set,
+                                                      IdxType num_entry_points, VisitedSet &visited_set)
+   {
+      std::vector<IdxType> entry_points;
+      entry_points.reserve(num_entry_points);
+      visited_set.clear();
+
+      // obtain entry points for label-equality scenario
+      if (_scenario == "equality")
+      {
+         auto node = _trie_index.find_exact_match(query_label_set);
+         if (node == nullptr || snapshot.group_redirects.count(node->group_id))
+            return entry_points;
+         get_entry_points_given_group_id(snapshot, num_entry_points, visited_set, node->group_id, entry_points);
+
+         // obtain entry points for label-containment scenario
+      }
+      else if (_scenario == "containment")
+      {
+         std::vector<IdxType> min_super_set_ids;
+         get_min_super_sets(query_label_set, min_super_set_ids);
+         resolve_entry_groups(snapshot, min_super_set_ids);
+         for (auto group_id : min_super_set_ids)
+            get_entry_points_given_group_id(snapshot, num_entry_points, visited_set, group_id, entry_points);
+      }
+      else
+      {
+         std::cerr << "Error: invalid scenario " << _scenario << std::endl;
+         exit(-1);
+      }
+
+      return entry_points;
+   }
+
+   std::vector<IdxType> UniNavGraph::get_query_entry_points(const std::vector<LabelType> &query_label_set, const std::string &scenario,
+                                                            IdxType num_entry_points, VisitedSet &visited_set)
+   {
+      auto snapshot = std::atomic_load(&_snapshot);
+      std::vector<IdxType> entry_points, entry_group_ids;
+      visited_set.clear();
+
+      // entry groups of the scenario, all of them feed the same search
+      if (scenario == "equality")
+      {
+         auto node = _trie_index.find_exact_match(query_label_set);
+         if (node == nullptr || snapshot->group_redirects.count(node->group_id))
+            return entry_points;
+         entry_group_ids.push_back(node->group_id);
+      }
+      else if (scenario == "containment" || scenario == "overlap" || scenario == "nofilter")
+      {
+         if (scenario == "containment")
+            get_min_super_sets(query_label_set, entry_group_ids);
+         else if (scenario == "overlap")
+            get_min_super_sets(query_label_set, entry_group_ids, false, false);
+         else
+            get_min_super_sets({}, entry_group_ids, true, true);
+         resolve_entry_groups(*snapshot, entry_group_ids);
+      }
+      else
+      {
+         std::cerr << "Error: invalid scenario " << scenario << std::endl;
+         exit(-1);
+      }
+
+      for (auto group_id : entry_group_ids)
+         get_entry_points_given_group_id(*snapshot, num_entry_points, visited_set, group_id, entry_points);
+      return entry_points;
+   }
+
+   void UniNavGraph::get_entry_points_given_group_id(const SearchSnapshot &snapshot, IdxType num_entry_points, VisitedSet &visited_set,
+                                                     IdxType group_id, std::vector<IdxType> &entry_points)
+   {
+      const auto &group_range = _group_id_to_range[group_id];
+      static const std::vector<IdxType> empty_segment;
+      const auto &segment_ids = group_id < _group_id_to_segment_ids.size() ? _group_id_to_segment_ids[group_id] : empty_segment;
+
+      // not enough entry points, use all of them
+      if (group_range.second - group_range.first + segment_ids.size() <= num_entry_points)
+      {
+         for (auto i = 0; i < group_range.second - group_range.first; ++i)
+            entry_points.emplace_back(i + group_range.first);
+         entry_points.insert(entry_points.end(), segment_ids.begin(), segment_ids.end());
+         return;
+      }
+
+      // groups created by inserts only have points in the segment
+      if (group_range.first == group_range.second)
+      {
+         const auto &group_entry_point = snapshot.group_entry_points[group_id];
+         visited_set.set(group_entry_point);
+         entry_points.emplace_back(group_entry_point);
+         for (auto i = 1; i < num_entry_points; ++i)
+         {
+            auto entry_point = segment_ids[rand() % segment_ids.size()];
+            if (visited_set.check(entry_point) == false && !_tombstones.check(entry_point))
+            {
+               visited_set.set(entry_point);
+               entry_points.emplace_back(entry_point);
+            }
+         }
+         return;
+      }
+
+      // add the entry point of the group
+      const auto &group_entry_point = snapshot.group_entry_points[group_id];
+      visited_set.set(group_entry_point);
+      entry_points.emplace_back(group_entry_point);
+
+      // randomly sample the other entry points
+      for (auto i = 1; i < num_entry_points; ++i)
+      {
+         auto entry_point = rand() % (group_range.second - group_range.first) + group_range.first;
+         if (visited_set.check(entry_point) == false && !_tombstones.check(entry_point))
+         {
+            visited_set.set(entry_point);
+            entry_points.emplace_back(entry_point);
+         }
+      }
+   }
+
+   IdxType UniNavGraph::iterate_to_fixed_point(const Graph &graph, IStorage &storage, const char *query,
+                                               std::shared_ptr<SearchCache> search_cache, IdxType target_id, const std::vector<IdxType> &entry_points,
+                                               bool clear_search_queue, bool clear_visited_set)
+   {
+      auto dim = storage.get_dim();
+      auto &search_queue = search_cache->search_queue;
+      auto &visited_set = search_cache->visited_set;
+      if (clear_search_queue)
+         search_queue.clear();
+      if (clear_visited_set)
+         visited_set.clear();
+
+      // entry point
+      for (const auto &entry_point : entry_points)
+         search_queue.insert(entry_point, _distance_handler->compute(query, storage.get_vector(entry_point), dim));
+      IdxType num_cmps = entry_points.size();
+
+      // greedily expand closest nodes
+      while (search_queue.has_unexpanded_node())
+      {
+         const Candidate &cur = search_queue.get_closest_unexpanded();
+
+         // iterate neighbors, the snapshot is not modified while searches run
+         auto neighbors = graph.get_neighbors(cur.id);
+         for (auto i = 0; i < neighbors.size(); ++i)
+         {
+
+            // prefetch
+            if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
+               storage.prefetch_vec_by_id(neighbors[i + 1]);
+
+            // skip if visited
+            auto &neighbor = neighbors[i];
+            if (visited_set.check(neighbor))
+               continue;
+            visited_set.set(neighbor);
+
+            // push to search queue
+            search_queue.insert(neighbor, _distance_handler->compute(query, storage.get_vector(neighbor), dim));
+            num_cmps++;
+         }
+      }
+      return num_cmps;
+   }
+
+   // fxy_add
+   IdxType UniNavGraph::iterate_to_fixed_point_global(const Graph &graph, IStorage &storage, const char *query,
+                                                      std::shared_ptr<SearchCache> search_cache, IdxType target_id, const std::vector<IdxType> &entry_points,
+                                                      bool clear_search_queue, bool clear_visited_set)
+   {
+      auto dim = storage.get_dim();
+      auto &search_queue = search_cache->search_queue;
+      auto &visited_set = search_cache->visited_set;
+      if (clear_search_queue)
+         search_queue.clear();
+      if (clear_visited_set)
+         visited_set.clear();
+
+      // entry point
+      for (const auto &entry_point : entry_points)
+         search_queue.insert(entry_point, _distance_handler->compute(query, storage.get_vector(entry_point), dim));
+      IdxType num_cmps = entry_points.size();
+
+      // greedily expand closest nodes
+      while (search_queue.has_unexpanded_node())
+      {
+         const Candidate &cur = search_queue.get_closest_unexpanded();
+
+         // iterate neighbors, the snapshot is not modified while searches run
+         auto neighbors = graph.get_neighbors(cur.id);
+         for (auto i = 0; i < neighbors.size(); ++i)
+         {
+
+            // prefetch
+            if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
+               storage.prefetch_vec_by_id(neighbors[i + 1]);
+
+            // skip if visited
+            auto &neighbor = neighbors[i];
+            if (visited_set.check(neighbor))
+               continue;
+            visited_set.set(neighbor);
+
+            // push to search queue
+            search_queue.insert(neighbor, _distance_handler->compute(query, storage.get_vector(neighbor), dim));
+            num_cmps++;
+         }
+      }
+      return num_cmps;
+   }
+
+   IdxType UniNavGraph::iterate_to_fixed_point_filtered(const Graph &graph, IStorage &storage, const char *query,
+                                                        std::shared_ptr<SearchCache> search_cache, const std::vector<IdxType> &entry_points, const roaring::Roaring &filter,
+                                                        SearchQueue &filtered_result)
+   {
+      auto dim = storage.get_dim();
+      auto &search_queue = search_cache->search_queue;
+      auto &visited_set = search_cache->visited_set;
+      search_queue.clear();
+
+      // entry point
+      for (const auto &entry_point : entry_points)
+      {
+         auto distance = _distance_handler->compute(query, storage.get_vector(entry_point), dim);
+         search_queue.insert(entry_point, distance);
+         if (filter.contains(entry_point) && !_tombstones.check(entry_point))
+            filtered_result.insert(entry_point, distance);
+      }
+      IdxType num_cmps = entry_points.size();
+
+      // greedily expand closest nodes, the points outside filter only route the search
+      while (search_queue.has_unexpanded_node())
+      {
+         const Candidate &cur = search_queue.get_closest_unexpanded();
+         auto neighbors = graph.get_neighbors(cur.id);
+         for (auto i = 0; i < neighbors.size(); ++i)
+         {
+
+            // prefetch
+            if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
+               storage.prefetch_vec_by_id(neighbors[i + 1]);
+
+            // skip if visited
             auto &neighbor = neighbors[i];
             if (visited_set.check(neighbor))
                continue;
             visited_set.set(neighbor);
 
-            // push to search queue
-            search_queue.insert(neighbor, _distance_handler->compute(query, _base_storage->get_vector(neighbor), dim));
-            num_cmps++;
+            // push to search queue and the filtered result
+            auto distance = _distance_handler->compute(query, storage.get_vector(neighbor), dim);
+            search_queue.insert(neighbor, distance);
+            if (filter.contains(neighbor) && !_tombstones.check(neighbor))
+               filtered_result.insert(neighbor, distance);
+            num_cmps++;
+         }
+      }
+      return num_cmps;
+   }
+
+   // =====================================begin NUMA=========================================
+   void UniNavGraph::set_numa_policy(NumaPolicy policy, uint32_t num_threads)
+   {
+      drop_numa_replicas();
+      _numa_policy = policy;
+      if (policy == NumaPolicy::NONE)
+         return;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      const auto &topology = NumaTopology::get();
+      auto snapshot = std::atomic_load(&_snapshot);
+
+      // each copy is made by a thread bound to its node, the pages are placed by its memory policy
+      IdxType num_replicas = policy == NumaPolicy::REPLICATE ? topology.num_nodes() : 1;
+      _numa_replicas.resize(num_replicas);
+      std::vector<std::thread> threads;
+      std::atomic<bool> is_placed(true);
+      for (IdxType node = 0; node < num_replicas; ++node)
+         threads.emplace_back([&, node]()
+                              {
+                                 bool placed = policy == NumaPolicy::INTERLEAVE || pin_thread_to_node(node);
+                                 placed = set_thread_memory_policy(policy, node) && placed;
+                                 auto copy_graph = [](const std::shared_ptr<Graph> &graph)
+                                 {
+                                    if (!graph)
+                                       return graph;
+                                    auto copy = Graph::create(graph->get_num_points());
+                                    for (IdxType i = 0; i < graph->get_num_points(); ++i)
+                                    {
+                                       auto neighbors = graph->get_neighbors(i);
+                                       copy->neighbors[i].assign(neighbors.begin(), neighbors.end());
+                                    }
+                                    if (graph->is_flat())
+                                       copy->flatten();
+                                    return copy;
+                                 };
+                                 auto &replica = _numa_replicas[node];
+                                 replica.storage = copy_storage(_base_storage);
+                                 replica.graph = copy_graph(snapshot->graph);
+                                 replica.global_graph = copy_graph(snapshot->global_graph);
+                                 set_thread_memory_policy(NumaPolicy::NONE);
+                                 if (!placed)
+                                    is_placed = false; });
+      for (auto &thread : threads)
+         thread.join();
+      _numa_snapshot = snapshot;
+      pin_omp_threads(num_threads);
+
+      std::cout << "- " << num_replicas << " NUMA " << (policy == NumaPolicy::REPLICATE ? "replica(s)" : "interleaved copy")
+                << " for " << topology.num_nodes() << " node(s) in "
+                << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+      if (!is_placed)
+         std::cerr << "Warning: the kernel refused the NUMA memory policy or affinity, the copies use the default placement" << std::endl;
+   }
+
+   void UniNavGraph::flatten_graphs()
+   {
+      auto start_time = std::chrono::high_resolution_clock::now();
+      auto snapshot = std::atomic_load(&_snapshot);
+      snapshot->graph->flatten();
+      if (snapshot->global_graph)
+         snapshot->global_graph->flatten();
+      drop_numa_replicas();
+      std::cout << "- Flattened the graphs in "
+                << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   }
+
+   SearchData UniNavGraph::get_search_data(const SearchSnapshot &snapshot) const
+   {
+      // the copies are only valid for the snapshot they were made from
+      if (_numa_replicas.empty() || _numa_snapshot.get() != &snapshot)
+         return {snapshot.graph.get(), snapshot.global_graph.get(), _base_storage.get(), 0};
+      uint32_t node = _numa_replicas.size() == 1 ? 0 : NumaTopology::get().current_node() % _numa_replicas.size();
+      const auto &replica = _numa_replicas[node];
+      return {replica.graph.get(), replica.global_graph.get(), replica.storage.get(), node};
+   }
+
+   void UniNavGraph::drop_numa_replicas()
+   {
+      _numa_replicas.clear();
+      _numa_snapshot.reset();
+   }
+   // =====================================end NUMA=========================================
+
+   // =====================================begin 在线插入=========================================
+   // fxy_add: 在线插入一批向量, 新向量追加在 segment 中, 直到 compact
+   std::vector<IdxType> UniNavGraph::insert(std::shared_ptr<IStorage> new_points,
+                                            std::shared_ptr<DistanceHandler> distance_handler, uint32_t num_threads)
+   {
+      IdxType num_new = new_points->get_num_points();
+      std::cout << "Inserting " << num_new << " points ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      if (new_points->get_dim() != _base_storage->get_dim())
+         throw std::invalid_argument("insert: dimension of the new points does not match the index");
+      if (new_points->get_num_numeric_attrs() != _base_storage->get_num_numeric_attrs())
+         throw std::invalid_argument("insert: number of numeric attributes of the new points does not match the index");
+      prepare_for_updates(distance_handler);
+      drop_numa_replicas();
+
+      // the views on the group ranges do not survive the growth of the storage and the graphs
+      IdxType first_id = _num_points;
+      bool has_global_graph = _global_graph && _global_vamana_entry_point < first_id &&
+                              _global_graph->get_neighbors(_global_vamana_entry_point).size() > 0;
+      _group_storages.clear();
+      _group_graphs.clear();
+      _vamana_instances.clear();
+      _numeric_indexes.clear();
+      _base_storage->reserve(first_id + num_new);
+      _graph->resize(first_id + num_new);
+      if (_global_graph)
+         _global_graph->resize(first_id + num_new);
+
+      // 1. route each point to the group of its label set, new label sets create a group
+      std::vector<IdxType> external_ids(num_new);
+      std::vector<bool> is_group_entry(num_new, false);
+      IdxType new_group_id = _num_groups + 1;
+      for (IdxType i = 0; i < num_new; ++i)
+      {
+         auto label_set = new_points->get_label_span(i).to_vector();
+         std::sort(label_set.begin(), label_set.end());
+         label_set.erase(std::unique(label_set.begin(), label_set.end()), label_set.end());
+         IdxType vec_id = _base_storage->append(new_points->get_vector(i), label_set,
+                                                _base_storage->get_num_numeric_attrs() > 0 ? new_points->get_numeric_attrs(i) : nullptr);
+         IdxType group_id = _trie_index.insert(label_set, new_group_id);
+         if (group_id > _num_groups)
+         {
+            add_group(group_id, label_set, vec_id);
+            is_group_entry[i] = true;
+         }
+         else if (group_id < _is_emptied_group.size() && _is_emptied_group[group_id])
+         {
+            // a group emptied by deletes is revived by its first new point
+            _is_emptied_group[group_id] = false;
+            _group_entry_points[group_id] = vec_id;
+            is_group_entry[i] = true;
+         }
+         _new_vec_id_to_group_id.push_back(group_id);
+         _new_to_old_vec_ids.push_back(_next_external_id);
+         _group_id_to_segment_ids[group_id].push_back(vec_id);
+         external_ids[i] = _next_external_id++;
+      }
+      _num_points = first_id + num_new;
+
+      // 2. link the points in parallel, locking the adjacency lists as in Vamana::link
+      SearchCacheList search_cache_list(num_threads, _num_points, _Lbuild);
+      omp_set_num_threads(num_threads);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (IdxType i = 0; i < num_new; ++i)
+      {
+         auto search_cache = search_cache_list.get_free_cache();
+         link_inserted_point(first_id + i, search_cache, is_group_entry[i]);
+         search_cache_list.release_cache(search_cache);
+      }
+
+      // the global graph, searched by search_hybrid and search_filter for low selectivity and large coverage
+      if (has_global_graph)
+      {
+         Vamana global_vamana(_base_storage, _distance_handler, _global_graph, _global_vamana_entry_point);
+         global_vamana.set_build_params(_max_degree, _Lbuild, _alpha);
+#pragma omp parallel for schedule(dynamic, 1)
+         for (IdxType i = 0; i < num_new; ++i)
+         {
+            auto search_cache = search_cache_list.get_free_cache();
+            global_vamana.link_point(first_id + i, search_cache);
+            search_cache_list.release_cache(search_cache);
+         }
+      }
+
+      // 3. the new points are covered by their groups and all ancestors of them
+      if (_scenario != "equality")
+      {
+         std::map<IdxType, std::vector<IdxType>> group_to_new_ids;
+         for (IdxType i = 0; i < num_new; ++i)
+            group_to_new_ids[_new_vec_id_to_group_id[first_id + i]].push_back(external_ids[i]);
+#pragma omp parallel for schedule(dynamic, 256)
+         for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
+         {
+            for (const auto &[new_group_id, ids] : group_to_new_ids)
+               if (group_id == new_group_id || _lng_descendants_rb[group_id].contains(new_group_id))
+               {
+                  _covered_sets_rb[group_id].addMany(ids.size(), ids.data());
+                  _label_nav_graph->covered_sets[group_id].insert(ids.begin(), ids.end());
+               }
+            _label_nav_graph->coverage_ratio[group_id] = static_cast<double>(_covered_sets_rb[group_id].cardinality()) / _num_points;
+         }
+      }
+
+      // 4. vector-attribute graph
+      append_to_vector_attr_graph(first_id);
+      _old_to_new_vec_ids.clear();
+      publish_snapshot();
+
+      std::cout << "- Finish in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count()
+                << " ms, " << _num_groups << " groups, " << get_segment_size() << " points in the segment" << std::endl;
+      return external_ids;
+   }
+
+   // fxy_add: 恢复更新需要的结构 (load 之后没有 LNG 的边), 准备剪枝用的 Vamana
+   void UniNavGraph::prepare_for_updates(std::shared_ptr<DistanceHandler> distance_handler)
+   {
+      _distance_handler = distance_handler;
+      sync_covered_sets();
+      if (!_lng_edges_ready && _scenario != "equality")
+         compute_label_nav_graph_edges();
+      _group_id_to_segment_ids.resize(_num_groups + 1);
+      _lng_descendants_rb.resize(_num_groups + 1);
+      _covered_sets_rb.resize(_num_groups + 1);
+      if (_next_external_id == 0)
+         for (auto id : _new_to_old_vec_ids)
+            _next_external_id = std::max(_next_external_id, id + 1);
+      if (_update_vamana == nullptr)
+      {
+         _update_vamana = std::make_shared<Vamana>(_base_storage, _distance_handler, _graph, 0);
+         _update_vamana->set_build_params(_max_degree, _Lbuild, _alpha);
+      }
+   }
+
+   // fxy_add: 插入时出现新的 label set, 新建 group 和 LNG 节点及其出入边, 更新 descendants
+   void UniNavGraph::add_group(IdxType group_id, const std::vector<LabelType> &label_set, IdxType entry_point)
+   {
+      _num_groups = group_id;
+      _group_id_to_label_set.resize(group_id + 1);
+      _group_id_to_label_set[group_id] = label_set;
+      _group_id_to_range.resize(group_id + 1, std::make_pair(_segment_start, _segment_start));
+      _group_entry_points.resize(group_id + 1);
+      _group_entry_points[group_id] = entry_point;
+      _group_id_to_segment_ids.resize(group_id + 1);
+      _lng_descendants_rb.resize(group_id + 1);
+      _covered_sets_rb.resize(group_id + 1);
+      if (_scenario == "equality")
+         return;
+
+      auto &lng = *_label_nav_graph;
+      size_t num_nodes = std::max(lng.out_neighbors.size(), static_cast<size_t>(group_id) + 1);
+      lng.in_neighbors.resize(num_nodes);
+      lng.out_neighbors.resize(num_nodes);
+      lng.coverage_ratio.resize(num_nodes, 0.0);
+      lng.covered_sets.resize(num_nodes);
+      lng._lng_descendants.resize(group_id);
+      lng._lng_descendants_num.resize(group_id);
+
+      // out-neighbors are the minimum super sets, the new group covers and reaches whatever they do
+      std::vector<IdxType> min_super_set_ids;
+      get_min_super_sets(label_set, min_super_set_ids, true);
+      lng.out_neighbors[group_id] = min_super_set_ids;
+      for (auto out_group_id : min_super_set_ids)
+      {
+         lng.in_neighbors[out_group_id].emplace_back(group_id);
+         _lng_descendants_rb[group_id].add(out_group_id);
+         _lng_descendants_rb[group_id] |= _lng_descendants_rb[out_group_id];
+         _covered_sets_rb[group_id] |= _covered_sets_rb[out_group_id];
+      }
+      lng._lng_descendants[group_id - 1] = std::unordered_set<IdxType>(_lng_descendants_rb[group_id].begin(), _lng_descendants_rb[group_id].end());
+      lng._lng_descendants_num[group_id - 1] = std::make_pair(group_id, static_cast<int>(_lng_descendants_rb[group_id].cardinality()));
+      lng.covered_sets[group_id] = std::unordered_set<IdxType>(_covered_sets_rb[group_id].begin(), _covered_sets_rb[group_id].end());
+
+      // every sub set gains a descendant, the ones without a group between them and the new one take it as out-neighbor
+      for (IdxType sub_group_id = 1; sub_group_id < group_id; ++sub_group_id)
+      {
+         const auto &sub_label_set = _group_id_to_label_set[sub_group_id];
+         if (!std::includes(label_set.begin(), label_set.end(), sub_label_set.begin(), sub_label_set.end()))
+            continue;
+         _lng_descendants_rb[sub_group_id].add(group_id);
+         lng._lng_descendants[sub_group_id - 1].insert(group_id);
+         lng._lng_descendants_num[sub_group_id - 1].second++;
+
+         auto &out_neighbors = lng.out_neighbors[sub_group_id];
+         bool has_group_between = std::any_of(out_neighbors.begin(), out_neighbors.end(), [&](IdxType out_group_id)
+                                              {
+            const auto &out_label_set = _group_id_to_label_set[out_group_id];
+            return std::includes(label_set.begin(), label_set.end(), out_label_set.begin(), out_label_set.end()); });
+         if (has_group_between)
+            continue;
+
+         // out-neighbors containing the new label set are no longer minimum
+         auto contains_new = [&](IdxType out_group_id)
+         {
+            const auto &out_label_set = _group_id_to_label_set[out_group_id];
+            return std::includes(out_label_set.begin(), out_label_set.end(), label_set.begin(), label_set.end());
+         };
+         for (auto out_group_id : out_neighbors)
+            if (contains_new(out_group_id))
+            {
+               auto &in_neighbors = lng.in_neighbors[out_group_id];
+               in_neighbors.erase(std::remove(in_neighbors.begin(), in_neighbors.end(), sub_group_id), in_neighbors.end());
+            }
+         out_neighbors.erase(std::remove_if(out_neighbors.begin(), out_neighbors.end(), contains_new), out_neighbors.end());
+         out_neighbors.emplace_back(group_id);
+         lng.in_neighbors[group_id].emplace_back(sub_group_id);
+      }
+   }
+
+   // fxy_add: 把一个新向量接入所在 group 的图 (剪枝 + 反向边), 并添加跨 group 的出边和入边
+   void UniNavGraph::link_inserted_point(IdxType vec_id, std::shared_ptr<SearchCache> search_cache, bool is_group_entry)
+   {
+      IdxType group_id = _new_vec_id_to_group_id[vec_id];
+      const char *query = _base_storage->get_vector(vec_id);
+      auto &search_queue = search_cache->search_queue;
+
+      // neighbors in the group: greedy search, robust pruning and the reversed edges
+      iterate_to_fixed_point_in_group(query, search_cache, group_id, vec_id);
+      std::vector<IdxType> pruned_list;
+      _update_vamana->prune_neighbors(vec_id, search_cache->expanded_list, pruned_list, search_cache);
+      {
+         std::lock_guard<std::mutex> lock(_graph->neighbor_locks[vec_id]);
+         _graph->neighbors[vec_id] = pruned_list;
+      }
+      inter_insert_in_group(vec_id, pruned_list, search_cache);
+      if (_scenario == "equality" || _num_cross_edges == 0)
+         return;
+
+      // cross-group edges into the minimum super sets, the entry of a new group keeps the closest point of each
+      SearchQueue cross_group_neighbors;
+      cross_group_neighbors.reserve(_num_cross_edges);
+      std::vector<IdxType> forced_neighbors;
+      std::vector<IdxType> out_group_ids = _label_nav_graph->out_neighbors[group_id];
+      resolve_entry_groups(*std::atomic_load(&_snapshot), out_group_ids);
+      for (auto out_group_id : out_group_ids)
+      {
+         iterate_to_fixed_point_in_group(query, search_cache, out_group_id);
+         for (auto k = 0; k < search_queue.size(); ++k)
+            cross_group_neighbors.insert(search_queue[k].id, search_queue[k].distance);
+         if (is_group_entry && search_queue.size() > 0)
+            forced_neighbors.emplace_back(search_queue[0].id);
+      }
+      {
+         std::lock_guard<std::mutex> lock(_graph->neighbor_locks[vec_id]);
+         auto &neighbors = _graph->neighbors[vec_id];
+         for (auto k = 0; k < cross_group_neighbors.size(); ++k)
+            neighbors.emplace_back(cross_group_neighbors[k].id);
+         for (auto neighbor : forced_neighbors)
+            if (std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end())
+               neighbors.emplace_back(neighbor);
+      }
+
+      // cross-group edges from the maximum sub sets (LNG in-neighbors), a new group is reached from each of them
+      IdxType num_in_edges = std::max<IdxType>(1, _num_cross_edges / 2);
+      for (auto in_group_id : _label_nav_graph->in_neighbors[group_id])
+      {
+         if (in_group_id < _is_emptied_group.size() && _is_emptied_group[in_group_id])
+            continue;
+         iterate_to_fixed_point_in_group(query, search_cache, in_group_id);
+         for (auto k = 0; k < search_queue.size() && k < num_in_edges; ++k)
+            add_cross_edge(search_queue[k].id, vec_id, search_queue[k].distance, is_group_entry && k == 0);
+      }
+   }
+
+   // fxy_add: 只在 group_id 内扩展的贪心搜索, 与 Vamana::iterate_to_fixed_point 一样记录扩展过的点
+   IdxType UniNavGraph::iterate_to_fixed_point_in_group(const char *query, std::shared_ptr<SearchCache> search_cache,
+                                                        IdxType group_id, IdxType target_id)
+   {
+      auto dim = _base_storage->get_dim();
+      auto &search_queue = search_cache->search_queue;
+      auto &visited_set = search_cache->visited_set;
+      auto &expanded_list = search_cache->expanded_list;
+      search_queue.clear();
+      visited_set.clear();
+      expanded_list.clear();
+      std::vector<IdxType> neighbors;
+
+      // entry point
+      IdxType entry_point = _group_entry_points[group_id];
+      visited_set.set(entry_point);
+      search_queue.insert(entry_point, _distance_handler->compute(query, _base_storage->get_vector(entry_point), dim));
+      IdxType num_cmps = 1;
+
+      // greedily expand closest nodes of the group
+      while (search_queue.has_unexpanded_node())
+      {
+         const Candidate &cur = search_queue.get_closest_unexpanded();
+         if (target_id != cur.id)
+            expanded_list.push_back(cur);
+         {
+            std::lock_guard<std::mutex> lock(_graph->neighbor_locks[cur.id]);
+            neighbors = _graph->neighbors[cur.id];
+         }
+         for (auto &neighbor : neighbors)
+         {
+            if (visited_set.check(neighbor))
+               continue;
+            visited_set.set(neighbor);
+            if (_new_vec_id_to_group_id[neighbor] != group_id)
+               continue;
+            search_queue.insert(neighbor, _distance_handler->compute(query, _base_storage->get_vector(neighbor), dim));
+            num_cmps++;
+         }
+      }
+      return num_cmps;
+   }
+
+   // fxy_add: 同 Vamana::inter_insert, 但只对同 group 的邻居剪枝, 跨 group 的边保持不变
+   void UniNavGraph::inter_insert_in_group(IdxType src, const std::vector<IdxType> &src_neighbors,
+                                           std::shared_ptr<SearchCache> search_cache)
+   {
+      auto dim = _base_storage->get_dim();
+      IdxType max_in_group_degree = default_paras::GRAPH_SLACK_FACTOR * _max_degree;
+      for (auto dst : src_neighbors)
+      {
+         IdxType dst_group_id = _new_vec_id_to_group_id[dst];
+         std::vector<Candidate> candidates;
+
+         // try to add edge dst -> src
+         {
+            std::lock_guard<std::mutex> lock(_graph->neighbor_locks[dst]);
+            auto &dst_neighbors = _graph->neighbors[dst];
+            if (std::find(dst_neighbors.begin(), dst_neighbors.end(), src) != dst_neighbors.end())
+               continue;
+            for (auto neighbor : dst_neighbors)
+               if (_new_vec_id_to_group_id[neighbor] == dst_group_id)
+                  candidates.emplace_back(neighbor, 0);
+            if (candidates.size() < max_in_group_degree)
+            {
+               dst_neighbors.push_back(src);
+               continue;
+            }
+            candidates.emplace_back(src, 0);
+         }
+
+         // prune the neighbors of dst in its group
+         for (auto &candidate : candidates)
+            candidate.distance = _distance_handler->compute(_base_storage->get_vector(dst),
+                                                            _base_storage->get_vector(candidate.id), dim);
+         std::vector<IdxType> new_dst_neighbors;
+         _update_vamana->prune_neighbors(dst, candidates, new_dst_neighbors, search_cache);
+         {
+            std::lock_guard<std::mutex> lock(_graph->neighbor_locks[dst]);
+            for (auto neighbor : _graph->neighbors[dst])
+               if (_new_vec_id_to_group_id[neighbor] != dst_group_id)
+                  new_dst_neighbors.push_back(neighbor);
+            _graph->neighbors[dst] = new_dst_neighbors;
+         }
+      }
+   }
+
+   // fxy_add: 添加跨 group 的边 from -> to, 已满时替换到同一 group 中最远的一条, 不会断开 group 之间的连通
+   void UniNavGraph::add_cross_edge(IdxType from, IdxType to, float distance, bool force)
+   {
+      auto dim = _base_storage->get_dim();
+      IdxType from_group_id = _new_vec_id_to_group_id[from], to_group_id = _new_vec_id_to_group_id[to];
+      std::lock_guard<std::mutex> lock(_graph->neighbor_locks[from]);
+      auto &neighbors = _graph->neighbors[from];
+      if (std::find(neighbors.begin(), neighbors.end(), to) != neighbors.end())
+         return;
+      IdxType num_cross_edges = std::count_if(neighbors.begin(), neighbors.end(), [&](IdxType neighbor)
+                                              { return _new_vec_id_to_group_id[neighbor] != from_group_id; });
+      if (force || num_cross_edges < _num_cross_edges)
+      {
+         neighbors.push_back(to);
+         return;
+      }
+
+      IdxType *farthest = nullptr;
+      float farthest_distance = distance;
+      for (auto &neighbor : neighbors)
+         if (_new_vec_id_to_group_id[neighbor] == to_group_id)
+         {
+            float cur_distance = _distance_handler->compute(_base_storage->get_vector(from), _base_storage->get_vector(neighbor), dim);
+            if (cur_distance > farthest_distance)
+            {
+               farthest_distance = cur_distance;
+               farthest = &neighbor;
+            }
+         }
+      if (farthest != nullptr)
+         *farthest = to;
+   }
+
+   // fxy_add: 二分图中属性节点排在向量节点之后, 插入后整体后移, 再加入新向量的边
+   void UniNavGraph::append_to_vector_attr_graph(IdxType first_id)
+   {
+      if (_vector_attr_graph.empty())
+         return;
+      _label_postings_rb.clear();
+      IdxType num_new = _num_points - first_id;
+      _vector_attr_graph.insert(_vector_attr_graph.begin() + first_id, num_new, std::vector<IdxType>());
+#pragma omp parallel for schedule(dynamic, 4096)
+      for (IdxType vec_id = 0; vec_id < first_id; ++vec_id)
+         for (auto &attr_node : _vector_attr_graph[vec_id])
+            attr_node += num_new;
+
+      for (IdxType vec_id = first_id; vec_id < _num_points; ++vec_id)
+         for (auto label : _base_storage->get_label_span(vec_id))
+         {
+            auto it = _attr_to_id.find(label);
+            AtrType attr_id;
+            if (it == _attr_to_id.end())
+            {
+               attr_id = _num_attributes++;
+               _attr_to_id[label] = attr_id;
+               _id_to_attr[attr_id] = label;
+               _vector_attr_graph.emplace_back();
+            }
+            else
+               attr_id = it->second;
+            _vector_attr_graph[vec_id].push_back(_num_points + attr_id);
+            _vector_attr_graph[_num_points + attr_id].push_back(vec_id);
+         }
+   }
+
+   // fxy_add: 把 segment 中的向量并入各 group 的连续区间, 重新编号向量, 图, 入口点和二分图
+   void UniNavGraph::compact(uint32_t num_threads)
+   {
+      if (get_segment_size() == 0)
+         return;
+      std::cout << "Compacting " << get_segment_size() << " points into the group ranges ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      omp_set_num_threads(num_threads);
+      sync_covered_sets();
+      drop_numa_replicas();
+
+      // new layout: each group keeps its range followed by its segment points
+      std::vector<IdxType> new_to_cur(_num_points);
+      std::vector<std::pair<IdxType, IdxType>> new_ranges(_num_groups + 1);
+      IdxType new_id = 0;
+      for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
+      {
+         new_ranges[group_id].first = new_id;
+         for (auto id = _group_id_to_range[group_id].first; id < _group_id_to_range[group_id].second; ++id)
+            new_to_cur[new_id++] = id;
+         for (auto id : _group_id_to_segment_ids[group_id])
+            new_to_cur[new_id++] = id;
+         new_ranges[group_id].second = new_id;
+      }
+      apply_layout(new_to_cur, new_ranges);
+      _group_id_to_segment_ids.assign(_num_groups + 1, std::vector<IdxType>());
+      _segment_start = _num_points;
+      publish_snapshot();
+      std::cout << "- Finish in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   }
+
+   // fxy_add: 按 new_to_cur 重新编号所有点 (new_to_cur[new_id] = 当前 id), 向量, 图, 入口点, 二分图和 tombstone 一起移动
+   void UniNavGraph::apply_layout(const std::vector<IdxType> &new_to_cur, std::vector<std::pair<IdxType, IdxType>> &new_ranges)
+   {
+      std::vector<IdxType> cur_to_new(_num_points);
+      for (IdxType id = 0; id < _num_points; ++id)
+         cur_to_new[new_to_cur[id]] = id;
+
+      // vectors, graphs and id maps, the group views of the build point into the old graph
+      _group_storages.clear();
+      _group_graphs.clear();
+      _vamana_instances.clear();
+      _base_storage->reorder_data(new_to_cur);
+      _numeric_indexes.clear();
+      auto remap_graph = [&](std::shared_ptr<Graph> graph)
+      {
+         graph->unflatten();
+         auto new_graph = Graph::create(_num_points);
+#pragma omp parallel for schedule(dynamic, 4096)
+         for (IdxType id = 0; id < _num_points; ++id)
+         {
+            new_graph->neighbors[id] = std::move(graph->neighbors[new_to_cur[id]]);
+            for (auto &neighbor : new_graph->neighbors[id])
+               neighbor = cur_to_new[neighbor];
+         }
+         graph->clean();
+         return new_graph;
+      };
+      _graph = remap_graph(_graph);
+      if (_global_graph)
+         _global_graph = remap_graph(_global_graph);
+      std::vector<IdxType> new_to_old_vec_ids(_num_points), new_vec_id_to_group_id(_num_points);
+      for (IdxType id = 0; id < _num_points; ++id)
+      {
+         new_to_old_vec_ids[id] = _new_to_old_vec_ids[new_to_cur[id]];
+         new_vec_id_to_group_id[id] = _new_vec_id_to_group_id[new_to_cur[id]];
+      }
+      _new_to_old_vec_ids.swap(new_to_old_vec_ids);
+      _new_vec_id_to_group_id.swap(new_vec_id_to_group_id);
+      _group_id_to_range.swap(new_ranges);
+      for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
+         _group_entry_points[group_id] = cur_to_new[_group_entry_points[group_id]];
+      if (_global_vamana_entry_point < _num_points)
+         _global_vamana_entry_point = cur_to_new[_global_vamana_entry_point];
+
+      // vector-attribute graph: rows of the vector nodes move, posting lists are renumbered
+      _label_postings_rb.clear();
+      if (!_vector_attr_graph.empty())
+      {
+         std::vector<std::vector<IdxType>> vector_rows(_num_points);
+         for (IdxType id = 0; id < _num_points; ++id)
+            vector_rows[id] = std::move(_vector_attr_graph[new_to_cur[id]]);
+         std::move(vector_rows.begin(), vector_rows.end(), _vector_attr_graph.begin());
+#pragma omp parallel for schedule(dynamic, 64)
+         for (AtrType attr_id = 0; attr_id < _num_attributes; ++attr_id)
+         {
+            auto &posting_list = _vector_attr_graph[_num_points + attr_id];
+            for (auto &id : posting_list)
+               id = cur_to_new[id];
+            std::sort(posting_list.begin(), posting_list.end());
          }
       }
-      return num_cmps;
+
+      // tombstones follow the points, the covered sets use the external ids and stay unchanged
+      auto deleted_ids = _tombstones.get_marked();
+      _tombstones.clear();
+      for (auto id : deleted_ids)
+         _tombstones.set(cur_to_new[id]);
+      for (auto &id : _pending_deletes)
+         id = cur_to_new[id];
+      _old_to_new_vec_ids.clear();
+      _update_vamana.reset();
    }
+   // =====================================end 在线插入=========================================
 
-   // fxy_add
-   IdxType UniNavGraph::iterate_to_fixed_point_global(const char *query, std::shared_ptr<SearchCache> search_cache,
-                                                      IdxType target_id, const std::vector<IdxType> &entry_points,
-                                                      bool clear_search_queue, bool clear_visited_set)
+   // =====================================begin 局部性重排=========================================
+   // fxy_add: 按图的局部性重新编号每个 group 内的点, group 的区间不变
+   void UniNavGraph::reorder_groups(ReorderMethod method, uint32_t num_threads)
    {
-      auto dim = _base_storage->get_dim();
-      auto &search_queue = search_cache->search_queue;
-      auto &visited_set = search_cache->visited_set;
-      std::vector<IdxType> neighbors;
-      if (clear_search_queue)
-         search_queue.clear();
-      if (clear_visited_set)
-         visited_set.clear();
+      if (method == ReorderMethod::NONE)
+         return;
+      compact(num_threads);
+      std::cout << "Reordering the points of " << _num_groups << " groups ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      omp_set_num_threads(num_threads);
+      sync_covered_sets();
+      drop_numa_replicas();
 
-      // entry point
-      for (const auto &entry_point : entry_points)
-         search_queue.insert(entry_point, _distance_handler->compute(query, _base_storage->get_vector(entry_point), dim));
-      IdxType num_cmps = entry_points.size();
+      // each group range is permuted on its own, from the edges inside it
+      std::vector<IdxType> new_to_cur(_num_points);
+      for (IdxType id = 0; id < _num_points; ++id)
+         new_to_cur[id] = id;
+#pragma omp parallel for schedule(dynamic, 1)
+      for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
+      {
+         const auto &range = _group_id_to_range[group_id];
+         auto order = locality_order(*_graph, range.first, range.second, _group_entry_points[group_id], method);
+         std::copy(order.begin(), order.end(), new_to_cur.begin() + range.first);
+      }
+      auto new_ranges = _group_id_to_range;
+      apply_layout(new_to_cur, new_ranges);
+      publish_snapshot();
+      std::cout << "- Finish in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+   }
+   // =====================================end 局部性重排=========================================
 
-      // greedily expand closest nodes
-      while (search_queue.has_unexpanded_node())
+   // =====================================begin 删除=========================================
+   // fxy_add: 删除只打 tombstone, 被删的点继续参与路由, 但不会出现在结果中, 由 consolidate 修复图
+   IdxType UniNavGraph::remove(const std::vector<IdxType> &ids)
+   {
+      std::lock_guard<std::mutex> lock(_delete_mutex);
+      if (_old_to_new_vec_ids.empty())
       {
-         const Candidate &cur = search_queue.get_closest_unexpanded();
+         IdxType num_ids = 0;
+         for (auto id : _new_to_old_vec_ids)
+            num_ids = std::max(num_ids, id + 1);
+         _old_to_new_vec_ids.assign(num_ids, -1);
+         for (IdxType new_id = 0; new_id < _num_points; ++new_id)
+            _old_to_new_vec_ids[_new_to_old_vec_ids[new_id]] = new_id;
+      }
+
+      IdxType num_removed = 0;
+      for (auto id : ids)
+      {
+         if (id >= _old_to_new_vec_ids.size() || _old_to_new_vec_ids[id] == -1)
+            continue;
+         IdxType new_id = _old_to_new_vec_ids[id];
+         if (!_tombstones.set(new_id))
+            continue;
+         _pending_deletes.push_back(new_id);
+         num_removed++;
+      }
+      return num_removed;
+   }
+
+   std::future<void> UniNavGraph::consolidate_async(std::shared_ptr<DistanceHandler> distance_handler, uint32_t num_threads)
+   {
+      return std::async(std::launch::async, [this, distance_handler, num_threads]()
+                        { consolidate(distance_handler, num_threads); });
+   }
 
-         // iterate neighbors
+   // fxy_add: 修复指向被删点的邻接表, 更新入口点, 缩小覆盖集合, 绕过被删空的 group, 最后发布新的快照
+   // 搜索读取的是旧快照, 这里只写新建的结构
+   void UniNavGraph::consolidate(std::shared_ptr<DistanceHandler> distance_handler, uint32_t num_threads)
+   {
+      std::vector<IdxType> deleted_ids;
+      {
+         std::lock_guard<std::mutex> lock(_delete_mutex);
+         deleted_ids.swap(_pending_deletes);
+      }
+      if (deleted_ids.empty())
+         return;
+      std::cout << "Consolidating " << deleted_ids.size() << " deleted points ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      auto snapshot = std::atomic_load(&_snapshot);
+      auto dim = _base_storage->get_dim();
+      omp_set_num_threads(num_threads);
+      BitsetType is_deleted(_num_points);
+      for (auto id : deleted_ids)
+         is_deleted.set(id);
+
+      // the build-time views and Vamana instances refer to the graphs being replaced
+      _group_storages.clear();
+      _group_graphs.clear();
+      _vamana_instances.clear();
+      _global_vamana.reset();
+      _update_vamana.reset();
+      if (!_lng_edges_ready && _label_nav_graph != nullptr)
+         compute_label_nav_graph_edges();
+
+      // lists pointing to deleted points are rebuilt from the neighbors of the deleted ones: same-group candidates
+      // are pruned as in Vamana, a deleted cross-group neighbor is replaced by the closest live point it links to
+      // in its own group, or in each of the groups it links to when its group has none left
+      SearchCacheList search_cache_list(num_threads, _num_points, _Lbuild);
+      auto repair_graph = [&](const Graph &graph, bool use_groups)
+      {
+         auto new_graph = Graph::create(_num_points);
+         auto pruner = std::make_shared<Vamana>(_base_storage, distance_handler, new_graph, 0);
+         pruner->set_build_params(_max_degree, _Lbuild, _alpha);
+         auto group_of = [&](IdxType id)
+         { return use_groups ? _new_vec_id_to_group_id[id] : 0; };
+#pragma omp parallel for schedule(dynamic, 256)
+         for (IdxType id = 0; id < _num_points; ++id)
          {
-            std::lock_guard<std::mutex> lock(_global_graph->neighbor_locks[cur.id]);
-            neighbors = _global_graph->neighbors[cur.id];
+            auto neighbors = graph.get_neighbors(id);
+            auto &new_neighbors = new_graph->neighbors[id];
+            if (is_deleted[id])
+               continue;
+            if (std::none_of(neighbors.begin(), neighbors.end(), [&](IdxType neighbor)
+                             { return is_deleted[neighbor]; }))
+            {
+               new_neighbors.assign(neighbors.begin(), neighbors.end());
+               continue;
+            }
+            IdxType group_id = group_of(id);
+            const char *vec = _base_storage->get_vector(id);
+            auto is_live = [&](IdxType candidate)
+            { return candidate != id && !is_deleted[candidate] && !_tombstones.check(candidate); };
+
+            // same-group neighbors
+            std::vector<IdxType> candidate_ids;
+            for (auto neighbor : neighbors)
+            {
+               if (group_of(neighbor) != group_id)
+                  continue;
+               if (!is_deleted[neighbor])
+                  candidate_ids.push_back(neighbor);
+               else
+                  for (auto candidate : graph.get_neighbors(neighbor))
+                     if (group_of(candidate) == group_id && is_live(candidate))
+                        candidate_ids.push_back(candidate);
+            }
+            std::sort(candidate_ids.begin(), candidate_ids.end());
+            candidate_ids.erase(std::unique(candidate_ids.begin(), candidate_ids.end()), candidate_ids.end());
+            std::vector<Candidate> candidates;
+            candidates.reserve(candidate_ids.size());
+            for (auto candidate : candidate_ids)
+               candidates.emplace_back(candidate, distance_handler->compute(vec, _base_storage->get_vector(candidate), dim));
+            auto search_cache = search_cache_list.get_free_cache();
+            pruner->prune_neighbors(id, candidates, new_neighbors, search_cache);
+            search_cache_list.release_cache(search_cache);
+
+            // cross-group neighbors, all of them lead to super sets of the group
+            auto add_neighbor = [&](IdxType neighbor)
+            {
+               if (std::find(new_neighbors.begin(), new_neighbors.end(), neighbor) == new_neighbors.end())
+                  new_neighbors.push_back(neighbor);
+            };
+            for (auto neighbor : neighbors)
+            {
+               IdxType neighbor_group_id = group_of(neighbor);
+               if (neighbor_group_id == group_id)
+                  continue;
+               if (!is_deleted[neighbor])
+               {
+                  add_neighbor(neighbor);
+                  continue;
+               }
+               std::map<IdxType, Candidate> closest_in_group;
+               for (auto candidate : graph.get_neighbors(neighbor))
+               {
+                  if (!is_live(candidate) || group_of(candidate) == group_id)
+                     continue;
+                  float distance = distance_handler->compute(vec, _base_storage->get_vector(candidate), dim);
+                  auto it = closest_in_group.find(group_of(candidate));
+                  if (it == closest_in_group.end())
+                     closest_in_group.emplace(group_of(candidate), Candidate(candidate, distance));
+                  else if (distance < it->second.distance)
+                     it->second = Candidate(candidate, distance);
+               }
+               auto it = closest_in_group.find(neighbor_group_id);
+               if (it != closest_in_group.end())
+                  add_neighbor(it->second.id);
+               else
+                  for (const auto &each : closest_in_group)
+                     add_neighbor(each.second.id);
+            }
          }
-         for (auto i = 0; i < neighbors.size(); ++i)
-         {
+         return new_graph;
+      };
+      auto graph = repair_graph(*snapshot->graph, true);
+      auto global_graph = snapshot->global_graph ? repair_graph(*snapshot->global_graph, false) : nullptr;
+
+      // entry points: a live same-group neighbor of the deleted one, or any live point of the group
+      std::vector<IdxType> affected_group_ids;
+      for (auto id : deleted_ids)
+         affected_group_ids.push_back(_new_vec_id_to_group_id[id]);
+      std::sort(affected_group_ids.begin(), affected_group_ids.end());
+      affected_group_ids.erase(std::unique(affected_group_ids.begin(), affected_group_ids.end()), affected_group_ids.end());
+      update_emptied_groups(affected_group_ids);
+      auto group_entry_points = snapshot->group_entry_points;
+      for (auto group_id : affected_group_ids)
+      {
+         auto &entry_point = group_entry_points[group_id];
+         if (!_tombstones.check(entry_point) || _is_emptied_group[group_id])
+            continue;
+         IdxType new_entry_point = -1;
+         for (auto neighbor : snapshot->graph->get_neighbors(entry_point))
+            if (_new_vec_id_to_group_id[neighbor] == group_id && !_tombstones.check(neighbor))
+            {
+               new_entry_point = neighbor;
+               break;
+            }
+         for (auto id = _group_id_to_range[group_id].first; new_entry_point == -1 && id < _group_id_to_range[group_id].second; ++id)
+            if (!_tombstones.check(id))
+               new_entry_point = id;
+         for (auto id : _group_id_to_segment_ids[group_id])
+            if (new_entry_point == -1 && !_tombstones.check(id))
+               new_entry_point = id;
+         entry_point = new_entry_point;
+      }
+      IdxType global_entry_point = snapshot->global_entry_point;
+      if (global_entry_point < _num_points && is_deleted[global_entry_point])
+      {
+         IdxType new_entry_point = -1;
+         for (auto neighbor : snapshot->global_graph->get_neighbors(global_entry_point))
+            if (!_tombstones.check(neighbor))
+            {
+               new_entry_point = neighbor;
+               break;
+            }
+         for (IdxType id = 0; new_entry_point == -1 && id < _num_points; ++id)
+            if (!_tombstones.check(id))
+               new_entry_point = id;
+         global_entry_point = new_entry_point;
+      }
 
-            // prefetch
-            if (i + 1 < neighbors.size() && visited_set.check(neighbors[i + 1]) == false)
-               _base_storage->prefetch_vec_by_id(neighbors[i + 1]);
+      // covered sets (external ids) of every group containing a deleted point
+      roaring::Roaring deleted_old_ids;
+      for (auto id : deleted_ids)
+         deleted_old_ids.add(_new_to_old_vec_ids[id]);
+      auto covered_sets_rb = std::make_shared<std::vector<roaring::Roaring>>(*snapshot->covered_sets_rb);
+#pragma omp parallel for schedule(dynamic, 64)
+      for (IdxType group_id = 0; group_id < covered_sets_rb->size(); ++group_id)
+         if ((*covered_sets_rb)[group_id].intersect(deleted_old_ids))
+            (*covered_sets_rb)[group_id] -= deleted_old_ids;
+
+      // publish, searches holding the old snapshot finish on the old graphs
+      auto new_snapshot = std::make_shared<SearchSnapshot>();
+      new_snapshot->graph = graph;
+      new_snapshot->global_graph = global_graph;
+      new_snapshot->group_entry_points = group_entry_points;
+      new_snapshot->global_entry_point = global_entry_point;
+      new_snapshot->group_redirects = get_group_redirects();
+      new_snapshot->covered_sets_rb = covered_sets_rb;
+      new_snapshot->num_live_points = _num_points - _tombstones.count();
+      std::atomic_store(&_snapshot, std::shared_ptr<const SearchSnapshot>(new_snapshot));
+      _graph = graph;
+      _global_graph = global_graph;
+      _group_entry_points = group_entry_points;
+      _global_vamana_entry_point = global_entry_point;
+
+      std::cout << "- Finish in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count()
+                << " ms, " << std::count(_is_emptied_group.begin(), _is_emptied_group.end(), true) << " emptied groups" << std::endl;
+   }
 
-            // skip if visited
-            auto &neighbor = neighbors[i];
-            if (visited_set.check(neighbor))
-               continue;
-            visited_set.set(neighbor);
+   // fxy_add: 搜索只读快照, 插入, 合并和保存在不与搜索并发时调用
+   void UniNavGraph::publish_snapshot()
+   {
+      if (_tombstones.size() != _num_points)
+         _tombstones.resize(_num_points);
+      auto snapshot = std::make_shared<SearchSnapshot>();
+      snapshot->graph = _graph;
+      snapshot->global_graph = _global_graph;
+      snapshot->group_entry_points = _group_entry_points;
+      snapshot->global_entry_point = _global_vamana_entry_point;
+      snapshot->group_redirects = get_group_redirects();
+      // the members are not changed while searches run, no copy is needed
+      snapshot->covered_sets_rb = std::shared_ptr<const std::vector<roaring::Roaring>>(std::shared_ptr<void>(), &_covered_sets_rb);
+      snapshot->num_live_points = _num_points - _tombstones.count();
+      std::atomic_store(&_snapshot, std::shared_ptr<const SearchSnapshot>(snapshot));
+   }
 
-            // push to search queue
-            search_queue.insert(neighbor, _distance_handler->compute(query, _base_storage->get_vector(neighbor), dim));
-            num_cmps++;
+   // fxy_add: consolidate 只缩小快照中的覆盖集合副本, 成员在下一次单线程更新前同步
+   void UniNavGraph::sync_covered_sets()
+   {
+      auto snapshot = std::atomic_load(&_snapshot);
+      if (snapshot == nullptr || snapshot->covered_sets_rb.get() == &_covered_sets_rb)
+         return;
+      _covered_sets_rb = *snapshot->covered_sets_rb;
+      if (_label_nav_graph != nullptr)
+      {
+         auto &lng = *_label_nav_graph;
+         for (IdxType group_id = 0; group_id < _covered_sets_rb.size() && group_id < lng.covered_sets.size(); ++group_id)
+            if (lng.covered_sets[group_id].size() != _covered_sets_rb[group_id].cardinality())
+            {
+               lng.covered_sets[group_id] = std::unordered_set<IdxType>(_covered_sets_rb[group_id].begin(), _covered_sets_rb[group_id].end());
+               if (group_id < lng.coverage_ratio.size())
+                  lng.coverage_ratio[group_id] = static_cast<double>(_covered_sets_rb[group_id].cardinality()) / _num_points;
+            }
+      }
+      publish_snapshot();
+   }
+
+   // fxy_add: group 中的点全部被删除后, 搜索改从它的非空超集进入
+   void UniNavGraph::update_emptied_groups(const std::vector<IdxType> &group_ids)
+   {
+      _is_emptied_group.resize(_num_groups + 1, false);
+      for (auto group_id : group_ids)
+      {
+         bool is_empty = true;
+         for (auto id = _group_id_to_range[group_id].first; is_empty && id < _group_id_to_range[group_id].second; ++id)
+            is_empty = _tombstones.check(id);
+         if (group_id < _group_id_to_segment_ids.size())
+            for (auto id : _group_id_to_segment_ids[group_id])
+               is_empty = is_empty && _tombstones.check(id);
+         _is_emptied_group[group_id] = is_empty;
+      }
+   }
+
+   std::unordered_map<IdxType, std::vector<IdxType>> UniNavGraph::get_group_redirects() const
+   {
+      std::unordered_map<IdxType, std::vector<IdxType>> group_redirects;
+      for (IdxType group_id = 1; group_id < _is_emptied_group.size(); ++group_id)
+      {
+         if (!_is_emptied_group[group_id])
+            continue;
+
+         // closest non-empty groups along the LNG out-edges
+         auto &redirects = group_redirects[group_id];
+         std::vector<IdxType> stack{group_id};
+         std::unordered_set<IdxType> visited{group_id};
+         while (!stack.empty() && _label_nav_graph != nullptr)
+         {
+            IdxType cur = stack.back();
+            stack.pop_back();
+            if (cur >= _label_nav_graph->out_neighbors.size())
+               continue;
+            for (auto out_group_id : _label_nav_graph->out_neighbors[cur])
+            {
+               if (!visited.insert(out_group_id).second)
+                  continue;
+               if (out_group_id < _is_emptied_group.size() && _is_emptied_group[out_group_id])
+                  stack.push_back(out_group_id);
+               else
+                  redirects.push_back(out_group_id);
+            }
          }
       }
-      return num_cmps;
+      return group_redirects;
+   }
+
+   // replace emptied groups by their redirects
+   void UniNavGraph::resolve_entry_groups(const SearchSnapshot &snapshot, std::vector<IdxType> &entry_group_ids) const
+   {
+      if (snapshot.group_redirects.empty())
+         return;
+      std::vector<IdxType> resolved;
+      for (auto group_id : entry_group_ids)
+      {
+         auto it = snapshot.group_redirects.find(group_id);
+         if (it == snapshot.group_redirects.end())
+            resolved.push_back(group_id);
+         else
+            resolved.insert(resolved.end(), it->second.begin(), it->second.end());
+      }
+      std::sort(resolved.begin(), resolved.end());
+      resolved.erase(std::unique(resolved.begin(), resolved.end()), resolved.end());
+      entry_group_ids.swap(resolved);
    }
+   // =====================================end 删除=========================================
 
    void UniNavGraph::save(std::string index_path_prefix, std::string results_path_prefix)
    {
       fs::create_directories(index_path_prefix);
       auto start_time = std::chrono::high_resolution_clock::now();
+      sync_covered_sets();
 
       // save meta data
       std::map<std::string, std::string> meta_data;
@@ -1736,6 +3501,7 @@ namespace ANNS
       meta_data["build_num_threads"] = std::to_string(_num_threads);
       meta_data["scenario"] = _scenario;
       meta_data["num_cross_edges"] = std::to_string(_num_cross_edges);
+      meta_data["segment_start"] = std::to_string(_segment_start);
       meta_data["graph_num_edges"] = std::to_string(_graph_num_edges);
       meta_data["LNG_num_edges"] = std::to_string(_LNG_num_edges);
       meta_data["index_size(MB)"] = std::to_string(_index_size);
@@ -1768,6 +3534,8 @@ namespace ANNS
       std::string bin_file = index_path_prefix + "vecs.bin";
       std::string label_file = index_path_prefix + "labels.txt";
       _base_storage->write_to_file(bin_file, label_file);
+      if (_base_storage->get_num_numeric_attrs() > 0)
+         _base_storage->write_numeric_attrs(index_path_prefix + "numeric_attrs");
 
       // save group id to label set
       std::string group_id_to_label_set_filename = index_path_prefix + "group_id_to_label_set";
@@ -1785,6 +3553,11 @@ namespace ANNS
       std::string new_to_old_vec_ids_filename = index_path_prefix + "new_to_old_vec_ids";
       write_1d_vector(new_to_old_vec_ids_filename, _new_to_old_vec_ids);
 
+      // save group ids of the points in the segment
+      std::string segment_group_ids_filename = index_path_prefix + "segment_group_ids";
+      write_1d_vector(segment_group_ids_filename, std::vector<IdxType>(_new_vec_id_to_group_id.begin() + _segment_start,
+                                                                       _new_vec_id_to_group_id.end()));
+
       // save trie index
       std::string trie_filename = index_path_prefix + "trie";
       _trie_index.save(trie_filename);
@@ -1799,6 +3572,10 @@ namespace ANNS
       std::string global_vamana_entry_point_filename = index_path_prefix + "global_vamana_entry_point";
       write_one_T(global_vamana_entry_point_filename, _global_vamana_entry_point);
 
+      // save deleted points
+      std::string deleted_ids_filename = index_path_prefix + "deleted_ids";
+      write_1d_vector(deleted_ids_filename, _tombstones.get_marked());
+
       // save LNG coverage ratio
       std::string coverage_ratio_filename = index_path_prefix + "lng_coverage_ratio";
       write_1d_vector(coverage_ratio_filename, _label_nav_graph->coverage_ratio);
@@ -1836,7 +3613,7 @@ namespace ANNS
       std::cout << "- Index saved in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
    }
 
-   void UniNavGraph::load(std::string index_path_prefix, const std::string &data_type)
+   void UniNavGraph::load(std::string index_path_prefix, const std::string &data_type, bool load_search_data)
    {
       std::cout << "Loading index from " << index_path_prefix << " ..." << std::endl;
       auto start_time = std::chrono::high_resolution_clock::now();
@@ -1845,12 +3622,25 @@ namespace ANNS
       std::string meta_filename = index_path_prefix + "meta";
       auto meta_data = parse_kv_file(meta_filename);
       _num_points = std::stoi(meta_data["num_points"]);
+      _num_groups = std::stoi(meta_data["num_groups"]);
+      _index_name = meta_data["index_name"];
+      _max_degree = std::stoi(meta_data["max_degree"]);
+      _Lbuild = std::stoi(meta_data["Lbuild"]);
+      _alpha = std::stof(meta_data["alpha"]);
+      _scenario = meta_data["scenario"];
+      _num_cross_edges = std::stoi(meta_data["num_cross_edges"]);
+      _segment_start = meta_data.count("segment_start") ? std::stoi(meta_data["segment_start"]) : _num_points;
 
       // load vectors and label sets
-      std::string bin_file = index_path_prefix + "vecs.bin";
-      std::string label_file = index_path_prefix + "labels.txt";
-      _base_storage = create_storage(data_type, false);
-      _base_storage->load_from_file(bin_file, label_file);
+      if (load_search_data)
+      {
+         std::string bin_file = index_path_prefix + "vecs.bin";
+         std::string label_file = index_path_prefix + "labels.txt";
+         _base_storage = create_storage(data_type, false);
+         _base_storage->load_from_file(bin_file, label_file);
+         if (fs::exists(index_path_prefix + "numeric_attrs"))
+            _base_storage->load_numeric_attrs(index_path_prefix + "numeric_attrs");
+      }
 
       // load group id to label set
       std::string group_id_to_label_set_filename = index_path_prefix + "group_id_to_label_set";
@@ -1868,19 +3658,39 @@ namespace ANNS
       std::string new_to_old_vec_ids_filename = index_path_prefix + "new_to_old_vec_ids";
       load_1d_vector(new_to_old_vec_ids_filename, _new_to_old_vec_ids);
 
+      // group of each point, from the ranges and the segment
+      _new_vec_id_to_group_id.assign(_num_points, 0);
+      for (IdxType group_id = 1; group_id <= _num_groups; ++group_id)
+         for (auto id = _group_id_to_range[group_id].first; id < _group_id_to_range[group_id].second; ++id)
+            _new_vec_id_to_group_id[id] = group_id;
+      _group_id_to_segment_ids.assign(_num_groups + 1, std::vector<IdxType>());
+      if (_segment_start < _num_points)
+      {
+         std::vector<IdxType> segment_group_ids;
+         load_1d_vector(index_path_prefix + "segment_group_ids", segment_group_ids);
+         for (IdxType id = _segment_start; id < _num_points; ++id)
+         {
+            _new_vec_id_to_group_id[id] = segment_group_ids[id - _segment_start];
+            _group_id_to_segment_ids[segment_group_ids[id - _segment_start]].push_back(id);
+         }
+      }
+
       // load trie index
       std::string trie_filename = index_path_prefix + "trie";
       _trie_index.load(trie_filename);
 
       // load graph data
-      std::string graph_filename = index_path_prefix + "graph";
-      _graph = std::make_shared<Graph>(_base_storage->get_num_points());
-      _graph->load(graph_filename);
-
-      // fxy_add:load global graph data
-      std::string global_graph_filename = index_path_prefix + "global_graph";
-      _global_graph = std::make_shared<Graph>(_base_storage->get_num_points());
-      _global_graph->load(global_graph_filename);
+      if (load_search_data)
+      {
+         std::string graph_filename = index_path_prefix + "graph";
+         _graph = Graph::create(_base_storage->get_num_points());
+         _graph->load(graph_filename);
+
+         // fxy_add:load global graph data
+         std::string global_graph_filename = index_path_prefix + "global_graph";
+         _global_graph = Graph::create(_base_storage->get_num_points());
+         _global_graph->load(global_graph_filename);
+      }
 
       // fxy_add: load global vamana entry point
       std::string global_vamana_entry_point_filename = index_path_prefix + "global_vamana_entry_point";
@@ -1922,6 +3732,27 @@ namespace ANNS
       load_roaring_vector(covered_sets_rb_filename, _covered_sets_rb);
       std::cout << "_covered_sets_rb loaded." << std::endl;
 
+      // deleted points, they are consolidated again by the next consolidate()
+      std::string deleted_ids_filename = index_path_prefix + "deleted_ids";
+      _tombstones.resize(_num_points);
+      if (fs::exists(deleted_ids_filename))
+      {
+         std::vector<IdxType> deleted_ids;
+         load_1d_vector(deleted_ids_filename, deleted_ids);
+         for (auto id : deleted_ids)
+            _tombstones.set(id);
+         _pending_deletes = deleted_ids;
+         if (!deleted_ids.empty())
+         {
+            if (_scenario != "equality")
+               compute_label_nav_graph_edges();
+            std::vector<IdxType> group_ids(_num_groups);
+            std::iota(group_ids.begin(), group_ids.end(), 1);
+            update_emptied_groups(group_ids);
+         }
+      }
+      publish_snapshot();
+
       // print
       std::cout << "- Index loaded in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
    }
@@ -1932,7 +3763,7 @@ namespace ANNS
       // number of edges in the unified navigating graph
       _graph_num_edges = 0;
       for (IdxType i = 0; i < _num_points; ++i)
-         _graph_num_edges += _graph->neighbors[i].size();
+         _graph_num_edges += _graph->get_neighbors(i).size();
 
       // number of edges in the label navigating graph
       _LNG_num_edges = 0;
@@ -1999,7 +3830,7 @@ namespace ANNS
          for (int i = 0; i < sample_num; ++i) // 每个组采样的个数
          {
             ANNS::IdxType vec_id = vec_ids[i];
-            if (_base_storage->get_label_set(vec_id).empty())
+            if (_base_storage->get_label_span(vec_id).empty())
             {
                continue; // 跳过无 base 属性的向量
             }
@@ -2040,7 +3871,7 @@ namespace ANNS
       for (const auto &task : all_queries)
       {
          // 获取基础存储中的原始标签集
-         const auto &original_labels = _base_storage->get_label_set(task.vec_id);
+         auto original_labels = _base_storage->get_label_span(task.vec_id);
 
          // 写入验证文件（无论是否开启verify都记录）
          verify_file << task.vec_id << " base_labels:";
@@ -2133,6 +3964,12 @@ namespace ANNS
    void UniNavGraph::generate_queries_method1_high_coverage(std::string &output_prefix, std::string dataset, int query_n, std::string &base_label_file, float coverage_threshold)
    {
       // Step 1: 读取base_label_file并统计每列标签频率
+      // the columns are the positions in the text lines, the storage keeps sorted label sets, so the file is read here
+      if (is_label_csr_file(base_label_file))
+      {
+         std::cerr << "Error: column coverage needs a text label file, got CSR: " << base_label_file << std::endl;
+         return;
+      }
       std::ifstream label_file(base_label_file);
       if (!label_file.is_open())
       {
@@ -2421,41 +4258,22 @@ namespace ANNS
        std::string &output_prefix,
        std::string dataset,
        int query_n,
-       std::string &base_label_file,
        int num_of_per_query_labels,
        float coverage_threshold,
        int K)
    {
-      // Step 1: 从标签文件加载并分析标签分布
-      std::ifstream label_file(base_label_file);
-      if (!label_file.is_open())
-      {
-         std::cerr << "Failed to open label file: " << base_label_file << std::endl;
-         return;
-      }
-
+      // Step 1: 从base storage分析标签分布
       // 统计标签出现频率
       std::unordered_map<int, int> label_counts;
       std::vector<std::vector<int>> all_label_sets;
-      std::string line;
-
-      while (std::getline(label_file, line))
+      all_label_sets.reserve(_num_points);
+      for (IdxType vec_id = 0; vec_id < _num_points; ++vec_id)
       {
-         std::vector<int> labels;
-         std::stringstream ss(line);
-         std::string label_str;
-
-         while (std::getline(ss, label_str, ','))
-         {
-            int label = std::stoi(label_str);
-            labels.push_back(label);
+         auto label_set = _base_storage->get_label_span(vec_id);
+         for (auto label : label_set)
             label_counts[label]++;
-         }
-
-         std::sort(labels.begin(), labels.end());
-         all_label_sets.push_back(labels);
+         all_label_sets.emplace_back(label_set.begin(), label_set.end());
       }
-      label_file.close();
 
       // 如果没有标签数据，使用默认标签
       if (all_label_sets.empty())
@@ -2665,7 +4483,7 @@ namespace ANNS
 
       for (LabelType root_label : conceptual_root_labels)
       {
-         auto node = _trie_index.find_exact_match({root_label});
+         auto node = _trie_index.find_exact_match(LabelSpan(&root_label, &root_label + 1));
          if (node)
          {
             IdxType root_group_id = node->group_id;
@@ -2856,7 +4674,6 @@ namespace ANNS
        std::string &output_prefix,
        std::string dataset,
        int query_n,
-       std::string &base_label_file,
        int num_of_per_query_labels, // 每个查询的标签数量
        int K,                       // 标签组合出现次数的下界
        int max_K,                   // 标签组合出现次数的上界
@@ -2866,27 +4683,9 @@ namespace ANNS
       std::unordered_map<int, int> label_counts;
 
       // 第一次扫描：仅统计标签频率
-      {
-         std::ifstream label_file(base_label_file);
-         if (!label_file.is_open())
-         {
-            std::cerr << "Failed to open label file: " << base_label_file << std::endl;
-            return;
-         }
-
-         std::string line;
-         while (std::getline(label_file, line))
-         {
-            std::stringstream ss(line);
-            std::string label_str;
-            while (std::getline(ss, label_str, ','))
-            {
-               int label = std::stoi(label_str);
-               label_counts[label]++;
-            }
-         }
-         label_file.close();
-      }
+      for (IdxType vec_id = 0; vec_id < _num_points; ++vec_id)
+         for (auto label : _base_storage->get_label_span(vec_id))
+            label_counts[label]++;
 
       if (label_counts.empty())
       {
@@ -2900,34 +4699,13 @@ namespace ANNS
 
       // 第二次扫描：仅缓存包含低频标签的行
       std::vector<std::vector<int>> low_freq_label_sets;
+      for (IdxType vec_id = 0; vec_id < _num_points; ++vec_id)
       {
-         std::ifstream label_file(base_label_file);
-         std::string line;
-
-         while (std::getline(label_file, line))
-         {
-            std::vector<int> labels;
-            std::stringstream ss(line);
-            std::string label_str;
-            bool has_low_freq_label = false;
-
-            while (std::getline(ss, label_str, ','))
-            {
-               int label = std::stoi(label_str);
-               if (label_counts[label] <= freq_threshold)
-               {
-                  has_low_freq_label = true;
-               }
-               labels.push_back(label);
-            }
-
-            if (has_low_freq_label)
-            {
-               std::sort(labels.begin(), labels.end());
-               low_freq_label_sets.push_back(labels);
-            }
-         }
-         label_file.close();
+         auto label_set = _base_storage->get_label_span(vec_id);
+         bool has_low_freq_label = std::any_of(label_set.begin(), label_set.end(), [&](LabelType label)
+                                               { return label_counts[label] <= freq_threshold; });
+         if (has_low_freq_label)
+            low_freq_label_sets.emplace_back(label_set.begin(), label_set.end());
       }
 
       // ==================== 阶段3：生成有效标签组合 ====================
@@ -3090,7 +4868,6 @@ namespace ANNS
        std::string &output_prefix,
        std::string dataset,
        int query_n,
-       std::string &base_label_file,
        std::string &base_label_info_file)
    {
       // Step 1: 读取LNG树信息文件获取总层数
@@ -3128,34 +4905,17 @@ namespace ANNS
       int max_depth_top = 3;
       std::cout << "Total layers: " << total_layers << ", Top layers to use: " << max_depth_top << std::endl;
 
-      // Step 2: 读取base_labels文件获取顶层标签
-      std::ifstream label_file(base_label_file);
-      if (!label_file.is_open())
-      {
-         std::cerr << "Failed to open base label file: " << base_label_file << std::endl;
-         return;
-      }
-
+      // Step 2: 按base文件的原始顺序取前几个非空标签集作为顶层标签
+      std::vector<IdxType> old_to_new_vec_ids(_num_points);
+      for (IdxType new_id = 0; new_id < _num_points; ++new_id)
+         old_to_new_vec_ids[_new_to_old_vec_ids[new_id]] = new_id;
       std::vector<std::vector<int>> top_layer_labels;
-      int lines_read = 0;
-      while (std::getline(label_file, line) && lines_read < max_depth_top)
+      for (IdxType old_id = 0; old_id < _num_points && top_layer_labels.size() < (size_t)max_depth_top; ++old_id)
       {
-         std::vector<int> labels;
-         std::stringstream ss(line);
-         std::string label_str;
-
-         while (std::getline(ss, label_str, ','))
-         {
-            labels.push_back(std::stoi(label_str));
-         }
-
-         if (!labels.empty())
-         {
-            top_layer_labels.push_back(labels);
-            lines_read++;
-         }
+         auto label_set = _base_storage->get_label_span(old_to_new_vec_ids[old_id]);
+         if (!label_set.empty())
+            top_layer_labels.emplace_back(label_set.begin(), label_set.end());
       }
-      label_file.close();
 
       if (top_layer_labels.empty())
       {
@@ -3223,5 +4983,187 @@ namespace ANNS
       std::cout << "Vectors written to: " << output_prefix + "/" + dataset + "_query.fvecs" << std::endl;
    }
 
+   // fxy_add: 按选择率区间并行生成查询负载, 选择率由 posting list 的 roaring 交集精确计算, 同时输出精确 ground truth
+   void UniNavGraph::generate_workload(const WorkloadConfig &config, std::shared_ptr<DistanceHandler> distance_handler,
+                                       const std::string &output_prefix, const std::string &dataset,
+                                       std::shared_ptr<IStorage> query_pool)
+   {
+      std::cout << "Generating workload by selectivity bands ..." << std::endl;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      const auto &bounds = config.band_bounds;
+      if (bounds.size() < 2 || !std::is_sorted(bounds.begin(), bounds.end()))
+         throw std::runtime_error("generate_workload: band_bounds must hold at least two ascending values");
+      if (_vector_attr_graph.size() != static_cast<size_t>(_num_points) + _num_attributes)
+         throw std::runtime_error("generate_workload: the vector-attribute graph is not loaded");
+      if (query_pool != nullptr && query_pool->get_dim() != _base_storage->get_dim())
+         throw std::runtime_error("generate_workload: dimension of the query pool does not match the base vectors");
+      omp_set_num_threads(config.num_threads);
+      IdxType num_bands = bounds.size() - 1;
+
+      // posting list of each attribute (new vector ids)
+      prepare_label_postings();
+      const auto &postings = _label_postings_rb;
+
+      // vectors whose label set contains label_set, intersecting the smallest posting lists first
+      auto match_label_set = [&](const std::vector<LabelType> &label_set)
+      {
+         std::vector<const roaring::Roaring *> lists;
+         for (auto label : label_set)
+         {
+            auto it = _attr_to_id.find(label);
+            if (it == _attr_to_id.end())
+               return roaring::Roaring();
+            lists.push_back(&postings[it->second]);
+         }
+         if (lists.empty())
+            return roaring::Roaring();
+         std::sort(lists.begin(), lists.end(), [](const roaring::Roaring *a, const roaring::Roaring *b)
+                   { return a->cardinality() < b->cardinality(); });
+         roaring::Roaring matches = *lists[0];
+         for (size_t i = 1; i < lists.size() && !matches.isEmpty(); ++i)
+            matches &= *lists[i];
+         return matches;
+      };
+
+      // sample candidate label sets in rounds, half from the LNG groups (coverage known from _covered_sets_rb),
+      // half as random subsets of base label sets; acceptance follows the attempt order, so the output only depends on the seed
+      struct Candidate
+      {
+         std::vector<LabelType> label_set;
+         uint64_t num_matches = 0;
+         int32_t band = -1;
+         bool from_group = false;
+      };
+      std::vector<std::vector<Candidate>> accepted(num_bands);
+      std::vector<std::set<std::vector<LabelType>>> seen(num_bands);
+      bool use_coverage = _covered_sets_rb.size() > _num_groups;
+      IdxType round = 0, num_full = 0;
+      for (; round < config.max_rounds && num_full < num_bands; ++round)
+      {
+         std::vector<Candidate> candidates(config.attempts_per_round);
+#pragma omp parallel for schedule(dynamic, 64)
+         for (IdxType i = 0; i < config.attempts_per_round; ++i)
+         {
+            std::seed_seq seq{static_cast<uint32_t>(config.seed), static_cast<uint32_t>(config.seed >> 32), round, i};
+            std::mt19937 gen(seq);
+            auto &candidate = candidates[i];
+            if (i % 2 == 0 && _num_groups > 0)
+            {
+               IdxType group_id = std::uniform_int_distribution<IdxType>(1, _num_groups)(gen);
+               candidate.label_set = _group_id_to_label_set[group_id];
+               candidate.from_group = true;
+               candidate.num_matches = use_coverage ? _covered_sets_rb[group_id].cardinality()
+                                                    : match_label_set(candidate.label_set).cardinality();
+            }
+            else
+            {
+               IdxType vec_id = std::uniform_int_distribution<IdxType>(0, _num_points - 1)(gen);
+               auto label_set = _base_storage->get_label_span(vec_id);
+               if (label_set.empty())
+                  continue;
+               std::bernoulli_distribution keep(0.5);
+               for (auto label : label_set)
+                  if (keep(gen))
+                     candidate.label_set.push_back(label);
+               if (candidate.label_set.empty())
+                  candidate.label_set.push_back(label_set[std::uniform_int_distribution<size_t>(0, label_set.size() - 1)(gen)]);
+               candidate.num_matches = match_label_set(candidate.label_set).cardinality();
+            }
+            double selectivity = static_cast<double>(candidate.num_matches) / _num_points;
+            auto it = std::upper_bound(bounds.begin(), bounds.end(), selectivity);
+            if (it != bounds.begin() && it != bounds.end())
+               candidate.band = static_cast<int32_t>(it - bounds.begin()) - 1;
+         }
+
+         for (auto &candidate : candidates)
+         {
+            auto band = candidate.band;
+            if (band < 0 || accepted[band].size() >= config.queries_per_band)
+               continue;
+            if (!seen[band].insert(candidate.label_set).second)
+               continue;
+            accepted[band].push_back(std::move(candidate));
+            if (accepted[band].size() == config.queries_per_band)
+               ++num_full;
+         }
+      }
+      std::vector<Candidate> queries;
+      for (IdxType b = 0; b < num_bands; ++b)
+      {
+         if (accepted[b].size() < config.queries_per_band)
+            std::cout << "! Warning: band [" << bounds[b] << ", " << bounds[b + 1] << ") only has "
+                      << accepted[b].size() << " distinct label sets after " << round << " rounds" << std::endl;
+         for (auto &candidate : accepted[b])
+            queries.push_back(std::move(candidate));
+      }
+      IdxType num_queries = queries.size();
+      std::cout << "- Sampled " << num_queries << " label sets in " << round << " rounds" << std::endl;
+
+      // query vectors, from the pool or random base vectors; a base vector is left out of its own ground truth,
+      // otherwise it would be its own nearest neighbor at distance 0
+      IdxType dim = _base_storage->get_dim();
+      size_t vec_bytes = dim * (_base_storage->get_data_type() == DataType::FLOAT ? sizeof(float) : sizeof(uint8_t));
+      std::vector<char> query_vecs(static_cast<size_t>(num_queries) * vec_bytes);
+      std::vector<IdxType> source_ids(num_queries, std::numeric_limits<IdxType>::max());
+      auto source = query_pool != nullptr ? query_pool : _base_storage;
+      std::mt19937_64 vec_gen(config.seed);
+      std::uniform_int_distribution<IdxType> vec_dis(0, source->get_num_points() - 1);
+      for (IdxType q = 0; q < num_queries; ++q)
+      {
+         IdxType source_id = vec_dis(vec_gen);
+         std::memcpy(query_vecs.data() + q * vec_bytes, source->get_vector(source_id), vec_bytes);
+         if (query_pool == nullptr)
+            source_ids[q] = source_id;
+      }
+
+      // exact ground truth by scanning the matching vectors
+      std::vector<std::pair<IdxType, float>> gt(static_cast<size_t>(num_queries) * config.K);
+#pragma omp parallel for schedule(dynamic, 1)
+      for (IdxType q = 0; q < num_queries; ++q)
+      {
+         const char *query = query_vecs.data() + q * vec_bytes;
+         SearchQueue search_queue;
+         search_queue.reserve(config.K);
+         for (auto vec_id : match_label_set(queries[q].label_set))
+            if (vec_id != source_ids[q])
+               search_queue.insert(vec_id, distance_handler->compute(query, _base_storage->get_vector(vec_id), dim));
+         for (IdxType k = 0; k < config.K; ++k)
+         {
+            if (k < static_cast<IdxType>(search_queue.size()))
+               gt[q * config.K + k] = std::make_pair(_new_to_old_vec_ids[search_queue[k].id], search_queue[k].distance);
+            else
+               gt[q * config.K + k] = std::make_pair(-1, -1);
+         }
+      }
+
+      // write queries, labels, ground truth and per-query statistics
+      std::string file_prefix = output_prefix + dataset;
+      std::ofstream vec_file(file_prefix + "_query.bin", std::ios::binary);
+      vec_file.write((char *)&num_queries, sizeof(IdxType));
+      vec_file.write((char *)&dim, sizeof(IdxType));
+      vec_file.write(query_vecs.data(), query_vecs.size());
+      vec_file.close();
+
+      std::ofstream label_file(file_prefix + "_query_labels.txt");
+      std::ofstream stats_file(file_prefix + "_workload_stats.csv");
+      stats_file << "QueryID,BandLow,BandHigh,Selectivity,NumMatches,NumLabels,Source" << std::endl;
+      for (IdxType q = 0; q < num_queries; ++q)
+      {
+         const auto &query = queries[q];
+         for (size_t j = 0; j < query.label_set.size(); ++j)
+            label_file << (j == 0 ? "" : ",") << query.label_set[j];
+         label_file << std::endl;
+         stats_file << q << "," << bounds[query.band] << "," << bounds[query.band + 1] << ","
+                    << static_cast<double>(query.num_matches) / _num_points << "," << query.num_matches << ","
+                    << query.label_set.size() << "," << (query.from_group ? "group" : "base_subset") << std::endl;
+      }
+      label_file.close();
+      stats_file.close();
+      write_gt_file(file_prefix + "_gt_labels_containment.bin", gt.data(), num_queries, config.K);
+
+      std::cout << "- Finish in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms" << std::endl;
+      std::cout << "- Workload written to " << file_prefix << "_{query.bin, query_labels.txt, gt_labels_containment.bin, workload_stats.csv}" << std::endl;
+   }
+
    // ===================================end：生成query task========================================
 }
\ No newline at end of file
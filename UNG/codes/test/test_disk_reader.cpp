@@ -0,0 +1,87 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "disk_reader.h"
+
+// the readers of the disk index: batches return the sectors they ask for, a read past the end of the file fails the
+// batch, and the reader stays usable afterwards (no completion of the failed batch is left for the next one)
+int main() {
+    const std::string filename = "disk_reader_file.bin";
+    const size_t num_sectors = 64;
+    {
+        std::ofstream out(filename, std::ios::binary);
+        std::vector<char> sector(ANNS::SECTOR_SIZE);
+        for (size_t s = 0; s < num_sectors; ++s) {
+            std::fill(sector.begin(), sector.end(), static_cast<char>(s));
+            out.write(sector.data(), sector.size());
+        }
+    }
+    auto file = std::make_shared<ANNS::DiskFile>(filename);
+    auto io_pool = std::make_shared<ANNS::IoThreadPool>(4);
+
+    // sectors first, first + step, ... of one batch, each into its own buffer; the first read is past the end of the
+    // file with past_end
+    auto read_batch = [&](ANNS::DiskReader &reader, size_t first, size_t step, size_t num, bool past_end) {
+        std::vector<std::unique_ptr<ANNS::AlignedBuffer>> buffers;
+        std::vector<ANNS::ReadRequest> requests;
+        for (size_t i = 0; i < num; ++i) {
+            size_t sector = past_end && i == 0 ? num_sectors : (first + i * step) % num_sectors;
+            buffers.emplace_back(new ANNS::AlignedBuffer(ANNS::SECTOR_SIZE));
+            requests.push_back({sector * ANNS::SECTOR_SIZE, ANNS::SECTOR_SIZE, buffers.back()->data});
+        }
+        reader.read(requests);
+        for (size_t i = 0; i < num; ++i)
+            for (size_t b = 0; b < ANNS::SECTOR_SIZE; ++b)
+                if (buffers[i]->data[b] != static_cast<char>(requests[i].offset / ANNS::SECTOR_SIZE))
+                    return false;
+        return true;
+    };
+
+    bool ok = true;
+    for (std::string engine : {"pread", "io_uring", "auto"}) {
+        std::unique_ptr<ANNS::DiskReader> reader;
+        try {
+            reader = ANNS::create_disk_reader(file, engine, 8, io_pool);
+        } catch (const std::runtime_error &e) {
+            std::cout << "- " << engine << " is not available: " << e.what() << std::endl;
+            continue;
+        }
+
+        // batches larger than the queue depth
+        bool engine_ok = read_batch(*reader, 3, 5, 20, false);
+
+        // a read past the end fails the whole batch, the next (smaller) batches are read correctly
+        bool thrown = false;
+        try {
+            read_batch(*reader, 0, 1, 8, true);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        engine_ok = engine_ok && thrown && read_batch(*reader, 9, 1, 1, false) && read_batch(*reader, 7, 3, 8, false);
+        std::cout << "- " << reader->get_name() << " (" << engine << "): " << (engine_ok ? "ok" : "failed") << std::endl;
+        ok = ok && engine_ok;
+    }
+
+    // concurrent batches sharing the I/O threads
+    std::vector<std::thread> threads;
+    std::vector<int> thread_ok(8, 1);
+    for (size_t t = 0; t < thread_ok.size(); ++t)
+        threads.emplace_back([&, t] {
+            auto reader = ANNS::create_disk_reader(file, "pread", 8, io_pool);
+            for (size_t batch = 0; batch < 200; ++batch)
+                if (!read_batch(*reader, t + batch, 7, 6, false))
+                    thread_ok[t] = 0;
+        });
+    for (auto &thread : threads)
+        thread.join();
+    for (auto value : thread_ok)
+        ok = ok && value;
+
+    if (!ok) {
+        std::cerr << "disk reader returned wrong data or accepted a read past the end" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "filter_expr.h"
+#include "label_io.h"
+
+// filter expressions over label names: the names are resolved through the dictionary of a CSR label file written by
+// convert_label_txt_to_csr, as search_UNG_index does with --label_dict_file
+int main() {
+    const std::string dir = "filter_expr_files/";
+    boost::filesystem::create_directories(dir);
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // names longer than the small string buffer, so a dangling dictionary does not go unnoticed
+    const std::vector<std::string> names = {"brand:alpha-industries", "brand:beta-corporation", "discontinued-item"};
+    {
+        std::ofstream out(dir + "labels.txt");
+        out << names[0] << "\n" << names[1] << "\n" << names[0] << "," << names[2] << "\n";
+    }
+    ANNS::convert_label_txt_to_csr(dir + "labels.txt", dir + "labels.csr", true);
+    auto name_to_label = ANNS::load_label_names(dir + "labels.csr");
+    check(name_to_label.size() == names.size(), "dictionary size");
+    for (size_t i = 0; i < names.size(); ++i)
+        check(name_to_label.count(names[i]) && name_to_label.at(names[i]) == i + 1, "label id of " + names[i]);
+
+    // the expression file as given by --query_filter_file
+    {
+        std::ofstream out(dir + "filters.txt");
+        out << "(" << names[0] << " || " << names[1] << ") && !" << names[2] << "\n";
+        out << "NOT 1 OR 3\n";
+        out << "*\n";
+    }
+    auto filters = ANNS::load_filter_exprs(dir + "filters.txt", name_to_label);
+    check(filters.size() == 3, "number of expressions");
+    std::vector<std::vector<ANNS::LabelType>> label_sets = {{1, 3}, {2}, {1}, {}};
+    std::vector<std::vector<bool>> expected = {{false, true, true, false}, {true, true, false, true},
+                                               {true, true, true, true}};
+    for (size_t f = 0; f < filters.size() && f < expected.size(); ++f)
+        for (size_t i = 0; i < label_sets.size(); ++i)
+            check(filters[f].matches(ANNS::LabelSpan(label_sets[i])) == expected[f][i],
+                  filters[f].to_string() + " on point " + std::to_string(i));
+
+    // evaluate over posting lists agrees with matches
+    std::vector<roaring::Roaring> posting_lists(4);
+    roaring::Roaring universe;
+    for (uint32_t i = 0; i < label_sets.size(); ++i) {
+        universe.add(i);
+        for (auto label : label_sets[i])
+            posting_lists[label].add(i);
+    }
+    for (size_t f = 0; f < filters.size() && f < expected.size(); ++f) {
+        auto ids = filters[f].evaluate([&](ANNS::LabelType label) -> const roaring::Roaring & {
+            return posting_lists[label];
+        }, universe);
+        for (uint32_t i = 0; i < label_sets.size(); ++i)
+            check(ids.contains(i) == expected[f][i], "evaluate " + filters[f].to_string() + " on point " + std::to_string(i));
+    }
+
+    // unknown names and syntax errors are rejected
+    for (std::string text : {"brand:unknown", "(1 AND 2", "1 OR", "AND 1"}) {
+        bool thrown = false;
+        try {
+            ANNS::FilterExpr::parse(text, name_to_label);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(thrown, "rejects '" + text + "'");
+    }
+
+    if (!ok)
+        return 1;
+    std::cout << "- filter expressions resolved through the label dictionary" << std::endl;
+    return 0;
+}
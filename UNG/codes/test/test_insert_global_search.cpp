@@ -0,0 +1,84 @@
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "uni_nav_graph.h"
+#include "utils.h"
+
+// points inserted into a built UniNavGraph must be found when search_hybrid falls back to the global graph: every
+// point has label 1, so a query for {1} covers the whole index and is answered by global search
+int main() {
+    const ANNS::IdxType num_points = 3000, num_new = 50, dim = 16, K = 10, Lsearch = 50;
+    const uint32_t num_threads = 4;
+    const std::string index_path_prefix = "insert_global_index/", results_path_prefix = "insert_global_results/";
+    boost::filesystem::create_directories(results_path_prefix);
+
+    // points with label 1 and 1-2 of the labels 2-5
+    std::mt19937 rng(11);
+    std::normal_distribution<float> value_dist;
+    std::uniform_int_distribution<ANNS::LabelType> label_dist(2, 5);
+    auto append = [&](std::shared_ptr<ANNS::IStorage> storage, ANNS::IdxType num) {
+        std::vector<float> vec(dim);
+        for (ANNS::IdxType i = 0; i < num; ++i) {
+            for (auto &value : vec)
+                value = value_dist(rng);
+            std::set<ANNS::LabelType> labels{1};
+            for (auto num_labels = 2 + rng() % 2; labels.size() < num_labels;)
+                labels.insert(label_dist(rng));
+            std::vector<ANNS::LabelType> label_set(labels.begin(), labels.end());
+            storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_set));
+        }
+    };
+    auto base_storage = ANNS::create_storage("float", dim, 0);
+    auto new_points = ANNS::create_storage("float", dim, 0);
+    append(base_storage, num_points);
+    append(new_points, num_new);
+
+    // build and save, then add a global Vamana graph over the saved (reordered) vectors
+    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+    {
+        ANNS::UniNavGraph index(num_points);
+        index.build(base_storage, distance_handler, "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+        index.save(index_path_prefix, results_path_prefix);
+    }
+    {
+        auto saved_storage = ANNS::create_storage("float", false);
+        saved_storage->load_from_file(index_path_prefix + "vecs.bin", index_path_prefix + "labels.txt");
+        auto global_graph = std::make_shared<ANNS::Graph>(num_points);
+        ANNS::Vamana global_vamana(false);
+        global_vamana.build(saved_storage, distance_handler, global_graph, 32, 100, 1.2, num_threads);
+        std::string global_graph_filename = index_path_prefix + "global_graph";
+        global_graph->save(global_graph_filename);
+        ANNS::write_one_T(index_path_prefix + "global_vamana_entry_point", global_vamana.get_entry_point());
+    }
+
+    // insert, each new point is its own query
+    ANNS::UniNavGraph index(1);
+    index.load(index_path_prefix, "float");
+    auto new_ids = index.insert(new_points, distance_handler, num_threads);
+    auto query_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<ANNS::LabelType> query_label_set{1};
+    for (ANNS::IdxType i = 0; i < num_new; ++i)
+        query_storage->append(new_points->get_vector(i), ANNS::LabelSpan(query_label_set));
+
+    std::vector<std::pair<ANNS::IdxType, float>> results(num_new * K);
+    std::vector<float> num_cmps(num_new);
+    std::vector<ANNS::QueryStats> query_stats;
+    std::vector<std::bitset<10000001>> bitmaps;
+    index.search_hybrid(query_storage, distance_handler, num_threads, Lsearch, 1, "containment", K, results.data(),
+                        num_cmps, query_stats, bitmaps, false);
+
+    ANNS::IdxType num_global = 0, num_found = 0;
+    for (ANNS::IdxType i = 0; i < num_new; ++i) {
+        num_global += query_stats[i].is_global_search;
+        num_found += results[i * K].first == new_ids[i];
+    }
+    std::cout << "- " << num_global << " global searches, " << num_found << " of " << num_new
+              << " inserted points found" << std::endl;
+    if (num_global != num_new || num_found != num_new) {
+        std::cerr << "inserted points are not reached by global search" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+#include "uni_nav_graph.h"
+
+// search_intra_query must find what search finds, with about as many distance computations, in both of its per-group
+// paths: the groups one after another by all the workers (more threads than groups) and the groups on different
+// threads (as many threads as groups). Both share one visited set across the groups of a query, as search does
+int main() {
+    const ANNS::IdxType dim = 16, num_queries = 20, K = 10, num_entry_points = 4;
+    const uint32_t num_threads = 8;
+
+    // clusters along the first dimension, groups are numbered in the order of their first point
+    std::mt19937 rng(7);
+    std::normal_distribution<float> value_dist;
+    auto append = [&](std::shared_ptr<ANNS::IStorage> storage, ANNS::IdxType num, float center,
+                      std::vector<ANNS::LabelType> label_set) {
+        std::vector<float> vec(dim);
+        for (ANNS::IdxType i = 0; i < num; ++i) {
+            for (auto &value : vec)
+                value = value_dist(rng);
+            vec[0] += center;
+            storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_set));
+        }
+    };
+    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+
+    // overlap of the results with those of search, and the ratio of the distance computations
+    bool ok = true;
+    auto compare = [&](ANNS::UniNavGraph &index, std::shared_ptr<ANNS::IStorage> query_storage, ANNS::IdxType Lsearch,
+                       uint32_t intra_threads, const std::string &what) {
+        std::vector<std::pair<ANNS::IdxType, float>> results(num_queries * K), intra_results(num_queries * K);
+        std::vector<float> num_cmps(num_queries), intra_num_cmps(num_queries);
+        std::vector<ANNS::QueryStats> query_stats, intra_query_stats;
+        std::vector<std::bitset<10000001>> bitmap;
+        index.search(query_storage, distance_handler, num_threads, Lsearch, num_entry_points, "overlap", K,
+                     results.data(), num_cmps, query_stats, bitmap);
+        index.search_intra_query(query_storage, distance_handler, intra_threads, Lsearch, num_entry_points, "overlap",
+                                 K, intra_results.data(), intra_num_cmps, intra_query_stats);
+        size_t num_found = 0, num_common = 0;
+        for (ANNS::IdxType i = 0; i < num_queries; ++i) {
+            std::set<ANNS::IdxType> ids;
+            for (ANNS::IdxType k = 0; k < K; ++k)
+                if (results[i * K + k].first != -1)
+                    ids.insert(results[i * K + k].first);
+            num_found += ids.size();
+            for (ANNS::IdxType k = 0; k < K; ++k)
+                num_common += ids.count(intra_results[i * K + k].first);
+        }
+        float overlap = num_found == 0 ? 0 : static_cast<float>(num_common) / num_found;
+        double cmps_ratio = std::accumulate(intra_num_cmps.begin(), intra_num_cmps.end(), 0.0) /
+                            std::accumulate(num_cmps.begin(), num_cmps.end(), 0.0);
+        std::cout << "- " << what << ", " << intra_threads << " threads: overlap with search " << overlap * 100
+                  << "%, distance computations " << cmps_ratio << "x those of search" << std::endl;
+        if (num_found == 0 || overlap < 0.9) {
+            std::cerr << "search_intra_query misses results of search" << std::endl;
+            ok = false;
+        }
+        if (cmps_ratio > 1.1) {
+            std::cerr << "search_intra_query expands points reached from several groups more than once" << std::endl;
+            ok = false;
+        }
+    };
+
+    // groups one after another: the query {1, 2} enters groups {2} and {1}; {1} is emptied by deletes and redirected
+    // to {1, 2}. The search in {2} visits the points of {1, 2} through its cross-group edges without expanding them,
+    // and the nearest neighbors of the queries are in {1, 2, 4}, which is only reached through {1, 2}
+    {
+        auto base_storage = ANNS::create_storage("float", dim, 0);
+        auto query_storage = ANNS::create_storage("float", dim, 0);
+        std::vector<ANNS::IdxType> deleted_ids;
+        append(base_storage, 1000, 0, {2});
+        for (ANNS::IdxType i = 0; i < 20; ++i)
+            deleted_ids.push_back(base_storage->get_num_points() + i);
+        append(base_storage, 20, 0, {1});
+        append(base_storage, 2, -20, {1, 2});
+        append(base_storage, 300, 40, {1, 2, 4});
+        append(query_storage, num_queries, 40, {1, 2});
+
+        ANNS::UniNavGraph index(base_storage->get_num_points());
+        index.build(base_storage, distance_handler, "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+        index.remove(deleted_ids);
+        index.consolidate(distance_handler, num_threads);
+        compare(index, query_storage, 10, num_threads, "entry groups reached by an earlier group");
+    }
+
+    // groups on different threads: the query {1, 2} enters groups {1} and {2}, whose searches both cross into their
+    // common child {1, 2} around the queries
+    {
+        auto base_storage = ANNS::create_storage("float", dim, 0);
+        auto query_storage = ANNS::create_storage("float", dim, 0);
+        append(base_storage, 300, 0, {1});
+        append(base_storage, 300, 0, {2});
+        append(base_storage, 1500, 0, {1, 2});
+        append(query_storage, num_queries, 0, {1, 2});
+
+        ANNS::UniNavGraph index(base_storage->get_num_points());
+        index.build(base_storage, distance_handler, "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+        compare(index, query_storage, 100, 2, "groups sharing a child");
+    }
+    return ok ? 0 : 1;
+}
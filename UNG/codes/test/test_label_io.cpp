@@ -0,0 +1,154 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "label_io.h"
+#include "uni_nav_graph.h"
+#include "vecs_io.h"
+
+// the label file readers: the text parser on valid and invalid lines, the query label files written by
+// UniNavGraph::query_generate, and the CSR writer and readers
+int main() {
+    const std::string dir = "label_io_files/";
+    boost::filesystem::create_directories(dir);
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+    auto load_txt = [&](const std::string &filename, ANNS::IdxType num_points) {
+        std::vector<std::vector<ANNS::LabelType>> label_sets(num_points);
+        std::vector<ANNS::IdxType> label_cnts;
+        ANNS::load_label_txt(filename, label_sets.data(), 0, num_points, label_cnts);
+        return label_sets;
+    };
+
+    // text parser: sorted sets, empty lines, '\r', trailing spaces and one trailing comma
+    {
+        std::ofstream out(dir + "valid.txt");
+        out << "3,1,2\n5,\n\n7\r\n4, \n";
+    }
+    std::vector<std::vector<ANNS::LabelType>> expected = {{1, 2, 3}, {5}, {}, {7}, {4}};
+    check(load_txt(dir + "valid.txt", expected.size()) == expected, "valid text labels");
+    for (std::string line : {"1,,2", ",1", "1,2,,", "a", "1;2", "1 2", "70000"}) {
+        {
+            std::ofstream out(dir + "invalid.txt");
+            out << "1\n" << line << "\n";
+        }
+        bool thrown = false;
+        try {
+            load_txt(dir + "invalid.txt", 2);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(thrown, "rejects '" + line + "'");
+    }
+
+    // query_generate writes the label set of each query with a comma after every label; with keep_prob 1 it is the
+    // label set of the base point whose vector is the query
+    const ANNS::IdxType num_points = 1000, dim = 8;
+    std::mt19937 rng(5);
+    std::normal_distribution<float> value_dist;
+    std::uniform_int_distribution<ANNS::LabelType> label_dist(1, 6);
+    auto base_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<float> vec(dim);
+    for (ANNS::IdxType i = 0; i < num_points; ++i) {
+        for (auto &value : vec)
+            value = value_dist(rng);
+        std::set<ANNS::LabelType> labels;
+        for (auto num_labels = 1 + rng() % 3; labels.size() < num_labels;)
+            labels.insert(label_dist(rng));
+        std::vector<ANNS::LabelType> label_set(labels.begin(), labels.end());
+        base_storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_set));
+    }
+    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+    ANNS::UniNavGraph index(num_points);
+    index.build(base_storage, distance_handler, "general", "Vamana", 4, 6, 16, 50, 1.2);
+    std::string query_prefix = dir + "query";
+    index.query_generate(query_prefix, 2, 1.0, false, false);
+
+    auto info = ANNS::sniff_vecs_file(query_prefix + ".fvecs");
+    std::vector<float> query_vecs(info.num_points * info.dim);
+    ANNS::read_vecs(query_prefix + ".fvecs", info, 0, info.num_points, query_vecs.data());
+    auto query_label_sets = load_txt(query_prefix + "_labels.txt", info.num_points);
+    check(info.num_points > 0 && info.dim == dim, "generated queries");
+    for (size_t q = 0; q < info.num_points; ++q) {
+        ANNS::IdxType base_id = 0;
+        while (base_id < num_points &&
+               std::memcmp(base_storage->get_vector(base_id), query_vecs.data() + q * dim, dim * sizeof(float)) != 0)
+            ++base_id;
+        check(base_id < num_points, "base point of query " + std::to_string(q));
+        if (base_id == num_points)
+            continue;
+        auto base_labels = base_storage->get_label_span(base_id);
+        check(std::vector<ANNS::LabelType>(base_labels.begin(), base_labels.end()) == query_label_sets[q],
+              "labels of query " + std::to_string(q));
+    }
+
+    // CSR: write, load, map in place and convert back to text
+    std::vector<std::string> dictionary = {"", "red", "green", "blue", "", "large", "", "small"};
+    ANNS::write_label_csr(dir + "labels.csr", expected.data(), expected.size(), dictionary);
+    {
+        std::vector<std::vector<ANNS::LabelType>> loaded(expected.size());
+        std::vector<ANNS::IdxType> label_cnts;
+        ANNS::load_label_csr(dir + "labels.csr", loaded.data(), 0, expected.size(), label_cnts);
+        check(loaded == expected && label_cnts[3] == 1 && label_cnts[6] == 0, "loaded CSR labels");
+        auto csr = ANNS::open_label_csr(dir + "labels.csr", 1, expected.size() - 1, label_cnts);
+        check(csr != nullptr && csr->dictionary() == dictionary, "mapped CSR file");
+        if (csr != nullptr)
+            for (size_t i = 0; i < expected.size(); ++i)
+                check(std::vector<ANNS::LabelType>(csr->begin(i), csr->end(i)) == expected[i],
+                      "mapped CSR labels of point " + std::to_string(i));
+        check(label_cnts[1] == 0 && label_cnts[5] == 1, "label counts of the mapped rows");
+        check(ANNS::open_label_csr(dir + "labels.csr", 1, expected.size(), label_cnts) == nullptr,
+              "rows past the end of the CSR file");
+    }
+    ANNS::convert_label_csr_to_txt(dir + "labels.csr", dir + "labels_back.txt", false);
+    check(load_txt(dir + "labels_back.txt", expected.size()) == expected, "CSR converted back to text");
+
+    // corrupt CSR files are rejected when opened: offsets at byte 24, labels at 72, the dictionary at 84 (its first
+    // name length at 92)
+    std::string csr_bytes;
+    {
+        std::ifstream in(dir + "labels.csr", std::ios::binary);
+        csr_bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto patch = [&](size_t pos, uint64_t value, size_t size) {
+        std::string bytes = csr_bytes;
+        std::memcpy(&bytes[pos], &value, size);
+        return bytes;
+    };
+    std::vector<std::pair<std::string, std::string>> corrupt_files = {
+        {"first offset not 0", patch(24, 1, 8)},
+        {"decreasing offsets", patch(40, 2, 8)},
+        {"offset past the labels", patch(32, 1000000, 8)},
+        {"last offset past the labels", patch(64, 7, 8)},
+        {"unsorted row", patch(72, 3, 2)},
+        {"truncated labels", csr_bytes.substr(0, 76)},
+        {"dictionary name past the end", patch(92, 1000, 4)},
+        {"dictionary size past the end", patch(84, 1ull << 40, 8)}};
+    for (const auto &[what, bytes] : corrupt_files) {
+        {
+            std::ofstream out(dir + "corrupt.csr", std::ios::binary);
+            out.write(bytes.data(), bytes.size());
+        }
+        bool thrown = false;
+        try {
+            ANNS::LabelCSR csr(dir + "corrupt.csr");
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(thrown, "rejects a CSR file with " + what);
+    }
+
+    if (!ok)
+        return 1;
+    std::cout << "- " << info.num_points << " generated query label sets read back" << std::endl;
+    return 0;
+}
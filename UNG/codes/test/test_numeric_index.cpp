@@ -0,0 +1,125 @@
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "numeric_index.h"
+
+// NumericRangeIndex::range returns the ids whose value lies in [lo, hi], as in_ranges decides it, for any number of
+// buckets: bounds on bucket boundaries and on repeated values, lo == hi, empty and inverted ranges, ranges outside
+// the values, and NaN values and bounds, which are in no range even with the -Ofast build
+int main() {
+    const ANNS::IdxType num_points = 2000, dim = 4;
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // column 0 repeats the values 0..49, column 1 is continuous with every 10th value NaN
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> value_dist(-100, 100);
+    auto storage = ANNS::create_storage("float", dim, 2);
+    std::vector<float> vec(dim, 0), attrs(2);
+    std::vector<ANNS::LabelType> label_set = {1};
+    for (ANNS::IdxType i = 0; i < num_points; ++i) {
+        attrs[0] = i % 50;
+        attrs[1] = i % 10 == 0 ? std::numeric_limits<float>::quiet_NaN() : value_dist(rng);
+        storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_set), attrs.data());
+    }
+    auto expected = [&](ANNS::IdxType column, float lo, float hi) {
+        roaring::Roaring ids;
+        std::vector<ANNS::NumericRange> ranges = {{column, lo, hi}};
+        for (ANNS::IdxType id = 0; id < num_points; ++id)
+            if (ANNS::in_ranges(storage->get_numeric_attrs(id), ranges))
+                ids.add(id);
+        return ids;
+    };
+
+    // -Ofast assumes finite values, the widest range is [lowest, max]
+    const float nan = std::numeric_limits<float>::quiet_NaN(), lowest = std::numeric_limits<float>::lowest(),
+                max = std::numeric_limits<float>::max();
+    for (ANNS::IdxType num_buckets : {1, 7, 50, 256, 5000}) {
+        ANNS::NumericRangeIndex index0, index1;
+        index0.build(storage, 0, num_buckets);
+        index1.build(storage, 1, num_buckets);
+        check(index0.get_num_points() == num_points && index1.get_num_points() == num_points - num_points / 10,
+              "NaN values left out with " + std::to_string(num_buckets) + " buckets");
+
+        // repeated values: every pair of bounds on and between them
+        bool repeated_ok = true;
+        for (float lo = -1.5f; repeated_ok && lo <= 51; lo += 0.5f)
+            for (float hi = lo - 1; repeated_ok && hi <= 51; hi += 0.5f)
+                repeated_ok = index0.range(lo, hi) == expected(0, lo, hi);
+        check(repeated_ok, "ranges of repeated values with " + std::to_string(num_buckets) + " buckets");
+
+        // continuous values: bounds on the values themselves and random bounds
+        std::uniform_int_distribution<ANNS::IdxType> id_dist(1, num_points - 1);
+        for (int i = 0; i < 500; ++i) {
+            float a = storage->get_numeric_attrs(id_dist(rng))[1], b = storage->get_numeric_attrs(id_dist(rng))[1];
+            if (ANNS::is_nan_value(a) || ANNS::is_nan_value(b))
+                continue;
+            float lo = std::min(a, b), hi = std::max(a, b);
+            check(index1.range(lo, hi) == expected(1, lo, hi), "range between two values");
+            check(index1.range(lo, lo) == expected(1, lo, lo) && index1.range(lo, lo).cardinality() >= 1, "lo == hi");
+            lo = value_dist(rng), hi = value_dist(rng);
+            check(index1.range(lo, hi) == expected(1, lo, hi), "random range");
+        }
+
+        // empty, inverted, outside and unbounded ranges
+        check(index0.range(10.5f, 10.9f).isEmpty() && index0.range(20, 10).isEmpty(), "empty and inverted ranges");
+        check(index0.range(50, 1000).isEmpty() && index0.range(-1000, -1).isEmpty(), "ranges outside the values");
+        check(index0.range(lowest, max).cardinality() == num_points &&
+                  index1.range(lowest, max).cardinality() == index1.get_num_points() &&
+                  index1.range(lowest, max) == expected(1, lowest, max),
+              "widest range");
+        check(index1.range(nan, 0).isEmpty() && index1.range(0, nan).isEmpty() && index1.range(nan, nan).isEmpty() &&
+                  expected(1, nan, 0).isEmpty() && expected(1, lowest, nan).isEmpty(),
+              "NaN bounds");
+    }
+
+    // all values NaN, and a column out of range
+    {
+        auto nan_storage = ANNS::create_storage("float", dim, 1);
+        for (ANNS::IdxType i = 0; i < 10; ++i)
+            nan_storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_set), &nan);
+        ANNS::NumericRangeIndex index;
+        index.build(nan_storage, 0);
+        check(index.get_num_points() == 0 && index.range(lowest, max).isEmpty(), "column of NaN values");
+        bool thrown = false;
+        try {
+            index.build(nan_storage, 1);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(thrown, "column out of range");
+    }
+
+    // range files: triples per line, an empty line has no range
+    {
+        std::ofstream out("numeric_ranges.txt");
+        out << "0 1.5 2\n\n1 -3 4 0 0 0\n";
+    }
+    auto query_ranges = ANNS::load_numeric_ranges("numeric_ranges.txt");
+    check(query_ranges.size() == 3 && query_ranges[0].size() == 1 && query_ranges[1].empty() &&
+              query_ranges[2].size() == 2 && query_ranges[0][0].lo == 1.5f && query_ranges[2][1].column == 0,
+          "range file");
+    {
+        std::ofstream out("numeric_ranges.txt");
+        out << "0 1.5\n";
+    }
+    bool thrown = false;
+    try {
+        ANNS::load_numeric_ranges("numeric_ranges.txt");
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    check(thrown, "range line without hi");
+
+    if (!ok)
+        return 1;
+    std::cout << "- numeric ranges match a scan of the values" << std::endl;
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "sharded_ung.h"
+
+// ShardedUniNavGraph with the range and the group partition: the merged top-K in global ids matches a scan of all
+// points, a query is only sent to the shards holding a matching point, and a saved and loaded index returns the same
+// results; invalid partitions are rejected
+int main() {
+    const ANNS::IdxType num_points = 3000, dim = 16, num_queries = 50, K = 10, Lsearch = 100, num_shards = 3;
+    const uint32_t num_threads = 4;
+    const std::string dir = "sharded_files/";
+    boost::filesystem::create_directories(dir);
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // five groups, {5} only contains itself
+    std::mt19937 rng(9);
+    std::normal_distribution<float> value_dist;
+    const std::vector<std::vector<ANNS::LabelType>> label_sets = {{1}, {2}, {1, 2}, {1, 3}, {5}};
+    auto base_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<std::vector<float>> base_vecs(num_points, std::vector<float>(dim));
+    std::vector<std::vector<ANNS::LabelType>> base_label_sets(num_points);
+    for (ANNS::IdxType i = 0; i < num_points; ++i) {
+        for (auto &value : base_vecs[i])
+            value = value_dist(rng);
+        base_label_sets[i] = label_sets[rng() % label_sets.size()];
+        base_storage->append(reinterpret_cast<const char *>(base_vecs[i].data()), ANNS::LabelSpan(base_label_sets[i]));
+    }
+    base_storage->write_to_file(dir + "base.bin", dir + "base_labels.txt");
+    auto query_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<float> vec(dim);
+    for (ANNS::IdxType i = 0; i < num_queries; ++i) {
+        for (auto &value : vec)
+            value = value_dist(rng);
+        query_storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_sets[i % label_sets.size()]));
+    }
+    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+
+    // containment top-K of each query by a scan, in global ids
+    std::vector<std::set<ANNS::GlobalIdxType>> true_ids(num_queries);
+    for (ANNS::IdxType q = 0; q < num_queries; ++q) {
+        const auto &query_labels = label_sets[q % label_sets.size()];
+        std::vector<std::pair<float, ANNS::GlobalIdxType>> candidates;
+        for (ANNS::IdxType id = 0; id < num_points; ++id)
+            if (std::includes(base_label_sets[id].begin(), base_label_sets[id].end(), query_labels.begin(), query_labels.end()))
+                candidates.emplace_back(distance_handler->compute(query_storage->get_vector(q),
+                                                                  reinterpret_cast<const char *>(base_vecs[id].data()), dim),
+                                        id);
+        std::sort(candidates.begin(), candidates.end());
+        for (size_t k = 0; k < std::min<size_t>(K, candidates.size()); ++k)
+            true_ids[q].insert(candidates[k].second);
+    }
+
+    // recall, distances of the returned global ids, and the shards a query was sent to
+    using Results = std::vector<std::pair<ANNS::GlobalIdxType, float>>;
+    auto run_search = [&](ANNS::ShardedUniNavGraph &index, const std::string &what, bool is_group) {
+        Results results(num_queries * K);
+        std::vector<float> num_cmps(num_queries);
+        std::vector<ANNS::IdxType> num_searched_shards(num_queries);
+        index.search(query_storage, distance_handler, num_threads, Lsearch, 4, "containment", K, results.data(),
+                     num_cmps, num_searched_shards);
+        size_t num_found = 0, num_expected = 0;
+        bool results_ok = true, shards_ok = true;
+        for (ANNS::IdxType q = 0; q < num_queries; ++q) {
+            num_expected += true_ids[q].size();
+            for (ANNS::IdxType k = 0; k < K; ++k) {
+                auto [id, distance] = results[q * K + k];
+                if (id == -1)
+                    continue;
+                num_found += true_ids[q].count(id);
+                results_ok = results_ok && id < num_points &&
+                             distance == distance_handler->compute(query_storage->get_vector(q),
+                                                                   reinterpret_cast<const char *>(base_vecs[id].data()), dim) &&
+                             (k == 0 || results[q * K + k - 1].second <= distance);
+            }
+
+            // with the group partition {5} lives in one shard and the other queries match 2-3 groups, the range
+            // partition spreads every group over all shards
+            bool only_group_5 = label_sets[q % label_sets.size()] == label_sets[4];
+            if (!is_group)
+                shards_ok = shards_ok && num_searched_shards[q] == num_shards;
+            else
+                shards_ok = shards_ok && (only_group_5 ? num_searched_shards[q] == 1
+                                                       : num_searched_shards[q] >= 1 && num_searched_shards[q] <= num_shards);
+        }
+        float recall = static_cast<float>(num_found) / num_expected;
+        std::cout << "- " << what << ": recall " << recall << std::endl;
+        check(recall >= 0.9, what + " misses points of the scan");
+        check(results_ok, what + " returns wrong ids or distances, or unsorted results");
+        check(shards_ok, what + " sends queries to the wrong shards");
+        return results;
+    };
+
+    for (std::string partition : {"range", "group"}) {
+        std::string index_path_prefix = dir + partition + "_index/";
+        Results results;
+        {
+            ANNS::ShardedUniNavGraph index;
+            index.build("float", dir + "base.bin", dir + "base_labels.txt", "", distance_handler, num_shards, partition,
+                        "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+            check(index.get_num_shards() == num_shards && index.get_num_points() == num_points, partition + " shards");
+            results = run_search(index, partition + " partition", partition == "group");
+            index.save(index_path_prefix, dir + partition + "_");
+        }
+        ANNS::ShardedUniNavGraph index;
+        index.load(index_path_prefix, "float", num_threads);
+        check(run_search(index, partition + " partition, loaded", partition == "group") == results,
+              partition + " partition returns other results after loading");
+    }
+
+    // no shards, an unknown partition, and more shards than groups
+    auto build_throws = [&](ANNS::IdxType shards, const std::string &partition) {
+        try {
+            ANNS::ShardedUniNavGraph index;
+            index.build("float", dir + "base.bin", dir + "base_labels.txt", "", distance_handler, shards, partition,
+                        "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    };
+    check(build_throws(0, "range"), "no shards");
+    check(build_throws(num_shards, "hash"), "unknown partition");
+    check(build_throws(label_sets.size() + 1, "group"), "more shards than groups");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "uni_nav_graph.h"
+
+// deletes: removed points are never returned by search or search_hybrid, before and after consolidate, after a save
+// and load, and after a second round of deletes consolidated in the background; a group whose points are all deleted
+// returns nothing, and the live points are still found
+int main() {
+    const ANNS::IdxType num_points = 3000, dim = 16, num_queries = 40, K = 10, Lsearch = 100;
+    const uint32_t num_threads = 4;
+    const std::string index_path_prefix = "tombstone_index/", results_path_prefix = "tombstone_results/";
+    boost::filesystem::create_directories(results_path_prefix);
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // label sets {1}, {2}, {1, 2} and {3}, the vectors and labels are kept for the exact search
+    std::mt19937 rng(3);
+    std::normal_distribution<float> value_dist;
+    const std::vector<std::vector<ANNS::LabelType>> label_sets = {{1}, {2}, {1, 2}, {3}};
+    auto base_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<std::vector<float>> base_vecs(num_points, std::vector<float>(dim));
+    std::vector<std::vector<ANNS::LabelType>> base_label_sets(num_points);
+    for (ANNS::IdxType i = 0; i < num_points; ++i) {
+        for (auto &value : base_vecs[i])
+            value = value_dist(rng);
+        base_label_sets[i] = label_sets[rng() % label_sets.size()];
+        base_storage->append(reinterpret_cast<const char *>(base_vecs[i].data()), ANNS::LabelSpan(base_label_sets[i]));
+    }
+    auto query_storage = ANNS::create_storage("float", dim, 0);
+    std::vector<float> vec(dim);
+    for (ANNS::IdxType i = 0; i < num_queries; ++i) {
+        for (auto &value : vec)
+            value = value_dist(rng);
+        query_storage->append(reinterpret_cast<const char *>(vec.data()), ANNS::LabelSpan(label_sets[i % label_sets.size()]));
+    }
+    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler("float", "L2");
+
+    // containment search of the live points: no deleted id, and the recall against a scan
+    std::vector<bool> is_deleted(num_points, false);
+    auto check_search = [&](ANNS::UniNavGraph &index, const std::string &what) {
+        ANNS::IdxType num_live = std::count(is_deleted.begin(), is_deleted.end(), false);
+        check(index.get_num_deleted() == num_points - num_live, what + ": number of deleted points");
+        for (bool hybrid : {false, true}) {
+            std::vector<std::pair<ANNS::IdxType, float>> results(num_queries * K);
+            std::vector<float> num_cmps(num_queries);
+            std::vector<ANNS::QueryStats> query_stats;
+            std::vector<std::bitset<10000001>> bitmaps;
+            if (hybrid)
+                index.search_hybrid(query_storage, distance_handler, num_threads, Lsearch, 4, "containment", K,
+                                    results.data(), num_cmps, query_stats, bitmaps, false);
+            else
+                index.search(query_storage, distance_handler, num_threads, Lsearch, 4, "containment", K, results.data(),
+                             num_cmps, query_stats, bitmaps);
+            size_t num_found = 0, num_expected = 0, num_deleted_returned = 0;
+            for (ANNS::IdxType q = 0; q < num_queries; ++q) {
+                auto query_labels = label_sets[q % label_sets.size()];
+                std::vector<std::pair<float, ANNS::IdxType>> candidates;
+                for (ANNS::IdxType id = 0; id < num_points; ++id)
+                    if (!is_deleted[id] && std::includes(base_label_sets[id].begin(), base_label_sets[id].end(),
+                                                         query_labels.begin(), query_labels.end()))
+                        candidates.emplace_back(distance_handler->compute(query_storage->get_vector(q),
+                                                                          reinterpret_cast<const char *>(base_vecs[id].data()), dim),
+                                                id);
+                std::sort(candidates.begin(), candidates.end());
+                std::set<ANNS::IdxType> true_ids;
+                for (size_t k = 0; k < std::min<size_t>(K, candidates.size()); ++k)
+                    true_ids.insert(candidates[k].second);
+                num_expected += true_ids.size();
+                for (ANNS::IdxType k = 0; k < K; ++k) {
+                    auto id = results[q * K + k].first;
+                    if (id == -1)
+                        continue;
+                    num_deleted_returned += id >= num_points || is_deleted[id];
+                    num_found += true_ids.count(id);
+                }
+            }
+            float recall = num_expected == 0 ? 1 : static_cast<float>(num_found) / num_expected;
+            std::string search_name = what + (hybrid ? ", search_hybrid" : ", search");
+            std::cout << "- " << search_name << ": recall " << recall << ", " << num_deleted_returned
+                      << " deleted points returned" << std::endl;
+            check(num_deleted_returned == 0, search_name + " returns deleted points");
+            check(recall >= 0.9, search_name + " misses live points");
+        }
+    };
+
+    // every third point and the whole group {3}, with duplicates and unknown ids
+    std::vector<ANNS::IdxType> deleted_ids;
+    for (ANNS::IdxType id = 0; id < num_points; ++id)
+        if (id % 3 == 0 || base_label_sets[id] == label_sets[3])
+            deleted_ids.push_back(id);
+    ANNS::IdxType num_deleted = deleted_ids.size();
+    deleted_ids.push_back(deleted_ids.front());
+    deleted_ids.push_back(num_points + 5);
+    {
+        ANNS::UniNavGraph index(num_points);
+        index.build(base_storage, distance_handler, "general", "Vamana", num_threads, 6, 32, 100, 1.2);
+        check(index.remove(deleted_ids) == num_deleted, "number of newly deleted points");
+        check(index.remove(deleted_ids) == 0, "deleting again");
+        for (auto id : deleted_ids)
+            if (id < num_points)
+                is_deleted[id] = true;
+        check_search(index, "tombstoned");
+        index.consolidate(distance_handler, num_threads);
+        check_search(index, "consolidated");
+        index.save(index_path_prefix, results_path_prefix);
+    }
+
+    // the tombstones are saved with the index, further deletes are consolidated in the background
+    ANNS::UniNavGraph index(1);
+    index.load(index_path_prefix, "float");
+    check_search(index, "loaded");
+    std::vector<ANNS::IdxType> more_deleted_ids;
+    for (ANNS::IdxType id = 1; id < num_points; id += 4)
+        if (!is_deleted[id]) {
+            more_deleted_ids.push_back(id);
+            is_deleted[id] = true;
+        }
+    check(index.remove(more_deleted_ids) == more_deleted_ids.size(), "number of deleted points after loading");
+    check_search(index, "tombstoned after loading");
+    index.consolidate_async(distance_handler, num_threads).get();
+    check_search(index, "consolidated in the background");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "vecs_io.h"
+
+// the shared vector reader: the format, size and element type sniffed from each extension, rows [begin, end) of
+// every format, 1-byte elements converted to float (signed for .i8bin), and the files and types it rejects
+int main() {
+    const uint32_t num_points = 7, dim = 5;
+    bool ok = true;
+    auto check = [&](bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // element d of row i is i * dim + d - 10, negative for the first rows
+    auto value = [&](uint32_t i, uint32_t d) { return static_cast<int32_t>(i * dim + d) - 10; };
+    auto write_file = [&](const std::string &filename, size_t elem_size, bool row_prefix, uint32_t num_rows) {
+        std::ofstream out(filename, std::ios::binary);
+        if (!row_prefix) {
+            out.write(reinterpret_cast<const char *>(&num_points), sizeof(uint32_t));
+            out.write(reinterpret_cast<const char *>(&dim), sizeof(uint32_t));
+        }
+        for (uint32_t i = 0; i < num_rows; ++i) {
+            if (row_prefix)
+                out.write(reinterpret_cast<const char *>(&dim), sizeof(uint32_t));
+            for (uint32_t d = 0; d < dim; ++d) {
+                float f = value(i, d);
+                int32_t n = value(i, d);
+                int8_t b = value(i, d);
+                out.write(elem_size == 1 ? reinterpret_cast<const char *>(&b)
+                                         : (filename.find("ivecs") != std::string::npos ? reinterpret_cast<const char *>(&n)
+                                                                                        : reinterpret_cast<const char *>(&f)),
+                          elem_size);
+            }
+        }
+    };
+    auto throws = [](auto &&read) {
+        try {
+            read();
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    };
+
+    // extension, format, element size, signedness of 1-byte elements, rows prefixed by their dimension
+    struct Case {
+        std::string filename;
+        ANNS::VecsFormat format;
+        size_t elem_size;
+        bool is_signed, row_prefix;
+    };
+    std::vector<Case> cases = {{"vecs.fvecs", ANNS::VecsFormat::FVECS, 4, false, true},
+                               {"vecs.ivecs", ANNS::VecsFormat::IVECS, 4, false, true},
+                               {"vecs.bvecs", ANNS::VecsFormat::BVECS, 1, false, true},
+                               {"vecs.fbin", ANNS::VecsFormat::FBIN, 4, false, false},
+                               {"vecs.u8bin", ANNS::VecsFormat::U8BIN, 1, false, false},
+                               {"vecs.i8bin", ANNS::VecsFormat::I8BIN, 1, true, false},
+                               {"vecs.bin", ANNS::VecsFormat::UNG_BIN, 4, false, false}};
+    for (const auto &c : cases) {
+        write_file(c.filename, c.elem_size, c.row_prefix, num_points);
+        auto info = ANNS::sniff_vecs_file(c.filename);
+        check(info.format == c.format && info.num_points == num_points && info.dim == dim &&
+                  info.elem_size == c.elem_size && (c.elem_size != 1 || info.is_signed == c.is_signed),
+              "sniffed " + c.filename);
+
+        // rows [2, 5) and a range past the end, which is cut at the last row; row begin is written to out[0]
+        std::vector<float> rows(num_points * dim, 0);
+        std::vector<int32_t> int_rows(num_points * dim, 0);
+        if (c.format == ANNS::VecsFormat::IVECS) {
+            ANNS::read_vecs(c.filename, info, 2, 5, int_rows.data() + 2 * dim);
+            ANNS::read_vecs(c.filename, info, 5, 100, int_rows.data() + 5 * dim);
+            for (uint32_t i = 0; i < num_points * dim; ++i)
+                rows[i] = int_rows[i];
+        } else {
+            ANNS::read_vecs(c.filename, info, 2, 5, rows.data() + 2 * dim);
+            ANNS::read_vecs(c.filename, info, 5, 100, rows.data() + 5 * dim);
+        }
+        bool rows_ok = true;
+        for (uint32_t i = 0; i < num_points; ++i)
+            for (uint32_t d = 0; d < dim; ++d) {
+                float expected = i < 2 ? 0 : value(i, d);
+                if (c.elem_size == 1 && !c.is_signed)
+                    expected = i < 2 ? 0 : static_cast<uint8_t>(value(i, d));
+                rows_ok = rows_ok && rows[i * dim + d] == expected;
+            }
+        check(rows_ok, "rows of " + c.filename);
+
+        // 1-byte rows are only converted to floating point types, wider rows must match the type
+        std::vector<int8_t> byte_rows(num_points * dim);
+        std::vector<int16_t> short_rows(num_points * dim);
+        if (c.elem_size == 1)
+            check(throws([&] { ANNS::read_vecs(c.filename, info, 0, num_points, short_rows.data()); }),
+                  "conversion of " + c.filename + " to an integer type");
+        else
+            check(throws([&] { ANNS::read_vecs(c.filename, info, 0, num_points, byte_rows.data()); }),
+                  "reading " + c.filename + " as bytes");
+    }
+
+    // the UNG .bin does not tell its element type
+    auto info = ANNS::sniff_vecs_file("vecs.bin", 1, true);
+    check(info.elem_size == 1 && info.is_signed, "element type of a .bin given by the caller");
+
+    // unknown extensions, empty files, and sizes that do not match the header
+    {
+        std::ofstream("vecs.txt") << "1 2 3\n";
+        std::ofstream("empty.fvecs");
+    }
+    write_file("short.fvecs", 4, true, num_points);
+    {
+        std::ofstream out("short.fvecs", std::ios::binary | std::ios::app);
+        out.write("xx", 2);
+    }
+    write_file("short.fbin", 4, false, num_points - 1);
+    write_file("short.u8bin", 1, false, num_points - 1);
+    for (std::string filename : {"vecs.txt", "empty.fvecs", "short.fvecs", "short.fbin", "short.u8bin", "missing.fbin"})
+        check(throws([&] { ANNS::sniff_vecs_file(filename); }), "rejects " + filename);
+    return ok ? 0 : 1;
+}
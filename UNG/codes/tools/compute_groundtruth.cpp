@@ -10,6 +10,7 @@ namespace po = boost::program_options;
 int main(int argc, char **argv)
 {
    std::string data_type, dist_fn, base_bin_file, query_bin_file, base_label_file, query_label_file, gt_file, scenario;
+   std::string query_filter_file, label_dict_file, base_numeric_file, query_range_file;
    ANNS::IdxType K;
    uint32_t num_threads;
 
@@ -32,7 +33,15 @@ int main(int argc, char **argv)
       desc.add_options()("gt_file", po::value<std::string>(&gt_file)->required(),
                          "Filename for the writing ground truth in binary format");
       desc.add_options()("scenario", po::value<std::string>(&scenario)->default_value("containment"),
-                         "Type of filter scenario <containment/equality/overlap/nofilter>");
+                         "Type of filter scenario <containment/equality/overlap/nofilter/expression>");
+      desc.add_options()("query_filter_file", po::value<std::string>(&query_filter_file)->default_value(""),
+                         "Boolean filter of each query, one per line (expression scenario)");
+      desc.add_options()("label_dict_file", po::value<std::string>(&label_dict_file)->default_value(""),
+                         "CSR label file whose dictionary resolves label names in the filters");
+      desc.add_options()("base_numeric_file", po::value<std::string>(&base_numeric_file)->default_value(""),
+                         "Numeric attributes of the base vectors (float .bin)");
+      desc.add_options()("query_range_file", po::value<std::string>(&query_range_file)->default_value(""),
+                         "Numeric ranges of each query, one line of \"column lo hi\" triples per query");
       desc.add_options()("K", po::value<ANNS::IdxType>(&K)->required(),
                          "Number of ground truth nearest neighbors to compute");
       desc.add_options()("num_threads", po::value<uint32_t>(&num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
@@ -58,6 +67,8 @@ int main(int argc, char **argv)
    std::shared_ptr<ANNS::IStorage> query_storage = ANNS::create_storage(data_type);
    base_storage->load_from_file(base_bin_file, base_label_file);
    query_storage->load_from_file(query_bin_file, query_label_file);
+   if (!base_numeric_file.empty())
+      base_storage->load_numeric_attrs(base_numeric_file);
 
    // preparation
    std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
@@ -67,7 +78,26 @@ int main(int argc, char **argv)
 
    // run
    ANNS::FilteredScan algo;
-   algo.run(base_storage, query_storage, distance_handler, scenario, num_threads, K, groundtruth);
+   std::vector<std::vector<ANNS::NumericRange>> query_ranges;
+   if (!query_range_file.empty())
+   {
+      query_ranges = ANNS::load_numeric_ranges(query_range_file);
+      if (query_ranges.size() != query_storage->get_num_points() || base_storage->get_num_numeric_attrs() == 0)
+      {
+         std::cerr << "query_range_file needs one line per query and base_numeric_file" << std::endl;
+         return -1;
+      }
+      algo.set_query_ranges(&query_ranges);
+   }
+   if (scenario == "expression")
+   {
+      auto name_to_label = label_dict_file.empty() ? std::unordered_map<std::string, ANNS::LabelType>()
+                                                   : ANNS::load_label_names(label_dict_file);
+      auto filters = ANNS::load_filter_exprs(query_filter_file, name_to_label);
+      algo.run(base_storage, query_storage, distance_handler, filters, num_threads, K, groundtruth);
+   }
+   else
+      algo.run(base_storage, query_storage, distance_handler, scenario, num_threads, K, groundtruth);
    auto time_cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
    std::cout << "Time cost: " << time_cost << "ms" << std::endl;
 
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "label_io.h"
+
+namespace po = boost::program_options;
+
+
+/*
+convert label files between the text format (one line per vector, comma separated labels) and
+the binary CSR format of label_csr.h, which Storage::load_from_file and the ACORN demos read directly
+*/
+
+int main(int argc, char** argv) {
+    std::string input_file, output_file, dict_file;
+    bool remap, with_names;
+    try {
+        po::options_description desc{"Arguments"};
+
+        desc.add_options()("help", "Print information on arguments");
+        desc.add_options()("input_file", po::value<std::string>(&input_file)->required(),
+                           "Input label file, txt or CSR");
+        desc.add_options()("output_file", po::value<std::string>(&output_file)->required(),
+                           "Output label file, CSR if the input is txt and txt otherwise");
+        desc.add_options()("remap", po::value<bool>(&remap)->default_value(false),
+                           "txt -> CSR: renumber string labels from 1 and store them in the dictionary");
+        desc.add_options()("dict_file", po::value<std::string>(&dict_file)->default_value(""),
+                           "txt -> CSR: CSR file whose dictionary is reused, e.g. the base labels for query labels");
+        desc.add_options()("with_names", po::value<bool>(&with_names)->default_value(false),
+                           "CSR -> txt: write the dictionary names instead of the label ids");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc;
+            return 0;
+        }
+        po::notify(vm);
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << '\n';
+        return -1;
+    }
+
+    if (ANNS::is_label_csr_file(input_file)) {
+        ANNS::convert_label_csr_to_txt(input_file, output_file, with_names);
+        std::cout << "Converted CSR labels " << input_file << " to txt " << output_file << std::endl;
+    } else {
+        ANNS::convert_label_txt_to_csr(input_file, output_file, remap, dict_file);
+        std::cout << "Converted txt labels " << input_file << " to CSR " << output_file << std::endl;
+    }
+    return 0;
+}
@@ -2,7 +2,10 @@
 #include <iostream>
 #include <cstring>
 #include <boost/program_options.hpp>
+#include <vector>
+#include <algorithm>
 #include "config.h"
+#include "vecs_io.h"
 
 namespace po = boost::program_options;
 
@@ -10,6 +13,7 @@ namespace po = boost::program_options;
 /*
 .fvec files start with 4 bytes for the number of dimensions, then each vector takes 4+dim*4 bytes
 .bin files start with 4 bytes for the number of vectors, then 4 bytes for the number of dimensions, and each vector takes dim*4 bytes
+Storage::load_from_file reads .fvecs/.bvecs/.fbin/.u8bin/.i8bin directly, so this conversion is optional
 */
 
 int main(int argc, char** argv) {
@@ -46,14 +50,10 @@ int main(int argc, char** argv) {
         exit(-1);
     }
 
-    // obtain dimension and number of vectors
-    uint32_t dim;
-    ANNS::IdxType num_vecs;
-    std::ifstream fvec_file(input_file, std::ios::binary | std::ios::ate);
-    size_t file_size = fvec_file.tellg();
-    fvec_file.seekg(0, std::ios::beg);
-    fvec_file.read((char *)&dim, sizeof(uint32_t));
-    num_vecs = file_size / (dim * data_size + sizeof(uint32_t));
+    // obtain dimension and number of vectors, any format known by vecs_io.h is accepted
+    auto info = ANNS::sniff_vecs_file(input_file, data_size, data_type == "int8");
+    uint32_t dim = info.dim;
+    ANNS::IdxType num_vecs = info.num_points;
     std::cout << "Dataset: #pts = " << num_vecs << ", # dims = " << dim << std::endl;
 
     // dump to binary file
@@ -61,18 +61,19 @@ int main(int argc, char** argv) {
     bin_file.write((char *)&num_vecs, sizeof(ANNS::IdxType));
     bin_file.write((char *)&dim, sizeof(uint32_t));
 
-    // dump vector data from fvec_file to bin_file
-    char *buffer = new char[dim * data_size], *tmp = new char[sizeof(uint32_t)];
-    for (ANNS::IdxType i = 0; i < num_vecs; i++) {
-        if (i > 0)
-            fvec_file.read(tmp, sizeof(uint32_t));
-        fvec_file.read(buffer, dim * data_size);
-        bin_file.write(buffer, dim * data_size);
+    // dump vector data in blocks of rows
+    size_t block_rows = std::max<size_t>(1, (256ul << 20) / (dim * data_size));
+    std::vector<char> buffer(block_rows * dim * data_size);
+    for (size_t begin = 0; begin < num_vecs; begin += block_rows) {
+        size_t end = std::min<size_t>(num_vecs, begin + block_rows);
+        if (data_type == "float")
+            ANNS::read_vecs(input_file, info, begin, end, (float *)buffer.data());
+        else
+            ANNS::read_vecs(input_file, info, begin, end, (uint8_t *)buffer.data());
+        bin_file.write(buffer.data(), (end - begin) * dim * data_size);
     }
-    delete[] buffer;
 
     // clean
-    fvec_file.close();
     bin_file.close();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "uni_nav_graph.h"
+#include "utils.h"
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+   std::string data_type, dist_fn, index_path_prefix, query_pool_bin_file, output_prefix, dataset, bands;
+   ANNS::WorkloadConfig config;
+
+   try
+   {
+      po::options_description desc{"Arguments"};
+      desc.add_options()("help,h", "Print information on arguments");
+      desc.add_options()("data_type", po::value<std::string>(&data_type)->required(),
+                         "data type <int8/uint8/float>");
+      desc.add_options()("dist_fn", po::value<std::string>(&dist_fn)->required(),
+                         "distance function <L2/IP/cosine>");
+      desc.add_options()("index_path_prefix", po::value<std::string>(&index_path_prefix)->required(),
+                         "Prefix of the UNG index (with vector_attr_graph)");
+      desc.add_options()("query_pool_bin_file", po::value<std::string>(&query_pool_bin_file)->default_value(""),
+                         "Vectors to draw the query vectors from, random base vectors when empty (excluded from their own ground truth)");
+      desc.add_options()("output_prefix", po::value<std::string>(&output_prefix)->required(),
+                         "Output directory (with trailing /) or prefix of the workload files");
+      desc.add_options()("dataset", po::value<std::string>(&dataset)->required(),
+                         "Dataset name, prefix of the workload file names");
+      desc.add_options()("selectivity_bands", po::value<std::string>(&bands)->default_value("0.0001,0.001,0.01,0.1,1.01"),
+                         "Comma separated bounds of the selectivity bands, band i is [b_i, b_{i+1})");
+      desc.add_options()("queries_per_band", po::value<ANNS::IdxType>(&config.queries_per_band)->default_value(100),
+                         "Number of queries (distinct label sets) per band");
+      desc.add_options()("K", po::value<ANNS::IdxType>(&config.K)->default_value(10),
+                         "Number of ground truth nearest neighbors to compute");
+      desc.add_options()("num_threads", po::value<uint32_t>(&config.num_threads)->default_value(ANNS::default_paras::NUM_THREADS),
+                         "Number of threads to use");
+      desc.add_options()("seed", po::value<uint64_t>(&config.seed)->default_value(0),
+                         "Random seed, the workload only depends on the seed");
+      desc.add_options()("max_rounds", po::value<ANNS::IdxType>(&config.max_rounds)->default_value(100),
+                         "Maximum number of sampling rounds");
+      desc.add_options()("attempts_per_round", po::value<ANNS::IdxType>(&config.attempts_per_round)->default_value(4096),
+                         "Number of candidate label sets sampled in parallel per round");
+
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help"))
+      {
+         std::cout << desc;
+         return 0;
+      }
+      po::notify(vm);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+
+   std::stringstream ss(bands);
+   std::string bound;
+   while (std::getline(ss, bound, ','))
+      config.band_bounds.push_back(std::stod(bound));
+
+   // load index and the vector-attribute graph
+   ANNS::UniNavGraph index(1);
+   index.load(index_path_prefix, data_type);
+   index.load_bipartite_graph(index_path_prefix + "vector_attr_graph");
+
+   std::shared_ptr<ANNS::IStorage> query_pool = nullptr;
+   if (!query_pool_bin_file.empty())
+   {
+      query_pool = ANNS::create_storage(data_type);
+      query_pool->load_from_file(query_pool_bin_file, "");
+   }
+
+   // generate
+   std::shared_ptr<ANNS::DistanceHandler> distance_handler = ANNS::get_distance_handler(data_type, dist_fn);
+   try
+   {
+      index.generate_workload(config, distance_handler, output_prefix, dataset, query_pool);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << ex.what() << std::endl;
+      return -1;
+   }
+   return 0;
+}
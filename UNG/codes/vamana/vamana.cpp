@@ -59,22 +59,7 @@ namespace ANNS
       for (auto id = 0; id < num_points; ++id)
       {
          auto search_cache = search_cache_list.get_free_cache();
-
-         // search for point
-         const char *query = _base_storage->get_vector(id);
-
-         iterate_to_fixed_point(query, search_cache, true, id);
-
-         // prune for candidate neighbors
-         std::vector<IdxType> pruned_list;
-         prune_neighbors(id, search_cache->expanded_list, pruned_list, search_cache);
-
-         // update neighbors and insert the reversed edge
-         {
-            std::lock_guard<std::mutex> lock(_graph->neighbor_locks[id]);
-            _graph->neighbors[id] = pruned_list;
-         }
-         inter_insert(id, pruned_list, search_cache);
+         link_point(id, search_cache);
 
          // clean and print
          search_cache_list.release_cache(search_cache);
@@ -103,6 +88,24 @@ namespace ANNS
          }
    }
 
+   void Vamana::link_point(IdxType id, std::shared_ptr<SearchCache> search_cache)
+   {
+      // search for point
+      const char *query = _base_storage->get_vector(id);
+      iterate_to_fixed_point(query, search_cache, true, id);
+
+      // prune for candidate neighbors
+      std::vector<IdxType> pruned_list;
+      prune_neighbors(id, search_cache->expanded_list, pruned_list, search_cache);
+
+      // update neighbors and insert the reversed edge
+      {
+         std::lock_guard<std::mutex> lock(_graph->neighbor_locks[id]);
+         _graph->neighbors[id] = pruned_list;
+      }
+      inter_insert(id, pruned_list, search_cache);
+   }
+
    IdxType Vamana::iterate_to_fixed_point(const char *query, std::shared_ptr<SearchCache> search_cache,
                                           bool record_expanded, IdxType target_id)
    {
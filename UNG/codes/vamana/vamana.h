@@ -33,6 +33,21 @@ namespace ANNS
       IdxType iterate_to_fixed_point(const char *query, std::shared_ptr<SearchCache> search_cache,
                                      bool record_expanded = false, IdxType target_id = -1);
 
+      // robust pruning on a built graph (e.g. for inserted points), with the parameters of set_build_params
+      void set_build_params(IdxType max_degree, IdxType Lbuild, float alpha,
+                            IdxType max_candidate_size = default_paras::MAX_CANDIDATE_SIZE)
+      {
+         _max_degree = max_degree;
+         _Lbuild = Lbuild;
+         _alpha = alpha;
+         _max_candidate_size = max_candidate_size;
+      }
+      void prune_neighbors(IdxType id, std::vector<Candidate> &candidates, std::vector<IdxType> &pruned_list,
+                           std::shared_ptr<SearchCache> search_cache);
+      // link point id into the graph as the build does: greedy search from the entry point, robust pruning and the
+      // reversed edges; the adjacency lists are locked, so points may be linked concurrently
+      void link_point(IdxType id, std::shared_ptr<SearchCache> search_cache);
+
       // stats and I/O
       void statistics();
       void save(std::string &index_path_prefix);
@@ -53,8 +68,6 @@ namespace ANNS
       std::shared_ptr<Graph> _graph;
       std::shared_ptr<Graph> _all_graph;
       void link();
-      void prune_neighbors(IdxType id, std::vector<Candidate> &candidates, std::vector<IdxType> &pruned_list,
-                           std::shared_ptr<SearchCache> search_cache);
       void inter_insert(IdxType src, std::vector<IdxType> &src_neighbors, std::shared_ptr<SearchCache> search_cache);
 
       // for logs
@@ -0,0 +1,196 @@
+#ifndef ANNS_LABEL_CSR_H
+#define ANNS_LABEL_CSR_H
+
+// header-only mmap reader of the binary CSR label format, shared by UNG and the ACORN demos
+//
+// file layout (little endian):
+//   uint32 magic "LCSR", uint32 version,
+//   uint64 num_points, uint64 num_entries,
+//   uint64 offsets[num_points + 1], uint16 labels[num_entries],
+//   version >= 2: uint64 dict_size, then dict_size x (uint32 len, char name[len])
+// labels of point i are labels[offsets[i], offsets[i + 1]), sorted
+// the dictionary gives the original name of each label id, it is empty when the ids are the original labels
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ANNS
+{
+
+   const uint32_t LABEL_CSR_MAGIC = 0x5253434c;
+   const uint32_t LABEL_CSR_VERSION = 2;
+   const size_t LABEL_CSR_HEADER_SIZE = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+   inline bool is_label_csr_file(const std::string &filename)
+   {
+      std::ifstream in(filename, std::ios::binary);
+      uint32_t magic = 0;
+      if (!in.read((char *)&magic, sizeof(uint32_t)))
+         return false;
+      return magic == LABEL_CSR_MAGIC;
+   }
+
+   class LabelCSR
+   {
+   public:
+      LabelCSR() = default;
+      explicit LabelCSR(const std::string &filename) { open(filename); }
+      ~LabelCSR() { close(); }
+      LabelCSR(const LabelCSR &) = delete;
+      LabelCSR &operator=(const LabelCSR &) = delete;
+
+      void open(const std::string &filename)
+      {
+         close();
+         int fd = ::open(filename.c_str(), O_RDONLY);
+         if (fd < 0)
+            throw std::runtime_error("Failed to open file: " + filename);
+         struct stat st;
+         fstat(fd, &st);
+         _file_size = st.st_size;
+         if (_file_size < LABEL_CSR_HEADER_SIZE)
+         {
+            ::close(fd);
+            throw std::runtime_error("Invalid label CSR file: " + filename);
+         }
+         _file = static_cast<char *>(mmap(nullptr, _file_size, PROT_READ, MAP_SHARED, fd, 0));
+         ::close(fd);
+         if (_file == MAP_FAILED)
+         {
+            _file = nullptr;
+            throw std::runtime_error("Failed to mmap file: " + filename);
+         }
+
+         uint32_t header[2];
+         std::memcpy(header, _file, sizeof(header));
+         std::memcpy(&_num_points, _file + 2 * sizeof(uint32_t), sizeof(uint64_t));
+         std::memcpy(&_num_entries, _file + 2 * sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint64_t));
+         // counts are checked against the remaining bytes before they are multiplied, so they cannot overflow
+         size_t body_size = _file_size - LABEL_CSR_HEADER_SIZE;
+         bool counts_fit = _num_points < body_size / sizeof(uint64_t) &&
+                           _num_entries <= (body_size - (_num_points + 1) * sizeof(uint64_t)) / sizeof(uint16_t);
+         size_t labels_end = counts_fit ? LABEL_CSR_HEADER_SIZE + (_num_points + 1) * sizeof(uint64_t) + _num_entries * sizeof(uint16_t) : 0;
+         if (header[0] != LABEL_CSR_MAGIC || header[1] == 0 || header[1] > LABEL_CSR_VERSION || !counts_fit)
+         {
+            close();
+            throw std::runtime_error("Invalid label CSR file: " + filename);
+         }
+         _offsets = reinterpret_cast<const uint64_t *>(_file + LABEL_CSR_HEADER_SIZE);
+         _labels = reinterpret_cast<const uint16_t *>(_offsets + _num_points + 1);
+
+         // the rows must lie inside the label array and be sorted, the readers index and intersect them directly
+         bool rows_valid = _offsets[0] == 0 && _offsets[_num_points] <= _num_entries;
+         for (uint64_t i = 0; rows_valid && i < _num_points; ++i)
+         {
+            rows_valid = _offsets[i] <= _offsets[i + 1] && _offsets[i + 1] <= _offsets[_num_points];
+            for (uint64_t j = _offsets[i] + 1; rows_valid && j < _offsets[i + 1]; ++j)
+               rows_valid = _labels[j - 1] <= _labels[j];
+         }
+         if (!rows_valid)
+         {
+            close();
+            throw std::runtime_error("Invalid label rows in " + filename);
+         }
+
+         // dictionary
+         if (header[1] >= 2 && _file_size >= labels_end + sizeof(uint64_t))
+         {
+            uint64_t dict_size;
+            const char *p = _file + labels_end;
+            std::memcpy(&dict_size, p, sizeof(uint64_t));
+            p += sizeof(uint64_t);
+            // every count and length must fit in the bytes that are left
+            size_t remaining = _file_size - labels_end - sizeof(uint64_t);
+            bool fits = dict_size <= remaining / sizeof(uint32_t);
+            if (fits)
+               _dictionary.resize(dict_size);
+            for (auto &name : _dictionary)
+            {
+               uint32_t len;
+               if (remaining < sizeof(uint32_t))
+               {
+                  fits = false;
+                  break;
+               }
+               std::memcpy(&len, p, sizeof(uint32_t));
+               p += sizeof(uint32_t);
+               remaining -= sizeof(uint32_t);
+               if (len > remaining)
+               {
+                  fits = false;
+                  break;
+               }
+               name.assign(p, len);
+               p += len;
+               remaining -= len;
+            }
+            if (!fits)
+            {
+               close();
+               throw std::runtime_error("Invalid label dictionary in " + filename);
+            }
+         }
+      }
+
+      void close()
+      {
+         if (_file)
+            munmap(_file, _file_size);
+         _file = nullptr;
+         _file_size = 0;
+         _num_points = _num_entries = 0;
+         _offsets = nullptr;
+         _labels = nullptr;
+         _dictionary.clear();
+      }
+
+      uint64_t num_points() const { return _num_points; }
+      uint64_t num_entries() const { return _num_entries; }
+      const std::vector<std::string> &dictionary() const { return _dictionary; }
+
+      // labels of point i, valid while the file is open
+      const uint16_t *begin(uint64_t i) const { return _labels + _offsets[i]; }
+      const uint16_t *end(uint64_t i) const { return _labels + _offsets[i + 1]; }
+      uint64_t size(uint64_t i) const { return _offsets[i + 1] - _offsets[i]; }
+      const uint64_t *offsets() const { return _offsets; }
+      const uint16_t *labels() const { return _labels; }
+
+      // hint the kernel that the label array is about to be scanned
+      void advise_sequential() const
+      {
+         madvise(_file, _file_size, MADV_SEQUENTIAL);
+      }
+
+      // copy points [first, first + num) out as one vector per point,
+      // e.g. as the metadata_multi of ACORN indices
+      template <typename IntT>
+      std::vector<std::vector<IntT>> to_vectors(uint64_t first = 0, uint64_t num = UINT64_MAX) const
+      {
+         first = std::min(first, _num_points);
+         num = std::min(num, _num_points - first);
+         std::vector<std::vector<IntT>> vecs(num);
+         for (uint64_t i = 0; i < num; ++i)
+            vecs[i].assign(begin(first + i), end(first + i));
+         return vecs;
+      }
+
+   private:
+      char *_file = nullptr;
+      size_t _file_size = 0;
+      uint64_t _num_points = 0, _num_entries = 0;
+      const uint64_t *_offsets = nullptr;
+      const uint16_t *_labels = nullptr;
+      std::vector<std::string> _dictionary;
+   };
+}
+
+#endif // ANNS_LABEL_CSR_H
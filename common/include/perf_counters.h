@@ -0,0 +1,139 @@
+#ifndef ANNS_PERF_COUNTERS_H
+#define ANNS_PERF_COUNTERS_H
+
+// header-only reader of the per-thread hardware counters, shared by UNG and ACORN (faiss::PerfCounters)
+
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace ANNS
+{
+
+   // hardware counter values, a counter the kernel does not provide stays 0
+   struct PerfCounterValues
+   {
+      uint64_t cycles = 0;
+      uint64_t instructions = 0;
+      uint64_t llc_misses = 0;
+      uint64_t dtlb_misses = 0;
+
+      void add(const PerfCounterValues &other)
+      {
+         cycles += other.cycles;
+         instructions += other.instructions;
+         llc_misses += other.llc_misses;
+         dtlb_misses += other.dtlb_misses;
+      }
+   };
+
+   // counters of the calling thread (cycles, instructions, LLC misses, dTLB load misses) as one perf_event_open group,
+   // must be created, started and stopped on the same thread
+   // without a PMU (VMs, containers with perf_event_paranoid or seccomp) available() is false and start/stop do nothing
+   class PerfCounters
+   {
+   public:
+      PerfCounters();
+      ~PerfCounters();
+      PerfCounters(const PerfCounters &) = delete;
+      PerfCounters &operator=(const PerfCounters &) = delete;
+
+      bool available() const { return _group_fd >= 0; }
+
+      // reset and enable the group
+      void start();
+
+      // disable the group and read it, scaled up if the kernel multiplexed the counters
+      PerfCounterValues stop();
+
+   private:
+      static const int NUM_EVENTS = 4;
+      int _group_fd = -1;
+      int _fds[NUM_EVENTS];
+      int _num_opened = 0;
+      int _slots[NUM_EVENTS]; // event index of each opened counter, in group read order
+   };
+
+#ifdef __linux__
+
+   inline PerfCounters::PerfCounters()
+   {
+      const uint32_t types[NUM_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+      const uint64_t configs[NUM_EVENTS] = {
+          PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+          PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+      // cycles lead the group, the other events are optional members
+      for (int i = 0; i < NUM_EVENTS; ++i)
+      {
+         perf_event_attr attr;
+         std::memset(&attr, 0, sizeof(attr));
+         attr.size = sizeof(attr);
+         attr.type = types[i];
+         attr.config = configs[i];
+         attr.disabled = _group_fd < 0;
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+         attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+         int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _group_fd, 0);
+         if (fd < 0)
+         {
+            if (_group_fd < 0)
+               return;
+            continue;
+         }
+         if (_group_fd < 0)
+            _group_fd = fd;
+         _fds[_num_opened] = fd;
+         _slots[_num_opened++] = i;
+      }
+   }
+
+   inline PerfCounters::~PerfCounters()
+   {
+      for (int i = 0; i < _num_opened; ++i)
+         close(_fds[i]);
+   }
+
+   inline void PerfCounters::start()
+   {
+      if (_group_fd < 0)
+         return;
+      ioctl(_group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(_group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+
+   inline PerfCounterValues PerfCounters::stop()
+   {
+      PerfCounterValues values;
+      if (_group_fd < 0)
+         return values;
+      ioctl(_group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+      // nr, time_enabled, time_running, then one value per opened counter
+      uint64_t buf[3 + NUM_EVENTS];
+      if (read(_group_fd, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)_num_opened)
+         return values;
+      double scale = buf[2] > 0 ? (double)buf[1] / buf[2] : 0.0;
+      uint64_t *fields[NUM_EVENTS] = {&values.cycles, &values.instructions, &values.llc_misses, &values.dtlb_misses};
+      for (int i = 0; i < _num_opened; ++i)
+         *fields[_slots[i]] = buf[3 + i] * scale;
+      return values;
+   }
+
+#else
+
+   inline PerfCounters::PerfCounters() {}
+   inline PerfCounters::~PerfCounters() {}
+   inline void PerfCounters::start() {}
+   inline PerfCounterValues PerfCounters::stop() { return PerfCounterValues(); }
+
+#endif
+}
+
+#endif // ANNS_PERF_COUNTERS_H
@@ -0,0 +1,174 @@
+#ifndef ANNS_VECS_IO_H
+#define ANNS_VECS_IO_H
+
+// header-only reader for vector files, shared by UNG (Storage) and the ACORN demos
+// supported formats, sniffed from the extension and the file size (other extensions are rejected):
+//   .fvecs/.ivecs/.bvecs: each row is a uint32 dim followed by dim elements (4/4/1 bytes)
+//   .fbin/.u8bin/.i8bin and the UNG .bin: uint32 num, uint32 dim, then num * dim elements
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ANNS
+{
+
+   enum class VecsFormat
+   {
+      FVECS,
+      IVECS,
+      BVECS,
+      FBIN,
+      U8BIN,
+      I8BIN,
+      UNG_BIN
+   };
+
+   struct VecsFileInfo
+   {
+      VecsFormat format;
+      size_t num_points;
+      size_t dim;
+      size_t elem_size;   // bytes per element
+      size_t header_size; // bytes before the first row
+      size_t row_prefix;  // bytes before the elements of each row
+      bool is_signed;     // for 1-byte elements
+      size_t row_bytes() const { return row_prefix + dim * elem_size; }
+   };
+
+   inline bool vecs_has_suffix(const std::string &filename, const std::string &suffix)
+   {
+      return filename.size() >= suffix.size() &&
+             filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+   }
+
+   // elem_size is only used for the UNG .bin, where the file does not tell the type
+   inline VecsFileInfo sniff_vecs_file(const std::string &filename, size_t elem_size = 4, bool is_signed = false)
+   {
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+         throw std::runtime_error("Failed to open file: " + filename);
+      struct stat st;
+      fstat(fd, &st);
+      size_t file_size = st.st_size;
+      uint32_t header[2] = {0, 0};
+      ssize_t ret = pread(fd, header, sizeof(header), 0);
+      close(fd);
+      if (ret < (ssize_t)sizeof(uint32_t))
+         throw std::runtime_error("Empty vector file: " + filename);
+
+      VecsFileInfo info;
+      info.is_signed = is_signed;
+      bool is_fvecs = vecs_has_suffix(filename, ".fvecs"), is_ivecs = vecs_has_suffix(filename, ".ivecs");
+      if (is_fvecs || is_ivecs || vecs_has_suffix(filename, ".bvecs"))
+      {
+         info.format = is_fvecs ? VecsFormat::FVECS : (is_ivecs ? VecsFormat::IVECS : VecsFormat::BVECS);
+         info.elem_size = info.format == VecsFormat::BVECS ? 1 : 4;
+         info.is_signed = false;
+         info.dim = header[0];
+         info.header_size = 0;
+         info.row_prefix = sizeof(uint32_t);
+         if (info.dim == 0 || file_size % info.row_bytes() != 0)
+            throw std::runtime_error("Invalid vecs file size: " + filename);
+         info.num_points = file_size / info.row_bytes();
+         return info;
+      }
+
+      if (vecs_has_suffix(filename, ".bin"))
+      {
+         info.format = VecsFormat::UNG_BIN;
+         info.elem_size = elem_size;
+      }
+      else if (vecs_has_suffix(filename, ".fbin"))
+      {
+         info.format = VecsFormat::FBIN;
+         info.elem_size = 4;
+      }
+      else if (vecs_has_suffix(filename, ".u8bin") || vecs_has_suffix(filename, ".i8bin"))
+      {
+         info.format = vecs_has_suffix(filename, ".u8bin") ? VecsFormat::U8BIN : VecsFormat::I8BIN;
+         info.elem_size = 1;
+         info.is_signed = info.format == VecsFormat::I8BIN;
+      }
+      else
+         throw std::runtime_error("Unknown vector file extension: " + filename);
+      info.num_points = header[0];
+      info.dim = header[1];
+      info.header_size = 2 * sizeof(uint32_t);
+      info.row_prefix = 0;
+      if (ret < (ssize_t)sizeof(header) || file_size < info.header_size + info.num_points * info.row_bytes())
+         throw std::runtime_error("Invalid bin file size: " + filename);
+      return info;
+   }
+
+   // read rows [begin, end) into out (row-major, dim elements per row)
+   // 1-byte elements are converted when T is wider, other type mismatches are rejected
+   template <typename T>
+   void read_vecs(const std::string &filename, const VecsFileInfo &info, size_t begin, size_t end, T *out)
+   {
+      end = std::min(end, info.num_points);
+      if (begin >= end)
+         return;
+      bool convert = sizeof(T) != info.elem_size;
+      if (convert && (info.elem_size != 1 || !std::is_floating_point<T>::value))
+         throw std::runtime_error("Element type of " + filename + " does not match the data type");
+
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+         throw std::runtime_error("Failed to open file: " + filename);
+      struct stat st;
+      fstat(fd, &st);
+      size_t file_size = st.st_size;
+      char *file = static_cast<char *>(mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+      close(fd);
+      if (file == MAP_FAILED)
+         throw std::runtime_error("Failed to mmap file: " + filename);
+
+      // the range is read once from front to back
+      size_t range_start = info.header_size + begin * info.row_bytes();
+      size_t range_end = info.header_size + end * info.row_bytes();
+      size_t page_start = range_start & ~size_t(4095);
+      madvise(file + page_start, range_end - page_start, MADV_SEQUENTIAL);
+
+      // copy in blocks of rows, each block is a large sequential read
+      const char *src = file + range_start;
+      size_t row_bytes = info.row_bytes(), row_prefix = info.row_prefix, dim = info.dim;
+      size_t num_rows = end - begin;
+      size_t block_rows = std::max<size_t>(1, (16ul << 20) / row_bytes);
+      int64_t num_blocks = (num_rows + block_rows - 1) / block_rows;
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t b = 0; b < num_blocks; ++b)
+      {
+         size_t row_begin = b * block_rows, row_end = std::min(num_rows, row_begin + block_rows);
+         const char *block = src + row_begin * row_bytes;
+         T *dst = out + row_begin * dim;
+         if (!convert && row_prefix == 0)
+         {
+            std::memcpy(dst, block, (row_end - row_begin) * row_bytes);
+            continue;
+         }
+         for (size_t i = row_begin; i < row_end; ++i, block += row_bytes, dst += dim)
+         {
+            const char *elems = block + row_prefix;
+            if (!convert)
+               std::memcpy(dst, elems, dim * sizeof(T));
+            else if (info.is_signed)
+               for (size_t d = 0; d < dim; ++d)
+                  dst[d] = static_cast<T>(reinterpret_cast<const int8_t *>(elems)[d]);
+            else
+               for (size_t d = 0; d < dim; ++d)
+                  dst[d] = static_cast<T>(reinterpret_cast<const uint8_t *>(elems)[d]);
+         }
+      }
+      munmap(file, file_size);
+   }
+}
+
+#endif // ANNS_VECS_IO_H